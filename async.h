@@ -0,0 +1,563 @@
+#ifndef ASYNC_H
+#define ASYNC_H
+
+// Coroutine API for lookups, inserts and removes with many requests in
+// flight per thread. Needs C++20; the rest of the library stays C++17.
+//
+//     AsyncExecutor executor(0.0001);  // 100 us per message
+//     executor.spawn(findAsync(*node, key, executor), [](const LookupResult& r) { ... });
+//     executor.run();
+//
+// Inside a coroutine: LookupResult r = co_await findAsync(*node, key, executor);
+
+#include <stdint.h>
+#include <stddef.h>
+#include <algorithm>
+#include <chrono>
+#include <coroutine>
+#include <deque>
+#include <exception>
+#include <map>
+#include <queue>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+#include "node.h"
+
+// Coroutine that produces a T, started when first awaited. Awaiting it
+// suspends the caller until the task returns, then resumes the caller in place.
+template <typename T>
+class AsyncTask {
+public:
+    struct promise_type {
+        T value;
+        std::coroutine_handle<> continuation;
+
+        AsyncTask get_return_object() {
+            return AsyncTask(std::coroutine_handle<promise_type>::from_promise(*this));
+        }
+
+        std::suspend_always initial_suspend() noexcept {
+            return {};
+        }
+
+        // Hand control straight back to the awaiting coroutine
+        struct FinalAwaiter {
+            bool await_ready() noexcept {
+                return false;
+            }
+            std::coroutine_handle<> await_suspend(std::coroutine_handle<promise_type> done) noexcept {
+                std::coroutine_handle<> next = done.promise().continuation;
+                return next ? next : std::noop_coroutine();
+            }
+            void await_resume() noexcept {
+            }
+        };
+
+        FinalAwaiter final_suspend() noexcept {
+            return {};
+        }
+
+        void return_value(T result) {
+            value = std::move(result);
+        }
+
+        void unhandled_exception() {
+            std::terminate();
+        }
+    };
+
+    AsyncTask(AsyncTask&& other) noexcept : handle_(std::exchange(other.handle_, nullptr)) {
+    }
+
+    AsyncTask(const AsyncTask&) = delete;
+    AsyncTask& operator=(const AsyncTask&) = delete;
+
+    ~AsyncTask() {
+        if (handle_) {
+            handle_.destroy();
+        }
+    }
+
+    bool await_ready() const {
+        return false;
+    }
+
+    std::coroutine_handle<> await_suspend(std::coroutine_handle<> caller) {
+        handle_.promise().continuation = caller;
+        return handle_;
+    }
+
+    T await_resume() {
+        return std::move(handle_.promise().value);
+    }
+
+private:
+    explicit AsyncTask(std::coroutine_handle<promise_type> handle) : handle_(handle) {
+    }
+
+    std::coroutine_handle<promise_type> handle_;
+};
+
+// Lookups an executor's coalescing saved (AsyncExecutor::enableCoalescing)
+struct CoalescingStats {
+    uint64_t routes = 0;     // Lookups that routed on their own
+    uint64_t sameKey = 0;    // ... that waited for a concurrent route to the same key instead
+    uint64_t sameRange = 0;  // ... cut short by a concurrent route that resolved their key's range
+
+    uint64_t collapsed() const {
+        return sameKey + sameRange;
+    }
+};
+
+// Single-threaded event loop that carries coroutines between nodes. Every
+// message an async operation sends suspends it; the executor resumes it once
+// the message's latency has passed on the steady clock, running other
+// operations meanwhile. A thread may run several executors one after the
+// other, and several threads each their own; nodes shared between threads
+// need Node::enableConcurrency.
+class AsyncExecutor {
+public:
+    typedef std::chrono::steady_clock Clock;
+
+    /**
+     * @param messageLatency: seconds every message spends on the wire; 0
+     *                        delivers it as soon as the executor gets to it.
+     */
+    explicit AsyncExecutor(double messageLatency = 0.0)
+        : latency_(std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(messageLatency))) {
+    }
+
+    AsyncExecutor(const AsyncExecutor&) = delete;
+    AsyncExecutor& operator=(const AsyncExecutor&) = delete;
+
+    // Awaitable message from one node to another; the awaiting coroutine
+    // continues when it arrives
+    struct Message {
+        AsyncExecutor& executor;
+        bool sent = true;  // False for a message that is not sent, which continues at once
+
+        bool await_ready() const {
+            return !sent;
+        }
+
+        void await_suspend(std::coroutine_handle<> sender) {
+            executor.deliver(sender);
+        }
+
+        void await_resume() const {
+        }
+    };
+
+    Message send() {
+        messages_++;
+        return Message{*this};
+    }
+
+    /**
+     * Run task to completion on this executor, as one of its operations in flight.
+     * @param done: called with the task's result, on the executor's thread.
+     */
+    template <typename T, typename Done>
+    void spawn(AsyncTask<T> task, Done done) {
+        drive(std::move(task), std::move(done));
+    }
+
+    template <typename T>
+    void spawn(AsyncTask<T> task) {
+        drive(std::move(task), [](const T&) {});
+    }
+
+    // Resume operations as their messages arrive, until none is left
+    void run() {
+        while (!ready_.empty() || !waiting_.empty()) {
+            if (ready_.empty()) {
+                std::this_thread::sleep_until(waiting_.top().due);
+            }
+            Clock::time_point now = Clock::now();
+            while (!waiting_.empty() && waiting_.top().due <= now) {
+                ready_.push_back(waiting_.top().handle);
+                waiting_.pop();
+            }
+            if (!ready_.empty()) {
+                std::coroutine_handle<> next = ready_.front();
+                ready_.pop_front();
+                next.resume();
+            }
+        }
+    }
+
+    // Operations spawned and not finished yet, and the most at any one time
+    size_t inFlight() const {
+        return inFlight_;
+    }
+
+    size_t peakInFlight() const {
+        return peakInFlight_;
+    }
+
+    // Messages sent by every operation so far, replies included
+    uint64_t messages() const {
+        return messages_;
+    }
+
+    /**
+     * Give every origin node an in-flight request table for findAsync. A
+     * lookup of a key that a lookup from the same origin is already routing
+     * waits for that route and completes with it, sending nothing. A route
+     * that reaches its owner records the range (predecessor, owner] it
+     * resolved; until the origin has no route left in flight, its lookups
+     * whose key falls in such a range, new ones or ones still routing, go
+     * straight to the owner. Ranges lapse when the ring epoch advances.
+     * Off by default.
+     */
+    void enableCoalescing(bool enabled = true) {
+        coalescing_ = enabled;
+    }
+
+    bool coalescing() const {
+        return coalescing_;
+    }
+
+    const CoalescingStats& coalescingStats() const {
+        return coalescingStats_;
+    }
+
+    // A lookup routing on behalf of its origin's in-flight table
+    class Route {
+    public:
+        Route(AsyncExecutor& executor, Node& origin, NodeId key) : executor_(executor), origin_(&origin), key_(key) {
+            executor_.tables_[origin_].routes[key_];
+            executor_.coalescingStats_.routes++;
+        }
+
+        Route(const Route&) = delete;
+        Route& operator=(const Route&) = delete;
+
+        // Owner of a range resolved for this key in the current ring epoch
+        Node* resolvedOwner() const {
+            const Table& table = executor_.tables_[origin_];
+            uint64_t epoch = Node::getRingEpoch();
+            for (auto range = table.ranges.rbegin(); range != table.ranges.rend(); ++range) {
+                if (range->epoch == epoch && ChordRing::inRange(key_, range->start, range->owner->getId())) {
+                    return range->owner;
+                }
+            }
+            return nullptr;
+        }
+
+        // Record the range the route resolved and hand its result to the
+        // lookups waiting for the same key
+        void finish(const LookupResult& result, NodeId rangeStart, bool resolved) {
+            Table& table = executor_.tables_[origin_];
+            if (resolved && result.node != nullptr) {
+                if (table.ranges.size() == kResolvedRanges) {
+                    table.ranges.pop_front();
+                }
+                table.ranges.push_back(Range{rangeStart, result.node, Node::getRingEpoch()});
+            }
+            auto it = table.routes.find(key_);
+            for (const Waiter& waiter : it->second) {
+                *waiter.result = result;
+                waiter.result->hops = 0;
+                waiter.result->messages = 0;
+                waiter.result->roundTrips = 0;
+                waiter.result->path.clear();
+                waiter.result->coalesced = true;
+                executor_.ready_.push_back(waiter.handle);
+            }
+            table.routes.erase(it);
+            // Ranges only serve routes that overlap with the burst that found them
+            if (table.routes.empty()) {
+                executor_.tables_.erase(origin_);
+            }
+        }
+
+    private:
+        AsyncExecutor& executor_;
+        Node* origin_;
+        NodeId key_;
+    };
+
+    // Awaitable that attaches a lookup to the route in flight for its key;
+    // ready at once when there is none
+    struct Attach {
+        AsyncExecutor& executor;
+        Node* origin;
+        NodeId key;
+        LookupResult* result;
+
+        bool await_ready() const {
+            auto table = executor.tables_.find(origin);
+            return table == executor.tables_.end() || table->second.routes.count(key) == 0;
+        }
+
+        void await_suspend(std::coroutine_handle<> handle) {
+            executor.tables_[origin].routes[key].push_back(Waiter{handle, result});
+            executor.coalescingStats_.sameKey++;
+            CHORD_METRIC_ADD(Counter::CoalescedSameKey, 1);
+        }
+
+        // Whether the lookup waited; result then holds the route's answer
+        bool await_resume() const {
+            return result->coalesced;
+        }
+    };
+
+    Attach attach(Node& origin, NodeId key, LookupResult* result) {
+        return Attach{*this, &origin, key, result};
+    }
+
+    void countSameRange() {
+        coalescingStats_.sameRange++;
+        CHORD_METRIC_ADD(Counter::CoalescedSameRange, 1);
+    }
+
+private:
+    struct Pending {
+        Clock::time_point due;
+        uint64_t sequence;  // Messages due at the same time arrive in sending order
+        std::coroutine_handle<> handle;
+
+        bool operator>(const Pending& other) const {
+            return due != other.due ? due > other.due : sequence > other.sequence;
+        }
+    };
+
+    // Coroutine frame that owns a spawned task; frees itself at the end
+    struct Detached {
+        struct promise_type {
+            Detached get_return_object() {
+                return {};
+            }
+            std::suspend_never initial_suspend() noexcept {
+                return {};
+            }
+            std::suspend_never final_suspend() noexcept {
+                return {};
+            }
+            void return_void() {
+            }
+            void unhandled_exception() {
+                std::terminate();
+            }
+        };
+    };
+
+    // Start on the next turn of run, so spawn itself never runs the task
+    struct Start {
+        AsyncExecutor& executor;
+
+        bool await_ready() const {
+            return false;
+        }
+
+        void await_suspend(std::coroutine_handle<> handle) {
+            executor.ready_.push_back(handle);
+        }
+
+        void await_resume() const {
+        }
+    };
+
+    template <typename T, typename Done>
+    Detached drive(AsyncTask<T> task, Done done) {
+        inFlight_++;
+        peakInFlight_ = std::max(peakInFlight_, inFlight_);
+        co_await Start{*this};
+        done(co_await task);
+        inFlight_--;
+    }
+
+    // Most recent resolved ranges an origin keeps while it has routes in flight
+    static constexpr size_t kResolvedRanges = 256;
+
+    struct Waiter {
+        std::coroutine_handle<> handle;
+        LookupResult* result;
+    };
+
+    struct Range {
+        NodeId start;      // The owner is responsible for (start, owner]
+        Node* owner;
+        uint64_t epoch;    // Ring epoch when resolved; stale once it advances
+    };
+
+    // In-flight request table of one origin node
+    struct Table {
+        std::map<NodeId, std::vector<Waiter> > routes;  // Key of every route in flight, and the lookups waiting for it
+        std::deque<Range> ranges;                       // Resolved since the table was last empty, oldest first
+    };
+
+    void deliver(std::coroutine_handle<> handle) {
+        if (latency_ == Clock::duration::zero()) {
+            ready_.push_back(handle);
+        } else {
+            waiting_.push(Pending{Clock::now() + latency_, sequence_++, handle});
+        }
+    }
+
+    Clock::duration latency_;
+    std::deque<std::coroutine_handle<> > ready_;
+    std::priority_queue<Pending, std::vector<Pending>, std::greater<Pending> > waiting_;
+    uint64_t sequence_ = 0;
+    size_t inFlight_ = 0;
+    size_t peakInFlight_ = 0;
+    uint64_t messages_ = 0;
+    bool coalescing_ = false;
+    std::map<Node*, Table> tables_;  // Origins with routes in flight
+    CoalescingStats coalescingStats_;
+};
+
+// Carry the request hop by hop from origin to the node responsible for
+// key; fills result.node, or result.looped after ChordRing::kMaxHops. In
+// RoutingMode::Iterative every hop answers the origin, which sends the next
+// request; in RoutingMode::Recursive every hop forwards the request and the
+// owner answers the origin with one more message (see reply).
+inline AsyncTask<LookupResult> routeAsync(Node& origin, NodeId key, AsyncExecutor& executor) {
+    LookupResult result;
+    Node* current = &origin;
+    bool owner = false;
+    bool iterative = Node::getRoutingMode() == RoutingMode::Iterative;
+    while (!owner) {
+        if (result.hops >= ChordRing::kMaxHops) {
+            result.looped = true;
+            co_return result;
+        }
+        Node* next = current->routeStep(key, &owner);
+        if (next != current) {
+            co_await executor.send();
+            if (iterative) {
+                co_await executor.send();
+            }
+            result.hops++;
+        }
+        current = next;
+    }
+    result.messages = Node::routeMessages(result.hops);
+    result.roundTrips = Node::routeRoundTrips(result.hops);
+    if (current->isAlive()) {
+        result.node = current;
+        result.servedBy = current;
+    }
+    co_return result;
+}
+
+// The owner's answer to a recursive route; iterative routes were answered
+// on their last hop already
+inline AsyncExecutor::Message reply(const LookupResult& result, Node& origin, AsyncExecutor& executor) {
+    bool owed = Node::getRoutingMode() == RoutingMode::Recursive && result.node != &origin;
+    return owed ? executor.send() : AsyncExecutor::Message{executor, false};
+}
+
+// routeAsync for a lookup in its origin's in-flight table. Before every hop
+// the route checks whether a concurrent one resolved its key's range; the
+// origin then asks that owner directly, one request and one reply.
+inline AsyncTask<LookupResult> coalescedRouteAsync(Node& origin, NodeId key, AsyncExecutor& executor) {
+    AsyncExecutor::Route route(executor, origin, key);
+    LookupResult result;
+    Node* current = &origin;
+    NodeId rangeStart = current->getId();
+    bool owner = false;
+    bool shortcut = false;
+    bool iterative = Node::getRoutingMode() == RoutingMode::Iterative;
+    while (!owner) {
+        if (result.hops >= ChordRing::kMaxHops) {
+            result.looped = true;
+            route.finish(result, rangeStart, false);
+            co_return result;
+        }
+        Node* resolved = route.resolvedOwner();
+        if (resolved != nullptr) {
+            co_await executor.send();
+            co_await executor.send();
+            result.hops++;
+            result.messages += 2;
+            result.roundTrips = iterative ? result.roundTrips + 1 : 1;
+            current = resolved;
+            owner = true;
+            shortcut = true;
+            executor.countSameRange();
+            break;
+        }
+        Node* next = current->routeStep(key, &owner);
+        if (next != current) {
+            co_await executor.send();
+            if (iterative) {
+                co_await executor.send();
+            }
+            result.hops++;
+            result.messages += iterative ? 2 : 1;
+            result.roundTrips += iterative ? 1 : 0;
+        }
+        if (owner) {
+            rangeStart = next != current ? current->getId() : ChordRing::sub(key, NodeId(1));
+        }
+        current = next;
+    }
+    if (current->isAlive()) {
+        result.node = current;
+        result.servedBy = current;
+        result.found = current->getLocalKeys().get(key, &result.value);
+        if (!shortcut && !iterative && current != &origin) {
+            result.messages++;
+            result.roundTrips = 1;
+        }
+        // The lookups waiting for this key complete with the owner's reply
+        if (!shortcut) {
+            co_await reply(result, origin, executor);
+        }
+    }
+    route.finish(result, rangeStart, !shortcut);
+    co_return result;
+}
+
+// Awaitable Node::lookup: the value as a view into the owner's store. With
+// coalescing on, concurrent lookups from one origin share routes (see
+// AsyncExecutor::enableCoalescing).
+inline AsyncTask<LookupResult> findAsync(Node& origin, NodeId key, AsyncExecutor& executor) {
+    LookupResult result;
+    if (origin.getLocalKeys().get(key, &result.value)) {
+        result.found = true;
+        result.node = &origin;
+        result.servedBy = &origin;
+        co_return result;
+    }
+    if (executor.coalescing()) {
+        if (co_await executor.attach(origin, key, &result)) {
+            co_return result;
+        }
+        co_return co_await coalescedRouteAsync(origin, key, executor);
+    }
+    result = co_await routeAsync(origin, key, executor);
+    if (result.node != nullptr) {
+        result.found = result.node->getLocalKeys().get(key, &result.value);
+        co_await reply(result, origin, executor);
+    }
+    co_return result;
+}
+
+// Awaitable Node::insert; the value travels with the request and found
+// reports that the owner stored it
+inline AsyncTask<LookupResult> insertAsync(Node& origin, NodeId key, std::string value, AsyncExecutor& executor) {
+    LookupResult result = co_await routeAsync(origin, key, executor);
+    if (result.node != nullptr) {
+        result.node->applyInsert(key, ByteView(value));
+        result.found = true;
+        co_await reply(result, origin, executor);
+    }
+    co_return result;
+}
+
+// Awaitable Node::remove; found tells whether the key was stored
+inline AsyncTask<LookupResult> removeAsync(Node& origin, NodeId key, AsyncExecutor& executor) {
+    LookupResult result = co_await routeAsync(origin, key, executor);
+    if (result.node != nullptr) {
+        result.found = result.node->applyRemove(key);
+        co_await reply(result, origin, executor);
+    }
+    co_return result;
+}
+
+#endif
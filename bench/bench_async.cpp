@@ -0,0 +1,123 @@
+// Lookups with many requests in flight on one thread (async.h). Every message
+// takes a fixed latency; for each number of outstanding lookups, a single
+// executor keeps that many client coroutines busy and reports lookups per
+// second of wall time, mean end-to-end latency and hops. Each answer is
+// checked against Node::lookup. Requests are routed recursively. One
+// outstanding lookup is what a blocking client gets. Then checks inserts and
+// removes through the same API.
+//
+// Usage: bench_async [nodes] [lookups] [latency us] [outstanding]
+//        e.g. bench_async 100000 10000 100 1,16,256,4096
+
+#include "../async.h"
+#include <cstdlib>
+#include <random>
+#include <sstream>
+
+typedef std::chrono::steady_clock Clock;
+
+static double secondsSince(Clock::time_point start) {
+    return std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+struct Totals {
+    size_t next = 0;
+    double latency = 0.0;
+    uint64_t hops = 0;
+    std::vector<Node*> owners;  // Answer to every query, checked after the run
+};
+
+// One client: takes the next query until none is left, one in flight at a time
+static AsyncTask<size_t> client(AsyncExecutor& executor, const std::vector<std::pair<Node*, NodeId> >& queries,
+                                Totals& totals) {
+    size_t done = 0;
+    while (totals.next < queries.size()) {
+        size_t index = totals.next++;
+        auto start = Clock::now();
+        LookupResult result = co_await findAsync(*queries[index].first, queries[index].second, executor);
+        totals.latency += secondsSince(start);
+        totals.hops += result.hops;
+        totals.owners[index] = result.node;
+        done++;
+    }
+    co_return done;
+}
+
+// Insert then remove every key through the coroutine API, one client per key
+static AsyncTask<size_t> writer(AsyncExecutor& executor, Node& origin, NodeId key, Node& reader) {
+    LookupResult inserted = co_await insertAsync(origin, key, "async", executor);
+    LookupResult seen = co_await findAsync(reader, key, executor);
+    // The view dies with the removal, so copy it first
+    bool read = seen.found && seen.value.str() == "async";
+    LookupResult removed = co_await removeAsync(origin, key, executor);
+    LookupResult gone = co_await findAsync(reader, key, executor);
+    co_return inserted.found && read && removed.found && !gone.found ? 0 : 1;
+}
+
+int main(int argc, char** argv) {
+    size_t nodeCount = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 100000;
+    size_t lookupCount = argc > 2 ? std::strtoul(argv[2], nullptr, 10) : 10000;
+    double latency = (argc > 3 ? std::atof(argv[3]) : 100.0) * 1e-6;
+    std::vector<size_t> outstanding;
+    std::stringstream list(argc > 4 ? argv[4] : "1,16,256,4096");
+    for (std::string item; std::getline(list, item, ',');) {
+        outstanding.push_back(std::strtoul(item.c_str(), nullptr, 10));
+    }
+
+    // One message per hop and the owner's reply
+    Node::setRoutingMode(RoutingMode::Recursive);
+    std::mt19937_64 rng(42);
+    std::vector<Node*> nodes;
+    for (size_t i = 0; i < nodeCount; i++) {
+        nodes.push_back(new Node(static_cast<NodeId>(rng())));
+    }
+    std::vector<std::pair<NodeId, std::string> > entries;
+    for (size_t i = 0; i < lookupCount; i++) {
+        entries.emplace_back(static_cast<NodeId>(rng()), "value");
+    }
+    Node::buildRing(nodes, entries);
+    // Half the lookups ask for stored keys, half for absent ones
+    std::vector<std::pair<Node*, NodeId> > queries;
+    for (size_t i = 0; i < lookupCount; i++) {
+        NodeId key = i % 2 == 0 ? entries[i].first : static_cast<NodeId>(rng());
+        queries.emplace_back(nodes[rng() % nodeCount], key);
+    }
+
+    std::cout << nodeCount << " nodes, " << BITLENGTH << "-bit ids, " << lookupCount << " lookups, "
+              << latency * 1e6 << " us per message" << std::endl;
+    std::cout << "outstanding\tlookups/s\tlatency ms\thops\tmessages\twrong" << std::endl;
+    int status = 0;
+    for (size_t count : outstanding) {
+        AsyncExecutor executor(latency);
+        Totals totals;
+        totals.owners.resize(lookupCount);
+        for (size_t c = 0; c < count; c++) {
+            executor.spawn(client(executor, queries, totals));
+        }
+        auto start = Clock::now();
+        executor.run();
+        double seconds = secondsSince(start);
+        size_t wrong = 0;
+        for (size_t i = 0; i < lookupCount; i++) {
+            wrong += totals.owners[i] != queries[i].first->lookup(queries[i].second).node;
+        }
+        std::cout << count << "\t\t" << lookupCount / seconds << "\t\t" << totals.latency * 1e3 / lookupCount << "\t\t"
+                  << static_cast<double>(totals.hops) / lookupCount << "\t" << executor.messages() << "\t\t"
+                  << wrong << std::endl;
+        status |= wrong != 0;
+    }
+
+    AsyncExecutor executor(latency);
+    size_t failed = 0;
+    size_t writes = std::min<size_t>(lookupCount, 1000);
+    auto start = Clock::now();
+    for (size_t i = 0; i < writes; i++) {
+        executor.spawn(writer(executor, *nodes[rng() % nodeCount], static_cast<NodeId>(rng()),
+                              *nodes[rng() % nodeCount]),
+                       [&](size_t wrong) { failed += wrong; });
+    }
+    executor.run();
+    std::cout << writes << " insert/find/remove/find sequences in " << secondsSince(start) << " s, peak "
+              << executor.peakInFlight() << " in flight, " << failed << " failed" << std::endl;
+    return status | (failed != 0);
+}
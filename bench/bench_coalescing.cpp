@@ -0,0 +1,115 @@
+// Coalescing of concurrent lookups (AsyncExecutor::enableCoalescing). A
+// burst is that many clients at one origin node, each issuing four lookups
+// of Zipf-distributed stored keys back to back; a burst runs to completion
+// before the next one starts at another origin. For each burst size, with
+// coalescing off and on, reports
+// lookups per second, hops and messages per lookup, and the share of
+// lookups that waited for a route to the same key or were cut short by one
+// that resolved their range. Every answer is checked against Node::lookup.
+//
+// Usage: bench_coalescing [nodes] [lookups] [zipf s] [latency us] [burst sizes]
+//        e.g. bench_coalescing 100000 20000 1.0 10 16,256,4096
+
+#include "../async.h"
+#include "workload.h"
+#include <cstdlib>
+#include <random>
+#include <sstream>
+
+typedef std::chrono::steady_clock Clock;
+
+static const size_t kLookupsPerClient = 4;
+
+static double secondsSince(Clock::time_point start) {
+    return std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+// One client of a burst: takes the burst's next query until none is left
+static AsyncTask<size_t> client(AsyncExecutor& executor, const std::vector<std::pair<Node*, NodeId> >& queries,
+                                size_t& next, size_t last, std::vector<LookupResult>& results) {
+    size_t done = 0;
+    while (next < last) {
+        size_t index = next++;
+        results[index] = co_await findAsync(*queries[index].first, queries[index].second, executor);
+        done++;
+    }
+    co_return done;
+}
+
+int main(int argc, char** argv) {
+    size_t nodeCount = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 100000;
+    size_t lookupCount = argc > 2 ? std::strtoul(argv[2], nullptr, 10) : 20000;
+    double skew = argc > 3 ? std::atof(argv[3]) : 1.0;
+    double latency = (argc > 4 ? std::atof(argv[4]) : 10.0) * 1e-6;
+    std::vector<size_t> bursts;
+    std::stringstream list(argc > 5 ? argv[5] : "16,256,4096");
+    for (std::string item; std::getline(list, item, ',');) {
+        bursts.push_back(std::strtoul(item.c_str(), nullptr, 10));
+    }
+
+    std::mt19937_64 rng(42);
+    std::vector<Node*> nodes;
+    for (size_t i = 0; i < nodeCount; i++) {
+        nodes.push_back(new Node(static_cast<NodeId>(rng())));
+    }
+    std::vector<std::pair<NodeId, std::string> > entries;
+    for (size_t i = 0; i < 10000; i++) {
+        entries.emplace_back(static_cast<NodeId>(rng()), "value");
+    }
+    Node::buildRing(nodes, entries);
+    ZipfSampler zipf(entries.size(), skew);
+
+    std::cout << nodeCount << " nodes, " << BITLENGTH << "-bit ids, " << lookupCount << " lookups, zipf " << skew
+              << ", " << latency * 1e6 << " us per message, "
+              << (Node::getRoutingMode() == RoutingMode::Iterative ? "iterative" : "recursive") << std::endl;
+    std::cout << "burst\tcoalescing\tlookups/s\thops\tmessages\tsame key %\tsame range %\twrong" << std::endl;
+    int status = 0;
+    for (size_t burst : bursts) {
+        for (bool coalescing : {false, true}) {
+            std::mt19937_64 draw(7);
+            std::vector<std::pair<Node*, NodeId> > queries;
+            size_t burstLookups = burst * kLookupsPerClient;
+            for (size_t i = 0; i < lookupCount; i++) {
+                if (i % burstLookups == 0) {
+                    queries.emplace_back(nodes[draw() % nodeCount], NodeId(0));
+                } else {
+                    queries.emplace_back(queries.back().first, NodeId(0));
+                }
+                queries.back().second = entries[zipf(draw)].first;
+            }
+
+            AsyncExecutor executor(latency);
+            executor.enableCoalescing(coalescing);
+            std::vector<LookupResult> results(lookupCount);
+            auto start = Clock::now();
+            for (size_t first = 0; first < lookupCount; first += burstLookups) {
+                size_t next = first;
+                size_t last = std::min(first + burstLookups, lookupCount);
+                for (size_t i = 0; i < burst; i++) {
+                    executor.spawn(client(executor, queries, next, last, results));
+                }
+                executor.run();
+            }
+            double seconds = secondsSince(start);
+
+            uint64_t hops = 0, messages = 0;
+            size_t wrong = 0;
+            for (size_t i = 0; i < lookupCount; i++) {
+                hops += results[i].hops;
+                messages += results[i].messages;
+                LookupResult expected = queries[i].first->lookup(queries[i].second);
+                wrong += results[i].node != expected.node || !results[i].found;
+            }
+            const CoalescingStats& stats = executor.coalescingStats();
+            double n = static_cast<double>(lookupCount);
+            std::cout << burst << "\t" << (coalescing ? "on" : "off") << "\t\t" << n / seconds << "\t\t" << hops / n
+                      << "\t" << messages / n << "\t\t" << 100.0 * stats.sameKey / n << "\t\t"
+                      << 100.0 * stats.sameRange / n << "\t\t" << wrong << std::endl;
+            status |= wrong != 0;
+        }
+    }
+    for (Node* node : nodes) {
+        delete node;
+    }
+    return status;
+}
@@ -0,0 +1,118 @@
+// Lookup throughput from 1 to N threads while a background thread keeps
+// running stabilize/fixFingers over the whole ring.
+//
+// Usage: bench_concurrency [nodes] [keys] [millis per step] [max threads]
+
+#include "../node.h"
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <random>
+#include <thread>
+
+int main(int argc, char** argv) {
+    size_t nodeCount = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 1000;
+    size_t keyCount = argc > 2 ? std::strtoul(argv[2], nullptr, 10) : 100000;
+    int millis = argc > 3 ? std::atoi(argv[3]) : 500;
+    unsigned maxThreads = argc > 4 ? std::atoi(argv[4]) : std::thread::hardware_concurrency();
+    if (maxThreads == 0) {
+        maxThreads = 1;
+    }
+
+    // Build the ring with distinct random ids
+    std::mt19937_64 rng(42);
+    std::set<NodeId> used;
+    std::vector<Node*> nodes;
+    while (nodes.size() < nodeCount) {
+        NodeId id = static_cast<NodeId>(rng());
+        if (used.insert(id).second) {
+            nodes.push_back(new Node(id));
+        }
+    }
+    nodes[0]->join(nullptr);
+    for (size_t i = 1; i < nodes.size(); i++) {
+        nodes[i]->join(nodes[i - 1]);
+    }
+    for (int round = 0; round < 3; round++) {
+        for (Node* node : nodes) {
+            node->stabilize();
+            for (int i = 0; i < BITLENGTH; i++) {
+                node->fixFingers();
+            }
+        }
+    }
+    for (Node* node : nodes) {
+        node->enableConcurrency();
+    }
+
+    std::vector<NodeId> keys;
+    for (size_t i = 0; i < keyCount; i++) {
+        keys.push_back(static_cast<NodeId>(rng()));
+        nodes[i % nodes.size()]->insert(keys.back(), static_cast<uint8_t>(i));
+    }
+
+    std::cout << "nodes=" << nodeCount << " keys=" << keyCount << " bits=" << BITLENGTH << std::endl;
+    std::cout << "threads\tlookups/s\tspeedup\tavg hops\tmaintenance rounds" << std::endl;
+
+    double baseline = 0.0;
+    for (unsigned threads = 1; threads <= maxThreads; threads *= 2) {
+        std::atomic<bool> stop(false);
+        std::atomic<uint64_t> totalLookups(0);
+        std::atomic<uint64_t> totalHops(0);
+        std::atomic<uint64_t> maintenanceRounds(0);
+
+        // Background maintenance mutates finger tables and predecessors
+        std::thread maintenance([&]() {
+            while (!stop.load(std::memory_order_relaxed)) {
+                for (Node* node : nodes) {
+                    node->stabilize();
+                    node->fixFingers();
+                }
+                maintenanceRounds++;
+            }
+        });
+
+        std::vector<std::thread> workers;
+        for (unsigned t = 0; t < threads; t++) {
+            workers.emplace_back([&, t]() {
+                std::mt19937_64 local(t + 1);
+                std::string value;
+                uint64_t lookups = 0;
+                uint64_t hops = 0;
+                while (!stop.load(std::memory_order_relaxed)) {
+                    for (int batch = 0; batch < 256; batch++) {
+                        Node* origin = nodes[local() % nodes.size()];
+                        LookupResult r = origin->lookup(keys[local() % keys.size()], &value);
+                        hops += r.hops;
+                        lookups++;
+                    }
+                }
+                totalLookups += lookups;
+                totalHops += hops;
+            });
+        }
+
+        auto start = std::chrono::steady_clock::now();
+        std::this_thread::sleep_for(std::chrono::milliseconds(millis));
+        stop.store(true);
+        for (std::thread& worker : workers) {
+            worker.join();
+        }
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        maintenance.join();
+
+        double rate = totalLookups.load() / seconds;
+        if (threads == 1) {
+            baseline = rate;
+        }
+        std::cout << threads << "\t" << static_cast<uint64_t>(rate) << "\t"
+                  << rate / baseline << "\t"
+                  << static_cast<double>(totalHops.load()) / totalLookups.load() << "\t"
+                  << maintenanceRounds.load() << std::endl;
+    }
+
+    for (Node* node : nodes) {
+        delete node;
+    }
+    return 0;
+}
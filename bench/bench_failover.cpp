@@ -0,0 +1,130 @@
+// Lookup success rate and latency while random nodes crash, with and
+// without successor lists. Nodes are killed with fail(), so nobody hands
+// off keys or repairs fingers; each step is measured right after the kills
+// and again once stabilize alone has reconnected the ring.
+//
+// Usage: bench_failover [nodes] [lookups per step] [successor list length]
+
+#include "../node.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <random>
+
+// First live node at or after key, by brute force over the sorted live ids
+static Node* owner(const std::vector<Node*>& live, NodeId key) {
+    auto it = std::lower_bound(live.begin(), live.end(), key,
+                               [](Node* n, NodeId k) { return n->getId() < k; });
+    return it == live.end() ? live.front() : *it;
+}
+
+// Every live node's successor finger points at the next live node
+static bool ringIsConnected(const std::vector<Node*>& live) {
+    for (size_t i = 0; i < live.size(); i++) {
+        if (live[i]->getFingerTable().getNodePtr(1) != live[(i + 1) % live.size()]) {
+            return false;
+        }
+    }
+    return true;
+}
+
+struct Measurement {
+    double successRate;
+    double avgHops;
+    double nsPerLookup;
+};
+
+static Measurement measure(const std::vector<Node*>& live, size_t lookups, std::mt19937_64& rng) {
+    size_t ok = 0;
+    uint64_t hops = 0;
+    auto start = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < lookups; i++) {
+        Node* origin = live[rng() % live.size()];
+        NodeId key = static_cast<NodeId>(rng());
+        LookupResult r = origin->lookup(key);
+        hops += r.hops;
+        if (r.node == owner(live, key)) {
+            ok++;
+        }
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    return Measurement{100.0 * ok / lookups, static_cast<double>(hops) / lookups, seconds * 1e9 / lookups};
+}
+
+static void run(size_t nodeCount, size_t lookups, size_t r) {
+    std::mt19937_64 rng(42);
+    std::set<NodeId> used;
+    std::vector<Node*> nodes;
+    while (nodes.size() < nodeCount) {
+        NodeId id = static_cast<NodeId>(rng());
+        if (used.insert(id).second) {
+            nodes.push_back(new Node(id));
+            nodes.back()->setSuccessorListLength(r);
+        }
+    }
+    nodes[0]->join(nullptr);
+    for (size_t i = 1; i < nodes.size(); i++) {
+        nodes[i]->join(nodes[i - 1]);
+    }
+    // Enough rounds for every successor list to fill to r entries
+    for (size_t round = 0; round < r + 2; round++) {
+        for (Node* node : nodes) {
+            node->stabilize();
+        }
+    }
+    for (Node* node : nodes) {
+        for (int i = 0; i < BITLENGTH; i++) {
+            node->fixFingers();
+        }
+    }
+
+    std::vector<Node*> live(nodes);
+    std::sort(live.begin(), live.end(), [](Node* a, Node* b) { return a->getId() < b->getId(); });
+
+    const double fractions[] = {0.0, 0.05, 0.1, 0.2, 0.3, 0.5};
+    for (double fraction : fractions) {
+        // Crash random nodes until the cumulative fraction is reached
+        size_t target = static_cast<size_t>(nodeCount * (1.0 - fraction));
+        while (live.size() > target && live.size() > 1) {
+            size_t victim = rng() % live.size();
+            live[victim]->fail();
+            live.erase(live.begin() + victim);
+        }
+
+        Measurement before = measure(live, lookups, rng);
+
+        size_t rounds = 0;
+        const size_t maxRounds = 50;
+        while (!ringIsConnected(live) && rounds < maxRounds) {
+            for (Node* node : live) {
+                node->stabilize();
+            }
+            rounds++;
+        }
+        Measurement after = measure(live, lookups, rng);
+
+        std::cout << r << "\t" << fraction * 100 << "%\t"
+                  << before.successRate << "%\t" << before.avgHops << "\t" << before.nsPerLookup << "\t"
+                  << (ringIsConnected(live) ? std::to_string(rounds) : "never") << "\t"
+                  << after.successRate << "%\t" << after.avgHops << "\t" << after.nsPerLookup << std::endl;
+    }
+
+    for (Node* node : nodes) {
+        delete node;
+    }
+}
+
+int main(int argc, char** argv) {
+    size_t nodeCount = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 1000;
+    size_t lookups = argc > 2 ? std::strtoul(argv[2], nullptr, 10) : 100000;
+    size_t r = argc > 3 ? std::strtoul(argv[3], nullptr, 10) : SuccessorList::kDefaultLength;
+
+    std::cout << "nodes=" << nodeCount << " lookups=" << lookups << " bits=" << BITLENGTH << std::endl;
+    std::cout << "r\tkilled\tsuccess\thops\tns/lookup\tstabilize rounds\tsuccess after\thops after\tns/lookup after"
+              << std::endl;
+
+    // r = 1 is plain Chord with a single successor pointer
+    run(nodeCount, lookups, 1);
+    run(nodeCount, lookups, r);
+    return 0;
+}
@@ -0,0 +1,110 @@
+// Closest-preceding-finger search: the pointer-chasing loop that loads every
+// finger node to read its id, against the scan of the offsets cached inline
+// in the finger table, scalar and vectorized. Each query is a random node and
+// a key at a random power-of-two distance; the three searches must pick the
+// same finger. Then compares whole lookups with the vector kernels off and on.
+//
+// Usage: bench_finger_search [nodes] [queries]
+//        e.g. bench_finger_search 100000 2000000
+
+#include "../node.h"
+#include <chrono>
+#include <cstdlib>
+#include <random>
+
+typedef std::chrono::steady_clock Clock;
+
+static double secondsSince(Clock::time_point start) {
+    return std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+static void report(const char* name, size_t count, double seconds) {
+    std::cout << name << "\t" << seconds * 1e9 / count << "\t" << count / seconds << "/s" << std::endl;
+}
+
+// The search as it was before the offsets: one node load per finger tried
+static Node* pointerLoop(Node* node, NodeId key) {
+    const FingerTable& fingers = node->getFingerTable();
+    for (size_t i = BITLENGTH; i >= 1; i--) {
+        Node* finger = fingers.getNodePtr(i);
+        if (ChordRing::inRange(finger->getId(), node->getId(), key) && finger->isAlive()) {
+            return finger;
+        }
+    }
+    return nullptr;
+}
+
+static Node* offsetScan(Node* node, NodeId key) {
+    return node->getFingerTable().closestPreceding(key);
+}
+
+template <typename Search>
+static uintptr_t run(const char* name, const std::vector<std::pair<Node*, NodeId> >& queries,
+                     std::vector<Node*>& found, Search search) {
+    uintptr_t checksum = 0;
+    auto start = Clock::now();
+    for (size_t i = 0; i < queries.size(); i++) {
+        found[i] = search(queries[i].first, queries[i].second);
+        checksum += reinterpret_cast<uintptr_t>(found[i]);
+    }
+    report(name, queries.size(), secondsSince(start));
+    return checksum;
+}
+
+int main(int argc, char** argv) {
+    size_t nodeCount = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 100000;
+    size_t queryCount = argc > 2 ? std::strtoul(argv[2], nullptr, 10) : 2000000;
+
+    std::mt19937_64 rng(42);
+    std::vector<Node*> nodes;
+    for (size_t i = 0; i < nodeCount; i++) {
+        nodes.push_back(new Node(static_cast<NodeId>(rng())));
+    }
+    Node::buildRing(nodes, std::vector<std::pair<NodeId, std::string> >());
+    std::vector<std::pair<Node*, NodeId> > queries;
+    // Distances spread evenly over the powers of two, as the hops of a
+    // lookup see them, so the search has to pass over the farther fingers
+    for (size_t i = 0; i < queryCount; i++) {
+        Node* node = nodes[rng() % nodeCount];
+        NodeId distance = ChordRing::pow2(rng() % BITLENGTH);
+        queries.emplace_back(node, ChordRing::add(node->getId(), distance));
+    }
+
+    std::cout << nodeCount << " nodes, " << BITLENGTH << "-bit ids, " << queryCount << " queries, kernel "
+              << FingerTable::searchKernel() << std::endl;
+    std::cout << "search\t\tns/op\tthroughput" << std::endl;
+    std::vector<Node*> expected(queryCount), found(queryCount);
+    run("pointer loop", queries, expected, pointerLoop);
+    FingerTable::setVectorSearch(false);
+    run("offsets scalar", queries, found, offsetScan);
+    size_t mismatches = 0;
+    for (size_t i = 0; i < queryCount; i++) {
+        mismatches += found[i] != expected[i];
+    }
+    FingerTable::setVectorSearch(true);
+    std::string name = std::string("offsets ") + FingerTable::searchKernel();
+    run(name.c_str(), queries, found, offsetScan);
+    for (size_t i = 0; i < queryCount; i++) {
+        mismatches += found[i] != expected[i];
+    }
+    if (mismatches != 0) {
+        std::cout << mismatches << " searches picked a different finger" << std::endl;
+        return 1;
+    }
+
+    size_t lookups = queryCount / 4;
+    for (bool vector : {false, true}) {
+        FingerTable::setVectorSearch(vector);
+        size_t hops = 0;
+        auto start = Clock::now();
+        for (size_t i = 0; i < lookups; i++) {
+            hops += queries[i].first->lookup(queries[i].second).hops;
+        }
+        std::string label = std::string("lookup ") + FingerTable::searchKernel();
+        report(label.c_str(), lookups, secondsSince(start));
+        if (hops == 0) {
+            std::cout << "no hops" << std::endl;
+        }
+    }
+    return 0;
+}
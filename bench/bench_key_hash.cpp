@@ -0,0 +1,119 @@
+// Byte-string key front-end. First hashing alone: keys per second and bytes
+// per second of SHA-1 and XXH64 for several key lengths, one key at a time
+// (KeyHash::toId) and in batches (KeyHash::toIds), whose ids must agree. Then
+// hashing against routing: insertKeys and findKeys of the same keys on a
+// ring, with the share of their time spent hashing.
+//
+// Usage: bench_key_hash [keys] [nodes] [lengths]
+//        e.g. bench_key_hash 200000 100000 16,64,256
+
+#include "../node.h"
+#include <chrono>
+#include <cstdlib>
+#include <random>
+#include <sstream>
+
+typedef std::chrono::steady_clock Clock;
+
+static double secondsSince(Clock::time_point start) {
+    return std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+static const char* name(KeyHashFunction function) {
+    return function == KeyHashFunction::Sha1 ? "sha1" : "xxh64";
+}
+
+// Random printable keys of exactly length bytes
+static std::vector<std::string> makeKeys(size_t count, size_t length, std::mt19937_64& rng) {
+    std::vector<std::string> keys(count, std::string(length, ' '));
+    for (std::string& key : keys) {
+        for (char& c : key) {
+            c = static_cast<char>('a' + rng() % 26);
+        }
+    }
+    return keys;
+}
+
+int main(int argc, char** argv) {
+    size_t keyCount = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 200000;
+    size_t nodeCount = argc > 2 ? std::strtoul(argv[2], nullptr, 10) : 100000;
+    std::vector<size_t> lengths;
+    std::stringstream list(argc > 3 ? argv[3] : "16,64,256");
+    for (std::string item; std::getline(list, item, ',');) {
+        lengths.push_back(std::strtoul(item.c_str(), nullptr, 10));
+    }
+    std::mt19937_64 rng(42);
+    int status = 0;
+
+    std::cout << keyCount << " keys, " << BITLENGTH << "-bit ids, batch kernel " << KeyHash::batchKernel()
+              << std::endl;
+    std::cout << "hash\tbytes\tsingle keys/s\tsingle MB/s\tbatch keys/s\tbatch MB/s" << std::endl;
+    for (size_t length : lengths) {
+        std::vector<std::string> keys = makeKeys(keyCount, length, rng);
+        std::vector<ByteView> views(keys.begin(), keys.end());
+        std::vector<NodeId> single(keyCount), batch(keyCount);
+        for (KeyHashFunction function : {KeyHashFunction::Sha1, KeyHashFunction::Fast}) {
+            auto start = Clock::now();
+            for (size_t i = 0; i < keyCount; i++) {
+                single[i] = KeyHash::toId(views[i], function);
+            }
+            double singleSeconds = secondsSince(start);
+            start = Clock::now();
+            KeyHash::toIds(views.data(), keyCount, batch.data(), function);
+            double batchSeconds = secondsSince(start);
+            size_t mismatches = 0;
+            for (size_t i = 0; i < keyCount; i++) {
+                mismatches += single[i] != batch[i];
+            }
+            double megabytes = keyCount * length / 1e6;
+            std::cout << name(function) << "\t" << length << "\t" << keyCount / singleSeconds << "\t"
+                      << megabytes / singleSeconds << "\t\t" << keyCount / batchSeconds << "\t"
+                      << megabytes / batchSeconds << std::endl;
+            if (mismatches != 0) {
+                std::cout << mismatches << " batch ids differ" << std::endl;
+                status = 1;
+            }
+        }
+    }
+
+    std::vector<Node*> nodes;
+    for (size_t i = 0; i < nodeCount; i++) {
+        nodes.push_back(new Node(static_cast<NodeId>(rng())));
+    }
+    Node::buildRing(nodes);
+    std::vector<std::string> keys;
+    for (size_t i = 0; i < keyCount; i++) {
+        keys.push_back("user:" + std::to_string(rng()));
+    }
+    std::vector<ByteView> views(keys.begin(), keys.end());
+    std::vector<std::pair<std::string, std::string> > entries;
+    for (const std::string& key : keys) {
+        entries.emplace_back(key, "value of " + key);
+    }
+    std::vector<NodeId> ids(keyCount);
+
+    std::cout << "\n" << nodeCount << " nodes, " << keyCount << " keys of about 25 bytes" << std::endl;
+    std::cout << "hash\thash s\tinsertKeys s\tfindKeys s\thash share\tmissing" << std::endl;
+    for (KeyHashFunction function : {KeyHashFunction::Sha1, KeyHashFunction::Fast}) {
+        Node::setKeyHash(function);
+        auto start = Clock::now();
+        KeyHash::toIds(views.data(), keyCount, ids.data(), function);
+        double hashSeconds = secondsSince(start);
+        BatchResult inserted = nodes[0]->insertKeys(entries);
+        BatchResult found = nodes[1]->findKeys(keys);
+        size_t missing = 0;
+        for (size_t i = 0; i < keyCount; i++) {
+            missing += !found.results[i].found || found.results[i].value.str() != entries[i].second;
+        }
+        std::cout << name(function) << "\t" << hashSeconds << "\t" << inserted.seconds << "\t" << found.seconds
+                  << "\t" << hashSeconds / found.seconds * 100 << "%\t\t" << missing << std::endl;
+        status |= missing != 0;
+        for (const std::string& key : keys) {
+            nodes[2]->removeKey(key);
+        }
+    }
+    for (Node* node : nodes) {
+        delete node;
+    }
+    return status;
+}
@@ -0,0 +1,151 @@
+// Average lookup hops with and without per-node location caches under a
+// Zipf-skewed and a uniform key workload, plus the cache's recovery after a
+// join invalidates every entry.
+//
+// Usage: bench_location_cache [nodes] [keys] [lookups] [cache capacity] [zipf s] [origins]
+
+#include "../node.h"
+#include "workload.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <random>
+
+struct Phase {
+    double avgHops;
+    double nsPerLookup;
+    double correct;
+};
+
+int main(int argc, char** argv) {
+    size_t nodeCount = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 1000;
+    size_t keyCount = argc > 2 ? std::strtoul(argv[2], nullptr, 10) : 100000;
+    size_t lookups = argc > 3 ? std::strtoul(argv[3], nullptr, 10) : 200000;
+    size_t capacity = argc > 4 ? std::strtoul(argv[4], nullptr, 10) : 1024;
+    double s = argc > 5 ? std::atof(argv[5]) : 1.1;
+    size_t originCount = argc > 6 ? std::strtoul(argv[6], nullptr, 10) : 16;
+
+    std::mt19937_64 rng(42);
+    std::set<NodeId> used;
+    std::vector<Node*> nodes;
+    while (nodes.size() < nodeCount) {
+        NodeId id = static_cast<NodeId>(rng());
+        if (used.insert(id).second) {
+            nodes.push_back(new Node(id));
+        }
+    }
+    nodes[0]->join(nullptr);
+    for (size_t i = 1; i < nodes.size(); i++) {
+        nodes[i]->join(nodes[i - 1]);
+    }
+    for (int round = 0; round < 3; round++) {
+        for (Node* node : nodes) {
+            node->stabilize();
+            for (int i = 0; i < BITLENGTH; i++) {
+                node->fixFingers();
+            }
+        }
+    }
+
+    std::vector<NodeId> keys;
+    for (size_t i = 0; i < keyCount; i++) {
+        keys.push_back(static_cast<NodeId>(rng()));
+    }
+    std::vector<Node*> origins(nodes.begin(), nodes.begin() + std::min(originCount, nodes.size()));
+    ZipfSampler zipf(keyCount, s);
+
+    // Routed owner must match the first node at or after the key
+    auto run = [&](bool skewed) {
+        std::vector<NodeId> ring(used.begin(), used.end());
+        uint64_t hops = 0;
+        size_t correct = 0;
+        std::mt19937_64 local(7);
+        auto start = std::chrono::steady_clock::now();
+        for (size_t i = 0; i < lookups; i++) {
+            Node* origin = origins[local() % origins.size()];
+            NodeId key = keys[skewed ? zipf(local) : local() % keys.size()];
+            LookupResult r = origin->lookup(key);
+            hops += r.hops;
+            auto it = std::lower_bound(ring.begin(), ring.end(), key);
+            NodeId expected = it == ring.end() ? ring.front() : *it;
+            if (r.node && r.node->getId() == expected) {
+                correct++;
+            }
+        }
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        return Phase{static_cast<double>(hops) / lookups, seconds * 1e9 / lookups, 100.0 * correct / lookups};
+    };
+
+    auto stats = [&]() {
+        LocationCache::Stats total;
+        for (Node* origin : origins) {
+            LocationCache::Stats st = origin->getLocationCacheStats();
+            total.lookups += st.lookups;
+            total.hits += st.hits;
+            total.stale += st.stale;
+            total.evictions += st.evictions;
+            total.hopsSaved += st.hopsSaved;
+        }
+        return total;
+    };
+
+    auto attachCaches = [&]() {
+        for (Node* origin : origins) {
+            origin->enableLocationCache(capacity);
+        }
+    };
+
+    std::cout << "nodes=" << nodeCount << " keys=" << keyCount << " lookups=" << lookups << " capacity="
+              << capacity << " zipf s=" << s << " origins=" << origins.size() << " bits=" << BITLENGTH
+              << std::endl;
+    std::cout << "workload\tcache\tavg hops\tns/lookup\tcorrect\thit rate\tstale\tevictions\thops saved"
+              << std::endl;
+
+    for (int skewed = 1; skewed >= 0; skewed--) {
+        const char* name = skewed ? "zipf" : "uniform";
+        for (Node* origin : origins) {
+            origin->enableLocationCache(0);
+        }
+        Phase off = run(skewed);
+        std::cout << name << "\toff\t" << off.avgHops << "\t" << off.nsPerLookup << "\t" << off.correct << "%"
+                  << std::endl;
+
+        attachCaches();
+        run(skewed);  // Warm up; counters below are deltas over the measured run
+        LocationCache::Stats warm = stats();
+        Phase on = run(skewed);
+        LocationCache::Stats after = stats();
+        uint64_t probes = after.lookups - warm.lookups;
+        std::cout << name << "\ton\t" << on.avgHops << "\t" << on.nsPerLookup << "\t" << on.correct << "%\t"
+                  << 100.0 * (after.hits - warm.hits) / probes << "%\t" << after.stale - warm.stale << "\t"
+                  << after.evictions - warm.evictions << "\t" << after.hopsSaved - warm.hopsSaved << std::endl;
+    }
+
+    // A join bumps the ring epoch: every cached range is stale at once
+    std::cout << "\nafter a join (zipf, cache kept)" << std::endl;
+    Node* joiner = nullptr;
+    while (joiner == nullptr) {
+        NodeId id = static_cast<NodeId>(rng());
+        if (used.insert(id).second) {
+            joiner = new Node(id);
+        }
+    }
+    joiner->join(nodes[0]);
+    for (Node* node : nodes) {
+        node->stabilize();
+    }
+    joiner->stabilize();
+    LocationCache::Stats before = stats();
+    Phase rejoin = run(true);
+    LocationCache::Stats after = stats();
+    std::cout << "zipf\ton\t" << rejoin.avgHops << "\t" << rejoin.nsPerLookup << "\t" << rejoin.correct << "%\t"
+              << 100.0 * (after.hits - before.hits) / (after.lookups - before.lookups) << "%\t"
+              << after.stale - before.stale << "\t" << after.evictions - before.evictions << "\t"
+              << after.hopsSaved - before.hopsSaved << std::endl;
+
+    delete joiner;
+    for (Node* node : nodes) {
+        delete node;
+    }
+    return 0;
+}
@@ -0,0 +1,151 @@
+// Write throughput of the in-memory SortedVectorStore against LogStore at
+// several group commit sizes, then the time a restarted node needs to get
+// its keys back: reopening the LogStore directory (map the segments and
+// rebuild the index) against pulling the whole range from a neighbour in
+// migration-sized batches, as a node without persistent storage must.
+// Also reports compaction while every key is overwritten twice.
+//
+// Usage: bench_log_store [keys] [value bytes] [directory]
+
+#include "../log_store.h"
+#include "../node.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <random>
+#include <unistd.h>
+
+typedef std::chrono::steady_clock Clock;
+
+static double secondsSince(Clock::time_point start) {
+    return std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+static void removeSegments(const std::string& dir) {
+    LogStore store;
+    if (store.open(dir)) {
+        store.clear();
+    }
+    rmdir(dir.c_str());
+}
+
+static double fill(KeyStore& store, const std::vector<NodeId>& keys, const std::string& value) {
+    auto start = Clock::now();
+    for (NodeId key : keys) {
+        store.put(key, ByteView(value));
+    }
+    return secondsSince(start);
+}
+
+int main(int argc, char** argv) {
+    size_t keyCount = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 100000;
+    size_t valueBytes = argc > 2 ? std::strtoul(argv[2], nullptr, 10) : 100;
+    std::string dir = argc > 3 ? argv[3] : "/tmp/chord_log_store_bench." + std::to_string(getpid());
+
+    std::mt19937_64 rng(42);
+    std::vector<NodeId> keys;
+    for (size_t i = 0; i < keyCount; i++) {
+        keys.push_back(static_cast<NodeId>(rng()));
+    }
+    std::sort(keys.begin(), keys.end());
+    std::string value(valueBytes, 'x');
+    std::cout << keyCount << " random keys, " << valueBytes << "-byte values, directory " << dir << std::endl;
+    std::cout << "store\t\t\tkeys\twrites/s\tMB/s" << std::endl;
+
+    // Keys are written in ascending order, as during migration and bulk
+    // load, so both indexes append and the storage cost is what differs.
+    // Syncing every record is far slower; it runs on a slice of the keys
+    // and is compared with the in-memory store on the same slice.
+    SortedVectorStore memory;
+    size_t small = std::min<size_t>(keyCount, 2000);
+    const size_t groups[] = {0, 1, 16, 256, 4096, size_t(-1)};
+    for (size_t group : groups) {
+        size_t count = group == 1 ? small : keyCount;
+        std::vector<NodeId> slice(keys.begin(), keys.begin() + count);
+        double seconds;
+        std::string label;
+        if (group == 0) {
+            seconds = fill(memory, slice, value);
+            label = "in-memory";
+        } else {
+            removeSegments(dir);
+            LogStoreOptions options;
+            options.groupCommitRecords = group == size_t(-1) ? 0 : group;
+            LogStore store(options);
+            if (!store.open(dir)) {
+                std::cerr << "cannot open " << dir << std::endl;
+                return 1;
+            }
+            auto start = Clock::now();
+            fill(store, slice, value);
+            store.commit();
+            seconds = secondsSince(start);
+            label = group == size_t(-1) ? "log, commit at end" : "log, commit every " + std::to_string(group);
+        }
+        std::cout << label << (label.size() < 16 ? "\t\t" : "\t") << count << "\t" << count / seconds << "\t"
+                  << count * (valueBytes + sizeof(NodeId)) / 1e6 / seconds << std::endl;
+        if (group == 1) {
+            SortedVectorStore baseline;
+            seconds = fill(baseline, slice, value);
+            std::cout << "in-memory\t\t" << count << "\t" << count / seconds << "\t"
+                      << count * (valueBytes + sizeof(NodeId)) / 1e6 / seconds << std::endl;
+        }
+    }
+
+    // The last store above holds every key; reopen it as a restarted node would
+    auto start = Clock::now();
+    double seconds = 0;
+    size_t recovered = 0;
+    size_t segments = 0;
+    {
+        LogStore reopened;
+        reopened.open(dir);
+        recovered = reopened.size();
+        segments = reopened.segmentCount();
+        seconds = secondsSince(start);
+    }
+    std::cout << "restart from log: " << seconds * 1e3 << " ms, " << recovered << " keys from " << segments
+              << " segments" << std::endl;
+
+    // Without persistent storage the whole range comes back from a neighbour
+    SortedVectorStore pulled;
+    SortedVectorStore batch;
+    size_t messages = 0;
+    NodeId from = NodeId(0);
+    RangeChunk chunk;
+    start = Clock::now();
+    do {
+        chunk = memory.copyRange(from, NodeId(0), batch, Node::kMigrationBatchEntries, Node::kMigrationBatchBytes);
+        for (const KeyValue& kv : batch) {
+            pulled.put(kv.first, kv.key, kv.second);
+        }
+        batch.clear();
+        from = chunk.last;
+        messages++;
+    } while (!chunk.done);
+    seconds = secondsSince(start);
+    std::cout << "restart by re-pull: " << seconds * 1e3 << " ms in-process, " << pulled.size() << " keys in "
+              << messages << " messages" << std::endl;
+
+    // Overwrite every key twice in random order: whenever half the log is
+    // superseded it is compacted
+    {
+        LogStore store;
+        store.open(dir);
+        size_t before = store.logBytes();
+        std::string newer(valueBytes, 'y');
+        std::vector<NodeId> order(keys);
+        std::shuffle(order.begin(), order.end(), rng);
+        start = Clock::now();
+        for (size_t i = 0; i < 2 * keyCount; i++) {
+            store.put(order[i % keyCount], ByteView(newer));
+        }
+        store.commit();
+        seconds = secondsSince(start);
+        std::cout << "overwrite twice: " << 2 * keyCount / seconds << " writes/s, log " << before / 1e6 << " MB -> "
+                  << store.logBytes() / 1e6 << " MB (" << store.garbageBytes() / 1e6 << " MB superseded), "
+                  << store.segmentCount() << " segments" << std::endl;
+    }
+    removeSegments(dir);
+    return 0;
+}
@@ -0,0 +1,133 @@
+// Cost of runtime metrics and a sample of what they report. Runs lookups,
+// inserts, removes, joins, leaves and maintenance rounds on one ring and
+// prints their throughput, then the metrics snapshot: hops and latency
+// percentiles, messages by type, keys migrated and stale fingers. Build
+// once more with -DCHORD_METRICS=OFF and compare the throughput lines to
+// see the overhead of recording.
+//
+// Usage: bench_metrics [nodes] [operations] [metrics file] [port]
+//        e.g. bench_metrics 10000 1000000 /tmp/chord.prom 9464
+//        (with a port, serves /metrics and /metrics.json for 30 s at the end)
+
+#include "../node.h"
+#ifdef __unix__
+#include "../metrics_server.h"
+#endif
+#include <chrono>
+#include <cstdlib>
+#include <random>
+#include <thread>
+
+typedef std::chrono::steady_clock Clock;
+
+static double secondsSince(Clock::time_point start) {
+    return std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+static void report(const char* op, size_t count, double seconds) {
+    std::cout << op << "\t" << count << "\t" << count / seconds << "/s" << std::endl;
+}
+
+int main(int argc, char** argv) {
+    size_t nodeCount = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 10000;
+    size_t operations = argc > 2 ? std::strtoul(argv[2], nullptr, 10) : 1000000;
+    std::string file = argc > 3 ? argv[3] : "";
+    int port = argc > 4 ? std::atoi(argv[4]) : -1;
+
+    std::mt19937_64 rng(42);
+    std::vector<Node*> nodes;
+    for (size_t i = 0; i < nodeCount; i++) {
+        nodes.push_back(new Node(static_cast<NodeId>(rng())));
+    }
+    std::vector<std::pair<NodeId, std::string> > entries;
+    for (size_t i = 0; i < nodeCount * 10; i++) {
+        entries.emplace_back(static_cast<NodeId>(rng()), std::string(100, 'v'));
+    }
+    Node::buildRing(nodes, entries);
+    std::cout << nodeCount << " nodes, " << entries.size() << " keys, metrics "
+              << (Metrics::enabled() ? "compiled in" : "compiled out") << std::endl;
+    std::cout << "op\t\tcount\tthroughput" << std::endl;
+
+    auto start = Clock::now();
+    size_t found = 0;
+    for (size_t i = 0; i < operations; i++) {
+        found += nodes[rng() % nodeCount]->lookup(entries[rng() % entries.size()].first).found;
+    }
+    report("lookup\t", operations, secondsSince(start));
+
+    std::string value(100, 'w');
+    size_t writes = operations / 10;
+    start = Clock::now();
+    for (size_t i = 0; i < writes; i++) {
+        nodes[rng() % nodeCount]->insert(static_cast<NodeId>(rng()), value);
+    }
+    report("insert\t", writes, secondsSince(start));
+
+    start = Clock::now();
+    for (size_t i = 0; i < writes; i++) {
+        nodes[rng() % nodeCount]->remove(entries[rng() % entries.size()].first);
+    }
+    report("remove\t", writes, secondsSince(start));
+
+    // Churn leaves fingers stale for the maintenance rounds to find
+    size_t churn = std::min<size_t>(nodeCount / 10, 1000);
+    std::vector<Node*> joined;
+    start = Clock::now();
+    for (size_t i = 0; i < churn; i++) {
+        Node* node = new Node(static_cast<NodeId>(rng()));
+        node->join(nodes[rng() % nodeCount]);
+        joined.push_back(node);
+    }
+    report("join\t", churn, secondsSince(start));
+
+    start = Clock::now();
+    for (size_t i = 0; i < churn / 2; i++) {
+        joined[i]->leave();
+    }
+    report("leave\t", churn / 2, secondsSince(start));
+
+    start = Clock::now();
+    for (Node* node : nodes) {
+        node->stabilize();
+        for (int k = 0; k < BITLENGTH; k++) {
+            node->fixFingers();
+        }
+    }
+    report("maintenance", nodeCount, secondsSince(start));
+    if (found == 0) {
+        std::cout << "no keys found" << std::endl;
+    }
+
+    MetricsSnapshot snapshot = Metrics::snapshot();
+    const HistogramSnapshot& hops = snapshot[Histogram::LookupHops];
+    const HistogramSnapshot& latency = snapshot[Histogram::LookupNanos];
+    std::cout << "lookup hops: mean " << hops.mean() << ", p50 <= " << hops.percentile(0.5) << ", p99 <= "
+              << hops.percentile(0.99) << std::endl;
+    std::cout << "lookup ns: mean " << latency.mean() << ", p50 <= " << latency.percentile(0.5) << ", p99 <= "
+              << latency.percentile(0.99) << std::endl;
+    std::cout << "messages: find_successor " << snapshot[Counter::FindSuccessorMessages] << ", notify "
+              << snapshot[Counter::NotifyMessages] << ", update_finger " << snapshot[Counter::UpdateFingerMessages]
+              << ", transfer " << snapshot[Counter::TransferMessages] << ", store "
+              << snapshot[Counter::StoreMessages] << std::endl;
+    std::cout << "migrated: " << snapshot[Counter::KeysMigrated] << " keys, " << snapshot[Counter::BytesMigrated]
+              << " bytes" << std::endl;
+    std::cout << "fixFingers: " << snapshot[Counter::FingersStale] << " of " << snapshot[Counter::FingersChecked]
+              << " fingers stale" << std::endl;
+
+    if (!file.empty()) {
+        bool json = file.size() > 5 && file.compare(file.size() - 5, 5, ".json") == 0;
+        std::cout << (Metrics::writeFile(file, json) ? "wrote " : "cannot write ") << file << std::endl;
+    }
+#ifdef __unix__
+    if (port >= 0) {
+        MetricsServer server;
+        if (server.start(static_cast<uint16_t>(port))) {
+            std::cout << "serving http://127.0.0.1:" << server.port() << "/metrics for 30 s" << std::endl;
+            std::this_thread::sleep_for(std::chrono::seconds(30));
+        } else {
+            std::cout << "cannot listen on port " << port << std::endl;
+        }
+    }
+#endif
+    return 0;
+}
@@ -0,0 +1,78 @@
+// Memory per node and routing speed of rings built in the NodePool. For each
+// ring size, reports the size of a Node and of its finger table and
+// successor list, the pool's slab memory and the other heap memory (key
+// stores) per node, and lookup throughput between random nodes.
+//
+// Usage: bench_node_memory [sizes] [lookups]
+//        e.g. bench_node_memory 10000,100000,1000000 1000000
+
+#include "../node.h"
+#include <chrono>
+#include <cstdlib>
+#include <random>
+#include <sstream>
+#ifdef __GLIBC__
+#include <malloc.h>
+#endif
+
+typedef std::chrono::steady_clock Clock;
+
+static double secondsSince(Clock::time_point start) {
+    return std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+// Bytes allocated from the heap, where the C library can tell
+static size_t heapBytes() {
+#if defined(__GLIBC__) && (__GLIBC__ > 2 || (__GLIBC__ == 2 && __GLIBC_MINOR__ >= 33))
+    struct mallinfo2 info = mallinfo2();
+    return info.uordblks + info.hblkhd;
+#else
+    return 0;
+#endif
+}
+
+int main(int argc, char** argv) {
+    std::vector<size_t> sizes;
+    std::stringstream list(argc > 1 ? argv[1] : "10000,100000,1000000");
+    for (std::string item; std::getline(list, item, ',');) {
+        sizes.push_back(std::strtoul(item.c_str(), nullptr, 10));
+    }
+    size_t lookups = argc > 2 ? std::strtoul(argv[2], nullptr, 10) : 1000000;
+
+    std::cout << BITLENGTH << "-bit ids: Node " << sizeof(Node) << " bytes, finger table " << sizeof(FingerTable)
+              << ", successor list " << sizeof(SuccessorList) << std::endl;
+    std::cout << "nodes\tpool B/node\theap B/node\ttotal B/node\tlookups/s" << std::endl;
+    size_t slabBytes = 0;
+    for (size_t count : sizes) {
+        size_t heapBefore = heapBytes();
+        std::mt19937_64 rng(42);
+        std::vector<Node*> nodes;
+        for (size_t i = 0; i < count; i++) {
+            nodes.push_back(new Node(static_cast<NodeId>(rng())));
+        }
+        Node::buildRing(nodes);
+        NodePool::Stats pool = NodePool::stats();
+        // Slabs freed by a smaller ring are reused, so divide all of them by the live nodes
+        double poolPerNode = static_cast<double>(pool.bytes) / pool.live;
+        // The nodes vector is counted with the heap, as the callers' own lists would be
+        size_t newSlabs = pool.bytes - std::min(pool.bytes, slabBytes);
+        double heapPerNode = static_cast<double>(heapBytes() - heapBefore - newSlabs) / count;
+        slabBytes = pool.bytes;
+
+        auto start = Clock::now();
+        size_t hops = 0;
+        for (size_t i = 0; i < lookups; i++) {
+            hops += nodes[rng() % count]->lookup(static_cast<NodeId>(rng())).hops;
+        }
+        double seconds = secondsSince(start);
+        std::cout << count << "\t" << poolPerNode << "\t\t" << heapPerNode << "\t\t" << poolPerNode + heapPerNode
+                  << "\t\t" << lookups / seconds << std::endl;
+        if (hops == 0) {
+            std::cout << "no hops" << std::endl;
+        }
+        for (Node* node : nodes) {
+            delete node;
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,171 @@
+// Replication factors 1 to R: read hops and read throughput under a Zipf
+// workload, the share of reads taken by the busiest node, messages and
+// throughput of writes for each acknowledgement mode, and how many keys are
+// still readable after a fraction of the nodes crash without handing off.
+//
+// Usage: bench_replication [nodes] [keys] [lookups] [crash fraction] [factors]
+//        e.g. bench_replication 10000 100000 200000 0.2 1,2,3,5
+
+#include "../node.h"
+#include "workload.h"
+#include <chrono>
+#include <cstdlib>
+#include <random>
+#include <sstream>
+
+typedef std::chrono::steady_clock Clock;
+
+static double secondsSince(Clock::time_point start) {
+    return std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+static bool successorsConsistent(const std::vector<Node*>& live) {
+    for (size_t i = 0; i < live.size(); i++) {
+        if (live[i]->getFingerTable().getNodePtr(1) != live[(i + 1) % live.size()]) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static uint64_t stabilizeAll(const std::vector<Node*>& nodes) {
+    Node::resetMessageCount();
+    for (Node* node : nodes) {
+        node->stabilize();
+    }
+    return Node::messageCount();
+}
+
+static const char* ackName(WriteAck ack) {
+    return ack == WriteAck::One ? "one" : ack == WriteAck::Quorum ? "quorum" : "all";
+}
+
+static void run(size_t nodeCount, size_t keyCount, size_t lookups, double crashFraction, size_t factor) {
+    std::mt19937_64 rng(42);
+    std::set<NodeId> used;
+    std::vector<Node*> nodes;
+    while (nodes.size() < nodeCount) {
+        NodeId id = static_cast<NodeId>(rng());
+        if (used.insert(id).second) {
+            nodes.push_back(new Node(id));
+        }
+    }
+    std::vector<NodeId> keys;
+    std::vector<std::string> values;
+    std::vector<std::pair<NodeId, std::string> > entries;
+    for (size_t i = 0; i < keyCount; i++) {
+        keys.push_back(static_cast<NodeId>(rng()));
+        values.push_back("v" + std::to_string(i));
+        entries.emplace_back(keys.back(), values.back());
+    }
+    Node::buildRing(nodes, entries);
+    entries.clear();
+
+    // The first stabilize round copies every range onto its replicas
+    Node::setReplication(factor);
+    auto start = Clock::now();
+    uint64_t fillMessages = stabilizeAll(nodes);
+    double fillSeconds = secondsSince(start);
+
+    // Zipf reads from random origins
+    ZipfSampler zipf(keys.size(), 1.1);
+    std::map<Node*, size_t> served;
+    uint64_t hops = 0;
+    size_t wrong = 0;
+    std::string value;
+    start = Clock::now();
+    for (size_t i = 0; i < lookups; i++) {
+        Node* origin = nodes[rng() % nodes.size()];
+        size_t k = zipf(rng);
+        LookupResult r = origin->lookup(keys[k], &value);
+        hops += r.hops;
+        served[r.servedBy]++;
+        if (!r.found || value != values[k]) {
+            wrong++;
+        }
+    }
+    double readSeconds = secondsSince(start);
+    size_t busiest = 0;
+    for (auto& entry : served) {
+        busiest = std::max(busiest, entry.second);
+    }
+
+    std::cout << "R=" << factor << "  fill: " << fillMessages << " msgs " << fillSeconds << " s" << std::endl;
+    std::cout << "  reads: " << static_cast<double>(hops) / lookups << " hops, " << lookups / readSeconds
+              << " reads/s, busiest node " << 100.0 * busiest / lookups << "% of reads, " << wrong << " wrong"
+              << std::endl;
+
+    // Overwrites under each acknowledgement mode, then the repair that
+    // brings lagging replicas up to date
+    size_t writes = std::min<size_t>(20000, keyCount);
+    const WriteAck acks[] = {WriteAck::One, WriteAck::Quorum, WriteAck::All};
+    for (WriteAck ack : acks) {
+        Node::setReplication(factor, ack);
+        Node::resetMessageCount();
+        start = Clock::now();
+        for (size_t i = 0; i < writes; i++) {
+            size_t k = rng() % keys.size();
+            values[k] = "w" + std::to_string(i);
+            nodes[rng() % nodes.size()]->insert(keys[k], values[k]);
+        }
+        double writeSeconds = secondsSince(start);
+        uint64_t writeMessages = Node::messageCount();
+        uint64_t repairMessages = stabilizeAll(nodes);
+        std::cout << "  writes ack=" << ackName(ack) << ": " << static_cast<double>(writeMessages) / writes
+                  << " msgs/write, " << writes / writeSeconds << " writes/s, repair " << repairMessages << " msgs"
+                  << std::endl;
+    }
+
+    // Crash a fraction of the nodes at once and stabilize until the ring is
+    // whole again; one more round lets the new owners re-replicate
+    std::vector<Node*> live;
+    std::vector<Node*> crashed;
+    for (Node* node : nodes) {
+        (std::uniform_real_distribution<double>(0, 1)(rng) < crashFraction ? crashed : live).push_back(node);
+    }
+    for (Node* node : crashed) {
+        node->fail();
+    }
+    size_t rounds = 0;
+    while (!successorsConsistent(live) && rounds < 50) {
+        stabilizeAll(live);
+        rounds++;
+    }
+    stabilizeAll(live);
+    size_t readable = 0;
+    for (size_t k = 0; k < keys.size(); k++) {
+        LookupResult r = live[k % live.size()]->lookup(keys[k], &value);
+        if (r.found && value == values[k]) {
+            readable++;
+        }
+    }
+    std::cout << "  after " << crashed.size() << " crashes (" << rounds << " rounds): "
+              << 100.0 * readable / keys.size() << "% of keys readable" << std::endl;
+
+    Node::setReplication(1);
+    for (Node* node : nodes) {
+        delete node;
+    }
+}
+
+int main(int argc, char** argv) {
+    size_t nodeCount = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 10000;
+    size_t keyCount = argc > 2 ? std::strtoul(argv[2], nullptr, 10) : 100000;
+    size_t lookups = argc > 3 ? std::strtoul(argv[3], nullptr, 10) : 200000;
+    double crashFraction = argc > 4 ? std::atof(argv[4]) : 0.2;
+    std::vector<size_t> factors = {1, 2, 3, 5};
+    if (argc > 5) {
+        factors.clear();
+        std::stringstream list(argv[5]);
+        std::string factor;
+        while (std::getline(list, factor, ',')) {
+            factors.push_back(std::strtoul(factor.c_str(), nullptr, 10));
+        }
+    }
+
+    std::cout << nodeCount << " nodes, " << keyCount << " keys, " << lookups << " Zipf reads" << std::endl;
+    for (size_t factor : factors) {
+        run(nodeCount, keyCount, lookups, crashFraction, factor);
+    }
+    return 0;
+}
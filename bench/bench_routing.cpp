@@ -0,0 +1,166 @@
+// Iterative against recursive routing (RoutingMode). First a check of
+// lookup owners against the ring's sorted ids on many small rings, with every
+// node as origin and keys at, just before and just after every node id, and
+// of findBatch owners and hops against lookup; the bench exits non-zero on
+// any difference. Then on an in-process
+// ring: messages and round trips per lookup and per insert for each mode,
+// over the same queries, whose owners must agree. Then end-to-end lookup
+// latency from the Simulator, on a steady ring and under churn, where a
+// recursive lookup pays one-way hops plus the reply and an iterative one a
+// round trip from the origin per hop. Over loopback, "chord_net ring"
+// compares the two modes between processes.
+//
+// Usage: bench_routing [nodes] [lookups] [virtual seconds] [session times]
+//        e.g. bench_routing 100000 100000 300 0,600
+
+#include "../simulator.h"
+#include "workload.h"
+#include <cstdlib>
+#include <random>
+#include <set>
+#include <sstream>
+
+static const char* name(RoutingMode mode) {
+    return mode == RoutingMode::Iterative ? "iterative" : "recursive";
+}
+
+// First id at or after key, wrapping past zero
+static NodeId expectedOwner(const std::set<NodeId>& ids, NodeId key) {
+    auto it = ids.lower_bound(key);
+    return it != ids.end() ? *it : *ids.begin();
+}
+
+// Lookups from every node of rings of 1 to 64 nodes, checked against the
+// sorted ids, and the same keys as one findBatch, checked against the
+// lookups. Returns the number of wrong owners and batch mismatches.
+static size_t checkOwners(size_t rings) {
+    std::mt19937_64 rng(1);
+    size_t lookups = 0, wrong = 0, mismatched = 0;
+    for (size_t r = 0; r < rings; r++) {
+        std::set<NodeId> ids;
+        size_t count = 1 + rng() % 64;
+        while (ids.size() < count) {
+            ids.insert(static_cast<NodeId>(rng()));
+        }
+        std::vector<Node*> nodes;
+        std::vector<NodeId> keys;
+        for (NodeId id : ids) {
+            nodes.push_back(new Node(id));
+            keys.push_back(id);
+            keys.push_back(ChordRing::sub(id, NodeId(1)));
+            keys.push_back(ChordRing::add(id, NodeId(1)));
+        }
+        for (size_t i = 0; i < 16; i++) {
+            keys.push_back(static_cast<NodeId>(rng()));
+        }
+        Node::buildRing(nodes);
+        for (Node* origin : nodes) {
+            BatchResult batch = origin->findBatch(keys);
+            for (size_t i = 0; i < keys.size(); i++) {
+                LookupResult result = origin->lookup(keys[i]);
+                wrong += result.node == nullptr || result.node->getId() != expectedOwner(ids, keys[i]);
+                mismatched += batch.results[i].node != result.node || batch.results[i].hops != result.hops;
+                lookups++;
+            }
+        }
+        for (Node* node : nodes) {
+            delete node;
+        }
+    }
+    std::cout << "owner check: " << lookups << " lookups on " << rings << " rings, " << wrong << " wrong, "
+              << mismatched << " batch owners or hops differ" << std::endl;
+    return wrong + mismatched;
+}
+
+int main(int argc, char** argv) {
+    size_t nodeCount = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 100000;
+    size_t lookupCount = argc > 2 ? std::strtoul(argv[2], nullptr, 10) : 100000;
+    double duration = argc > 3 ? std::atof(argv[3]) : 300.0;
+    std::vector<double> sessions;
+    std::stringstream list(argc > 4 ? argv[4] : "0,600");
+    for (std::string item; std::getline(list, item, ',');) {
+        sessions.push_back(std::atof(item.c_str()));
+    }
+    const RoutingMode modes[] = {RoutingMode::Iterative, RoutingMode::Recursive};
+    int status = checkOwners(200) != 0;
+
+    std::mt19937_64 rng(42);
+    std::vector<Node*> nodes;
+    for (size_t i = 0; i < nodeCount; i++) {
+        nodes.push_back(new Node(static_cast<NodeId>(rng())));
+    }
+    Node::buildRing(nodes);
+    std::vector<std::pair<Node*, NodeId> > queries;
+    for (size_t i = 0; i < lookupCount; i++) {
+        queries.emplace_back(nodes[rng() % nodeCount], static_cast<NodeId>(rng()));
+    }
+
+    std::cout << nodeCount << " nodes, " << BITLENGTH << "-bit ids, " << lookupCount << " lookups" << std::endl;
+    std::cout << "mode\t\thops\tmessages\tround trips\tinsert messages\twrong owners" << std::endl;
+    std::vector<Node*> owners(lookupCount);
+    for (RoutingMode mode : modes) {
+        Node::setRoutingMode(mode);
+        uint64_t hops = 0, messages = 0, roundTrips = 0;
+        size_t wrong = 0;
+        for (size_t i = 0; i < lookupCount; i++) {
+            LookupResult r = queries[i].first->lookup(queries[i].second);
+            hops += r.hops;
+            messages += r.messages;
+            roundTrips += r.roundTrips;
+            if (mode == modes[0]) {
+                owners[i] = r.node;
+            } else {
+                wrong += owners[i] != r.node;
+            }
+        }
+        // Routing messages of insert and remove come from findSuccessor
+        Node::resetMessageCount();
+        for (size_t i = 0; i < lookupCount; i++) {
+            queries[i].first->insert(queries[i].second, "v");
+        }
+        double insertMessages = static_cast<double>(Node::messageCount()) / lookupCount;
+        for (size_t i = 0; i < lookupCount; i++) {
+            queries[i].first->remove(queries[i].second);
+        }
+        double n = static_cast<double>(lookupCount);
+        std::cout << name(mode) << "\t" << hops / n << "\t" << messages / n << "\t\t" << roundTrips / n << "\t\t"
+                  << insertMessages << "\t\t" << wrong << std::endl;
+        status |= wrong != 0;
+    }
+    for (Node* node : nodes) {
+        delete node;
+    }
+
+    std::cout << "\nSimulator, " << duration << " virtual s at 1000 lookups/s" << std::endl;
+    std::cout << "session s\tmode\t\thops\tlatency ms\tp99 ms\tmessages\tround trips\tfailed %" << std::endl;
+    for (double session : sessions) {
+        for (RoutingMode mode : modes) {
+            SimulatorOptions options;
+            options.lookupRate = 1000.0;
+            options.routing = mode;
+            if (session > 0) {
+                double rate = nodeCount / session;
+                options.joinRate = rate;
+                options.leaveRate = rate / 2;
+                options.failRate = rate / 2;
+            }
+            Simulator simulator(options);
+            simulator.bootstrap(nodeCount);
+            simulator.run(options.stabilizeInterval);
+            simulator.resetStats();
+            simulator.run(duration);
+            SimulatorStats stats = simulator.getStats();
+            double lookups = std::max<double>(1, stats.lookups);
+            double mean = 0;
+            for (double latency : stats.latencies) {
+                mean += latency;
+            }
+            mean /= std::max<size_t>(1, stats.latencies.size());
+            std::cout << (session > 0 ? std::to_string(static_cast<uint64_t>(session)) : "none") << "\t\t"
+                      << name(mode) << "\t" << stats.hops / lookups << "\t" << mean * 1e3 << "\t\t"
+                      << percentile(stats.latencies, 0.99) * 1e3 << "\t" << stats.lookupMessages / lookups << "\t\t"
+                      << stats.roundTrips / lookups << "\t\t" << 100.0 * stats.failedLookups / lookups << std::endl;
+        }
+    }
+    return status;
+}
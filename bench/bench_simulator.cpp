@@ -0,0 +1,74 @@
+// Lookup latency and the cost of stale fingers under churn, from the
+// discrete-event Simulator. For each mean session time, nodes join at the
+// rate that keeps the ring size steady and leave at the same rate, half
+// gracefully and half by crashing. After a warm-up of one stabilize period,
+// reports hops, end-to-end latency, timeouts on dead nodes, failed lookups,
+// the share of stale fingers, maintenance messages per node per second,
+// and the simulator's own speed.
+//
+// Usage: bench_simulator [nodes] [virtual seconds] [lookups/s] [threads] [session times]
+//        e.g. bench_simulator 100000 300 1000 1 0,3600,600
+
+#include "../simulator.h"
+#include "workload.h"
+#include <chrono>
+#include <cstdlib>
+#include <sstream>
+
+typedef std::chrono::steady_clock Clock;
+
+static double secondsSince(Clock::time_point start) {
+    return std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+int main(int argc, char** argv) {
+    size_t nodeCount = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 100000;
+    double duration = argc > 2 ? std::atof(argv[2]) : 300.0;
+    double lookupRate = argc > 3 ? std::atof(argv[3]) : 1000.0;
+    size_t threads = argc > 4 ? std::strtoul(argv[4], nullptr, 10) : 1;
+    std::vector<double> sessions;
+    std::stringstream list(argc > 5 ? argv[5] : "0,3600,600");
+    for (std::string item; std::getline(list, item, ',');) {
+        sessions.push_back(std::atof(item.c_str()));
+    }
+
+    std::cout << nodeCount << " nodes, " << duration << " virtual s, " << lookupRate << " lookups/s, " << threads
+              << " threads" << std::endl;
+    std::cout << "session s\tjoins\tdeparts\thops\tlatency ms\tp99 ms\ttimeouts\tfailed %\tstale %\t"
+              << "maint msg/node/s\tevents/s" << std::endl;
+    for (double session : sessions) {
+        SimulatorOptions options;
+        options.lookupRate = lookupRate;
+        options.sampleInterval = 10.0;
+        options.threads = threads;
+        if (session > 0) {
+            double rate = nodeCount / session;
+            options.joinRate = rate;
+            options.leaveRate = rate / 2;
+            options.failRate = rate / 2;
+        }
+        Simulator simulator(options);
+        simulator.bootstrap(nodeCount);
+        simulator.run(options.stabilizeInterval);
+        simulator.resetStats();
+
+        auto start = Clock::now();
+        simulator.run(duration);
+        double seconds = secondsSince(start);
+        SimulatorStats stats = simulator.getStats();
+        double lookups = std::max<double>(1, stats.lookups);
+        double mean = 0;
+        for (double latency : stats.latencies) {
+            mean += latency;
+        }
+        mean /= std::max<size_t>(1, stats.latencies.size());
+        std::cout << (session > 0 ? std::to_string(static_cast<uint64_t>(session)) : "none") << "\t\t" << stats.joins
+                  << "\t" << stats.leaves + stats.failures << "\t" << stats.hops / lookups << "\t" << mean * 1e3
+                  << "\t\t" << percentile(stats.latencies, 0.99) * 1e3 << "\t" << stats.timeouts / lookups << "\t\t"
+                  << 100.0 * stats.failedLookups / lookups << "\t\t"
+                  << 100.0 * stats.staleFingers / std::max<uint64_t>(1, stats.fingersSampled) << "\t"
+                  << stats.maintenanceMessages / duration / nodeCount << "\t\t\t" << stats.events / seconds
+                  << std::endl;
+    }
+    return 0;
+}
@@ -0,0 +1,90 @@
+// Bootstrapping a large ring: building it with Node::buildRing against
+// saving it once and loading the snapshot. Reports the file size, save and
+// load times, and checks that lookups on the loaded ring reach the same
+// owners and values as on the original.
+//
+// Usage: bench_snapshot [nodes] [keys] [threads] [file]
+//        e.g. bench_snapshot 1000000 100000000 0 /tmp/ring.snap
+
+#include "../snapshot.h"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <unistd.h>
+
+typedef std::chrono::steady_clock Clock;
+
+static double secondsSince(Clock::time_point start) {
+    return std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+int main(int argc, char** argv) {
+    size_t nodeCount = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 100000;
+    size_t keyCount = argc > 2 ? std::strtoul(argv[2], nullptr, 10) : 1000000;
+    size_t threads = argc > 3 ? std::strtoul(argv[3], nullptr, 10) : 1;
+    std::string path = argc > 4 ? argv[4] : "/tmp/chord_snapshot_bench." + std::to_string(getpid());
+
+    std::mt19937_64 rng(42);
+    std::vector<Node*> nodes;
+    for (size_t i = 0; i < nodeCount; i++) {
+        nodes.push_back(new Node(static_cast<NodeId>(rng())));
+    }
+    std::vector<std::pair<NodeId, std::string> > entries;
+    entries.reserve(keyCount);
+    for (size_t i = 0; i < keyCount; i++) {
+        NodeId key = static_cast<NodeId>(rng());
+        entries.emplace_back(key, ChordRing::toString(key));
+    }
+    std::cout << nodeCount << " nodes, " << keyCount << " keys, " << threads << " threads" << std::endl;
+
+    auto start = Clock::now();
+    Node::buildRing(nodes, entries, threads);
+    std::cout << "buildRing: " << secondsSince(start) << " s" << std::endl;
+
+    start = Clock::now();
+    if (!RingSnapshot::save(nodes, path)) {
+        std::cerr << "cannot write " << path << std::endl;
+        return 1;
+    }
+    double seconds = secondsSince(start);
+    FILE* file = std::fopen(path.c_str(), "rb");
+    std::fseek(file, 0, SEEK_END);
+    long bytes = std::ftell(file);
+    std::fclose(file);
+    std::cout << "save: " << seconds << " s, " << bytes / 1e6 << " MB" << std::endl;
+
+    RingSnapshot snapshot;
+    start = Clock::now();
+    if (!snapshot.load(path, threads)) {
+        std::cerr << "cannot load " << path << std::endl;
+        return 1;
+    }
+    std::cout << "load: " << secondsSince(start) << " s, " << snapshot.getNodes().size() << " nodes, "
+              << snapshot.keyCount() << " keys" << std::endl;
+
+    // Same lookups from the same starting positions on both rings
+    std::vector<Node*>& loaded = snapshot.getNodes();
+    size_t checks = std::min<size_t>(keyCount, 100000);
+    size_t wrong = 0;
+    uint64_t hops = 0;
+    for (size_t i = 0; i < checks; i++) {
+        const std::pair<NodeId, std::string>& entry = entries[rng() % keyCount];
+        size_t from = rng() % nodeCount;
+        LookupResult expected = nodes[from]->lookup(entry.first);
+        LookupResult result = loaded[from]->lookup(entry.first);
+        hops += result.hops;
+        if (!result.found || result.value.str() != entry.second || result.node == nullptr ||
+            expected.node == nullptr || result.node->getId() != expected.node->getId()) {
+            wrong++;
+        }
+    }
+    std::cout << "verify: " << checks << " lookups, " << static_cast<double>(hops) / checks << " hops, wrong="
+              << wrong << std::endl;
+
+    for (Node* node : nodes) {
+        delete node;
+    }
+    std::remove(path.c_str());
+    return wrong == 0 ? 0 : 1;
+}
@@ -0,0 +1,97 @@
+// Parallel maintenance rounds (Node::stabilizeRing) after a mass crash. For
+// each thread count, builds the same ring, crashes the same fraction of its
+// nodes, and runs rounds until one changes nothing; reports the rounds it took
+// and their wall time, then checks every live node's successor list,
+// predecessor and fingers against the sorted live ids. Nodes whose whole
+// successor list crashed stay cut off, as they would with stabilize, and so
+// do fingers routed through them; large fractions show up as wrong nodes.
+//
+// Usage: bench_stabilize [nodes] [crash fraction] [threads]
+//        e.g. bench_stabilize 100000 0.2 1,2,4,8
+
+#include "../node.h"
+#include <cstdlib>
+#include <random>
+#include <sstream>
+#include <thread>
+
+// Live nodes whose successor list, predecessor or fingers are not the ring's
+static size_t wrongNodes(const std::vector<Node*>& live) {
+    std::vector<NodeId> ids;
+    for (Node* node : live) {
+        ids.push_back(node->getId());
+    }
+    size_t n = live.size();
+    auto owner = [&](NodeId id) {
+        size_t index = std::lower_bound(ids.begin(), ids.end(), id) - ids.begin();
+        return live[index == n ? 0 : index];
+    };
+    size_t wrong = 0;
+    for (size_t i = 0; i < n; i++) {
+        Node* node = live[i];
+        bool ok = node->getPredecessor() == live[(i + n - 1) % n];
+        const SuccessorList& list = node->getSuccessorList();
+        for (size_t s = 0; ok && s < list.size(); s++) {
+            ok = list.get(s) == live[(i + 1 + s) % n];
+        }
+        for (int k = 1; ok && k <= BITLENGTH; k++) {
+            ok = node->getFingerTable().getNodePtr(k) == owner(ChordRing::fingerStart(node->getId(), k));
+        }
+        wrong += !ok;
+    }
+    return wrong;
+}
+
+int main(int argc, char** argv) {
+    size_t nodeCount = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 100000;
+    double crashFraction = argc > 2 ? std::atof(argv[2]) : 0.2;
+    std::vector<size_t> threadCounts;
+    std::stringstream list(argc > 3 ? argv[3] : "");
+    for (std::string item; std::getline(list, item, ',');) {
+        threadCounts.push_back(std::strtoul(item.c_str(), nullptr, 10));
+    }
+    if (threadCounts.empty()) {
+        for (size_t t = 1; t <= std::max(1u, std::thread::hardware_concurrency()); t *= 2) {
+            threadCounts.push_back(t);
+        }
+    }
+
+    std::cout << nodeCount << " nodes, " << BITLENGTH << "-bit ids, " << crashFraction * 100 << "% crashed"
+              << std::endl;
+    std::cout << "threads\trounds\tconverged\tchanges\tms/round\tmax ms\ttotal s\tspeedup\twrong" << std::endl;
+    double baseline = 0.0;
+    for (size_t threads : threadCounts) {
+        std::mt19937_64 rng(42);
+        std::vector<Node*> nodes;
+        for (size_t i = 0; i < nodeCount; i++) {
+            nodes.push_back(new Node(static_cast<NodeId>(rng())));
+        }
+        Node::buildRing(nodes, std::vector<std::pair<NodeId, std::string> >(), threads);
+        std::vector<Node*> live;
+        // The first node always survives, so the ring never empties
+        for (size_t i = 0; i < nodeCount; i++) {
+            if (i > 0 && std::generate_canonical<double, 64>(rng) < crashFraction) {
+                nodes[i]->fail();
+            } else {
+                live.push_back(nodes[i]);
+            }
+        }
+
+        StabilizeResult result = Node::stabilizeRing(nodes, threads);
+        double longest = 0.0;
+        for (double seconds : result.roundSeconds) {
+            longest = std::max(longest, seconds);
+        }
+        double total = result.seconds();
+        if (baseline == 0.0) {
+            baseline = total;
+        }
+        std::cout << threads << "\t" << result.rounds << "\t" << (result.converged ? "yes" : "no") << "\t\t"
+                  << result.changes << "\t" << total * 1e3 / result.roundSeconds.size() << "\t\t" << longest * 1e3
+                  << "\t" << total << "\t" << baseline / total << "\t" << wrongNodes(live) << std::endl;
+        for (Node* node : nodes) {
+            delete node;
+        }
+    }
+    return 0;
+}
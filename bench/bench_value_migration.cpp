@@ -0,0 +1,127 @@
+// Migration of large values (ValueBuffer). First between two stores: moving
+// every entry by copying its bytes, as migration did before values were
+// shared, against extractRange, which hands each buffer over. Then on a ring:
+// a node joins and pulls its range from its successor, then leaves and
+// streams it back, and the keys and bytes moved per second are reported.
+//
+// Usage: bench_value_migration [value sizes] [MB per size] [nodes] [rounds]
+//        e.g. bench_value_migration 1024,16384,262144,1048576 128 16 8
+
+#include "../node.h"
+#include <cstdlib>
+#include <iostream>
+#include <random>
+#include <sstream>
+
+typedef std::chrono::steady_clock Clock;
+
+static double secondsSince(Clock::time_point start) {
+    return std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+// Sum of every value's bytes at a sparse stride, to check that moves kept them
+static uint64_t checksum(const KeyStore& store) {
+    uint64_t sum = 0;
+    for (const KeyValue& kv : store) {
+        for (size_t i = 0; i < kv.second.size; i += 997) {
+            sum += static_cast<uint8_t>(kv.second.data[i]);
+        }
+    }
+    return sum;
+}
+
+int main(int argc, char** argv) {
+    std::vector<size_t> sizes;
+    std::stringstream list(argc > 1 ? argv[1] : "1024,16384,262144,1048576");
+    for (std::string item; std::getline(list, item, ',');) {
+        sizes.push_back(std::strtoul(item.c_str(), nullptr, 10));
+    }
+    size_t budget = (argc > 2 ? std::strtoul(argv[2], nullptr, 10) : 128) << 20;
+    size_t nodeCount = argc > 3 ? std::strtoul(argv[3], nullptr, 10) : 16;
+    size_t rounds = argc > 4 ? std::strtoul(argv[4], nullptr, 10) : 8;
+    int status = 0;
+
+    std::cout << "Store to store, " << (budget >> 20) << " MB per value size" << std::endl;
+    std::cout << "value bytes\tentries\tcopy GB/s\tshare GB/s\tcopy entries/s\tshare entries/s\twrong" << std::endl;
+    for (size_t size : sizes) {
+        size_t count = std::max<size_t>(1, budget / size);
+        std::mt19937_64 rng(42);
+        std::string value(size, '\0');
+        SortedVectorStore source;
+        for (size_t i = 0; i < count; i++) {
+            for (char& c : value) {
+                c = static_cast<char>(rng());
+            }
+            source.put(static_cast<NodeId>(rng()), value);
+        }
+        uint64_t expected = checksum(source);
+
+        // Copy every value into the destination, then drop the source's entries
+        SortedVectorStore copied;
+        auto start = Clock::now();
+        for (const KeyValue& kv : source) {
+            copied.put(kv.first, kv.key, kv.second);
+        }
+        source.clear();
+        double copySeconds = secondsSince(start);
+
+        SortedVectorStore shared;
+        start = Clock::now();
+        copied.extractRange(NodeId(0), NodeId(0), shared);
+        double shareSeconds = secondsSince(start);
+
+        bool wrong = checksum(shared) != expected || shared.size() != count || !copied.empty();
+        double bytes = static_cast<double>(count) * size;
+        std::cout << size << "\t\t" << count << "\t" << bytes / copySeconds / 1e9 << "\t\t"
+                  << bytes / shareSeconds / 1e9 << "\t\t" << count / copySeconds << "\t\t" << count / shareSeconds
+                  << "\t\t" << (wrong ? "yes" : "no") << std::endl;
+        status |= wrong;
+    }
+
+    std::cout << "\nJoin and leave on a " << nodeCount << "-node ring, " << rounds << " rounds" << std::endl;
+    std::cout << "value bytes\tkeys moved\tjoin ms\tjoin GB/s\tleave ms\tleave GB/s\tlost" << std::endl;
+    for (size_t size : sizes) {
+        std::mt19937_64 rng(7);
+        std::vector<Node*> nodes;
+        for (size_t i = 0; i < nodeCount; i++) {
+            nodes.push_back(new Node(static_cast<NodeId>(rng())));
+        }
+        std::vector<std::pair<NodeId, std::string> > entries;
+        for (size_t i = 0; i < std::max<size_t>(1, budget / size); i++) {
+            entries.emplace_back(static_cast<NodeId>(rng()), std::string(size, static_cast<char>('a' + i % 26)));
+        }
+        Node::buildRing(nodes, entries);
+        entries.clear();
+
+        size_t moved = 0, lost = 0;
+        double joinSeconds = 0, leaveSeconds = 0;
+        std::vector<Node*> departed;
+        for (size_t r = 0; r < rounds; r++) {
+            Node* node = new Node(static_cast<NodeId>(rng()));
+            auto start = Clock::now();
+            node->join(nodes[rng() % nodeCount]);
+            joinSeconds += secondsSince(start);
+            size_t keys = node->getLocalKeys().size();
+            moved += keys;
+            Node* successor = node->getFingerTable().getNodePtr(1);
+            size_t before = successor->getLocalKeys().size();
+            start = Clock::now();
+            node->leave();
+            leaveSeconds += secondsSince(start);
+            lost += before + keys - successor->getLocalKeys().size();
+            departed.push_back(node);
+        }
+        double bytes = static_cast<double>(moved) * size;
+        std::cout << size << "\t\t" << moved << "\t\t" << joinSeconds * 1e3 / rounds << "\t"
+                  << bytes / joinSeconds / 1e9 << "\t\t" << leaveSeconds * 1e3 / rounds << "\t"
+                  << bytes / leaveSeconds / 1e9 << "\t\t" << lost << std::endl;
+        status |= lost != 0;
+        for (Node* node : departed) {
+            delete node;
+        }
+        for (Node* node : nodes) {
+            delete node;
+        }
+    }
+    return status;
+}
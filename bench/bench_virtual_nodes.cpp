@@ -0,0 +1,96 @@
+// Key load per physical host with 1 to K virtual nodes per host, and with
+// adaptive rebalancing that adds virtual nodes until the variance of
+// per-host key counts falls under a threshold. Every configuration checks
+// that each stored key is still found at its successor afterwards.
+//
+// Usage: bench_virtual_nodes [hosts] [keys] [max virtual nodes per host] [target cv]
+
+#include "../host.h"
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <random>
+
+struct Outcome {
+    double variance;
+    double maxOverMean;
+    size_t virtualNodes;
+    double found;
+};
+
+static Outcome measure(std::vector<Host*>& hosts, const std::vector<NodeId>& keys) {
+    size_t maxLoad = 0;
+    size_t virtualNodes = 0;
+    for (Host* host : hosts) {
+        maxLoad = std::max(maxLoad, host->load());
+        virtualNodes += host->getVirtualNodes().size();
+    }
+    size_t found = 0;
+    for (size_t i = 0; i < keys.size(); i++) {
+        LookupResult r = hosts[i % hosts.size()]->lookup(keys[i]);
+        if (r.found && r.value.str() == std::to_string(i)) {
+            found++;
+        }
+    }
+    double mean = static_cast<double>(keys.size()) / hosts.size();
+    return Outcome{Host::loadVariance(hosts), maxLoad / mean, virtualNodes, 100.0 * found / keys.size()};
+}
+
+static void print(const std::string& label, const Outcome& o, double mean) {
+    std::cout << label << "\t" << o.virtualNodes << "\t" << o.variance << "\t" << std::sqrt(o.variance) / mean << "\t"
+              << o.maxOverMean << "\t" << o.found << "%" << std::endl;
+}
+
+int main(int argc, char** argv) {
+    size_t hostCount = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 100;
+    size_t keyCount = argc > 2 ? std::strtoul(argv[2], nullptr, 10) : 100000;
+    size_t maxVirtual = argc > 3 ? std::strtoul(argv[3], nullptr, 10) : 64;
+    double targetCv = argc > 4 ? std::atof(argv[4]) : 0.05;
+
+    std::mt19937_64 rng(42);
+    std::vector<NodeId> keys;
+    std::set<NodeId> unique;
+    while (keys.size() < keyCount) {
+        NodeId key = static_cast<NodeId>(rng());
+        if (unique.insert(key).second) {
+            keys.push_back(key);
+        }
+    }
+    double mean = static_cast<double>(keyCount) / hostCount;
+
+    std::cout << "hosts=" << hostCount << " keys=" << keyCount << " bits=" << BITLENGTH << std::endl;
+    std::cout << "mode\tvnodes\tvariance\tcv\tmax/mean\tfound" << std::endl;
+
+    std::vector<size_t> perHost = {1, 4, 16};
+    if (maxVirtual > 16) {
+        perHost.push_back(maxVirtual);
+    }
+    for (size_t k : perHost) {
+        std::vector<Host*> hosts;
+        for (size_t h = 0; h < hostCount; h++) {
+            hosts.push_back(new Host(static_cast<uint32_t>(h)));
+            hosts.back()->addVirtualNodes(k, h == 0 ? nullptr : hosts[0]->getVirtualNodes().front());
+        }
+        Node* entry = hosts[0]->getVirtualNodes().front();
+        for (size_t i = 0; i < keys.size(); i++) {
+            entry->insert(keys[i], std::to_string(i));
+        }
+        print("static k=" + std::to_string(k), measure(hosts, keys), mean);
+
+        // Adaptive: start from k and split heavy ranges until cv <= target
+        if (k == 4) {
+            double threshold = (targetCv * mean) * (targetCv * mean);
+            auto start = std::chrono::steady_clock::now();
+            RebalanceResult r = Host::rebalance(hosts, threshold, maxVirtual);
+            double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+            print("adaptive k=4", measure(hosts, keys), mean);
+            std::cout << "  rebalance: added " << r.added << ", removed " << r.removed << ", keys moved "
+                      << r.keysMoved << ", variance " << r.varianceBefore << " -> " << r.varianceAfter << ", "
+                      << seconds << "s" << std::endl;
+        }
+        for (Host* host : hosts) {
+            delete host;
+        }
+    }
+    return 0;
+}
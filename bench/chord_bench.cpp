@@ -0,0 +1,321 @@
+// Routing, join/leave and migration costs across ring sizes, written as JSON
+// for regression tracking.
+//
+// Usage: chord_bench [--nodes 100,1000,10000,100000] [--workload uniform|zipf|both]
+//                    [--keys-per-node 10] [--max-keys 1000000] [--lookups 100000]
+//                    [--zipf 1.1] [--joins 20] [--leaves 20] [--fail 0.05]
+//                    [--seed 42] [--threads 0] [--out results.json]
+//
+// For every ring size and workload the bench reports lookup hops and latency
+// (mean, p50, p99), the messages, time and keys moved per join and per leave,
+// and how many stabilize rounds reconnect the ring after a fraction of the
+// nodes crash. Rings are bootstrapped with Node::buildRing on --threads
+// threads (0 = every core).
+
+#include "../node.h"
+#include "workload.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <random>
+#include <sstream>
+#include <string>
+
+typedef std::chrono::steady_clock Clock;
+
+static double secondsSince(Clock::time_point start) {
+    return std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+// Counts keys handed between nodes by join/leave
+class MigrationCounter : public TraceSink {
+public:
+    void onMigrate(NodeId /* key */, const Node& /* from */, const Node& /* to */) override {
+        moved++;
+    }
+
+    uint64_t moved = 0;
+};
+
+struct Options {
+    std::vector<size_t> nodes = {100, 1000, 10000, 100000};
+    std::vector<std::string> workloads = {"uniform", "zipf"};
+    size_t keysPerNode = 10;
+    size_t maxKeys = 1000000;
+    size_t lookups = 100000;
+    double zipf = 1.1;
+    size_t joins = 20;
+    size_t leaves = 20;
+    double failFraction = 0.05;
+    uint64_t seed = 42;
+    size_t threads = 0;
+    std::string out;
+};
+
+// First node at or after id in a ring sorted by id
+static Node* ownerOf(const std::vector<Node*>& sorted, NodeId id) {
+    auto it = std::lower_bound(sorted.begin(), sorted.end(), id,
+                               [](Node* n, NodeId k) { return n->getId() < k; });
+    return it == sorted.end() ? sorted.front() : *it;
+}
+
+static bool successorsConsistent(const std::vector<Node*>& sorted) {
+    for (size_t i = 0; i < sorted.size(); i++) {
+        if (sorted[i]->getFingerTable().getNodePtr(1) != sorted[(i + 1) % sorted.size()]) {
+            return false;
+        }
+    }
+    return true;
+}
+
+struct Summary {
+    double mean = 0;
+    double p50 = 0;
+    double p99 = 0;
+};
+
+template <typename T>
+static Summary summarize(std::vector<T>& values) {
+    Summary s;
+    if (values.empty()) {
+        return s;
+    }
+    double sum = 0;
+    for (T v : values) {
+        sum += static_cast<double>(v);
+    }
+    s.mean = sum / values.size();
+    s.p50 = static_cast<double>(percentile(values, 0.50));
+    s.p99 = static_cast<double>(percentile(values, 0.99));
+    return s;
+}
+
+static std::string json(const Summary& s) {
+    std::ostringstream out;
+    out << "{\"mean\": " << s.mean << ", \"p50\": " << s.p50 << ", \"p99\": " << s.p99 << "}";
+    return out.str();
+}
+
+// Cost of one membership change: messages, wall time and keys moved
+struct ChangeCost {
+    std::vector<uint64_t> messages;
+    std::vector<double> micros;
+    std::vector<uint64_t> keysMoved;
+
+    std::string toJson() {
+        std::ostringstream out;
+        out << "{\"samples\": " << messages.size() << ", \"messages\": " << json(summarize(messages))
+            << ", \"micros\": " << json(summarize(micros)) << ", \"keys_moved\": " << json(summarize(keysMoved))
+            << "}";
+        return out.str();
+    }
+};
+
+static std::string runOne(size_t nodeCount, const std::string& workload, const Options& opt) {
+    std::mt19937_64 rng(opt.seed);
+
+    // Ring and keys, bootstrapped in bulk
+    std::set<NodeId> used;
+    std::vector<Node*> sorted;
+    while (sorted.size() < nodeCount) {
+        NodeId id = static_cast<NodeId>(rng());
+        if (used.insert(id).second) {
+            sorted.push_back(new Node(id));
+        }
+    }
+    size_t keyCount = std::max<size_t>(1, std::min(opt.maxKeys, nodeCount * opt.keysPerNode));
+    std::vector<std::pair<NodeId, std::string> > entries;
+    std::vector<NodeId> keys;
+    entries.reserve(keyCount);
+    keys.reserve(keyCount);
+    for (size_t i = 0; i < keyCount; i++) {
+        keys.push_back(static_cast<NodeId>(rng()));
+        entries.emplace_back(keys.back(), std::string("v") + std::to_string(i));
+    }
+    auto buildStart = Clock::now();
+    Node::buildRing(sorted, entries, opt.threads);
+    double buildSeconds = secondsSince(buildStart);
+    entries.clear();
+
+    // Lookups
+    ZipfSampler zipf(keys.size(), opt.zipf);
+    bool skewed = workload == "zipf";
+    std::vector<uint32_t> hops;
+    std::vector<double> latencies;
+    hops.reserve(opt.lookups);
+    latencies.reserve(opt.lookups);
+    size_t wrong = 0;
+    for (size_t i = 0; i < opt.lookups; i++) {
+        Node* origin = sorted[rng() % sorted.size()];
+        NodeId key = keys[skewed ? zipf(rng) : rng() % keys.size()];
+        auto start = Clock::now();
+        LookupResult r = origin->lookup(key);
+        latencies.push_back(std::chrono::duration<double, std::nano>(Clock::now() - start).count());
+        hops.push_back(r.hops);
+        if (r.node != ownerOf(sorted, key) || !r.found) {
+            wrong++;
+        }
+    }
+
+    // Joins and leaves, one at a time on the loaded ring
+    MigrationCounter migrations;
+    TraceSink* previousSink = Node::getTraceSink();
+    Node::setTraceSink(&migrations);
+
+    ChangeCost joins;
+    std::vector<Node*> joined;
+    for (size_t i = 0; i < opt.joins; i++) {
+        NodeId id = static_cast<NodeId>(rng());
+        if (!used.insert(id).second) {
+            continue;
+        }
+        Node* node = new Node(id);
+        Node* bootstrap = sorted[rng() % sorted.size()];
+        Node::resetMessageCount();
+        migrations.moved = 0;
+        auto start = Clock::now();
+        node->join(bootstrap);
+        joins.micros.push_back(std::chrono::duration<double, std::micro>(Clock::now() - start).count());
+        joins.messages.push_back(Node::messageCount());
+        joins.keysMoved.push_back(migrations.moved);
+        sorted.insert(std::lower_bound(sorted.begin(), sorted.end(), node,
+                                       [](Node* a, Node* b) { return a->getId() < b->getId(); }),
+                      node);
+        joined.push_back(node);
+    }
+
+    ChangeCost leaves;
+    std::vector<Node*> departed;
+    for (size_t i = 0; i < opt.leaves && sorted.size() > 2; i++) {
+        size_t index = rng() % sorted.size();
+        Node* node = sorted[index];
+        Node::resetMessageCount();
+        migrations.moved = 0;
+        auto start = Clock::now();
+        node->leave();
+        leaves.micros.push_back(std::chrono::duration<double, std::micro>(Clock::now() - start).count());
+        leaves.messages.push_back(Node::messageCount());
+        leaves.keysMoved.push_back(migrations.moved);
+        sorted.erase(sorted.begin() + index);
+        departed.push_back(node);
+    }
+    Node::setTraceSink(previousSink);
+
+    // Crash a fraction of the nodes and count stabilize rounds until every
+    // live successor pointer is right again
+    size_t crashes = static_cast<size_t>(sorted.size() * opt.failFraction);
+    for (size_t i = 0; i < crashes && sorted.size() > 2; i++) {
+        size_t index = rng() % sorted.size();
+        sorted[index]->fail();
+        departed.push_back(sorted[index]);
+        sorted.erase(sorted.begin() + index);
+    }
+    const size_t maxRounds = 100;
+    size_t rounds = 0;
+    Node::resetMessageCount();
+    auto stabilizeStart = Clock::now();
+    while (!successorsConsistent(sorted) && rounds < maxRounds) {
+        for (Node* node : sorted) {
+            node->stabilize();
+        }
+        rounds++;
+    }
+    double stabilizeSeconds = secondsSince(stabilizeStart);
+    uint64_t stabilizeMessages = Node::messageCount();
+    bool converged = successorsConsistent(sorted);
+
+    std::ostringstream out;
+    out << "    {\"nodes\": " << nodeCount << ", \"workload\": \"" << workload << "\", \"keys\": " << keyCount
+        << ",\n     \"build_seconds\": " << buildSeconds
+        << ",\n     \"lookup\": {\"count\": " << opt.lookups << ", \"wrong\": " << wrong
+        << ", \"hops\": " << json(summarize(hops)) << ", \"latency_ns\": " << json(summarize(latencies)) << "}"
+        << ",\n     \"join\": " << joins.toJson() << ",\n     \"leave\": " << leaves.toJson()
+        << ",\n     \"stabilize\": {\"crashed\": " << crashes << ", \"converged\": " << (converged ? "true" : "false")
+        << ", \"rounds\": " << rounds << ", \"messages\": " << stabilizeMessages
+        << ", \"seconds\": " << stabilizeSeconds << "}}";
+
+    for (Node* node : sorted) {
+        delete node;
+    }
+    for (Node* node : departed) {
+        delete node;
+    }
+    return out.str();
+}
+
+static std::vector<std::string> split(const std::string& list) {
+    std::vector<std::string> parts;
+    std::stringstream in(list);
+    std::string part;
+    while (std::getline(in, part, ',')) {
+        if (!part.empty()) {
+            parts.push_back(part);
+        }
+    }
+    return parts;
+}
+
+int main(int argc, char** argv) {
+    Options opt;
+    for (int i = 1; i + 1 < argc; i += 2) {
+        std::string flag = argv[i];
+        std::string value = argv[i + 1];
+        if (flag == "--nodes") {
+            opt.nodes.clear();
+            for (const std::string& n : split(value)) {
+                opt.nodes.push_back(static_cast<size_t>(std::strtod(n.c_str(), nullptr)));
+            }
+        } else if (flag == "--workload") {
+            opt.workloads = value == "both" ? std::vector<std::string>{"uniform", "zipf"}
+                                            : std::vector<std::string>{value};
+        } else if (flag == "--keys-per-node") {
+            opt.keysPerNode = std::strtoul(value.c_str(), nullptr, 10);
+        } else if (flag == "--max-keys") {
+            opt.maxKeys = std::strtoul(value.c_str(), nullptr, 10);
+        } else if (flag == "--lookups") {
+            opt.lookups = std::strtoul(value.c_str(), nullptr, 10);
+        } else if (flag == "--zipf") {
+            opt.zipf = std::atof(value.c_str());
+        } else if (flag == "--joins") {
+            opt.joins = std::strtoul(value.c_str(), nullptr, 10);
+        } else if (flag == "--leaves") {
+            opt.leaves = std::strtoul(value.c_str(), nullptr, 10);
+        } else if (flag == "--fail") {
+            opt.failFraction = std::atof(value.c_str());
+        } else if (flag == "--threads") {
+            opt.threads = std::strtoul(value.c_str(), nullptr, 10);
+        } else if (flag == "--seed") {
+            opt.seed = std::strtoull(value.c_str(), nullptr, 10);
+        } else if (flag == "--out") {
+            opt.out = value;
+        } else {
+            std::cerr << "unknown option " << flag << std::endl;
+            return 1;
+        }
+    }
+
+    std::ostringstream out;
+    out << "{\n  \"bits\": " << BITLENGTH << ", \"seed\": " << opt.seed << ", \"zipf_s\": " << opt.zipf
+        << ", \"successor_list\": " << SuccessorList::kDefaultLength
+        << ", \"build_threads\": " << opt.threads << ",\n  \"results\": [\n";
+    bool first = true;
+    for (size_t n : opt.nodes) {
+        for (const std::string& workload : opt.workloads) {
+            std::cerr << "nodes=" << n << " workload=" << workload << std::endl;
+            out << (first ? "" : ",\n") << runOne(n, workload, opt);
+            first = false;
+        }
+    }
+    out << "\n  ]\n}\n";
+
+    if (opt.out.empty()) {
+        std::cout << out.str();
+    } else {
+        std::ofstream file(opt.out);
+        file << out.str();
+        std::cerr << "wrote " << opt.out << std::endl;
+    }
+    return 0;
+}
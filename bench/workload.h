@@ -0,0 +1,48 @@
+#ifndef BENCH_WORKLOAD_H
+#define BENCH_WORKLOAD_H
+
+// Key workload helpers shared by the benchmark programs
+
+#include <stddef.h>
+#include <algorithm>
+#include <cmath>
+#include <random>
+#include <vector>
+
+// Draws indexes in [0, n) with probability proportional to 1 / (index + 1)^s
+class ZipfSampler {
+public:
+    ZipfSampler(size_t n, double s) : cdf_(n) {
+        double sum = 0.0;
+        for (size_t i = 0; i < n; i++) {
+            sum += 1.0 / std::pow(static_cast<double>(i + 1), s);
+            cdf_[i] = sum;
+        }
+        for (double& c : cdf_) {
+            c /= sum;
+        }
+    }
+
+    template <typename Rng>
+    size_t operator()(Rng& rng) {
+        double u = std::uniform_real_distribution<double>(0.0, 1.0)(rng);
+        size_t index = std::lower_bound(cdf_.begin(), cdf_.end(), u) - cdf_.begin();
+        return std::min(index, cdf_.size() - 1);
+    }
+
+private:
+    std::vector<double> cdf_;
+};
+
+// p in [0, 1]; reorders values
+template <typename T>
+T percentile(std::vector<T>& values, double p) {
+    if (values.empty()) {
+        return T();
+    }
+    size_t index = std::min(values.size() - 1, static_cast<size_t>(p * values.size()));
+    std::nth_element(values.begin(), values.begin() + index, values.end());
+    return values[index];
+}
+
+#endif
@@ -0,0 +1,357 @@
+// Multi-process Chord over TCP on 127.0.0.1.
+//
+//   chord_net node <port> [bootstrapPort] [--id N] [--interval ms]
+//   chord_net put <port> <key> <value>
+//   chord_net get <port> <key>
+//   chord_net remove <port> <key>
+//   chord_net stats <port>
+//   chord_net ring <nodes> <basePort> [keys]
+//
+// "ring" starts one node process per port, waits until every successor
+// pointer is correct, runs a put/get workload through the RPC client, reads
+// the keys again with recursive routing, and finally stops the nodes with
+// SIGTERM so they leave gracefully.
+
+#include <signal.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <iostream>
+#include <map>
+#include <random>
+#include <set>
+#include <string>
+#include <thread>
+#include <vector>
+#include "key_hash.h"
+#include "net_node.h"
+
+static volatile sig_atomic_t stopRequested = 0;
+
+static void onSignal(int) {
+    stopRequested = 1;
+}
+
+static NodeId toId(uint64_t v) {
+    return ChordRing::add(NodeId(0), NodeId(v));
+}
+
+// SHA-1 of "ip:port", as in the Chord paper: the same address keeps its id
+// across restarts, and adjacent ports still land far apart on the ring
+static NodeId idForPort(uint16_t port) {
+    std::string address = "127.0.0.1:" + std::to_string(port);
+    return KeyHash::toId(ByteView(address), KeyHashFunction::Sha1);
+}
+
+static NodeHandle handleFor(uint16_t port) {
+    NodeHandle h;
+    h.ip = kLoopback;
+    h.port = port;
+    return h;
+}
+
+static double elapsedMicros(std::chrono::steady_clock::time_point since) {
+    return std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - since).count();
+}
+
+static double percentile(std::vector<double> values, double p) {
+    if (values.empty()) {
+        return 0;
+    }
+    size_t index = std::min(values.size() - 1, static_cast<size_t>(p * values.size()));
+    std::nth_element(values.begin(), values.begin() + index, values.end());
+    return values[index];
+}
+
+static int runNode(int argc, char* argv[]) {
+    if (argc < 3) {
+        std::cerr << "usage: chord_net node <port> [bootstrapPort] [--id N] [--interval ms]" << std::endl;
+        return 1;
+    }
+    uint16_t port = static_cast<uint16_t>(std::atoi(argv[2]));
+    uint16_t bootstrapPort = 0;
+    NodeId id = idForPort(port);
+    int interval = 100;
+    for (int i = 3; i < argc; i++) {
+        if (std::strcmp(argv[i], "--id") == 0 && i + 1 < argc) {
+            id = toId(std::strtoull(argv[++i], nullptr, 10));
+        } else if (std::strcmp(argv[i], "--interval") == 0 && i + 1 < argc) {
+            interval = std::atoi(argv[++i]);
+        } else {
+            bootstrapPort = static_cast<uint16_t>(std::atoi(argv[i]));
+        }
+    }
+
+    signal(SIGTERM, onSignal);
+    signal(SIGINT, onSignal);
+    signal(SIGPIPE, SIG_IGN);
+
+    NetNode node(id, port, interval);
+    NodeHandle bootstrap = handleFor(bootstrapPort);
+    if (!node.start(bootstrapPort != 0 ? &bootstrap : nullptr)) {
+        std::cerr << "node " << port << ": failed to start" << std::endl;
+        return 1;
+    }
+    std::cout << "Node " << node.self().toString() << " is up" << std::endl;
+
+    while (!stopRequested) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    }
+    size_t keys = node.keyCount();
+    node.leave();
+    std::cout << "Node " << node.self().toString() << " left, handed " << keys << " keys to its successor"
+              << std::endl;
+    return 0;
+}
+
+static int runClient(int argc, char* argv[]) {
+    std::string command = argv[1];
+    if (argc < 3 || (command != "stats" && argc < 4) || (command == "put" && argc < 5)) {
+        std::cerr << "usage: chord_net put|get|remove <port> <key> [value], chord_net stats <port>" << std::endl;
+        return 1;
+    }
+    NodeHandle start = handleFor(static_cast<uint16_t>(std::atoi(argv[2])));
+    ChordClient client;
+    uint32_t hops = 0;
+
+    if (command == "stats") {
+        std::vector<uint64_t> received;
+        uint64_t keys;
+        if (!client.stats(start, &received, &keys)) {
+            std::cerr << "node unreachable" << std::endl;
+            return 1;
+        }
+        std::cout << "keys " << keys << std::endl;
+        for (size_t type = 1; type < received.size(); type++) {
+            std::cout << messageTypeName(static_cast<uint8_t>(type)) << " " << received[type] << std::endl;
+        }
+        return 0;
+    }
+
+    NodeId key = toId(std::strtoull(argv[3], nullptr, 10));
+    bool ok;
+    if (command == "put") {
+        ok = client.put(start, key, ByteView(argv[4], std::strlen(argv[4])), &hops);
+        if (ok) std::cout << "Stored key " << ChordRing::toString(key) << std::endl;
+    } else if (command == "get") {
+        std::string value;
+        bool found = false;
+        ok = client.get(start, key, &value, &found, &hops);
+        if (ok) std::cout << "Key " << ChordRing::toString(key) << ": " << (found ? value : "None") << std::endl;
+    } else if (command == "remove") {
+        bool found = false;
+        ok = client.remove(start, key, &found, &hops);
+        if (ok) std::cout << (found ? "Removed key " : "Key not found: ") << ChordRing::toString(key) << std::endl;
+    } else {
+        std::cerr << "unknown command " << command << std::endl;
+        return 1;
+    }
+    if (!ok) {
+        std::cerr << "request failed" << std::endl;
+        return 1;
+    }
+    std::cout << "hops " << hops << ", messages " << client.rpc().totalSent() << std::endl;
+    return 0;
+}
+
+static pid_t spawnNode(const char* self, uint16_t port, uint16_t bootstrapPort, NodeId id) {
+    pid_t pid = fork();
+    if (pid == 0) {
+        std::string portArg = std::to_string(port);
+        std::string bootstrapArg = std::to_string(bootstrapPort);
+        std::string idArg = ChordRing::toString(id);
+        std::vector<char*> args = {const_cast<char*>(self), const_cast<char*>("node"), &portArg[0]};
+        if (bootstrapPort != 0) {
+            args.push_back(&bootstrapArg[0]);
+        }
+        // Wide ids print as hex and cannot be passed back; let the node hash its address
+        if (BITLENGTH <= 64) {
+            args.push_back(const_cast<char*>("--id"));
+            args.push_back(&idArg[0]);
+        }
+        args.push_back(nullptr);
+        execv(self, args.data());
+        _exit(127);
+    }
+    return pid;
+}
+
+static bool waitUntil(std::function<bool()> done, int timeoutMs) {
+    auto start = std::chrono::steady_clock::now();
+    while (!done()) {
+        if (elapsedMicros(start) > timeoutMs * 1000.0) {
+            return false;
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    }
+    return true;
+}
+
+// Every live node's successor is the next live node clockwise
+static bool ringIsStable(ChordClient& client, const std::map<NodeId, uint16_t>& live) {
+    for (auto it = live.begin(); it != live.end(); ++it) {
+        auto next = std::next(it) == live.end() ? live.begin() : std::next(it);
+        std::vector<uint8_t> response;
+        if (!client.rpc().call(handleFor(it->second), MSG_GET_SUCCESSOR, WireWriter(), &response)) {
+            return false;
+        }
+        WireReader reply(response.data(), response.size());
+        if (reply.handle().port != next->second) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static int runRing(int argc, char* argv[]) {
+    if (argc < 4) {
+        std::cerr << "usage: chord_net ring <nodes> <basePort> [keys]" << std::endl;
+        return 1;
+    }
+    int count = std::atoi(argv[2]);
+    uint16_t basePort = static_cast<uint16_t>(std::atoi(argv[3]));
+    int keyCount = argc > 4 ? std::atoi(argv[4]) : 1000;
+    signal(SIGPIPE, SIG_IGN);
+
+    // Pick distinct ids; nodes are addressed by port, so collisions just shift the id
+    std::map<NodeId, uint16_t> live;
+    std::map<uint16_t, pid_t> pids;
+    ChordClient client(500);
+    for (int i = 0; i < count; i++) {
+        uint16_t port = static_cast<uint16_t>(basePort + i);
+        NodeId id = idForPort(port);
+        while (BITLENGTH <= 64 && live.count(id)) {
+            id = ChordRing::add(id, NodeId(1));
+        }
+        pid_t pid = spawnNode(argv[0], port, i == 0 ? 0 : basePort, id);
+        std::vector<uint8_t> response;
+        if (!waitUntil([&]() { return client.rpc().call(handleFor(port), MSG_PING, WireWriter(), &response); },
+                       5000)) {
+            std::cerr << "node on port " << port << " did not come up" << std::endl;
+            kill(pid, SIGKILL);
+            waitpid(pid, nullptr, 0);
+            continue;
+        }
+        pids[port] = pid;
+        live[id] = port;
+    }
+
+    auto stabilizeStart = std::chrono::steady_clock::now();
+    bool stable = waitUntil([&]() { return ringIsStable(client, live); }, 30000);
+    std::cout << "Ring of " << live.size() << " nodes " << (stable ? "stabilized" : "did NOT stabilize") << " in "
+              << elapsedMicros(stabilizeStart) / 1000 << " ms" << std::endl;
+
+    std::mt19937_64 rng(42);
+    std::vector<uint16_t> ports;
+    for (auto& entry : live) {
+        ports.push_back(entry.second);
+    }
+    // Distinct keys, so every get has exactly one expected value
+    std::set<NodeId> distinct;
+    while (distinct.size() < static_cast<size_t>(keyCount) &&
+           (BITLENGTH >= 32 || distinct.size() < (size_t(1) << BITLENGTH))) {
+        distinct.insert(toId(rng()));
+    }
+    std::vector<NodeId> keys(distinct.begin(), distinct.end());
+    std::shuffle(keys.begin(), keys.end(), rng);
+
+    auto runPhase = [&](const char* name, bool write) {
+        std::vector<double> latencies;
+        uint64_t totalHops = 0;
+        size_t failures = 0;
+        uint64_t messagesBefore = client.messages();
+        for (size_t i = 0; i < keys.size(); i++) {
+            NodeHandle start = handleFor(ports[rng() % ports.size()]);
+            std::string value = "value-" + std::to_string(i);
+            uint32_t hops = 0;
+            auto t = std::chrono::steady_clock::now();
+            bool ok;
+            if (write) {
+                ok = client.put(start, keys[i], ByteView(value), &hops);
+            } else {
+                std::string read;
+                bool found = false;
+                ok = client.get(start, keys[i], &read, &found, &hops) && found && read == value;
+            }
+            latencies.push_back(elapsedMicros(t));
+            totalHops += hops;
+            failures += ok ? 0 : 1;
+        }
+        double ops = static_cast<double>(keys.size());
+        std::cout << name << ": " << keys.size() << " ops, " << failures << " failed, p50 "
+                  << percentile(latencies, 0.5) << " us, p99 " << percentile(latencies, 0.99) << " us, "
+                  << totalHops / ops << " hops/op, " << (client.messages() - messagesBefore) / ops
+                  << " messages/op" << std::endl;
+        return failures;
+    };
+
+    size_t failures = runPhase("put", true);
+    failures += runPhase("get", false);
+
+    // The same reads again, forwarded from node to node
+    if (client.setRoutingMode(RoutingMode::Recursive)) {
+        failures += runPhase("recursive get", false);
+    }
+
+    // Take one node out gracefully and check that its keys moved
+    if (live.size() > 1) {
+        auto victim = std::next(live.begin(), live.size() / 2);
+        uint16_t port = victim->second;
+        kill(pids[port], SIGTERM);
+        waitpid(pids[port], nullptr, 0);
+        pids.erase(port);
+        live.erase(victim);
+        ports.erase(std::find(ports.begin(), ports.end(), port));
+        stable = waitUntil([&]() { return ringIsStable(client, live); }, 30000);
+        std::cout << "Node on port " << port << " left, ring " << (stable ? "restabilized" : "did NOT restabilize")
+                  << std::endl;
+        failures += runPhase("get after leave", false);
+    }
+
+    // Messages served across the ring, by type
+    std::vector<uint64_t> totals(MSG_TYPE_COUNT, 0);
+    uint64_t storedKeys = 0;
+    for (uint16_t port : ports) {
+        std::vector<uint64_t> received;
+        uint64_t keysHeld = 0;
+        if (client.stats(handleFor(port), &received, &keysHeld)) {
+            storedKeys += keysHeld;
+            for (size_t type = 0; type < received.size() && type < totals.size(); type++) {
+                totals[type] += received[type];
+            }
+        }
+    }
+    std::cout << "Keys stored: " << storedKeys << std::endl;
+    std::cout << "Messages served:";
+    for (size_t type = 1; type < totals.size(); type++) {
+        std::cout << " " << messageTypeName(static_cast<uint8_t>(type)) << "=" << totals[type];
+    }
+    std::cout << std::endl;
+
+    for (auto& entry : pids) {
+        kill(entry.second, SIGTERM);
+    }
+    for (auto& entry : pids) {
+        waitpid(entry.second, nullptr, 0);
+    }
+    return failures == 0 && stable ? 0 : 1;
+}
+
+int main(int argc, char* argv[]) {
+    if (argc < 2) {
+        std::cerr << "usage: chord_net node|put|get|remove|stats|ring ..." << std::endl;
+        return 1;
+    }
+    std::string command = argv[1];
+    if (command == "node") {
+        return runNode(argc, argv);
+    }
+    if (command == "ring") {
+        return runRing(argc, argv);
+    }
+    return runClient(argc, argv);
+}
@@ -0,0 +1,168 @@
+#include "host.h"
+#include <algorithm>
+
+// SplitMix64 finalizer: spreads consecutive host/index pairs over the ring
+static uint64_t mix64(uint64_t x) {
+    x += 0x9E3779B97F4A7C15ULL;
+    x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    x = (x ^ (x >> 27)) * 0x94D049BB133111EBULL;
+    return x ^ (x >> 31);
+}
+
+Host::Host(uint32_t id) : id_(id), nextIndex_(0) {
+}
+
+Host::~Host() {
+    for (Node* node : nodes_) {
+        delete node;
+    }
+    for (Node* node : retired_) {
+        delete node;
+    }
+}
+
+NodeId Host::position(uint32_t host, uint32_t index) {
+    // Fill every byte of the id so wide rings are covered evenly
+    uint8_t bytes[ChordRing::kBytes];
+    uint64_t state = (static_cast<uint64_t>(host) << 32) | index;
+    for (size_t i = 0; i < ChordRing::kBytes; i++) {
+        if (i % 8 == 0) {
+            state = mix64(state);
+        }
+        bytes[i] = static_cast<uint8_t>(state >> (8 * (i % 8)));
+    }
+    return ChordRing::fromBytes(bytes);
+}
+
+Node* Host::addVirtualNode(NodeId position, Node* bootstrap) {
+    if (bootstrap == nullptr && !nodes_.empty()) {
+        bootstrap = nodes_.front();
+    }
+    if (bootstrap != nullptr) {
+        LookupResult owner = bootstrap->lookup(position);
+        if (owner.node == nullptr || owner.node->getId() == position) {
+            return nullptr;
+        }
+    }
+    Node* node = new Node(position);
+    node->join(bootstrap);
+    nodes_.push_back(node);
+    return node;
+}
+
+size_t Host::addVirtualNodes(size_t count, Node* bootstrap) {
+    size_t added = 0;
+    // A few extra attempts for positions that collide on small rings
+    for (size_t attempt = 0; added < count && attempt < 4 * count; attempt++) {
+        if (addVirtualNode(position(id_, nextIndex_++), bootstrap) != nullptr) {
+            added++;
+        }
+    }
+    return added;
+}
+
+bool Host::removeVirtualNode(Node* node) {
+    auto it = std::find(nodes_.begin(), nodes_.end(), node);
+    if (it == nodes_.end()) {
+        return false;
+    }
+    node->leave();
+    nodes_.erase(it);
+    retired_.push_back(node);
+    return true;
+}
+
+size_t Host::load() const {
+    size_t keys = 0;
+    for (Node* node : nodes_) {
+        keys += node->getLocalKeys().size();
+    }
+    return keys;
+}
+
+double Host::loadVariance(const std::vector<Host*>& hosts) {
+    std::vector<int> loads;
+    for (Host* host : hosts) {
+        loads.push_back(static_cast<int>(host->load()));
+    }
+    return Node::computeVariance(loads);
+}
+
+// Id of the key at position index in ring order within node's range
+// (predecessor, node]. The store is sorted by id, so a range that wraps past
+// zero starts at the first id above the predecessor.
+static NodeId keyInRingOrder(Node* node, size_t index) {
+    const KeyStore& keys = node->getLocalKeys();
+    NodeId predecessor = node->getPredecessor()->getId();
+    size_t low = 0;
+    size_t high = keys.size();
+    while (low < high) {
+        size_t mid = (low + high) / 2;
+        if (keys.entryAt(mid).first <= predecessor) {
+            low = mid + 1;
+        } else {
+            high = mid;
+        }
+    }
+    size_t first = low == keys.size() ? 0 : low;
+    return keys.entryAt((first + index) % keys.size()).first;
+}
+
+RebalanceResult Host::rebalance(std::vector<Host*>& hosts, double threshold, size_t maxVirtualNodes,
+                                size_t maxSteps) {
+    RebalanceResult result;
+    result.varianceBefore = loadVariance(hosts);
+    result.varianceAfter = result.varianceBefore;
+    if (hosts.size() < 2) {
+        return result;
+    }
+
+    for (size_t step = 0; step < maxSteps && result.varianceAfter > threshold; step++) {
+        std::vector<Host*> order(hosts);
+        std::sort(order.begin(), order.end(), [](Host* a, Host* b) { return a->load() < b->load(); });
+        Host* heavy = order.back();
+        Host* light = nullptr;
+        for (Host* host : order) {
+            if (host != heavy && host->nodes_.size() < maxVirtualNodes) {
+                light = host;
+                break;
+            }
+        }
+        if (light == nullptr) {
+            break;
+        }
+
+        // Split the heavy host's fullest range: the new virtual node owns
+        // (predecessor, position], i.e. the first take keys of that range
+        Node* fullest = *std::max_element(heavy->nodes_.begin(), heavy->nodes_.end(), [](Node* a, Node* b) {
+            return a->getLocalKeys().size() < b->getLocalKeys().size();
+        });
+        size_t keys = fullest->getLocalKeys().size();
+        size_t gap = heavy->load() - light->load();
+        size_t take = std::min(keys - (keys > 0 ? 1 : 0), gap / 2);
+        if (take == 0) {
+            break;
+        }
+        Node* added = light->addVirtualNode(keyInRingOrder(fullest, take - 1), fullest);
+        if (added == nullptr) {
+            break;
+        }
+        result.added++;
+        result.keysMoved += added->getLocalKeys().size();
+        result.varianceAfter = loadVariance(hosts);
+    }
+
+    // Virtual nodes that own no keys only add routing state; drop them,
+    // keeping one per host
+    for (size_t h = 0; h < hosts.size() && result.added > 0; h++) {
+        Host* host = hosts[h];
+        for (size_t i = host->nodes_.size(); i-- > 0 && host->nodes_.size() > 1;) {
+            Node* node = host->nodes_[i];
+            if (node->getLocalKeys().empty() && host->removeVirtualNode(node)) {
+                result.removed++;
+            }
+        }
+    }
+    result.varianceAfter = loadVariance(hosts);
+    return result;
+}
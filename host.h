@@ -0,0 +1,92 @@
+#ifndef HOST_H
+#define HOST_H
+
+#include <stdint.h>
+#include <vector>
+#include "node.h"
+
+// Outcome of Host::rebalance
+struct RebalanceResult {
+    double varianceBefore = 0.0;  // Node::computeVariance over per-host key counts
+    double varianceAfter = 0.0;
+    size_t added = 0;             // Virtual nodes joined to split a heavy range
+    size_t removed = 0;           // Virtual nodes that owned nothing and left
+    size_t keysMoved = 0;         // Keys handed from one host to another
+};
+
+// A physical machine running K virtual nodes. Every virtual node is an
+// ordinary Node at its own ring position that joins and leaves through the
+// normal protocol, so keys always live at their successor and lookups stay
+// correct; the host only decides how many positions it holds and where.
+// Load is the number of keys across all of a host's virtual nodes.
+class Host {
+public:
+    /**
+     * @param id: host identifier; virtual node positions are derived from it.
+     */
+    explicit Host(uint32_t id);
+    ~Host();
+
+    uint32_t getId() const {
+        return id_;
+    }
+
+    /**
+     * Join virtual nodes at the next count hashed positions of this host.
+     * @param bootstrap: any node already in the ring, or nullptr when this
+     *                   host creates the ring.
+     * @return number of virtual nodes that joined; positions already taken
+     *         by another node are skipped.
+     */
+    size_t addVirtualNodes(size_t count, Node* bootstrap);
+
+    /**
+     * Join one virtual node at position.
+     * @return the new node, or nullptr if a node already sits at position.
+     */
+    Node* addVirtualNode(NodeId position, Node* bootstrap);
+
+    // Hand node's keys to its successor and take it off the ring. The node
+    // object stays allocated until the host is destroyed, since other nodes
+    // may still hold pointers to it.
+    bool removeVirtualNode(Node* node);
+
+    const std::vector<Node*>& getVirtualNodes() const {
+        return nodes_;
+    }
+
+    // Keys stored across this host's virtual nodes
+    size_t load() const;
+
+    // Lookup entry point; any virtual node can start a route. A host without
+    // virtual nodes returns an empty result
+    LookupResult lookup(NodeId key) {
+        return nodes_.empty() ? LookupResult() : nodes_.front()->lookup(key);
+    }
+
+    // Ring position of this host's index-th virtual node
+    static NodeId position(uint32_t host, uint32_t index);
+
+    static double loadVariance(const std::vector<Host*>& hosts);
+
+    /**
+     * Even out load between hosts. While the variance of per-host key counts
+     * exceeds threshold, the lightest host joins a virtual node inside the
+     * most loaded range of the heaviest host, placed so it takes over just
+     * enough keys to close half the gap between the two. Virtual nodes left
+     * owning nothing leave the ring afterwards.
+     * @param threshold: target variance, in keys squared.
+     * @param maxVirtualNodes: cap on virtual nodes per host.
+     * @param maxSteps: cap on virtual nodes added in this call.
+     */
+    static RebalanceResult rebalance(std::vector<Host*>& hosts, double threshold, size_t maxVirtualNodes = 64,
+                                     size_t maxSteps = 1000);
+
+private:
+    uint32_t id_;
+    uint32_t nextIndex_;          // Next hashed position to try
+    std::vector<Node*> nodes_;    // Virtual nodes currently in the ring
+    std::vector<Node*> retired_;  // Virtual nodes that left, freed with the host
+};
+
+#endif
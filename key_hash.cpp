@@ -0,0 +1,353 @@
+#include "key_hash.h"
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#include <immintrin.h>
+#define CHORD_HASH_SIMD 1
+#else
+#define CHORD_HASH_SIMD 0
+#endif
+
+static_assert(ChordRing::kBytes <= KeyHash::kSha1Bytes, "SHA-1 ids need a ring of at most 160 bits");
+
+static inline uint32_t rotl32(uint32_t x, int n) {
+    return (x << n) | (x >> (32 - n));
+}
+
+static inline uint64_t rotl64(uint64_t x, int n) {
+    return (x << n) | (x >> (64 - n));
+}
+
+static inline uint32_t loadBig32(const uint8_t* p) {
+    return (static_cast<uint32_t>(p[0]) << 24) | (static_cast<uint32_t>(p[1]) << 16) |
+           (static_cast<uint32_t>(p[2]) << 8) | p[3];
+}
+
+static inline uint64_t loadLittle64(const uint8_t* p) {
+    uint64_t v = 0;
+    for (int i = 0; i < 8; i++) {
+        v |= static_cast<uint64_t>(p[i]) << (8 * i);
+    }
+    return v;
+}
+
+static inline uint32_t loadLittle32(const uint8_t* p) {
+    return static_cast<uint32_t>(p[0]) | (static_cast<uint32_t>(p[1]) << 8) | (static_cast<uint32_t>(p[2]) << 16) |
+           (static_cast<uint32_t>(p[3]) << 24);
+}
+
+// ---- SHA-1 (FIPS 180-4) ----
+
+static const uint32_t kSha1Init[5] = {0x67452301, 0xEFCDAB89, 0x98BADCFE, 0x10325476, 0xC3D2E1F0};
+
+// 64-byte blocks of a message of len bytes once padded
+static size_t sha1Blocks(size_t len) {
+    return (len + 8) / 64 + 1;
+}
+
+// Block index of the padded message: the message itself where it has a whole
+// block, else built in scratch with the 0x80 marker and the bit length
+static const uint8_t* sha1Block(const uint8_t* data, size_t len, size_t index, uint8_t* scratch) {
+    size_t offset = index * 64;
+    if (offset + 64 <= len) {
+        return data + offset;
+    }
+    std::memset(scratch, 0, 64);
+    if (offset < len) {
+        std::memcpy(scratch, data + offset, len - offset);
+    }
+    if (offset <= len) {
+        scratch[len - offset] = 0x80;
+    }
+    if (index == sha1Blocks(len) - 1) {
+        uint64_t bits = static_cast<uint64_t>(len) * 8;
+        for (int i = 0; i < 8; i++) {
+            scratch[63 - i] = static_cast<uint8_t>(bits >> (8 * i));
+        }
+    }
+    return scratch;
+}
+
+static void sha1Compress(uint32_t state[5], const uint8_t* block) {
+    uint32_t w[80];
+    for (int t = 0; t < 16; t++) {
+        w[t] = loadBig32(block + 4 * t);
+    }
+    for (int t = 16; t < 80; t++) {
+        w[t] = rotl32(w[t - 3] ^ w[t - 8] ^ w[t - 14] ^ w[t - 16], 1);
+    }
+    uint32_t a = state[0], b = state[1], c = state[2], d = state[3], e = state[4];
+    auto round = [&](uint32_t f, uint32_t k, uint32_t word) {
+        uint32_t temp = rotl32(a, 5) + f + e + k + word;
+        e = d;
+        d = c;
+        c = rotl32(b, 30);
+        b = a;
+        a = temp;
+    };
+    for (int t = 0; t < 20; t++) {
+        round((b & c) | (~b & d), 0x5A827999, w[t]);
+    }
+    for (int t = 20; t < 40; t++) {
+        round(b ^ c ^ d, 0x6ED9EBA1, w[t]);
+    }
+    for (int t = 40; t < 60; t++) {
+        round((b & c) | (b & d) | (c & d), 0x8F1BBCDC, w[t]);
+    }
+    for (int t = 60; t < 80; t++) {
+        round(b ^ c ^ d, 0xCA62C1D6, w[t]);
+    }
+    state[0] += a;
+    state[1] += b;
+    state[2] += c;
+    state[3] += d;
+    state[4] += e;
+}
+
+void KeyHash::sha1(const void* data, size_t len, uint8_t digest[kSha1Bytes]) {
+    const uint8_t* bytes = static_cast<const uint8_t*>(data);
+    uint32_t state[5];
+    std::memcpy(state, kSha1Init, sizeof(state));
+    uint8_t scratch[64];
+    for (size_t i = 0, blocks = sha1Blocks(len); i < blocks; i++) {
+        sha1Compress(state, sha1Block(bytes, len, i, scratch));
+    }
+    for (int i = 0; i < 5; i++) {
+        for (int j = 0; j < 4; j++) {
+            digest[4 * i + j] = static_cast<uint8_t>(state[i] >> (24 - 8 * j));
+        }
+    }
+}
+
+// The id is the digest's first kBytes bytes read as a big-endian number
+static NodeId idFromDigest(const uint8_t* digest) {
+    uint8_t bytes[ChordRing::kBytes];
+    for (size_t i = 0; i < ChordRing::kBytes; i++) {
+        bytes[i] = digest[ChordRing::kBytes - 1 - i];
+    }
+    return ChordRing::fromBytes(bytes);
+}
+
+#if CHORD_HASH_SIMD
+// Eight SHA-1 computations side by side, one per 32-bit lane. Lanes whose
+// message has fewer blocks than the longest keep their state once done.
+struct Sha1x8 {
+    static constexpr size_t kLanes = 8;
+
+    template <int N>
+    __attribute__((target("avx2"))) static inline __m256i rotl(__m256i x) {
+        return _mm256_or_si256(_mm256_slli_epi32(x, N), _mm256_srli_epi32(x, 32 - N));
+    }
+
+    __attribute__((target("avx2"))) static void hash(const ByteView* keys, size_t count, NodeId* ids) {
+        size_t blocks[kLanes] = {};
+        size_t maxBlocks = 0;
+        for (size_t lane = 0; lane < count; lane++) {
+            blocks[lane] = sha1Blocks(keys[lane].size);
+            maxBlocks = std::max(maxBlocks, blocks[lane]);
+        }
+        __m256i state[5];
+        for (int i = 0; i < 5; i++) {
+            state[i] = _mm256_set1_epi32(static_cast<int>(kSha1Init[i]));
+        }
+        alignas(32) uint32_t words[16][kLanes];
+        alignas(32) int32_t active[kLanes];
+        uint8_t scratch[64];
+        for (size_t b = 0; b < maxBlocks; b++) {
+            // Transpose: word t of every lane's block into one register
+            for (size_t lane = 0; lane < kLanes; lane++) {
+                active[lane] = lane < count && b < blocks[lane] ? -1 : 0;
+                if (active[lane]) {
+                    const uint8_t* data = reinterpret_cast<const uint8_t*>(keys[lane].data);
+                    const uint8_t* block = sha1Block(data, keys[lane].size, b, scratch);
+                    for (int t = 0; t < 16; t++) {
+                        words[t][lane] = loadBig32(block + 4 * t);
+                    }
+                } else {
+                    for (int t = 0; t < 16; t++) {
+                        words[t][lane] = 0;
+                    }
+                }
+            }
+            __m256i w[16];
+            for (int t = 0; t < 16; t++) {
+                w[t] = _mm256_load_si256(reinterpret_cast<const __m256i*>(words[t]));
+            }
+            __m256i a = state[0], bb = state[1], c = state[2], d = state[3], e = state[4];
+            for (int t = 0; t < 80; t++) {
+                __m256i wt;
+                if (t < 16) {
+                    wt = w[t];
+                } else {
+                    wt = rotl<1>(_mm256_xor_si256(_mm256_xor_si256(w[(t - 3) & 15], w[(t - 8) & 15]),
+                                                  _mm256_xor_si256(w[(t - 14) & 15], w[t & 15])));
+                    w[t & 15] = wt;
+                }
+                __m256i f;
+                uint32_t k;
+                if (t < 20) {
+                    f = _mm256_or_si256(_mm256_and_si256(bb, c), _mm256_andnot_si256(bb, d));
+                    k = 0x5A827999;
+                } else if (t < 40) {
+                    f = _mm256_xor_si256(_mm256_xor_si256(bb, c), d);
+                    k = 0x6ED9EBA1;
+                } else if (t < 60) {
+                    f = _mm256_or_si256(_mm256_and_si256(bb, _mm256_or_si256(c, d)), _mm256_and_si256(c, d));
+                    k = 0x8F1BBCDC;
+                } else {
+                    f = _mm256_xor_si256(_mm256_xor_si256(bb, c), d);
+                    k = 0xCA62C1D6;
+                }
+                __m256i temp = _mm256_add_epi32(_mm256_add_epi32(rotl<5>(a), f),
+                                                _mm256_add_epi32(_mm256_add_epi32(e, wt),
+                                                                 _mm256_set1_epi32(static_cast<int>(k))));
+                e = d;
+                d = c;
+                c = rotl<30>(bb);
+                bb = a;
+                a = temp;
+            }
+            __m256i mask = _mm256_load_si256(reinterpret_cast<const __m256i*>(active));
+            __m256i rounds[5] = {a, bb, c, d, e};
+            for (int i = 0; i < 5; i++) {
+                state[i] = _mm256_blendv_epi8(state[i], _mm256_add_epi32(state[i], rounds[i]), mask);
+            }
+        }
+        alignas(32) uint32_t out[5][kLanes];
+        for (int i = 0; i < 5; i++) {
+            _mm256_store_si256(reinterpret_cast<__m256i*>(out[i]), state[i]);
+        }
+        for (size_t lane = 0; lane < count; lane++) {
+            uint8_t digest[KeyHash::kSha1Bytes];
+            for (int i = 0; i < 5; i++) {
+                for (int j = 0; j < 4; j++) {
+                    digest[4 * i + j] = static_cast<uint8_t>(out[i][lane] >> (24 - 8 * j));
+                }
+            }
+            ids[lane] = idFromDigest(digest);
+        }
+    }
+};
+#endif
+
+// ---- XXH64 ----
+
+static const uint64_t kPrime64_1 = 0x9E3779B185EBCA87ULL;
+static const uint64_t kPrime64_2 = 0xC2B2AE3D27D4EB4FULL;
+static const uint64_t kPrime64_3 = 0x165667B19E3779F9ULL;
+static const uint64_t kPrime64_4 = 0x85EBCA77C2B2AE63ULL;
+static const uint64_t kPrime64_5 = 0x27D4EB2F165667C5ULL;
+
+static inline uint64_t xxhRound(uint64_t acc, uint64_t input) {
+    acc += input * kPrime64_2;
+    acc = rotl64(acc, 31);
+    return acc * kPrime64_1;
+}
+
+static inline uint64_t xxhMerge(uint64_t acc, uint64_t value) {
+    acc ^= xxhRound(0, value);
+    return acc * kPrime64_1 + kPrime64_4;
+}
+
+uint64_t KeyHash::xxh64(const void* data, size_t len, uint64_t seed) {
+    const uint8_t* p = static_cast<const uint8_t*>(data);
+    const uint8_t* end = p + len;
+    uint64_t h;
+    if (len >= 32) {
+        uint64_t v1 = seed + kPrime64_1 + kPrime64_2;
+        uint64_t v2 = seed + kPrime64_2;
+        uint64_t v3 = seed;
+        uint64_t v4 = seed - kPrime64_1;
+        for (; p + 32 <= end; p += 32) {
+            v1 = xxhRound(v1, loadLittle64(p));
+            v2 = xxhRound(v2, loadLittle64(p + 8));
+            v3 = xxhRound(v3, loadLittle64(p + 16));
+            v4 = xxhRound(v4, loadLittle64(p + 24));
+        }
+        h = rotl64(v1, 1) + rotl64(v2, 7) + rotl64(v3, 12) + rotl64(v4, 18);
+        h = xxhMerge(h, v1);
+        h = xxhMerge(h, v2);
+        h = xxhMerge(h, v3);
+        h = xxhMerge(h, v4);
+    } else {
+        h = seed + kPrime64_5;
+    }
+    h += len;
+    for (; p + 8 <= end; p += 8) {
+        h ^= xxhRound(0, loadLittle64(p));
+        h = rotl64(h, 27) * kPrime64_1 + kPrime64_4;
+    }
+    if (p + 4 <= end) {
+        h ^= static_cast<uint64_t>(loadLittle32(p)) * kPrime64_1;
+        h = rotl64(h, 23) * kPrime64_2 + kPrime64_3;
+        p += 4;
+    }
+    for (; p < end; p++) {
+        h ^= *p * kPrime64_5;
+        h = rotl64(h, 11) * kPrime64_1;
+    }
+    h ^= h >> 33;
+    h *= kPrime64_2;
+    h ^= h >> 29;
+    h *= kPrime64_3;
+    h ^= h >> 32;
+    return h;
+}
+
+// ---- Ids ----
+
+NodeId KeyHash::toId(ByteView key, KeyHashFunction function) {
+    if (function == KeyHashFunction::Sha1) {
+        uint8_t digest[kSha1Bytes];
+        sha1(key.data, key.size, digest);
+        return idFromDigest(digest);
+    }
+    // One XXH64 per 8 bytes of id, seeded with the word's index
+    uint8_t bytes[ChordRing::kBytes];
+    for (size_t i = 0; i < ChordRing::kBytes; i += 8) {
+        uint64_t h = xxh64(key.data, key.size, i / 8);
+        for (size_t j = 0; j < 8 && i + j < ChordRing::kBytes; j++) {
+            bytes[i + j] = static_cast<uint8_t>(h >> (8 * j));
+        }
+    }
+    return ChordRing::fromBytes(bytes);
+}
+
+static bool detectVectorHash() {
+#if CHORD_HASH_SIMD
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("avx2");
+#else
+    return false;
+#endif
+}
+
+static const bool kVectorHash = detectVectorHash();
+static std::atomic<bool> vectorHash(true);
+
+static bool useVectorHash() {
+    return kVectorHash && vectorHash.load(std::memory_order_relaxed);
+}
+
+const char* KeyHash::batchKernel() {
+    return useVectorHash() ? "avx2" : "scalar";
+}
+
+void KeyHash::setVectorHash(bool enabled) {
+    vectorHash.store(enabled, std::memory_order_relaxed);
+}
+
+void KeyHash::toIds(const ByteView* keys, size_t count, NodeId* ids, KeyHashFunction function) {
+    size_t i = 0;
+#if CHORD_HASH_SIMD
+    if (function == KeyHashFunction::Sha1 && useVectorHash()) {
+        for (; i < count; i += Sha1x8::kLanes) {
+            Sha1x8::hash(keys + i, std::min(Sha1x8::kLanes, count - i), ids + i);
+        }
+    }
+#endif
+    for (; i < count; i++) {
+        ids[i] = toId(keys[i], function);
+    }
+}
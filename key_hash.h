@@ -0,0 +1,45 @@
+#ifndef KEY_HASH_H
+#define KEY_HASH_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include "key_store.h"
+#include "ring.h"
+
+// Hash that turns byte-string keys into ring ids
+enum class KeyHashFunction : uint8_t {
+    Sha1,  // SHA-1, as in the Chord paper; the id is the digest's first m bits
+    Fast   // XXH64, non-cryptographic; wide rings take further seeded rounds
+};
+
+// Key front-end: maps byte-string keys to ring ids. Batches of SHA-1 keys are
+// hashed eight at a time, one key per lane of AVX2 registers, where the CPU
+// has it (checked at startup); other batches run key by key.
+class KeyHash {
+public:
+    static constexpr size_t kSha1Bytes = 20;
+
+    // SHA-1 digest of len bytes
+    static void sha1(const void* data, size_t len, uint8_t digest[kSha1Bytes]);
+
+    // XXH64 of len bytes
+    static uint64_t xxh64(const void* data, size_t len, uint64_t seed = 0);
+
+    // Ring id of one key
+    static NodeId toId(ByteView key, KeyHashFunction function);
+
+    /**
+     * Ring ids of many keys; the same ids toId gives, but faster per key.
+     * @param keys: count keys to hash.
+     * @param ids: receives count ids, in the order of keys.
+     */
+    static void toIds(const ByteView* keys, size_t count, NodeId* ids, KeyHashFunction function);
+
+    // Kernel toIds uses for SHA-1: "avx2" or "scalar"
+    static const char* batchKernel();
+
+    // Turn the vector kernel off (false) to compare it with the scalar one
+    static void setVectorHash(bool enabled);
+};
+
+#endif
@@ -0,0 +1,450 @@
+#include "key_store.h"
+#include <algorithm>
+#include <cstring>
+#include <mutex>
+
+// Free ValueBuffer blocks, one list per size class. Block sizes step by an
+// eighth of a power of two, so a block wastes less than a fifth of itself,
+// and each list keeps at most kCachedBytes for reuse. Blocks larger than
+// that could never be kept and go straight to the heap.
+namespace {
+
+const size_t kMinBlockBytes = 64;
+const size_t kCachedBytes = 16 << 20;
+const unsigned kSizeClasses = 4 * 25;  // Blocks up to 2^24 bytes, kCachedBytes
+const unsigned kUnpooled = kSizeClasses;
+
+struct FreeList {
+    std::mutex lock;
+    std::vector<void*> blocks;
+};
+
+// Never destroyed, so buffers released during static destruction still have a home
+FreeList* freeLists() {
+    static FreeList* lists = new FreeList[kSizeClasses];
+    return lists;
+}
+
+// Size class of a block of at least bytes, or kUnpooled; blockBytes receives its size
+unsigned sizeClassOf(size_t bytes, size_t* blockBytes) {
+    bytes = std::max(bytes, kMinBlockBytes);
+    if (bytes > kCachedBytes) {
+        *blockBytes = bytes;
+        return kUnpooled;
+    }
+    unsigned exponent = 0;
+    while ((size_t(1) << exponent) < bytes) {
+        exponent++;
+    }
+    // bytes is in (2^(exponent-1), 2^exponent], five to eight steps of 2^(exponent-3)
+    size_t step = size_t(1) << (exponent - 3);
+    size_t steps = (bytes + step - 1) / step;
+    *blockBytes = steps * step;
+    return 4 * exponent + static_cast<unsigned>(steps - 5);
+}
+
+}  // namespace
+
+ValueBuffer* ValueBuffer::create(const char* data, size_t len) {
+    size_t blockBytes;
+    unsigned sizeClass = sizeClassOf(sizeof(ValueBuffer) + len, &blockBytes);
+    void* block = nullptr;
+    if (sizeClass != kUnpooled) {
+        FreeList& list = freeLists()[sizeClass];
+        std::lock_guard<std::mutex> guard(list.lock);
+        if (!list.blocks.empty()) {
+            block = list.blocks.back();
+            list.blocks.pop_back();
+        }
+    }
+    if (block == nullptr) {
+        block = ::operator new(blockBytes);
+    }
+    ValueBuffer* buffer = new (block) ValueBuffer(len, sizeClass);
+    if (len > 0) {
+        std::memcpy(reinterpret_cast<char*>(buffer + 1), data, len);
+    }
+    return buffer;
+}
+
+void ValueBuffer::release() const {
+    if (refs_.fetch_sub(1, std::memory_order_acq_rel) != 1) {
+        return;
+    }
+    void* block = const_cast<ValueBuffer*>(this);
+    if (sizeClass_ == kUnpooled) {
+        ::operator delete(block);
+        return;
+    }
+    size_t blockBytes;
+    sizeClassOf(sizeof(ValueBuffer) + size_, &blockBytes);
+    FreeList& list = freeLists()[sizeClass_];
+    {
+        std::lock_guard<std::mutex> guard(list.lock);
+        if ((list.blocks.size() + 1) * blockBytes <= kCachedBytes) {
+            list.blocks.push_back(block);
+            return;
+        }
+    }
+    ::operator delete(block);
+}
+
+std::string ByteView::toDisplayString() const {
+    if (size == 0 || (size == 1 && data[0] == 0)) {
+        return "None";
+    }
+    if (size == 1) {
+        return std::to_string(static_cast<int>(static_cast<uint8_t>(data[0])));
+    }
+    return str();
+}
+
+size_t KeyStore::eraseRange(NodeId start, NodeId end) {
+    SortedVectorStore discarded;
+    return extractRange(start, end, discarded);
+}
+
+RangeChunk KeyStore::copyRange(NodeId start, NodeId end, KeyStore& dest, size_t maxEntries, size_t maxBytes) const {
+    RangeChunk chunk;
+    size_t count = size();
+    if (count == 0) {
+        return chunk;
+    }
+    // Entries are sorted by id, so the range starts at the first id above
+    // start and runs on in ring order, wrapping past zero at most once
+    size_t low = 0;
+    size_t high = count;
+    while (low < high) {
+        size_t mid = low + (high - low) / 2;
+        if (entryAt(mid).first <= start) {
+            low = mid + 1;
+        } else {
+            high = mid;
+        }
+    }
+    for (size_t i = 0; i < count; i++) {
+        KeyValue kv = entryAt((low + i) % count);
+        if (!ChordRing::inRange(kv.first, start, end)) {
+            return chunk;
+        }
+        if (chunk.entries >= maxEntries || (chunk.entries > 0 && chunk.bytes + kv.key.size + kv.second.size > maxBytes)) {
+            chunk.done = false;
+            return chunk;
+        }
+        dest.put(kv);
+        chunk.entries++;
+        chunk.bytes += kv.key.size + kv.second.size;
+        chunk.last = kv.first;
+    }
+    return chunk;
+}
+
+uint32_t ByteArena::append(const char* data, size_t len) {
+    uint32_t offset = static_cast<uint32_t>(bytes_.size());
+    if (len == 0) {
+        return offset;
+    }
+    // Source bytes may live in this arena; copy them out before growing
+    if (data >= bytes_.data() && data < bytes_.data() + bytes_.size()) {
+        std::vector<char> copy(data, data + len);
+        bytes_.insert(bytes_.end(), copy.begin(), copy.end());
+    } else {
+        bytes_.insert(bytes_.end(), data, data + len);
+    }
+    return offset;
+}
+
+std::vector<SortedVectorStore::Slot>::iterator SortedVectorStore::lowerBound(NodeId id) {
+    return std::lower_bound(slots_.begin(), slots_.end(), id,
+                            [](const Slot& slot, const NodeId& key) { return slot.id < key; });
+}
+
+std::vector<SortedVectorStore::Slot>::const_iterator SortedVectorStore::lowerBound(NodeId id) const {
+    return std::lower_bound(slots_.begin(), slots_.end(), id,
+                            [](const Slot& slot, const NodeId& key) { return slot.id < key; });
+}
+
+SortedVectorStore::~SortedVectorStore() {
+    clear();
+}
+
+const ValueBuffer* SortedVectorStore::bufferOf(const Slot& slot) const {
+    if (slot.valueLength != kSharedValue) {
+        return nullptr;
+    }
+    const ValueBuffer* buffer;
+    std::memcpy(&buffer, arena_.view(slot.valueOffset, sizeof(buffer)).data, sizeof(buffer));
+    return buffer;
+}
+
+// Give up the slot's arena bytes and its reference to a shared value
+void SortedVectorStore::drop(const Slot& slot) {
+    const ValueBuffer* buffer = bufferOf(slot);
+    if (buffer) {
+        buffer->release();
+        arena_.release(slot.keyLength + sizeof(buffer));
+    } else {
+        arena_.release(slot.keyLength + slot.valueLength);
+    }
+}
+
+void SortedVectorStore::clear() {
+    for (const Slot& slot : slots_) {
+        const ValueBuffer* buffer = bufferOf(slot);
+        if (buffer) {
+            buffer->release();
+        }
+    }
+    slots_.clear();
+    arena_.clear();
+}
+
+bool SortedVectorStore::lookup(NodeId id, KeyValue* entry) const {
+    auto it = lowerBound(id);
+    if (it == slots_.end() || it->id != id) {
+        return false;
+    }
+    *entry = entryAt(it - slots_.begin());
+    return true;
+}
+
+void SortedVectorStore::put(NodeId id, ByteView key, ByteView value) {
+    if (value.size >= ValueBuffer::kSharedBytes) {
+        store(id, key, value, ValueBuffer::create(value.data, value.size));
+    } else {
+        store(id, key, value, nullptr);
+    }
+}
+
+// Small values are cheaper to copy than to share
+void SortedVectorStore::putShared(NodeId id, ByteView key, const ValueBuffer* value) {
+    if (value->size() < ValueBuffer::kSharedBytes) {
+        store(id, key, value->view(), nullptr);
+        return;
+    }
+    value->retain();
+    store(id, key, value->view(), value);
+}
+
+// Insert or overwrite with the value inline, or as buffer, whose reference
+// the store takes over
+void SortedVectorStore::store(NodeId id, ByteView key, ByteView value, const ValueBuffer* buffer) {
+    Slot slot;
+    slot.id = id;
+    slot.keyOffset = arena_.append(key.data, key.size);
+    slot.keyLength = static_cast<uint32_t>(key.size);
+    if (buffer) {
+        slot.valueOffset = arena_.append(reinterpret_cast<const char*>(&buffer), sizeof(buffer));
+        slot.valueLength = kSharedValue;
+    } else {
+        slot.valueOffset = arena_.append(value.data, value.size);
+        slot.valueLength = static_cast<uint32_t>(value.size);
+    }
+
+    // Keys usually arrive in ascending order during migration and bulk load
+    if (slots_.empty() || slots_.back().id < id) {
+        slots_.push_back(slot);
+        return;
+    }
+
+    auto it = lowerBound(id);
+    if (it != slots_.end() && it->id == id) {
+        drop(*it);
+        *it = slot;
+        compactIfNeeded();
+    } else {
+        slots_.insert(it, slot);
+    }
+}
+
+bool SortedVectorStore::erase(NodeId id) {
+    auto it = lowerBound(id);
+    if (it == slots_.end() || it->id != id) {
+        return false;
+    }
+    drop(*it);
+    slots_.erase(it);
+    compactIfNeeded();
+    return true;
+}
+
+KeyValue SortedVectorStore::entryAt(size_t index) const {
+    const Slot& slot = slots_[index];
+    KeyValue kv;
+    kv.first = slot.id;
+    kv.buffer = bufferOf(slot);
+    kv.second = kv.buffer ? kv.buffer->view() : arena_.view(slot.valueOffset, slot.valueLength);
+    kv.key = arena_.view(slot.keyOffset, slot.keyLength);
+    return kv;
+}
+
+// Copy slots [first, last) into dest, if any, and drop them from this store.
+// Shared values move as a reference.
+void SortedVectorStore::moveRun(size_t first, size_t last, KeyStore* dest) {
+    for (size_t i = first; i < last; i++) {
+        const Slot& slot = slots_[i];
+        if (dest) {
+            dest->put(entryAt(i));
+        }
+        drop(slot);
+    }
+    slots_.erase(slots_.begin() + first, slots_.begin() + last);
+}
+
+size_t SortedVectorStore::removeRange(NodeId start, NodeId end, KeyStore* dest) {
+    size_t before = slots_.size();
+    if (before == 0) {
+        return 0;
+    }
+
+    if (start == end) {
+        // The whole ring
+        moveRun(0, slots_.size(), dest);
+    } else if (start < end) {
+        // (start, end] is one run
+        size_t first = std::upper_bound(slots_.begin(), slots_.end(), start,
+                                        [](const NodeId& key, const Slot& slot) { return key < slot.id; }) - slots_.begin();
+        size_t last = std::upper_bound(slots_.begin(), slots_.end(), end,
+                                       [](const NodeId& key, const Slot& slot) { return key < slot.id; }) - slots_.begin();
+        moveRun(first, last, dest);
+    } else {
+        // Wrapping interval: (start, max] followed by [0, end], moved in ring order
+        size_t first = std::upper_bound(slots_.begin(), slots_.end(), start,
+                                        [](const NodeId& key, const Slot& slot) { return key < slot.id; }) - slots_.begin();
+        moveRun(first, slots_.size(), dest);
+        size_t last = std::upper_bound(slots_.begin(), slots_.end(), end,
+                                       [](const NodeId& key, const Slot& slot) { return key < slot.id; }) - slots_.begin();
+        moveRun(0, last, dest);
+    }
+
+    compactIfNeeded();
+    return before - slots_.size();
+}
+
+size_t SortedVectorStore::extractRange(NodeId start, NodeId end, KeyStore& dest) {
+    return removeRange(start, end, &dest);
+}
+
+size_t SortedVectorStore::eraseRange(NodeId start, NodeId end) {
+    return removeRange(start, end, nullptr);
+}
+
+void SortedVectorStore::reserve(size_t entries, size_t bytes) {
+    slots_.reserve(entries);
+    arena_.reserve(bytes);
+}
+
+// Rewrite the arena once more than half of it is dead bytes
+void SortedVectorStore::compactIfNeeded() {
+    if (arena_.garbage() < 4096 || arena_.garbage() * 2 < arena_.size()) {
+        return;
+    }
+    ByteArena fresh;
+    for (Slot& slot : slots_) {
+        ByteView key = arena_.view(slot.keyOffset, slot.keyLength);
+        ByteView value = arena_.view(slot.valueOffset, slot.valueLength == kSharedValue ? sizeof(ValueBuffer*)
+                                                                                        : slot.valueLength);
+        slot.keyOffset = fresh.append(key.data, key.size);
+        slot.valueOffset = fresh.append(value.data, value.size);
+    }
+    arena_.swap(fresh);
+}
+
+StripedStore::StripedStore(size_t stripes) : count_(1), shift_(64), mergedValid_(false) {
+    while (count_ < stripes) {
+        count_ <<= 1;
+        shift_--;
+    }
+    stripes_.reset(new Stripe[count_]);
+}
+
+bool StripedStore::lookup(NodeId id, KeyValue* entry) const {
+    Stripe& stripe = stripeFor(id);
+    std::shared_lock<std::shared_mutex> guard(stripe.lock);
+    return stripe.store.lookup(id, entry);
+}
+
+bool StripedStore::read(NodeId id, std::string* value) const {
+    Stripe& stripe = stripeFor(id);
+    std::shared_lock<std::shared_mutex> guard(stripe.lock);
+    return stripe.store.read(id, value);
+}
+
+bool StripedStore::share(NodeId id, ValueRef* value) const {
+    Stripe& stripe = stripeFor(id);
+    std::shared_lock<std::shared_mutex> guard(stripe.lock);
+    return stripe.store.share(id, value);
+}
+
+void StripedStore::put(NodeId id, ByteView key, ByteView value) {
+    Stripe& stripe = stripeFor(id);
+    std::unique_lock<std::shared_mutex> guard(stripe.lock);
+    stripe.store.put(id, key, value);
+    mergedValid_.store(false, std::memory_order_relaxed);
+}
+
+void StripedStore::putShared(NodeId id, ByteView key, const ValueBuffer* value) {
+    Stripe& stripe = stripeFor(id);
+    std::unique_lock<std::shared_mutex> guard(stripe.lock);
+    stripe.store.putShared(id, key, value);
+    mergedValid_.store(false, std::memory_order_relaxed);
+}
+
+bool StripedStore::erase(NodeId id) {
+    Stripe& stripe = stripeFor(id);
+    std::unique_lock<std::shared_mutex> guard(stripe.lock);
+    mergedValid_.store(false, std::memory_order_relaxed);
+    return stripe.store.erase(id);
+}
+
+size_t StripedStore::size() const {
+    size_t total = 0;
+    for (size_t i = 0; i < count_; i++) {
+        std::shared_lock<std::shared_mutex> guard(stripes_[i].lock);
+        total += stripes_[i].store.size();
+    }
+    return total;
+}
+
+void StripedStore::clear() {
+    for (size_t i = 0; i < count_; i++) {
+        std::unique_lock<std::shared_mutex> guard(stripes_[i].lock);
+        stripes_[i].store.clear();
+    }
+    mergedValid_.store(false, std::memory_order_relaxed);
+}
+
+KeyValue StripedStore::entryAt(size_t index) const {
+    if (!mergedValid_.load(std::memory_order_relaxed)) {
+        merged_.clear();
+        for (size_t i = 0; i < count_; i++) {
+            for (const KeyValue& kv : stripes_[i].store) {
+                merged_.push_back(kv);
+            }
+        }
+        std::sort(merged_.begin(), merged_.end(),
+                  [](const KeyValue& a, const KeyValue& b) { return a.first < b.first; });
+        mergedValid_.store(true, std::memory_order_relaxed);
+    }
+    return merged_[index];
+}
+
+size_t StripedStore::eraseRange(NodeId start, NodeId end) {
+    size_t erased = 0;
+    for (size_t i = 0; i < count_; i++) {
+        std::unique_lock<std::shared_mutex> guard(stripes_[i].lock);
+        erased += stripes_[i].store.eraseRange(start, end);
+    }
+    mergedValid_.store(false, std::memory_order_relaxed);
+    return erased;
+}
+
+size_t StripedStore::extractRange(NodeId start, NodeId end, KeyStore& dest) {
+    size_t moved = 0;
+    for (size_t i = 0; i < count_; i++) {
+        std::unique_lock<std::shared_mutex> guard(stripes_[i].lock);
+        moved += stripes_[i].store.extractRange(start, end, dest);
+    }
+    mergedValid_.store(false, std::memory_order_relaxed);
+    return moved;
+}
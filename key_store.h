@@ -0,0 +1,441 @@
+#ifndef KEY_STORE_H
+#define KEY_STORE_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string>
+#include <vector>
+#include <iterator>
+#include <memory>
+#include <atomic>
+#include <shared_mutex>
+#include "ring.h"
+
+// Non-owning view of a byte string stored in a KeyStore. Views stay valid
+// until the next mutation of the store they came from.
+struct ByteView {
+    const char* data;
+    size_t size;
+
+    ByteView() : data(nullptr), size(0) {}
+    ByteView(const char* d, size_t n) : data(d), size(n) {}
+    ByteView(const std::string& s) : data(s.data()), size(s.size()) {}
+
+    bool empty() const {
+        return size == 0;
+    }
+
+    std::string str() const {
+        return std::string(data, size);
+    }
+
+    // Single-byte value as used by the uint8_t API; empty reads as None (0)
+    uint8_t asByte() const {
+        return size == 0 ? 0 : static_cast<uint8_t>(data[0]);
+    }
+
+    // Demo formatting: empty or a zero byte prints "None", a single byte
+    // prints as a number, anything longer prints as text
+    std::string toDisplayString() const;
+};
+
+// Immutable value bytes with a reference count. Stores keep values of
+// kSharedBytes or more in one of these instead of their own arena, so moving
+// an entry between stores hands over a reference and never copies the bytes.
+// Blocks are recycled through per-size-class free lists rather than returned
+// to the heap.
+class ValueBuffer {
+public:
+    static constexpr size_t kSharedBytes = 256;
+
+    // New buffer holding a copy of len bytes; the caller owns the one reference
+    static ValueBuffer* create(const char* data, size_t len);
+
+    void retain() const {
+        refs_.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    // Drop one reference; the last one recycles the block
+    void release() const;
+
+    ByteView view() const {
+        return ByteView(reinterpret_cast<const char*>(this + 1), size_);
+    }
+
+    size_t size() const {
+        return size_;
+    }
+
+    uint32_t references() const {
+        return refs_.load(std::memory_order_acquire);
+    }
+
+private:
+    ValueBuffer(size_t size, unsigned sizeClass) : refs_(1), size_(static_cast<uint32_t>(size)), sizeClass_(sizeClass) {}
+
+    mutable std::atomic<uint32_t> refs_;
+    uint32_t size_;
+    uint32_t sizeClass_;  // Free list the block returns to (see key_store.cpp)
+};
+
+// Owning handle to a ValueBuffer: keeps the value readable after the store
+// it came from has changed or dropped it
+class ValueRef {
+public:
+    ValueRef() : buffer_(nullptr) {}
+
+    // Takes over a reference the caller already holds
+    explicit ValueRef(const ValueBuffer* buffer) : buffer_(buffer) {}
+
+    ValueRef(const ValueRef& other) : buffer_(other.buffer_) {
+        if (buffer_) {
+            buffer_->retain();
+        }
+    }
+
+    ValueRef(ValueRef&& other) noexcept : buffer_(other.buffer_) {
+        other.buffer_ = nullptr;
+    }
+
+    ValueRef& operator=(ValueRef other) {
+        std::swap(buffer_, other.buffer_);
+        return *this;
+    }
+
+    ~ValueRef() {
+        if (buffer_) {
+            buffer_->release();
+        }
+    }
+
+    ByteView view() const {
+        return buffer_ ? buffer_->view() : ByteView();
+    }
+
+    const ValueBuffer* get() const {
+        return buffer_;
+    }
+
+    explicit operator bool() const {
+        return buffer_ != nullptr;
+    }
+
+private:
+    const ValueBuffer* buffer_;
+};
+
+// One stored entry as seen through the iterator view. Named first/second so
+// existing code written against std::map<NodeId, ...> keeps working.
+struct KeyValue {
+    NodeId first;       // Ring position of the key
+    ByteView second;    // Value bytes
+    ByteView key;       // Original key bytes, empty when the key is a bare ring id
+    const ValueBuffer* buffer = nullptr;  // Shared buffer behind second, if the store keeps the value in one
+};
+
+// Append-only byte buffer backing variable-length keys and values. Entries
+// refer to it by offset so growing the buffer never invalidates them.
+class ByteArena {
+public:
+    uint32_t append(const char* data, size_t len);
+
+    ByteView view(uint32_t offset, uint32_t len) const {
+        return ByteView(bytes_.data() + offset, len);
+    }
+
+    // Mark len bytes as dead; they are reclaimed by the owner's compaction
+    void release(size_t len) {
+        garbage_ += len;
+    }
+
+    size_t size() const {
+        return bytes_.size();
+    }
+
+    size_t garbage() const {
+        return garbage_;
+    }
+
+    void clear() {
+        bytes_.clear();
+        garbage_ = 0;
+    }
+
+    void reserve(size_t bytes) {
+        bytes_.reserve(bytes);
+    }
+
+    void swap(ByteArena& other) {
+        bytes_.swap(other.bytes_);
+        std::swap(garbage_, other.garbage_);
+    }
+
+private:
+    std::vector<char> bytes_;
+    size_t garbage_ = 0;
+};
+
+// Progress of one chunk of a range copy (see KeyStore::copyRange)
+struct RangeChunk {
+    size_t entries = 0;         // Entries copied in this chunk
+    size_t bytes = 0;           // Key and value bytes copied
+    NodeId last = NodeId(0);    // Id of the last entry copied; the next chunk starts after it
+    bool done = true;           // Nothing in the range is left past last
+};
+
+// Per-node storage engine interface. Entries are kept ordered by ring id so
+// a responsibility interval (start, end] maps to at most two contiguous runs.
+class KeyStore {
+public:
+    class const_iterator {
+    public:
+        typedef std::forward_iterator_tag iterator_category;
+        typedef KeyValue value_type;
+        typedef ptrdiff_t difference_type;
+        typedef const KeyValue* pointer;
+        typedef KeyValue reference;
+
+        const_iterator(const KeyStore* store, size_t index) : store_(store), index_(index) {}
+
+        KeyValue operator*() const {
+            return store_->entryAt(index_);
+        }
+
+        const_iterator& operator++() {
+            ++index_;
+            return *this;
+        }
+
+        bool operator==(const const_iterator& other) const {
+            return index_ == other.index_;
+        }
+
+        bool operator!=(const const_iterator& other) const {
+            return index_ != other.index_;
+        }
+
+    private:
+        const KeyStore* store_;
+        size_t index_;
+    };
+
+    virtual ~KeyStore() {}
+
+    /**
+     * @param id: ring position of the key.
+     * @param entry: receives views of the stored key and value when found.
+     * @return whether the key is stored here.
+     */
+    virtual bool lookup(NodeId id, KeyValue* entry) const = 0;
+
+    // Insert or overwrite; key may be empty when callers address by ring id only
+    virtual void put(NodeId id, ByteView key, ByteView value) = 0;
+
+    // Insert or overwrite with a value another store already holds. Engines
+    // that can share it take a reference; the default copies the bytes.
+    virtual void putShared(NodeId id, ByteView key, const ValueBuffer* value) {
+        put(id, key, value->view());
+    }
+
+    virtual bool erase(NodeId id) = 0;
+
+    virtual size_t size() const = 0;
+
+    virtual void clear() = 0;
+
+    // Entry at position index in ascending id order
+    virtual KeyValue entryAt(size_t index) const = 0;
+
+    /**
+     * Move every entry whose id lies in (start, end] into dest, which must
+     * be a different store. start == end moves everything.
+     * @return number of entries moved.
+     */
+    virtual size_t extractRange(NodeId start, NodeId end, KeyStore& dest) = 0;
+
+    // Drop every entry whose id lies in (start, end]; start == end drops
+    // everything. Returns the number of entries removed.
+    virtual size_t eraseRange(NodeId start, NodeId end);
+
+    // Copy the value out. Engines shared between threads override this to
+    // copy while holding their lock, since views may dangle once it is released.
+    virtual bool read(NodeId id, std::string* value) const {
+        ByteView view;
+        if (!get(id, &view)) {
+            return false;
+        }
+        value->assign(view.data, view.size);
+        return true;
+    }
+
+    /**
+     * Zero-copy read that outlives later writes: a reference to the stored
+     * buffer, or a new buffer holding a copy when the engine keeps the value
+     * inline. Engines shared between threads override this to take the
+     * reference under their lock.
+     */
+    virtual bool share(NodeId id, ValueRef* value) const {
+        KeyValue entry;
+        if (!lookup(id, &entry)) {
+            return false;
+        }
+        if (entry.buffer) {
+            entry.buffer->retain();
+            *value = ValueRef(entry.buffer);
+        } else {
+            *value = ValueRef(ValueBuffer::create(entry.second.data, entry.second.size));
+        }
+        return true;
+    }
+
+    /**
+     * Copy entries with ids in (start, end] into dest in ring order from
+     * start, leaving this store unchanged. Stops once maxEntries entries or
+     * maxBytes bytes have been copied; at least one entry is copied when the
+     * range is not empty. Continue with start = the returned chunk's last.
+     */
+    RangeChunk copyRange(NodeId start, NodeId end, KeyStore& dest, size_t maxEntries, size_t maxBytes) const;
+
+    void put(NodeId id, ByteView value) {
+        put(id, ByteView(), value);
+    }
+
+    // Store an entry read from another store, sharing its buffer if it has one
+    void put(const KeyValue& entry) {
+        if (entry.buffer) {
+            putShared(entry.first, entry.key, entry.buffer);
+        } else {
+            put(entry.first, entry.key, entry.second);
+        }
+    }
+
+    bool get(NodeId id, ByteView* value) const {
+        KeyValue entry;
+        if (!lookup(id, &entry)) {
+            return false;
+        }
+        *value = entry.second;
+        return true;
+    }
+
+    bool contains(NodeId id) const {
+        KeyValue ignored;
+        return lookup(id, &ignored);
+    }
+
+    bool empty() const {
+        return size() == 0;
+    }
+
+    const_iterator begin() const {
+        return const_iterator(this, 0);
+    }
+
+    const_iterator end() const {
+        return const_iterator(this, size());
+    }
+};
+
+// Default engine: a sorted vector of fixed-size slots with key and value
+// bytes packed in one arena. Lookups are a binary search over contiguous
+// memory, in-order appends are O(1), and range extraction moves whole runs.
+// Values of ValueBuffer::kSharedBytes or more live in shared buffers, and the
+// arena holds a pointer to the buffer in their place.
+class SortedVectorStore : public KeyStore {
+public:
+    SortedVectorStore() {}
+    SortedVectorStore(const SortedVectorStore&) = delete;
+    SortedVectorStore& operator=(const SortedVectorStore&) = delete;
+    ~SortedVectorStore() override;
+
+    bool lookup(NodeId id, KeyValue* entry) const override;
+    void put(NodeId id, ByteView key, ByteView value) override;
+    void putShared(NodeId id, ByteView key, const ValueBuffer* value) override;
+    bool erase(NodeId id) override;
+    size_t extractRange(NodeId start, NodeId end, KeyStore& dest) override;
+    size_t eraseRange(NodeId start, NodeId end) override;
+    KeyValue entryAt(size_t index) const override;
+
+    size_t size() const override {
+        return slots_.size();
+    }
+
+    void clear() override;
+
+    void reserve(size_t entries, size_t bytes);
+
+    using KeyStore::put;
+    using KeyStore::get;
+
+private:
+    // valueLength of a slot whose value is a ValueBuffer; the arena then
+    // holds the buffer's address at valueOffset
+    static constexpr uint32_t kSharedValue = ~0U;
+
+    struct Slot {
+        NodeId id;
+        uint32_t keyOffset;
+        uint32_t keyLength;
+        uint32_t valueOffset;
+        uint32_t valueLength;
+    };
+
+    const ValueBuffer* bufferOf(const Slot& slot) const;
+    void store(NodeId id, ByteView key, ByteView value, const ValueBuffer* buffer);
+    void drop(const Slot& slot);
+    std::vector<Slot>::iterator lowerBound(NodeId id);
+    std::vector<Slot>::const_iterator lowerBound(NodeId id) const;
+    void moveRun(size_t first, size_t last, KeyStore* dest);
+    size_t removeRange(NodeId start, NodeId end, KeyStore* dest);
+    void compactIfNeeded();
+
+    std::vector<Slot> slots_;
+    ByteArena arena_;
+};
+
+// Thread-safe engine: entries are spread over independently locked
+// SortedVectorStore stripes by a hash of the ring id, so readers and writers
+// of different keys rarely contend. Point operations (lookup/read/put/erase)
+// are safe from any thread. Ordered iteration (entryAt, begin/end) merges
+// the stripes and is meant for quiescent moments such as printing or
+// migration, when no other thread is writing.
+class StripedStore : public KeyStore {
+public:
+    explicit StripedStore(size_t stripes = 16);
+
+    bool lookup(NodeId id, KeyValue* entry) const override;
+    bool read(NodeId id, std::string* value) const override;
+    bool share(NodeId id, ValueRef* value) const override;
+    void put(NodeId id, ByteView key, ByteView value) override;
+    void putShared(NodeId id, ByteView key, const ValueBuffer* value) override;
+    bool erase(NodeId id) override;
+    size_t size() const override;
+    void clear() override;
+    KeyValue entryAt(size_t index) const override;
+    size_t extractRange(NodeId start, NodeId end, KeyStore& dest) override;
+    size_t eraseRange(NodeId start, NodeId end) override;
+
+    using KeyStore::put;
+    using KeyStore::get;
+
+private:
+    struct alignas(64) Stripe {
+        mutable std::shared_mutex lock;
+        SortedVectorStore store;
+    };
+
+    Stripe& stripeFor(NodeId id) const {
+        // Fibonacci hashing spreads nearby ring ids over all stripes
+        return stripes_[(ChordRing::low64(id) * 0x9E3779B97F4A7C15ULL) >> shift_];
+    }
+
+    std::unique_ptr<Stripe[]> stripes_;
+    size_t count_;
+    unsigned shift_;
+
+    // Merged order for iteration, rebuilt after any mutation
+    mutable std::vector<KeyValue> merged_;
+    mutable std::atomic<bool> mergedValid_;
+};
+
+#endif
@@ -0,0 +1,166 @@
+#ifndef LOCATION_CACHE_H
+#define LOCATION_CACHE_H
+
+#include <stdint.h>
+#include <algorithm>
+#include <mutex>
+#include <vector>
+#include "ring.h"
+
+class Node;
+
+// Per-node memo of where earlier lookups ended: each entry maps a key range
+// (start, end] to the node that owned it. Entries carry the ring membership
+// epoch they were learned in and stop matching once the epoch moves on, so
+// a join, leave, crash or stabilize change drops every stale entry at once
+// without touching the cache. Eviction is CLOCK over a fixed number of slots.
+//
+// Slots are parallel arrays, and a sorted array of range ends maps a key to
+// the one slot that can contain it with a binary search. Access goes through
+// try_lock: a thread that finds the cache busy routes normally instead of
+// waiting.
+class LocationCache {
+public:
+    struct Stats {
+        uint64_t lookups = 0;     // Cache probes
+        uint64_t hits = 0;        // Probes answered with a current entry
+        uint64_t stale = 0;       // Probes that matched only an outdated entry
+        uint64_t inserts = 0;     // Ranges learned from routed lookups
+        uint64_t evictions = 0;   // Current entries pushed out by CLOCK
+        uint64_t hopsSaved = 0;   // Route length of hit entries minus the one direct hop
+
+        double hitRate() const {
+            return lookups > 0 ? static_cast<double>(hits) / lookups : 0.0;
+        }
+    };
+
+    /**
+     * @param capacity: number of ranges kept.
+     */
+    explicit LocationCache(size_t capacity)
+        : starts_(capacity), owners_(capacity, nullptr), epochs_(capacity, 0), hops_(capacity, 0),
+          referenced_(capacity, 0), hand_(0) {
+        sortedEnds_.reserve(capacity);
+        sortedSlots_.reserve(capacity);
+    }
+
+    size_t capacity() const {
+        return owners_.size();
+    }
+
+    /**
+     * @param key: ring position being looked up.
+     * @param epoch: current ring membership epoch.
+     * @return the cached owner of key, or null on a miss.
+     */
+    Node* find(NodeId key, uint64_t epoch) {
+        std::unique_lock<std::mutex> guard(lock_, std::try_to_lock);
+        if (!guard.owns_lock()) {
+            return nullptr;
+        }
+        stats_.lookups++;
+        if (sortedEnds_.empty()) {
+            return nullptr;
+        }
+        // The range holding key ends at the first end >= key, or wraps past
+        // zero and ends at the smallest one
+        size_t at = std::lower_bound(sortedEnds_.begin(), sortedEnds_.end(), key) - sortedEnds_.begin();
+        if (at == sortedEnds_.size()) {
+            at = 0;
+        }
+        uint32_t slot = sortedSlots_[at];
+        if (!ChordRing::inRange(key, starts_[slot], sortedEnds_[at])) {
+            return nullptr;
+        }
+        if (epochs_[slot] != epoch) {
+            stats_.stale++;
+            return nullptr;
+        }
+        referenced_[slot] = 1;
+        stats_.hits++;
+        stats_.hopsSaved += hops_[slot] > 1 ? hops_[slot] - 1 : 0;
+        return owners_[slot];
+    }
+
+    /**
+     * Remember that owner is responsible for (start, end].
+     * @param hops: length of the route that found it.
+     */
+    void insert(NodeId start, NodeId end, Node* owner, uint32_t hops, uint64_t epoch) {
+        std::unique_lock<std::mutex> guard(lock_, std::try_to_lock);
+        if (!guard.owns_lock() || owners_.empty()) {
+            return;
+        }
+        stats_.inserts++;
+
+        size_t at = std::lower_bound(sortedEnds_.begin(), sortedEnds_.end(), end) - sortedEnds_.begin();
+        uint32_t slot;
+        if (at < sortedEnds_.size() && sortedEnds_[at] == end) {
+            // Same owner id: refresh the range in place
+            slot = sortedSlots_[at];
+        } else {
+            if (sortedEnds_.size() < owners_.size()) {
+                slot = static_cast<uint32_t>(sortedEnds_.size());
+            } else {
+                slot = evict();
+                at = std::lower_bound(sortedEnds_.begin(), sortedEnds_.end(), end) - sortedEnds_.begin();
+            }
+            sortedEnds_.insert(sortedEnds_.begin() + at, end);
+            sortedSlots_.insert(sortedSlots_.begin() + at, slot);
+        }
+
+        starts_[slot] = start;
+        owners_[slot] = owner;
+        epochs_[slot] = epoch;
+        hops_[slot] = hops;
+        referenced_[slot] = 0;
+    }
+
+    void clear() {
+        std::lock_guard<std::mutex> guard(lock_);
+        sortedEnds_.clear();
+        sortedSlots_.clear();
+        hand_ = 0;
+    }
+
+    Stats stats() const {
+        std::lock_guard<std::mutex> guard(lock_);
+        return stats_;
+    }
+
+    void resetStats() {
+        std::lock_guard<std::mutex> guard(lock_);
+        stats_ = Stats();
+    }
+
+private:
+    // CLOCK: sweep past recently used slots, clearing their bit, and free the
+    // first one that is unreferenced. Caller holds lock_ and the cache is full.
+    uint32_t evict() {
+        while (referenced_[hand_]) {
+            referenced_[hand_] = 0;
+            hand_ = (hand_ + 1) % owners_.size();
+        }
+        uint32_t slot = static_cast<uint32_t>(hand_);
+        hand_ = (hand_ + 1) % owners_.size();
+        stats_.evictions++;
+
+        size_t at = std::find(sortedSlots_.begin(), sortedSlots_.end(), slot) - sortedSlots_.begin();
+        sortedEnds_.erase(sortedEnds_.begin() + at);
+        sortedSlots_.erase(sortedSlots_.begin() + at);
+        return slot;
+    }
+
+    std::vector<NodeId> starts_;      // Indexed by slot
+    std::vector<Node*> owners_;
+    std::vector<uint64_t> epochs_;
+    std::vector<uint32_t> hops_;
+    std::vector<uint8_t> referenced_;
+    std::vector<NodeId> sortedEnds_;  // Range ends in ring order
+    std::vector<uint32_t> sortedSlots_;  // Slot of each entry in sortedEnds_
+    size_t hand_;
+    Stats stats_;
+    mutable std::mutex lock_;
+};
+
+#endif
@@ -0,0 +1,567 @@
+#include "log_store.h"
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// Segment file layout: a fixed header, then records back to back, each
+// padded to 8 bytes. A record is a RecordHeader, the key's ring id (and for
+// range removals the end id), the key bytes and the value bytes.
+static const char kSegmentMagic[8] = {'C', 'H', 'O', 'R', 'D', 'L', 'O', 'G'};
+static const uint32_t kSegmentVersion = 1;
+static const size_t kSegmentHeaderBytes = 32;
+
+struct SegmentHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t bits;     // Ring width the ids were written with
+    uint32_t number;
+    uint32_t reserved[3];
+};
+
+enum RecordType : uint8_t {
+    RECORD_PUT = 1,
+    RECORD_ERASE = 2,
+    RECORD_ERASE_RANGE = 3  // Every entry in (id, end]
+};
+
+struct RecordHeader {
+    uint32_t checksum;  // Over everything after this field, padding excluded
+    uint8_t type;
+    uint8_t reserved[3];
+    uint64_t sequence;  // One more than the previous record in the log
+    uint32_t keyLength;
+    uint32_t valueLength;
+};
+
+static_assert(sizeof(SegmentHeader) <= kSegmentHeaderBytes, "segment header too large");
+static_assert(sizeof(RecordHeader) == 24, "record header must stay 8-byte aligned");
+
+static size_t recordBytes(uint8_t type, size_t keyLength, size_t valueLength) {
+    size_t ids = type == RECORD_ERASE_RANGE ? 2 : 1;
+    return (sizeof(RecordHeader) + ids * ChordRing::kBytes + keyLength + valueLength + 7) & ~size_t(7);
+}
+
+// Word-at-a-time multiply-xorshift hash; only has to catch torn writes
+static uint32_t checksum(const char* data, size_t len) {
+    uint64_t h = 0x9E3779B97F4A7C15ULL ^ len;
+    size_t i = 0;
+    for (; i + 8 <= len; i += 8) {
+        uint64_t word;
+        std::memcpy(&word, data + i, 8);
+        h = (h ^ word) * 0xBF58476D1CE4E5B9ULL;
+        h ^= h >> 29;
+    }
+    for (; i < len; i++) {
+        h = (h ^ static_cast<uint8_t>(data[i])) * 0x94D049BB133111EBULL;
+    }
+    h ^= h >> 32;
+    return static_cast<uint32_t>(h);
+}
+
+static size_t pageSize() {
+    static const size_t size = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+    return size;
+}
+
+LogStore::LogStore(const LogStoreOptions& options)
+    : options_(options), nextNumber_(0), sequence_(1), pendingRecords_(0), pendingBytes_(0), logBytes_(0),
+      garbage_(0), failed_(false) {
+    // Record offsets are 32-bit
+    options_.segmentBytes = std::max<size_t>(pageSize(), std::min<size_t>(options_.segmentBytes, 1u << 31));
+}
+
+LogStore::~LogStore() {
+    commit();
+    for (Segment& segment : segments_) {
+        unmapSegment(segment, false);
+    }
+}
+
+std::string LogStore::segmentPath(uint32_t number) const {
+    char name[32];
+    std::snprintf(name, sizeof(name), "segment-%08u.log", number);
+    return dir_ + "/" + name;
+}
+
+bool LogStore::open(const std::string& dir) {
+    dir_ = dir;
+    if (mkdir(dir.c_str(), 0755) != 0 && errno != EEXIST) {
+        return false;
+    }
+    DIR* handle = opendir(dir.c_str());
+    if (handle == nullptr) {
+        return false;
+    }
+    std::vector<uint32_t> numbers;
+    while (dirent* entry = readdir(handle)) {
+        unsigned number;
+        char tail;
+        if (std::sscanf(entry->d_name, "segment-%8u.lo%c", &number, &tail) == 2 && tail == 'g') {
+            numbers.push_back(number);
+        }
+    }
+    closedir(handle);
+    std::sort(numbers.begin(), numbers.end());
+
+    for (uint32_t number : numbers) {
+        if (!mapSegment(number, false, 0)) {
+            for (Segment& segment : segments_) {
+                unmapSegment(segment, false);
+            }
+            segments_.clear();
+            return false;
+        }
+    }
+    nextNumber_ = numbers.empty() ? 0 : numbers.back() + 1;
+    recover();
+    return true;
+}
+
+// Map an existing segment file, or create one of the given capacity
+bool LogStore::mapSegment(uint32_t number, bool create, size_t capacity) {
+    std::string path = segmentPath(number);
+    int fd = ::open(path.c_str(), create ? O_RDWR | O_CREAT | O_TRUNC : O_RDWR, 0644);
+    if (fd < 0) {
+        return false;
+    }
+    if (create) {
+        if (ftruncate(fd, static_cast<off_t>(capacity)) != 0) {
+            close(fd);
+            unlink(path.c_str());
+            return false;
+        }
+    } else {
+        struct stat info;
+        if (fstat(fd, &info) != 0 || static_cast<size_t>(info.st_size) < kSegmentHeaderBytes) {
+            close(fd);
+            return false;
+        }
+        capacity = static_cast<size_t>(info.st_size);
+    }
+    void* base = mmap(nullptr, capacity, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (base == MAP_FAILED) {
+        close(fd);
+        return false;
+    }
+
+    Segment segment;
+    segment.number = number;
+    segment.fd = fd;
+    segment.base = static_cast<char*>(base);
+    segment.capacity = capacity;
+    segment.used = kSegmentHeaderBytes;
+    segment.synced = create ? 0 : capacity;
+
+    SegmentHeader* header = reinterpret_cast<SegmentHeader*>(segment.base);
+    if (create) {
+        std::memcpy(header->magic, kSegmentMagic, sizeof(kSegmentMagic));
+        header->version = kSegmentVersion;
+        header->bits = BITLENGTH;
+        header->number = number;
+    } else if (std::memcmp(header->magic, kSegmentMagic, sizeof(kSegmentMagic)) != 0 ||
+               header->version != kSegmentVersion || header->bits != BITLENGTH) {
+        unmapSegment(segment, false);
+        return false;
+    }
+    segments_.push_back(segment);
+    return true;
+}
+
+void LogStore::unmapSegment(Segment& segment, bool unlinkFile) {
+    munmap(segment.base, segment.capacity);
+    close(segment.fd);
+    if (unlinkFile) {
+        unlink(segmentPath(segment.number).c_str());
+    }
+}
+
+// Start a new segment with room for at least minBytes of records, sealing
+// (syncing) the current one first
+bool LogStore::addSegment(size_t minBytes) {
+    if (!segments_.empty() && !syncSegment(segments_.back())) {
+        return false;
+    }
+    size_t pages = (kSegmentHeaderBytes + minBytes + pageSize() - 1) / pageSize();
+    size_t capacity = std::max(options_.segmentBytes, pages * pageSize());
+    if (capacity > (size_t(1) << 32) || !mapSegment(nextNumber_, true, capacity)) {
+        return false;
+    }
+    nextNumber_++;
+    logBytes_ += kSegmentHeaderBytes;
+    return true;
+}
+
+bool LogStore::syncSegment(Segment& segment) {
+    if (segment.synced >= segment.used) {
+        return true;
+    }
+    size_t from = segment.synced & ~(pageSize() - 1);
+    if (msync(segment.base + from, segment.used - from, MS_SYNC) != 0) {
+        return false;
+    }
+    segment.synced = segment.used;
+    return true;
+}
+
+bool LogStore::commit() {
+    for (Segment& segment : segments_) {
+        if (!syncSegment(segment)) {
+            failed_ = true;
+            return false;
+        }
+    }
+    pendingRecords_ = 0;
+    pendingBytes_ = 0;
+    return true;
+}
+
+// Append one record; for puts, slot receives where the key and value live
+bool LogStore::appendRecord(uint8_t type, NodeId id, NodeId end, ByteView key, ByteView value, Slot* slot) {
+    size_t bytes = recordBytes(type, key.size, value.size);
+    if (segments_.empty() || segments_.back().used + bytes > segments_.back().capacity) {
+        if (!addSegment(bytes)) {
+            failed_ = true;
+            return false;
+        }
+    }
+    Segment& segment = segments_.back();
+    char* record = segment.base + segment.used;
+
+    RecordHeader header = {};
+    header.type = type;
+    header.sequence = sequence_;
+    header.keyLength = static_cast<uint32_t>(key.size);
+    header.valueLength = static_cast<uint32_t>(value.size);
+    char* cursor = record + sizeof(RecordHeader);
+    ChordRing::toBytes(id, reinterpret_cast<uint8_t*>(cursor));
+    cursor += ChordRing::kBytes;
+    if (type == RECORD_ERASE_RANGE) {
+        ChordRing::toBytes(end, reinterpret_cast<uint8_t*>(cursor));
+        cursor += ChordRing::kBytes;
+    }
+    if (key.size > 0) {
+        std::memcpy(cursor, key.data, key.size);
+    }
+    if (value.size > 0) {
+        std::memcpy(cursor + key.size, value.data, value.size);
+    }
+    std::memcpy(record, &header, sizeof(header));
+    size_t covered = cursor + key.size + value.size - record;
+    header.checksum = checksum(record + sizeof(uint32_t), covered - sizeof(uint32_t));
+    std::memcpy(record, &header.checksum, sizeof(uint32_t));
+
+    if (slot != nullptr) {
+        slot->id = id;
+        slot->segment = static_cast<uint32_t>(segments_.size() - 1);
+        slot->offset = static_cast<uint32_t>(segment.used);
+        slot->keyLength = header.keyLength;
+        slot->valueLength = header.valueLength;
+    }
+    segment.used += bytes;
+    logBytes_ += bytes;
+    sequence_++;
+
+    // Group commit: one msync covers every record since the previous one
+    pendingRecords_++;
+    pendingBytes_ += bytes;
+    if (options_.groupCommitRecords > 0 &&
+        (pendingRecords_ >= options_.groupCommitRecords || pendingBytes_ >= options_.groupCommitBytes)) {
+        commit();
+    }
+    return true;
+}
+
+// Rebuild the index from the mapped segments. Records are replayed in
+// sequence order; the first record that is torn (bad checksum) or stale
+// (out of sequence, left over from before a crash) ends the log, and any
+// later segments are deleted.
+void LogStore::recover() {
+    struct Replayed {
+        Slot slot;
+        uint64_t sequence;
+        bool erased;
+    };
+    struct RangeErase {
+        NodeId start;
+        NodeId end;
+        uint64_t sequence;
+    };
+    std::vector<Replayed> records;
+    std::vector<RangeErase> ranges;
+    uint64_t expected = 0;
+    size_t valid = 0;
+
+    for (; valid < segments_.size(); valid++) {
+        Segment& segment = segments_[valid];
+        size_t pos = kSegmentHeaderBytes;
+        bool torn = false;
+        while (pos + sizeof(RecordHeader) <= segment.capacity) {
+            RecordHeader header;
+            std::memcpy(&header, segment.base + pos, sizeof(header));
+            if (header.type < RECORD_PUT || header.type > RECORD_ERASE_RANGE) {
+                break;
+            }
+            size_t bytes = recordBytes(header.type, header.keyLength, header.valueLength);
+            if (bytes > segment.capacity - pos || (expected != 0 && header.sequence != expected)) {
+                torn = true;
+                break;
+            }
+            size_t covered = sizeof(RecordHeader) + ChordRing::kBytes * (header.type == RECORD_ERASE_RANGE ? 2 : 1) +
+                             header.keyLength + header.valueLength;
+            if (checksum(segment.base + pos + sizeof(uint32_t), covered - sizeof(uint32_t)) != header.checksum) {
+                torn = true;
+                break;
+            }
+            const uint8_t* ids = reinterpret_cast<const uint8_t*>(segment.base + pos + sizeof(RecordHeader));
+            NodeId id = ChordRing::fromBytes(ids);
+            if (header.type == RECORD_ERASE_RANGE) {
+                ranges.push_back(RangeErase{id, ChordRing::fromBytes(ids + ChordRing::kBytes), header.sequence});
+            } else {
+                Replayed r;
+                r.slot.id = id;
+                r.slot.segment = static_cast<uint32_t>(valid);
+                r.slot.offset = static_cast<uint32_t>(pos);
+                r.slot.keyLength = header.keyLength;
+                r.slot.valueLength = header.valueLength;
+                r.sequence = header.sequence;
+                r.erased = header.type == RECORD_ERASE;
+                records.push_back(r);
+            }
+            expected = header.sequence + 1;
+            pos += bytes;
+        }
+        segment.used = pos;
+        segment.synced = pos;
+        logBytes_ += pos;
+        if (torn) {
+            // Clear what follows so records that outlived the torn one
+            // cannot line up with the sequence of later appends
+            std::memset(segment.base + pos, 0, segment.capacity - pos);
+            msync(segment.base + (pos & ~(pageSize() - 1)), segment.capacity - (pos & ~(pageSize() - 1)), MS_SYNC);
+            valid++;
+            break;
+        }
+    }
+    for (size_t i = valid; i < segments_.size(); i++) {
+        unmapSegment(segments_[i], true);
+    }
+    segments_.resize(valid);
+    sequence_ = expected != 0 ? expected : 1;
+
+    // The last record per id wins, unless a later range removal covers it
+    auto byId = [](const Replayed& a, const Replayed& b) { return a.slot.id < b.slot.id; };
+    if (!std::is_sorted(records.begin(), records.end(), byId)) {
+        std::stable_sort(records.begin(), records.end(), byId);
+    }
+    index_.clear();
+    size_t live = 0;
+    for (size_t i = 0; i < records.size(); i++) {
+        if (i + 1 < records.size() && records[i + 1].slot.id == records[i].slot.id) {
+            continue;
+        }
+        const Replayed& r = records[i];
+        bool removed = r.erased;
+        for (const RangeErase& range : ranges) {
+            if (!removed && range.sequence > r.sequence && ChordRing::inRange(r.slot.id, range.start, range.end)) {
+                removed = true;
+            }
+        }
+        if (!removed) {
+            index_.push_back(r.slot);
+            live += recordBytes(RECORD_PUT, r.slot.keyLength, r.slot.valueLength);
+        }
+    }
+    garbage_ = logBytes_ - segments_.size() * kSegmentHeaderBytes - live;
+}
+
+std::vector<LogStore::Slot>::iterator LogStore::lowerBound(NodeId id) {
+    return std::lower_bound(index_.begin(), index_.end(), id,
+                            [](const Slot& slot, const NodeId& key) { return slot.id < key; });
+}
+
+std::vector<LogStore::Slot>::const_iterator LogStore::lowerBound(NodeId id) const {
+    return std::lower_bound(index_.begin(), index_.end(), id,
+                            [](const Slot& slot, const NodeId& key) { return slot.id < key; });
+}
+
+bool LogStore::lookup(NodeId id, KeyValue* entry) const {
+    auto it = lowerBound(id);
+    if (it == index_.end() || it->id != id) {
+        return false;
+    }
+    *entry = entryAt(it - index_.begin());
+    return true;
+}
+
+KeyValue LogStore::entryAt(size_t index) const {
+    const Slot& slot = index_[index];
+    const char* data = segments_[slot.segment].base + slot.offset + sizeof(RecordHeader) + ChordRing::kBytes;
+    KeyValue kv;
+    kv.first = slot.id;
+    kv.key = ByteView(data, slot.keyLength);
+    kv.second = ByteView(data + slot.keyLength, slot.valueLength);
+    return kv;
+}
+
+void LogStore::release(const Slot& slot) {
+    garbage_ += recordBytes(RECORD_PUT, slot.keyLength, slot.valueLength);
+}
+
+void LogStore::put(NodeId id, ByteView key, ByteView value) {
+    Slot slot;
+    if (!appendRecord(RECORD_PUT, id, id, key, value, &slot)) {
+        return;
+    }
+    // Keys usually arrive in ascending order during migration and bulk load
+    if (index_.empty() || index_.back().id < id) {
+        index_.push_back(slot);
+        return;
+    }
+    auto it = lowerBound(id);
+    if (it != index_.end() && it->id == id) {
+        release(*it);
+        *it = slot;
+        compactIfNeeded();
+    } else {
+        index_.insert(it, slot);
+    }
+}
+
+bool LogStore::erase(NodeId id) {
+    auto it = lowerBound(id);
+    if (it == index_.end() || it->id != id) {
+        return false;
+    }
+    if (!appendRecord(RECORD_ERASE, id, id, ByteView(), ByteView(), nullptr)) {
+        return false;
+    }
+    release(*it);
+    garbage_ += recordBytes(RECORD_ERASE, 0, 0);
+    index_.erase(it);
+    compactIfNeeded();
+    return true;
+}
+
+// Drop the entries in (start, end], copying them to dest first if given.
+// One range record replaces a tombstone per key.
+size_t LogStore::removeRange(NodeId start, NodeId end, KeyStore* dest) {
+    auto upper = [this](NodeId id) {
+        return static_cast<size_t>(std::upper_bound(index_.begin(), index_.end(), id,
+                                                    [](const NodeId& key, const Slot& slot) { return key < slot.id; }) -
+                                   index_.begin());
+    };
+    // Runs [first, last) of the index, in ring order
+    std::pair<size_t, size_t> runs[2];
+    size_t count = 0;
+    if (start == end) {
+        runs[count++] = std::make_pair(size_t(0), index_.size());
+    } else if (start < end) {
+        runs[count++] = std::make_pair(upper(start), upper(end));
+    } else {
+        runs[count++] = std::make_pair(upper(start), index_.size());
+        runs[count++] = std::make_pair(size_t(0), upper(end));
+    }
+    size_t removed = 0;
+    for (size_t r = 0; r < count; r++) {
+        removed += runs[r].second - runs[r].first;
+    }
+    if (removed == 0 || !appendRecord(RECORD_ERASE_RANGE, start, end, ByteView(), ByteView(), nullptr)) {
+        return 0;
+    }
+    garbage_ += recordBytes(RECORD_ERASE_RANGE, 0, 0);
+
+    for (size_t r = 0; r < count; r++) {
+        for (size_t i = runs[r].first; i < runs[r].second; i++) {
+            if (dest) {
+                KeyValue kv = entryAt(i);
+                dest->put(kv.first, kv.key, kv.second);
+            }
+            release(index_[i]);
+        }
+    }
+    // A wrapping range's tail run goes first, leaving the head's positions intact
+    for (size_t r = 0; r < count; r++) {
+        index_.erase(index_.begin() + runs[r].first, index_.begin() + runs[r].second);
+    }
+    compactIfNeeded();
+    return removed;
+}
+
+size_t LogStore::extractRange(NodeId start, NodeId end, KeyStore& dest) {
+    return removeRange(start, end, &dest);
+}
+
+size_t LogStore::eraseRange(NodeId start, NodeId end) {
+    return removeRange(start, end, nullptr);
+}
+
+void LogStore::clear() {
+    for (Segment& segment : segments_) {
+        unmapSegment(segment, true);
+    }
+    segments_.clear();
+    index_.clear();
+    pendingRecords_ = 0;
+    pendingBytes_ = 0;
+    logBytes_ = 0;
+    garbage_ = 0;
+}
+
+bool LogStore::compact() {
+    if (segments_.empty()) {
+        return true;
+    }
+    // Live records are copied out of the old mappings into new segments,
+    // which are synced before the old files go away: after a crash in
+    // between, replaying old then new segments gives the same entries
+    std::vector<Segment> old;
+    old.swap(segments_);
+    std::vector<Slot> index;
+    index.swap(index_);
+    logBytes_ = 0;
+    garbage_ = 0;
+    bool ok = !failed_;
+    for (size_t i = 0; ok && i < index.size(); i++) {
+        const Slot& slot = index[i];
+        const char* data = old[slot.segment].base + slot.offset + sizeof(RecordHeader) + ChordRing::kBytes;
+        Slot moved;
+        ok = appendRecord(RECORD_PUT, slot.id, slot.id, ByteView(data, slot.keyLength),
+                          ByteView(data + slot.keyLength, slot.valueLength), &moved);
+        index_.push_back(moved);
+    }
+    if (!ok || !commit()) {
+        // Keep the old log; drop whatever was written of the new one
+        for (Segment& segment : segments_) {
+            unmapSegment(segment, true);
+        }
+        segments_.swap(old);
+        index_.swap(index);
+        logBytes_ = 0;
+        for (const Segment& segment : segments_) {
+            logBytes_ += segment.used;
+        }
+        size_t live = 0;
+        for (const Slot& slot : index_) {
+            live += recordBytes(RECORD_PUT, slot.keyLength, slot.valueLength);
+        }
+        garbage_ = logBytes_ - segments_.size() * kSegmentHeaderBytes - live;
+        return false;
+    }
+    for (Segment& segment : old) {
+        unmapSegment(segment, true);
+    }
+    return true;
+}
+
+void LogStore::compactIfNeeded() {
+    if (garbage_ < options_.compactMinBytes || garbage_ < options_.compactRatio * logBytes_) {
+        return;
+    }
+    compact();
+}
@@ -0,0 +1,134 @@
+#ifndef LOG_STORE_H
+#define LOG_STORE_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string>
+#include <vector>
+#include "key_store.h"
+
+// Tuning for LogStore
+struct LogStoreOptions {
+    size_t segmentBytes = 64 << 20;     // Size of each segment file; larger records get a segment of their own
+    size_t groupCommitRecords = 256;    // Sync after this many records; 1 syncs every write, 0 only on commit()
+    size_t groupCommitBytes = 1 << 20;  // ... or once this many bytes are unsynced
+    double compactRatio = 0.5;          // Compact once this fraction of the log is superseded records
+    size_t compactMinBytes = 4 << 20;   // ... and at least this many bytes are superseded
+};
+
+// Persistent engine: a log-structured store over memory-mapped segment
+// files in one directory per node. Every put, erase and range removal
+// appends a checksummed record to the current segment; values are read
+// straight out of the mapping, so views stay zero-copy. Records are made
+// durable in groups (msync once per groupCommitRecords records or
+// groupCommitBytes bytes) rather than one by one. Once enough of the log is
+// superseded, the live entries are rewritten into fresh segments in id order
+// and the old files are deleted.
+//
+// Opening a directory that already holds segments maps them and rebuilds
+// the in-memory index from their records, stopping at the first torn or
+// stale record, so a restarted node gets its keys back without asking the
+// ring for them. POSIX only; not thread-safe, like SortedVectorStore.
+class LogStore : public KeyStore {
+public:
+    explicit LogStore(const LogStoreOptions& options = LogStoreOptions());
+    ~LogStore();
+
+    LogStore(const LogStore&) = delete;
+    LogStore& operator=(const LogStore&) = delete;
+
+    /**
+     * Open the store in dir, creating the directory if needed, and recover
+     * any entries a previous store left there.
+     * @return false if the directory or an existing segment cannot be used.
+     */
+    bool open(const std::string& dir);
+
+    // Set once a segment could not be created or synced; writes made after
+    // that point are not stored
+    bool failed() const {
+        return failed_;
+    }
+
+    // Make every record appended so far durable
+    bool commit();
+
+    // Rewrite the live entries into new segments and delete the old ones.
+    // Views into the store are invalidated.
+    bool compact();
+
+    bool lookup(NodeId id, KeyValue* entry) const override;
+    void put(NodeId id, ByteView key, ByteView value) override;
+    bool erase(NodeId id) override;
+    size_t extractRange(NodeId start, NodeId end, KeyStore& dest) override;
+    size_t eraseRange(NodeId start, NodeId end) override;
+    KeyValue entryAt(size_t index) const override;
+
+    size_t size() const override {
+        return index_.size();
+    }
+
+    // Drops every entry and deletes the segment files
+    void clear() override;
+
+    // Bytes in all segments, and the part of them superseded by later records
+    size_t logBytes() const {
+        return logBytes_;
+    }
+
+    size_t garbageBytes() const {
+        return garbage_;
+    }
+
+    size_t segmentCount() const {
+        return segments_.size();
+    }
+
+    using KeyStore::put;
+    using KeyStore::get;
+
+private:
+    struct Segment {
+        uint32_t number;   // Files are replayed in number order
+        int fd;
+        char* base;        // Mapping of the whole file
+        size_t capacity;   // File and mapping size
+        size_t used;       // End of the last record
+        size_t synced;     // Prefix already made durable
+    };
+
+    struct Slot {
+        NodeId id;
+        uint32_t segment;  // Index into segments_
+        uint32_t offset;   // Record start within the segment
+        uint32_t keyLength;
+        uint32_t valueLength;
+    };
+
+    std::vector<Slot>::iterator lowerBound(NodeId id);
+    std::vector<Slot>::const_iterator lowerBound(NodeId id) const;
+    bool appendRecord(uint8_t type, NodeId id, NodeId end, ByteView key, ByteView value, Slot* slot);
+    bool addSegment(size_t minBytes);
+    bool mapSegment(uint32_t number, bool create, size_t capacity);
+    bool syncSegment(Segment& segment);
+    void recover();
+    size_t removeRange(NodeId start, NodeId end, KeyStore* dest);
+    void release(const Slot& slot);
+    void unmapSegment(Segment& segment, bool unlinkFile);
+    void compactIfNeeded();
+    std::string segmentPath(uint32_t number) const;
+
+    LogStoreOptions options_;
+    std::string dir_;
+    std::vector<Segment> segments_;
+    std::vector<Slot> index_;
+    uint32_t nextNumber_;      // File number of the next segment
+    uint64_t sequence_;        // Sequence number of the next record
+    size_t pendingRecords_;    // Appended since the last sync
+    size_t pendingBytes_;
+    size_t logBytes_;
+    size_t garbage_;
+    bool failed_;
+};
+
+#endif
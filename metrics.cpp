@@ -0,0 +1,258 @@
+#include "metrics.h"
+#include <cstdio>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <vector>
+
+thread_local Metrics::ThreadBlock* Metrics::local_ = nullptr;
+
+struct MetricName {
+    const char* name;   // Prometheus family and JSON key
+    const char* label;  // Value of the type label, or nullptr
+    const char* help;
+};
+
+static const MetricName kCounterNames[kCounterCount] = {
+    {"chord_messages_total", "find_successor", "Messages sent, by type"},
+    {"chord_messages_total", "notify", "Messages sent, by type"},
+    {"chord_messages_total", "update_finger", "Messages sent, by type"},
+    {"chord_messages_total", "transfer", "Messages sent, by type"},
+    {"chord_messages_total", "replicate", "Messages sent, by type"},
+    {"chord_messages_total", "store", "Messages sent, by type"},
+    {"chord_keys_migrated_total", nullptr, "Entries moved by join and leave"},
+    {"chord_bytes_migrated_total", nullptr, "Key and value bytes moved by join and leave"},
+    {"chord_fingers_checked_total", nullptr, "Fingers refreshed by fixFingers"},
+    {"chord_fingers_stale_total", nullptr, "Fingers fixFingers found pointing at the wrong node"},
+    {"chord_lookups_coalesced_total", "key", "Async lookups completed by a concurrent route, by what they shared"},
+    {"chord_lookups_coalesced_total", "range", "Async lookups completed by a concurrent route, by what they shared"},
+};
+
+static const MetricName kHistogramNames[kHistogramCount] = {
+    {"chord_lookup_hops", nullptr, "Nodes contacted per lookup"},
+    {"chord_lookup_nanos", nullptr, "Lookup latency, one call in 64 per thread"},
+    {"chord_insert_nanos", nullptr, "Insert latency, one call in 64 per thread"},
+    {"chord_remove_nanos", nullptr, "Remove latency, one call in 64 per thread"},
+    {"chord_join_nanos", nullptr, "Join latency, key migration included"},
+    {"chord_leave_nanos", nullptr, "Leave latency, key migration included"},
+    {"chord_stabilize_nanos", nullptr, "Stabilize latency, one call in 64 per thread"},
+    {"chord_fix_fingers_nanos", nullptr, "fixFingers latency, one call in 64 per thread"},
+};
+
+// Blocks of live threads, and the totals of threads that have exited. Never
+// destroyed, since threads may still exit during static destruction.
+struct MetricsRegistry {
+    std::mutex lock;
+    std::vector<Metrics::ThreadBlock*> blocks;
+    MetricsSnapshot retired;
+};
+
+static MetricsRegistry& registry() {
+    static MetricsRegistry* instance = new MetricsRegistry();
+    return *instance;
+}
+
+static void accumulate(const Metrics::ThreadBlock& block, MetricsSnapshot& total) {
+    for (size_t i = 0; i < kCounterCount; i++) {
+        total.counters[i] += block.counters[i].load(std::memory_order_relaxed);
+    }
+    for (size_t h = 0; h < kHistogramCount; h++) {
+        HistogramSnapshot& out = total.histograms[h];
+        out.count += block.histograms[h].count.load(std::memory_order_relaxed);
+        out.sum += block.histograms[h].sum.load(std::memory_order_relaxed);
+        for (size_t b = 0; b < kHistogramBuckets; b++) {
+            out.buckets[b] += block.histograms[h].buckets[b].load(std::memory_order_relaxed);
+        }
+    }
+}
+
+// Unregisters the thread's block on thread exit and keeps its totals
+struct ThreadBlockOwner {
+    std::unique_ptr<Metrics::ThreadBlock> block;
+
+    ~ThreadBlockOwner() {
+        MetricsRegistry& r = registry();
+        std::lock_guard<std::mutex> guard(r.lock);
+        accumulate(*block, r.retired);
+        for (size_t i = 0; i < r.blocks.size(); i++) {
+            if (r.blocks[i] == block.get()) {
+                r.blocks[i] = r.blocks.back();
+                r.blocks.pop_back();
+                break;
+            }
+        }
+    }
+};
+
+Metrics::ThreadBlock& Metrics::attach() {
+    static thread_local ThreadBlockOwner owner;
+    if (!owner.block) {
+        owner.block.reset(new ThreadBlock());
+        MetricsRegistry& r = registry();
+        std::lock_guard<std::mutex> guard(r.lock);
+        r.blocks.push_back(owner.block.get());
+    }
+    local_ = owner.block.get();
+    return *local_;
+}
+
+MetricsSnapshot Metrics::snapshot() {
+    MetricsRegistry& r = registry();
+    std::lock_guard<std::mutex> guard(r.lock);
+    MetricsSnapshot total = r.retired;
+    for (const ThreadBlock* block : r.blocks) {
+        accumulate(*block, total);
+    }
+    return total;
+}
+
+void Metrics::reset() {
+    MetricsRegistry& r = registry();
+    std::lock_guard<std::mutex> guard(r.lock);
+    r.retired = MetricsSnapshot();
+    for (ThreadBlock* block : r.blocks) {
+        for (auto& counter : block->counters) {
+            counter.store(0, std::memory_order_relaxed);
+        }
+        for (auto& histogram : block->histograms) {
+            histogram.count.store(0, std::memory_order_relaxed);
+            histogram.sum.store(0, std::memory_order_relaxed);
+            for (auto& bucket : histogram.buckets) {
+                bucket.store(0, std::memory_order_relaxed);
+            }
+        }
+    }
+}
+
+uint64_t Metrics::bucketBound(size_t b) {
+    if (b < 8) {
+        return b;
+    }
+    unsigned exponent = static_cast<unsigned>((b - 8) / 4 + 3);
+    uint64_t sub = (b - 8) % 4;
+    return exponent == 63 && sub == 3 ? ~0ULL : ((4 + sub + 1) << (exponent - 2)) - 1;
+}
+
+uint64_t HistogramSnapshot::percentile(double p) const {
+    if (count == 0) {
+        return 0;
+    }
+    uint64_t rank = static_cast<uint64_t>(p * (count - 1)) + 1;
+    uint64_t seen = 0;
+    for (size_t b = 0; b < kHistogramBuckets; b++) {
+        seen += buckets[b];
+        if (seen >= rank) {
+            return Metrics::bucketBound(b);
+        }
+    }
+    return Metrics::bucketBound(kHistogramBuckets - 1);
+}
+
+// Histograms measured in nanoseconds are exported in seconds
+static bool isNanos(const char* name) {
+    std::string s(name);
+    return s.size() > 6 && s.compare(s.size() - 6, 6, "_nanos") == 0;
+}
+
+static std::string exportName(const char* name) {
+    std::string s(name);
+    return isNanos(name) ? s.substr(0, s.size() - 6) + "_seconds" : s;
+}
+
+// Integers stay exact; nanoseconds are written as seconds
+static void writeValue(std::ostream& out, uint64_t value, bool seconds) {
+    if (seconds) {
+        char text[32];
+        std::snprintf(text, sizeof(text), "%.9g", value * 1e-9);
+        out << text;
+    } else {
+        out << value;
+    }
+}
+
+std::string Metrics::toPrometheus(const MetricsSnapshot& snapshot) {
+    std::ostringstream out;
+    const char* family = nullptr;
+    for (size_t i = 0; i < kCounterCount; i++) {
+        const MetricName& m = kCounterNames[i];
+        if (family == nullptr || std::string(family) != m.name) {
+            out << "# HELP " << m.name << " " << m.help << "\n# TYPE " << m.name << " counter\n";
+            family = m.name;
+        }
+        out << m.name;
+        if (m.label != nullptr) {
+            out << "{type=\"" << m.label << "\"}";
+        }
+        out << " " << snapshot.counters[i] << "\n";
+    }
+    for (size_t h = 0; h < kHistogramCount; h++) {
+        const MetricName& m = kHistogramNames[h];
+        const HistogramSnapshot& hist = snapshot.histograms[h];
+        std::string name = exportName(m.name);
+        bool seconds = isNanos(m.name);
+        out << "# HELP " << name << " " << m.help << "\n# TYPE " << name << " histogram\n";
+        // Buckets past the largest value add nothing but +Inf covers them
+        size_t last = 0;
+        for (size_t b = 0; b < kHistogramBuckets; b++) {
+            if (hist.buckets[b] != 0) {
+                last = b;
+            }
+        }
+        uint64_t cumulative = 0;
+        for (size_t b = 0; b <= last && b + 1 < kHistogramBuckets; b++) {
+            cumulative += hist.buckets[b];
+            out << name << "_bucket{le=\"";
+            writeValue(out, Metrics::bucketBound(b), seconds);
+            out << "\"} " << cumulative << "\n";
+        }
+        out << name << "_bucket{le=\"+Inf\"} " << hist.count << "\n";
+        out << name << "_sum ";
+        writeValue(out, hist.sum, seconds);
+        out << "\n";
+        out << name << "_count " << hist.count << "\n";
+    }
+    return out.str();
+}
+
+std::string Metrics::toJson(const MetricsSnapshot& snapshot) {
+    std::ostringstream out;
+    out << "{\"counters\": {";
+    for (size_t i = 0; i < kCounterCount; i++) {
+        const MetricName& m = kCounterNames[i];
+        out << (i > 0 ? ", " : "") << "\"" << m.name;
+        if (m.label != nullptr) {
+            out << ":" << m.label;
+        }
+        out << "\": " << snapshot.counters[i];
+    }
+    out << "}, \"histograms\": {";
+    for (size_t h = 0; h < kHistogramCount; h++) {
+        const HistogramSnapshot& hist = snapshot.histograms[h];
+        out << (h > 0 ? ", " : "") << "\"" << kHistogramNames[h].name << "\": {\"count\": " << hist.count
+            << ", \"sum\": " << hist.sum << ", \"p50\": " << hist.percentile(0.5)
+            << ", \"p99\": " << hist.percentile(0.99) << ", \"buckets\": [";
+        bool first = true;
+        for (size_t b = 0; b < kHistogramBuckets; b++) {
+            if (hist.buckets[b] != 0) {
+                out << (first ? "" : ", ") << "[" << Metrics::bucketBound(b) << ", " << hist.buckets[b] << "]";
+                first = false;
+            }
+        }
+        out << "]}";
+    }
+    out << "}}\n";
+    return out.str();
+}
+
+bool Metrics::writeFile(const std::string& path, bool json) {
+    MetricsSnapshot current = snapshot();
+    std::string text = json ? toJson(current) : toPrometheus(current);
+    std::string temp = path + ".tmp";
+    FILE* file = std::fopen(temp.c_str(), "wb");
+    if (file == nullptr) {
+        return false;
+    }
+    bool ok = std::fwrite(text.data(), 1, text.size(), file) == text.size();
+    ok = std::fclose(file) == 0 && ok;
+    return ok && std::rename(temp.c_str(), path.c_str()) == 0;
+}
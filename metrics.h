@@ -0,0 +1,209 @@
+#ifndef METRICS_H
+#define METRICS_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <atomic>
+#include <chrono>
+#include <string>
+
+// Runtime metrics are compiled in unless the build sets CHORD_METRICS=0
+// (cmake -DCHORD_METRICS=OFF), which turns every recording macro below into
+// nothing
+#ifndef CHORD_METRICS
+#define CHORD_METRICS 1
+#endif
+
+// Monotonic counters
+enum class Counter : uint8_t {
+    FindSuccessorMessages,  // Routing requests, forwards and replies of findSuccessor/findPredecessor
+    NotifyMessages,         // Predecessor queries, notify and predecessor handoffs
+    UpdateFingerMessages,   // Finger updates sent by joining and leaving nodes
+    TransferMessages,       // Migration batches and range drops
+    ReplicateMessages,      // Replica writes, syncs and drops
+    StoreMessages,          // Writes and removals at a remote owner; batches send one per owner run, plus its reply
+    KeysMigrated,           // Entries moved by join and leave
+    BytesMigrated,          // Key and value bytes of those entries
+    FingersChecked,         // Fingers refreshed by fixFingers
+    FingersStale,           // ... that had to change
+    CoalescedSameKey,       // Async lookups that waited for a concurrent route to their key
+    CoalescedSameRange,     // Async lookups cut short by a concurrent route that resolved their key's range
+    kCount
+};
+
+// Distributions, in log-linear buckets (see kHistogramBuckets)
+enum class Histogram : uint8_t {
+    LookupHops,
+    LookupNanos,
+    InsertNanos,
+    RemoveNanos,
+    JoinNanos,
+    LeaveNanos,
+    StabilizeNanos,
+    FixFingersNanos,
+    kCount
+};
+
+static const size_t kCounterCount = static_cast<size_t>(Counter::kCount);
+static const size_t kHistogramCount = static_cast<size_t>(Histogram::kCount);
+
+// Log-linear buckets: values below 8 get a bucket each, and every power of
+// two above that is split into four, so a bucket bound is within 25% of the
+// values it holds
+static const size_t kHistogramBuckets = 8 + 61 * 4;
+
+struct HistogramSnapshot {
+    uint64_t count = 0;
+    uint64_t sum = 0;
+    uint64_t buckets[kHistogramBuckets] = {};
+
+    double mean() const {
+        return count > 0 ? static_cast<double>(sum) / count : 0.0;
+    }
+
+    // Upper bound of the bucket holding the p-quantile, p in [0, 1]
+    uint64_t percentile(double p) const;
+};
+
+// Totals over every thread at one point in time
+struct MetricsSnapshot {
+    uint64_t counters[kCounterCount] = {};
+    HistogramSnapshot histograms[kHistogramCount];
+
+    uint64_t operator[](Counter counter) const {
+        return counters[static_cast<size_t>(counter)];
+    }
+
+    const HistogramSnapshot& operator[](Histogram histogram) const {
+        return histograms[static_cast<size_t>(histogram)];
+    }
+};
+
+// Process-wide metrics registry. Every thread records into its own block of
+// counters and histograms, which only it writes (relaxed atomic stores, no
+// read-modify-write and no shared cache lines), so recording costs a few
+// instructions on the hot path. snapshot() adds up the blocks of all live
+// threads and the totals left by threads that have exited.
+class Metrics {
+public:
+    struct ThreadBlock {
+        std::atomic<uint64_t> counters[kCounterCount];
+        struct {
+            std::atomic<uint64_t> count;
+            std::atomic<uint64_t> sum;
+            std::atomic<uint64_t> buckets[kHistogramBuckets];
+        } histograms[kHistogramCount];
+        uint64_t ticks;  // Sampled timers started by this thread
+    };
+
+    // Sampled timers measure one call in this many on each thread
+    static const uint64_t kSampleEvery = 64;
+
+    static void add(Counter counter, uint64_t n = 1) {
+        bump(local().counters[static_cast<size_t>(counter)], n);
+    }
+
+    static void record(Histogram histogram, uint64_t value) {
+        auto& h = local().histograms[static_cast<size_t>(histogram)];
+        bump(h.count, 1);
+        bump(h.sum, value);
+        bump(h.buckets[bucket(value)], 1);
+    }
+
+    static size_t bucket(uint64_t value) {
+        if (value < 8) {
+            return static_cast<size_t>(value);
+        }
+        unsigned exponent = 63 - __builtin_clzll(value);
+        return 8 + (exponent - 3) * 4 + ((value >> (exponent - 2)) & 3);
+    }
+
+    // Whether the calling thread's next sampled timer should measure
+    static bool sampleTick() {
+        return local().ticks++ % kSampleEvery == 0;
+    }
+
+    // Largest value that falls into bucket b
+    static uint64_t bucketBound(size_t b);
+
+    static MetricsSnapshot snapshot();
+
+    // Zero every thread's block; counts recorded concurrently may be lost
+    static void reset();
+
+    // Prometheus text exposition format; *_nanos histograms are exported in seconds
+    static std::string toPrometheus(const MetricsSnapshot& snapshot);
+
+    static std::string toJson(const MetricsSnapshot& snapshot);
+
+    /**
+     * Write a snapshot to path, replacing the file in one rename.
+     * @param json: JSON instead of Prometheus text.
+     * @return false if the file could not be written.
+     */
+    static bool writeFile(const std::string& path, bool json = false);
+
+    // Whether this build records anything
+    static constexpr bool enabled() {
+        return CHORD_METRICS != 0;
+    }
+
+private:
+    static void bump(std::atomic<uint64_t>& value, uint64_t n) {
+        value.store(value.load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+    }
+
+    static ThreadBlock& local() {
+        ThreadBlock* block = local_;
+        return block != nullptr ? *block : attach();
+    }
+
+    static ThreadBlock& attach();
+
+    static thread_local ThreadBlock* local_;
+};
+
+// Records the time from construction to destruction into a histogram.
+// Reading the clock serializes the pipeline and costs more than a lookup's
+// cache misses would, so timers on hot operations are sampled: they measure
+// one call in Metrics::kSampleEvery per thread.
+class MetricTimer {
+public:
+    explicit MetricTimer(Histogram histogram, bool sampled = false)
+        : histogram_(histogram), active_(!sampled || Metrics::sampleTick()) {
+        if (active_) {
+            start_ = std::chrono::steady_clock::now();
+        }
+    }
+
+    ~MetricTimer() {
+        if (active_) {
+            auto elapsed = std::chrono::steady_clock::now() - start_;
+            Metrics::record(histogram_, std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count());
+        }
+    }
+
+    MetricTimer(const MetricTimer&) = delete;
+    MetricTimer& operator=(const MetricTimer&) = delete;
+
+private:
+    Histogram histogram_;
+    bool active_;
+    std::chrono::steady_clock::time_point start_;
+};
+
+#if CHORD_METRICS
+#define CHORD_METRIC_ADD(counter, n) Metrics::add(counter, n)
+#define CHORD_METRIC_RECORD(histogram, value) Metrics::record(histogram, value)
+#define CHORD_METRIC_TIMER(name, histogram) MetricTimer name(histogram)
+#define CHORD_METRIC_SAMPLED_TIMER(name, histogram) MetricTimer name(histogram, true)
+#else
+// The arguments sit in unevaluated sizeof operands: nothing runs, but
+// variables passed only to these macros still count as used
+#define CHORD_METRIC_ADD(counter, n) ((void)sizeof(counter), (void)sizeof(n))
+#define CHORD_METRIC_RECORD(histogram, value) ((void)sizeof(histogram), (void)sizeof(value))
+#define CHORD_METRIC_TIMER(name, histogram) ((void)0)
+#define CHORD_METRIC_SAMPLED_TIMER(name, histogram) ((void)0)
+#endif
+
+#endif
@@ -0,0 +1,118 @@
+#include "metrics_server.h"
+#include "metrics.h"
+#include <arpa/inet.h>
+#include <cstring>
+#include <netinet/in.h>
+#include <poll.h>
+#include <string>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <unistd.h>
+
+#ifndef MSG_NOSIGNAL
+#define MSG_NOSIGNAL 0
+#endif
+
+MetricsServer::MetricsServer() : listen_(-1), port_(0), running_(false) {
+}
+
+MetricsServer::~MetricsServer() {
+    stop();
+}
+
+bool MetricsServer::start(uint16_t port) {
+    if (listen_ >= 0) {
+        return false;
+    }
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (fd < 0) {
+        return false;
+    }
+    int one = 1;
+    setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+    sockaddr_in addr;
+    std::memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    addr.sin_port = htons(port);
+    socklen_t len = sizeof(addr);
+    if (bind(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0 || ::listen(fd, 16) != 0 ||
+        getsockname(fd, reinterpret_cast<sockaddr*>(&addr), &len) != 0) {
+        close(fd);
+        return false;
+    }
+    listen_ = fd;
+    port_ = ntohs(addr.sin_port);
+    running_.store(true);
+    thread_ = std::thread(&MetricsServer::serve, this);
+    return true;
+}
+
+void MetricsServer::stop() {
+    if (listen_ < 0) {
+        return;
+    }
+    running_.store(false);
+    thread_.join();
+    close(listen_);
+    listen_ = -1;
+    port_ = 0;
+}
+
+// Poll with a short timeout so stop() is noticed without waking the thread
+void MetricsServer::serve() {
+    while (running_.load()) {
+        pollfd p;
+        p.fd = listen_;
+        p.events = POLLIN;
+        p.revents = 0;
+        if (poll(&p, 1, 100) <= 0) {
+            continue;
+        }
+        int fd = accept(listen_, nullptr, nullptr);
+        if (fd < 0) {
+            continue;
+        }
+        // A client that never finishes its request cannot hold the server
+        timeval timeout = {1, 0};
+        setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+        setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+        respond(fd);
+        close(fd);
+    }
+}
+
+void MetricsServer::respond(int fd) {
+    std::string request;
+    char buffer[1024];
+    while (request.find("\r\n\r\n") == std::string::npos && request.size() < 8192) {
+        ssize_t n = recv(fd, buffer, sizeof(buffer), 0);
+        if (n <= 0) {
+            return;
+        }
+        request.append(buffer, n);
+    }
+    std::string status = "200 OK";
+    std::string type = "text/plain; version=0.0.4";
+    std::string body;
+    if (request.compare(0, 18, "GET /metrics.json ") == 0) {
+        type = "application/json";
+        body = Metrics::toJson(Metrics::snapshot());
+    } else if (request.compare(0, 13, "GET /metrics ") == 0) {
+        body = Metrics::toPrometheus(Metrics::snapshot());
+    } else {
+        status = "404 Not Found";
+        type = "text/plain";
+        body = "not found\n";
+    }
+    std::string response = "HTTP/1.0 " + status + "\r\nContent-Type: " + type +
+                           "\r\nContent-Length: " + std::to_string(body.size()) + "\r\nConnection: close\r\n\r\n" + body;
+    size_t sent = 0;
+    while (sent < response.size()) {
+        ssize_t n = send(fd, response.data() + sent, response.size() - sent, MSG_NOSIGNAL);
+        if (n <= 0) {
+            return;
+        }
+        sent += n;
+    }
+}
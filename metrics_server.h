@@ -0,0 +1,44 @@
+#ifndef METRICS_SERVER_H
+#define METRICS_SERVER_H
+
+#include <stdint.h>
+#include <atomic>
+#include <thread>
+
+// Serves metrics snapshots over HTTP on 127.0.0.1 from a background thread:
+// GET /metrics answers in the Prometheus text format and GET /metrics.json
+// in JSON. Requests are handled one at a time, which suits a scraper. POSIX
+// only.
+class MetricsServer {
+public:
+    MetricsServer();
+    ~MetricsServer();
+
+    MetricsServer(const MetricsServer&) = delete;
+    MetricsServer& operator=(const MetricsServer&) = delete;
+
+    /**
+     * Bind 127.0.0.1:port and start serving.
+     * @param port: port in host byte order; 0 picks a free port.
+     * @return false if the port could not be bound or the server already runs.
+     */
+    bool start(uint16_t port);
+
+    // Stop serving and close the port; returns once the thread has exited
+    void stop();
+
+    uint16_t port() const {
+        return port_;
+    }
+
+private:
+    void serve();
+    void respond(int fd);
+
+    int listen_;
+    uint16_t port_;
+    std::atomic<bool> running_;
+    std::thread thread_;
+};
+
+#endif
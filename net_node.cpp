@@ -0,0 +1,699 @@
+#include "net_node.h"
+#include <algorithm>
+#include <chrono>
+
+ChordClient::~ChordClient() {
+    if (replies_) {
+        replies_->loop.stop();
+        replies_->server.join();
+    }
+}
+
+bool ChordClient::setRoutingMode(RoutingMode mode) {
+    if (mode == RoutingMode::Recursive && !replies_) {
+        std::unique_ptr<Replies> replies(new Replies());
+        if (!replies->loop.listen(kLoopback, 0)) {
+            return false;
+        }
+        replies->self.ip = kLoopback;
+        replies->self.port = replies->loop.port();
+        Replies* r = replies.get();
+        r->loop.setHandler([r](uint8_t type, WireReader& request, WireWriter&) {
+            uint32_t tag = request.u32();
+            NodeHandle owner = request.handle();
+            uint32_t hops = request.u32();
+            std::lock_guard<std::mutex> guard(r->lock);
+            if (type == MSG_ROUTE_REPLY && request.ok() && tag == r->waiting && !r->done) {
+                r->done = true;
+                r->owner = owner;
+                r->hops = hops;
+                r->arrived.notify_one();
+            }
+            return false;
+        });
+        r->server = std::thread([r]() { r->loop.run(); });
+        replies_ = std::move(replies);
+    }
+    mode_ = mode;
+    return true;
+}
+
+bool ChordClient::findSuccessor(const NodeHandle& start, NodeId id, NodeHandle* owner, uint32_t* hops) {
+    if (mode_ == RoutingMode::Recursive && findRecursive(start, id, owner, hops)) {
+        return true;
+    }
+    return findIterative(start, id, owner, hops);
+}
+
+// A request and its response, or the request alone if the peer failed
+bool ChordClient::exchange(const NodeHandle& to, uint8_t type, const WireWriter& request,
+                           std::vector<uint8_t>* response) {
+    bool ok = rpc_.call(to, type, request, response);
+    messages_ += ok ? 2 : 1;
+    return ok;
+}
+
+// Recursive routing: start forwards MSG_ROUTE towards the owner, and the
+// owner's predecessor sends the answer to our reply port
+bool ChordClient::findRecursive(const NodeHandle& start, NodeId id, NodeHandle* owner, uint32_t* hops) {
+    uint32_t tag = nextTag_++;
+    {
+        std::lock_guard<std::mutex> guard(replies_->lock);
+        replies_->waiting = tag;
+        replies_->done = false;
+    }
+    WireWriter request;
+    request.id(id);
+    request.u32(tag);
+    request.handle(replies_->self);
+    request.u32(0);
+    if (!rpc_.send(start, MSG_ROUTE, request)) {
+        return false;
+    }
+    std::unique_lock<std::mutex> guard(replies_->lock);
+    bool done = replies_->arrived.wait_for(guard, std::chrono::milliseconds(timeoutMs_),
+                                           [this]() { return replies_->done; });
+    replies_->waiting = 0;
+    if (!done) {
+        messages_ += 1;
+        return false;
+    }
+    // Every hop received one MSG_ROUTE, then one reply
+    messages_ += replies_->hops + 1;
+    *owner = replies_->owner;
+    if (hops) {
+        *hops = replies_->hops;
+    }
+    return owner->valid();
+}
+
+// Iterative routing: each hop answers with the owner or a closer node
+bool ChordClient::findIterative(const NodeHandle& start, NodeId id, NodeHandle* owner, uint32_t* hops) {
+    NodeHandle current = start;
+    NodeHandle previous;
+    std::vector<uint8_t> response;
+    for (uint32_t hop = 1; hop <= ChordRing::kMaxHops; hop++) {
+        WireWriter request;
+        request.id(id);
+        if (!exchange(current, MSG_FIND_SUCCESSOR, request, &response)) {
+            // A stale finger sent us to a node that is gone: step to the
+            // previous hop's successor instead, which is always closer
+            if (!previous.valid() || !exchange(previous, MSG_GET_SUCCESSOR, WireWriter(), &response)) {
+                return false;
+            }
+            WireReader reply(response.data(), response.size());
+            NodeHandle successor = reply.handle();
+            if (!reply.ok() || !successor.valid() || successor == current) {
+                return false;
+            }
+            current = successor;
+            continue;
+        }
+        WireReader reply(response.data(), response.size());
+        bool done = reply.u8() != 0;
+        NodeHandle next = reply.handle();
+        if (!reply.ok() || !next.valid()) {
+            return false;
+        }
+        if (done || next == current) {
+            *owner = next;
+            if (hops) {
+                *hops = hop;
+            }
+            return true;
+        }
+        previous = current;
+        current = next;
+    }
+    return false;
+}
+
+bool ChordClient::get(const NodeHandle& start, NodeId key, std::string* value, bool* found, uint32_t* hops) {
+    NodeHandle owner;
+    if (!findSuccessor(start, key, &owner, hops)) {
+        return false;
+    }
+    WireWriter request;
+    request.id(key);
+    std::vector<uint8_t> response;
+    if (!exchange(owner, MSG_GET, request, &response)) {
+        return false;
+    }
+    WireReader reply(response.data(), response.size());
+    *found = reply.u8() != 0;
+    ByteView v = reply.bytes();
+    value->assign(v.data, v.size);
+    return reply.ok();
+}
+
+bool ChordClient::put(const NodeHandle& start, NodeId key, ByteView value, uint32_t* hops) {
+    NodeHandle owner;
+    if (!findSuccessor(start, key, &owner, hops)) {
+        return false;
+    }
+    WireWriter request;
+    request.id(key);
+    request.bytes(ByteView());
+    request.bytes(value);
+    std::vector<uint8_t> response;
+    return exchange(owner, MSG_PUT, request, &response);
+}
+
+bool ChordClient::remove(const NodeHandle& start, NodeId key, bool* found, uint32_t* hops) {
+    NodeHandle owner;
+    if (!findSuccessor(start, key, &owner, hops)) {
+        return false;
+    }
+    WireWriter request;
+    request.id(key);
+    std::vector<uint8_t> response;
+    if (!exchange(owner, MSG_REMOVE, request, &response)) {
+        return false;
+    }
+    WireReader reply(response.data(), response.size());
+    *found = reply.u8() != 0;
+    return reply.ok();
+}
+
+bool ChordClient::stats(const NodeHandle& node, std::vector<uint64_t>* received, uint64_t* keys) {
+    std::vector<uint8_t> response;
+    if (!rpc_.call(node, MSG_STATS, WireWriter(), &response)) {
+        return false;
+    }
+    WireReader reply(response.data(), response.size());
+    *keys = reply.u64();
+    uint32_t count = reply.u32();
+    received->assign(count, 0);
+    for (uint32_t i = 0; i < count; i++) {
+        (*received)[i] = reply.u64();
+    }
+    return reply.ok();
+}
+
+NetNode::NetNode(NodeId id, uint16_t port, int maintenanceMs)
+    : maintenanceMs_(maintenanceMs),
+      client_(std::max(50, maintenanceMs * 5)),
+      forwarder_(std::max(50, maintenanceMs * 5)),
+      running_(false) {
+    self_.ip = kLoopback;
+    self_.port = port;
+    self_.id = id;
+    std::fill(received_, received_ + MSG_TYPE_COUNT, 0);
+}
+
+NetNode::~NetNode() {
+    stop();
+}
+
+NodeHandle NetNode::successor() const {
+    std::lock_guard<std::mutex> guard(lock_);
+    return fingers_[1];
+}
+
+NodeHandle NetNode::predecessor() const {
+    std::lock_guard<std::mutex> guard(lock_);
+    return predecessor_;
+}
+
+size_t NetNode::keyCount() const {
+    std::lock_guard<std::mutex> guard(lock_);
+    return store_.size();
+}
+
+bool NetNode::start(const NodeHandle* bootstrap) {
+    if (!loop_.listen(kLoopback, self_.port)) {
+        return false;
+    }
+    self_.port = loop_.port();
+    loop_.setHandler([this](uint8_t type, WireReader& request, WireWriter& reply) {
+        return handle(type, request, reply);
+    });
+
+    NodeHandle successor = self_;
+    if (bootstrap != nullptr) {
+        // Find our successor through the bootstrap node
+        if (!client_.findSuccessor(*bootstrap, self_.id, &successor)) {
+            return false;
+        }
+    }
+    {
+        std::lock_guard<std::mutex> guard(lock_);
+        fingers_.fill(successor);
+        predecessor_ = bootstrap == nullptr ? self_ : NodeHandle();
+    }
+
+    running_.store(true);
+    router_ = std::thread([this]() { routeLoop(); });
+    server_ = std::thread([this]() { loop_.run(); });
+
+    if (bootstrap != nullptr && successor != self_) {
+        // Copy the keys in (predecessor, self] that the successor was holding,
+        // one bounded batch per request; it keeps serving them meanwhile. It
+        // only stores (its predecessor, successor], so that is everything
+        // outside (self, successor]
+        NodeId start = successor.id;
+        bool done = false;
+        while (!done) {
+            WireWriter request;
+            request.id(start);
+            request.id(self_.id);
+            request.u32(kMigrationBatchEntries);
+            std::vector<uint8_t> response;
+            if (!client_.rpc().call(successor, MSG_TRANSFER_KEYS, request, &response)) {
+                break;
+            }
+            WireReader reply(response.data(), response.size());
+            done = reply.u8() != 0;
+            std::lock_guard<std::mutex> guard(lock_);
+            if (readEntries(reply, store_, &start) == 0 || !reply.ok()) {
+                break;
+            }
+        }
+        stabilize();
+
+        // Our notify handed the range over; the successor drops its copy. If
+        // the copy broke off, it keeps the keys and hands them back later
+        // through handOffForeignKeys
+        if (done) {
+            WireWriter release;
+            release.id(successor.id);
+            release.id(self_.id);
+            std::vector<uint8_t> response;
+            client_.rpc().call(successor, MSG_RELEASE_KEYS, release, &response);
+        }
+    }
+
+    maintenance_ = std::thread([this]() { maintenanceLoop(); });
+    return true;
+}
+
+void NetNode::leave() {
+    if (!running_.load()) {
+        return;
+    }
+    running_.store(false);
+    if (maintenance_.joinable()) {
+        maintenance_.join();
+    }
+
+    NodeHandle successor;
+    NodeHandle predecessor;
+    {
+        std::lock_guard<std::mutex> guard(lock_);
+        successor = fingers_[1];
+        predecessor = predecessor_;
+    }
+
+    std::vector<uint8_t> response;
+    if (successor.valid() && successor != self_) {
+        // Stream every key to the successor in ring order after our
+        // predecessor, one bounded batch per request, and keep serving them
+        // until the leave notices below hand the range over
+        NodeId start = predecessor.valid() ? predecessor.id : self_.id;
+        NodeId end = start;
+        RangeChunk chunk;
+        do {
+            SortedVectorStore batch;
+            {
+                std::lock_guard<std::mutex> guard(lock_);
+                chunk = store_.copyRange(start, end, batch, kMigrationBatchEntries, kMigrationBatchBytes);
+            }
+            if (chunk.entries == 0) {
+                break;
+            }
+            WireWriter keys;
+            writeEntries(keys, batch);
+            if (!client_.rpc().call(successor, MSG_STORE_KEYS, keys, &response)) {
+                break;
+            }
+            start = chunk.last;
+        } while (!chunk.done);
+
+        WireWriter notice;
+        notice.handle(self_);
+        notice.handle(predecessor);
+        notice.handle(successor);
+        client_.rpc().call(successor, MSG_LEAVE, notice, &response);
+        if (predecessor.valid() && predecessor != self_) {
+            client_.rpc().call(predecessor, MSG_LEAVE, notice, &response);
+        }
+    }
+    {
+        std::lock_guard<std::mutex> guard(lock_);
+        store_.clear();
+    }
+    stop();
+}
+
+void NetNode::stop() {
+    running_.store(false);
+    if (maintenance_.joinable()) {
+        maintenance_.join();
+    }
+    loop_.stop();
+    if (server_.joinable()) {
+        server_.join();
+    }
+    {
+        std::lock_guard<std::mutex> guard(forwardLock_);
+        forwards_.clear();
+        forwardReady_.notify_one();
+    }
+    if (router_.joinable()) {
+        router_.join();
+    }
+}
+
+// Runs on the server thread; answers from local state only
+bool NetNode::handle(uint8_t type, WireReader& request, WireWriter& reply) {
+    std::lock_guard<std::mutex> guard(lock_);
+    if (type < MSG_TYPE_COUNT) {
+        received_[type]++;
+    }
+
+    switch (type) {
+    case MSG_PING:
+        return true;
+
+    case MSG_FIND_SUCCESSOR: {
+        NodeId id = request.id();
+        const NodeHandle& successor = fingers_[1];
+        if (ChordRing::inRange(id, self_.id, successor.id)) {
+            reply.u8(1);
+            reply.handle(successor);
+            return true;
+        }
+        NodeHandle next = closestPrecedingFinger(id);
+        if (next == self_) {
+            reply.u8(1);
+            reply.handle(successor);
+        } else {
+            reply.u8(0);
+            reply.handle(next);
+        }
+        return true;
+    }
+
+    case MSG_ROUTE: {
+        // One hop of a recursive lookup: hand it to the router thread, which
+        // forwards it or answers the origin; nothing goes back to the sender
+        NodeId id = request.id();
+        uint32_t tag = request.u32();
+        NodeHandle origin = request.handle();
+        uint32_t hops = request.u32() + 1;
+        if (!request.ok() || !origin.valid() || hops > ChordRing::kMaxHops) {
+            return false;
+        }
+        const NodeHandle& successor = fingers_[1];
+        NodeHandle next = ChordRing::inRange(id, self_.id, successor.id) ? self_ : closestPrecedingFinger(id);
+        Forward forward;
+        if (next == self_) {
+            forward.to = origin;
+            forward.type = MSG_ROUTE_REPLY;
+            forward.message.u32(tag);
+            forward.message.handle(successor);
+            forward.message.u32(hops);
+        } else {
+            forward.to = next;
+            forward.type = MSG_ROUTE;
+            forward.message.id(id);
+            forward.message.u32(tag);
+            forward.message.handle(origin);
+            forward.message.u32(hops);
+        }
+        std::lock_guard<std::mutex> forwardGuard(forwardLock_);
+        forwards_.push_back(std::move(forward));
+        forwardReady_.notify_one();
+        return false;
+    }
+
+    case MSG_GET_SUCCESSOR:
+        reply.handle(fingers_[1]);
+        return true;
+
+    case MSG_GET_PREDECESSOR:
+        reply.handle(predecessor_);
+        return true;
+
+    case MSG_NOTIFY: {
+        NodeHandle n = request.handle();
+        if (request.ok() && n != self_ &&
+            (!predecessor_.valid() || predecessor_ == self_ || ChordRing::inRange(n.id, predecessor_.id, self_.id))) {
+            predecessor_ = n;
+        }
+        // The first node adopts whoever notifies it as successor too
+        if (request.ok() && fingers_[1] == self_ && n != self_) {
+            fingers_[1] = n;
+        }
+        return true;
+    }
+
+    case MSG_TRANSFER_KEYS: {
+        NodeId start = request.id();
+        NodeId end = request.id();
+        uint32_t limit = std::max(1u, std::min(request.u32(), kMigrationBatchEntries));
+        SortedVectorStore batch;
+        RangeChunk chunk;
+        if (request.ok()) {
+            chunk = store_.copyRange(start, end, batch, limit, kMigrationBatchBytes);
+        }
+        reply.u8(chunk.done ? 1 : 0);
+        writeEntries(reply, batch);
+        return true;
+    }
+
+    case MSG_RELEASE_KEYS: {
+        NodeId start = request.id();
+        NodeId end = request.id();
+        reply.u32(request.ok() ? static_cast<uint32_t>(store_.eraseRange(start, end)) : 0);
+        return true;
+    }
+
+    case MSG_STORE_KEYS: {
+        readEntries(request, store_, nullptr);
+        return true;
+    }
+
+    case MSG_GET: {
+        ByteView value;
+        bool found = store_.get(request.id(), &value);
+        reply.u8(found ? 1 : 0);
+        reply.bytes(value);
+        return true;
+    }
+
+    case MSG_PUT: {
+        NodeId id = request.id();
+        ByteView key = request.bytes();
+        ByteView value = request.bytes();
+        if (request.ok()) {
+            store_.put(id, key, value);
+        }
+        return true;
+    }
+
+    case MSG_REMOVE:
+        reply.u8(store_.erase(request.id()) ? 1 : 0);
+        return true;
+
+    case MSG_LEAVE: {
+        NodeHandle leaving = request.handle();
+        NodeHandle itsPredecessor = request.handle();
+        NodeHandle itsSuccessor = request.handle();
+        if (!request.ok()) {
+            return true;
+        }
+        if (predecessor_ == leaving) {
+            predecessor_ = itsPredecessor;
+        }
+        replaceFailed(leaving, itsSuccessor);
+        return true;
+    }
+
+    case MSG_STATS:
+        reply.u64(store_.size());
+        reply.u32(MSG_TYPE_COUNT);
+        for (uint64_t count : received_) {
+            reply.u64(count);
+        }
+        return true;
+
+    default:
+        return false;
+    }
+}
+
+// Caller holds lock_
+NodeHandle NetNode::closestPrecedingFinger(NodeId id) const {
+    for (int i = BITLENGTH; i >= 1; i--) {
+        const NodeHandle& finger = fingers_[i];
+        if (finger.valid() && finger != self_ && ChordRing::inOpenRange(finger.id, self_.id, id)) {
+            return finger;
+        }
+    }
+    return self_;
+}
+
+// Caller holds lock_. Point every finger that referenced failed elsewhere.
+void NetNode::replaceFailed(const NodeHandle& failed, const NodeHandle& replacement) {
+    NodeHandle target = replacement.valid() && replacement != failed ? replacement : self_;
+    for (int i = 1; i <= BITLENGTH; i++) {
+        if (fingers_[i] == failed) {
+            fingers_[i] = target;
+        }
+    }
+}
+
+// Send the recursive lookups the server thread routed. A next hop that
+// cannot be reached gets the lookup sent to our successor instead, which is
+// closer to the owner; a lookup nobody takes is dropped, and its client
+// retries iteratively.
+void NetNode::routeLoop() {
+    while (true) {
+        Forward forward;
+        {
+            std::unique_lock<std::mutex> guard(forwardLock_);
+            forwardReady_.wait(guard, [this]() { return !forwards_.empty() || !running_.load(); });
+            if (forwards_.empty()) {
+                return;
+            }
+            forward = std::move(forwards_.front());
+            forwards_.pop_front();
+        }
+        if (forwarder_.send(forward.to, forward.type, forward.message) || forward.type != MSG_ROUTE) {
+            continue;
+        }
+        NodeHandle successor = this->successor();
+        if (successor != forward.to && successor != self_) {
+            forwarder_.send(successor, MSG_ROUTE, forward.message);
+        }
+    }
+}
+
+void NetNode::maintenanceLoop() {
+    while (running_.load()) {
+        stabilize();
+        fixFingers();
+        checkPredecessor();
+        handOffForeignKeys();
+        std::this_thread::sleep_for(std::chrono::milliseconds(maintenanceMs_));
+    }
+}
+
+// Verify our successor and tell it about us
+void NetNode::stabilize() {
+    NodeHandle successor = this->successor();
+    if (successor == self_) {
+        // Alone, or the first node before anyone notified us
+        NodeHandle predecessor = this->predecessor();
+        if (predecessor.valid() && predecessor != self_) {
+            std::lock_guard<std::mutex> guard(lock_);
+            fingers_[1] = predecessor;
+        }
+        return;
+    }
+
+    std::vector<uint8_t> response;
+    if (!client_.rpc().call(successor, MSG_GET_PREDECESSOR, WireWriter(), &response)) {
+        // Successor is unreachable: fall back to the next distinct finger
+        std::lock_guard<std::mutex> guard(lock_);
+        NodeHandle replacement = self_;
+        for (int i = 2; i <= BITLENGTH; i++) {
+            if (fingers_[i] != successor && fingers_[i].valid()) {
+                replacement = fingers_[i];
+                break;
+            }
+        }
+        replaceFailed(successor, replacement);
+        return;
+    }
+
+    WireReader reply(response.data(), response.size());
+    NodeHandle x = reply.handle();
+    if (reply.ok() && x.valid() && x != self_ && ChordRing::inOpenRange(x.id, self_.id, successor.id)) {
+        std::lock_guard<std::mutex> guard(lock_);
+        fingers_[1] = x;
+        successor = x;
+    }
+
+    WireWriter notify;
+    notify.handle(self_);
+    client_.rpc().call(successor, MSG_NOTIFY, notify, &response);
+}
+
+// Refresh the whole finger table. A finger whose start still falls before
+// the previous finger's node reuses it, so only O(log N) starts need a lookup.
+void NetNode::fixFingers() {
+    std::array<NodeHandle, BITLENGTH + 1> fingers;
+    {
+        std::lock_guard<std::mutex> guard(lock_);
+        fingers = fingers_;
+    }
+    for (int i = 2; i <= BITLENGTH; i++) {
+        NodeId start = ChordRing::fingerStart(self_.id, i);
+        if (ChordRing::inRange(start, self_.id, fingers[i - 1].id)) {
+            fingers[i] = fingers[i - 1];
+            continue;
+        }
+        NodeHandle first;
+        {
+            std::lock_guard<std::mutex> guard(lock_);
+            first = closestPrecedingFinger(start);
+        }
+        NodeHandle owner;
+        if (first == self_) {
+            fingers[i] = fingers[1];
+        } else if (client_.findSuccessor(first, start, &owner)) {
+            fingers[i] = owner;
+        }
+    }
+    std::lock_guard<std::mutex> guard(lock_);
+    // The successor may have moved while we were routing; keep the newer one
+    fingers[1] = fingers_[1];
+    fingers_ = fingers;
+}
+
+// Forget a predecessor that stopped answering
+void NetNode::checkPredecessor() {
+    NodeHandle predecessor = this->predecessor();
+    if (!predecessor.valid() || predecessor == self_) {
+        return;
+    }
+    std::vector<uint8_t> response;
+    if (!client_.rpc().call(predecessor, MSG_PING, WireWriter(), &response)) {
+        std::lock_guard<std::mutex> guard(lock_);
+        if (predecessor_ == predecessor) {
+            predecessor_ = NodeHandle();
+        }
+    }
+}
+
+// Keys outside (predecessor, self] were written before a newer node joined
+// in front of us; push them back to the predecessor, which forwards them
+// further on its own rounds until they reach their owner
+void NetNode::handOffForeignKeys() {
+    NodeHandle predecessor;
+    SortedVectorStore foreign;
+    {
+        std::lock_guard<std::mutex> guard(lock_);
+        predecessor = predecessor_;
+        if (!predecessor.valid() || predecessor == self_ || store_.empty()) {
+            return;
+        }
+        store_.extractRange(self_.id, predecessor.id, foreign);
+    }
+    if (foreign.empty()) {
+        return;
+    }
+
+    WireWriter keys;
+    writeEntries(keys, foreign);
+    std::vector<uint8_t> response;
+    if (!client_.rpc().call(predecessor, MSG_STORE_KEYS, keys, &response)) {
+        // Keep them until the predecessor is reachable again
+        std::lock_guard<std::mutex> guard(lock_);
+        for (const KeyValue& kv : foreign) {
+            store_.put(kv);
+        }
+    }
+}
@@ -0,0 +1,164 @@
+#ifndef NET_NODE_H
+#define NET_NODE_H
+
+#include <stdint.h>
+#include <array>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include "key_store.h"
+#include "transport.h"
+#include "wire.h"
+
+// Client side of the Chord protocol over RPC. Lookups are iterative by
+// default: the caller asks each hop for the next closer node until one
+// reports the owner. Recursive lookups send one MSG_ROUTE that the nodes
+// forward among themselves; the owner's predecessor replies to the client
+// directly, on a port the client listens on for that.
+class ChordClient {
+public:
+    explicit ChordClient(int timeoutMs = 1000) : rpc_(timeoutMs), timeoutMs_(timeoutMs) {}
+    ~ChordClient();
+
+    /**
+     * Route the lookups of findSuccessor, get, put and remove iteratively
+     * or recursively. A recursive lookup whose reply does not arrive within
+     * the timeout, because a forward was lost on a dead node, is retried
+     * iteratively.
+     * @return false if the reply port could not be opened; the mode is unchanged.
+     */
+    bool setRoutingMode(RoutingMode mode);
+
+    RoutingMode routingMode() const {
+        return mode_;
+    }
+
+    /**
+     * @param start: node to begin routing at.
+     * @param id: ring position to resolve.
+     * @param owner: receives the node responsible for id.
+     * @param hops: optional, receives the number of routing RPCs the lookup took.
+     * @return false if a node on the path could not be reached.
+     */
+    bool findSuccessor(const NodeHandle& start, NodeId id, NodeHandle* owner, uint32_t* hops = nullptr);
+
+    bool get(const NodeHandle& start, NodeId key, std::string* value, bool* found, uint32_t* hops = nullptr);
+    bool put(const NodeHandle& start, NodeId key, ByteView value, uint32_t* hops = nullptr);
+    bool remove(const NodeHandle& start, NodeId key, bool* found, uint32_t* hops = nullptr);
+
+    // Per-type count of requests a node has served
+    bool stats(const NodeHandle& node, std::vector<uint64_t>* received, uint64_t* keys);
+
+    // Messages sent for this client's lookups, gets, puts and removes:
+    // requests, replies and the forwards between nodes
+    uint64_t messages() const {
+        return messages_;
+    }
+
+    RpcClient& rpc() {
+        return rpc_;
+    }
+
+private:
+    bool findIterative(const NodeHandle& start, NodeId id, NodeHandle* owner, uint32_t* hops);
+    bool findRecursive(const NodeHandle& start, NodeId id, NodeHandle* owner, uint32_t* hops);
+    bool exchange(const NodeHandle& to, uint8_t type, const WireWriter& request, std::vector<uint8_t>* response);
+
+    // Listener for the replies of recursive lookups
+    struct Replies {
+        EventLoop loop;
+        NodeHandle self;
+        std::thread server;
+        std::mutex lock;
+        std::condition_variable arrived;
+        uint32_t waiting = 0;  // Tag of the lookup in flight; guarded by lock, like the fields below
+        bool done = false;
+        NodeHandle owner;
+        uint32_t hops = 0;
+    };
+
+    RpcClient rpc_;
+    int timeoutMs_;
+    RoutingMode mode_ = RoutingMode::Iterative;
+    std::unique_ptr<Replies> replies_;
+    uint32_t nextTag_ = 1;
+    uint64_t messages_ = 0;
+};
+
+// A Chord node running in its own process. A server thread answers RPCs
+// from local state through an epoll EventLoop, and a maintenance thread
+// periodically runs stabilize, fixFingers and checkPredecessor with its own
+// RpcClient. A router thread sends on the recursive lookups the server
+// thread has routed. Other nodes are referenced only by NodeHandle.
+class NetNode {
+public:
+    /**
+     * @param id: position of the node on the ring.
+     * @param port: TCP port on 127.0.0.1; 0 picks a free one.
+     * @param maintenanceMs: period of the stabilization loop.
+     */
+    NetNode(NodeId id, uint16_t port, int maintenanceMs = 100);
+    ~NetNode();
+
+    // Create a ring when bootstrap is null, otherwise join through it
+    bool start(const NodeHandle* bootstrap);
+
+    // Hand keys to the successor, tell the neighbours, and stop serving
+    void leave();
+
+    // Stop without telling anyone, as if the process crashed
+    void stop();
+
+    NodeHandle self() const {
+        return self_;
+    }
+
+    NodeHandle successor() const;
+    NodeHandle predecessor() const;
+
+    size_t keyCount() const;
+
+private:
+    bool handle(uint8_t type, WireReader& request, WireWriter& reply);
+    void maintenanceLoop();
+    void stabilize();
+    void fixFingers();
+    void checkPredecessor();
+    void handOffForeignKeys();
+    NodeHandle closestPrecedingFinger(NodeId id) const;
+    void replaceFailed(const NodeHandle& failed, const NodeHandle& replacement);
+    void routeLoop();
+
+    // Recursive lookup message queued for the router thread
+    struct Forward {
+        NodeHandle to;
+        uint8_t type;  // MSG_ROUTE to the next hop or MSG_ROUTE_REPLY to the origin
+        WireWriter message;
+    };
+
+    NodeHandle self_;
+    int maintenanceMs_;
+
+    mutable std::mutex lock_;  // Guards everything below against the server thread
+    NodeHandle predecessor_;
+    std::array<NodeHandle, BITLENGTH + 1> fingers_;  // fingers_[1] is the successor
+    SortedVectorStore store_;
+    uint64_t received_[MSG_TYPE_COUNT];
+
+    EventLoop loop_;
+    ChordClient client_;  // Used only by the maintenance thread
+    RpcClient forwarder_;  // Used only by the router thread
+    std::mutex forwardLock_;  // Guards forwards_; taken after lock_ when both are held
+    std::condition_variable forwardReady_;
+    std::deque<Forward> forwards_;
+    std::thread server_;
+    std::thread maintenance_;
+    std::thread router_;
+    std::atomic<bool> running_;
+};
+
+#endif
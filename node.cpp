@@ -1,581 +1,1954 @@
-#include "node.h"
-#include <iostream>
-#include <cmath>
-#include <random>
-#include <algorithm>
-#include <numeric>
-
-// Constructor
-Node::Node(uint8_t id) 
-    : id_(id), 
-      fingerTable_(id), 
-      predecessor_(nullptr), 
-      next_finger_(1) {
-}
-
-// Print the finger table in a nice format
-void FingerTable::prettyPrint() {
-    std::cout << "----------Node id:" << static_cast<int>(nodeId_) << "----------" << std::endl;
-    std::cout << "Successor: " << static_cast<int>(getNodePtr(1)->getId()) << std::endl;
-    
-    std::cout << "FingerTables:" << std::endl;
-    for (size_t i = 1; i <= BITLENGTH; i++) {
-        uint8_t start = (nodeId_ + (1 << (i - 1))) % (1 << BITLENGTH);
-        uint8_t end = (nodeId_ + (1 << i)) % (1 << BITLENGTH);
-        std::cout << "| k = " << i << " [" << static_cast<int>(start) << " , " 
-                  << static_cast<int>(end) << ") \tsucc. = " 
-                  << static_cast<int>(getNodePtr(i)->getId()) << " |" << std::endl;
-    }
-    std::cout << "-----------------------------" << std::endl;
-}
-
-// Helper function to check if id is in the range (start, end]
-bool Node::inRange(uint8_t id, uint8_t start, uint8_t end) const {
-    if (start == end) {
-        return true;
-    } else if (start < end) {
-        return (id > start && id <= end);
-    } else { // start > end, wrapping around the circle
-        return (id > start || id <= end);
-    }
-}
-
-// Find the closest preceding finger node for id
-Node* Node::closestPrecedingFinger(uint8_t id) {
-    for (int i = BITLENGTH; i >= 1; i--) {
-        if (inRange(fingerTable_.getNodePtr(i)->getId(), id_, id)) {
-            return fingerTable_.getNodePtr(i);
-        }
-    }
-    return this;
-}
-
-// Find the predecessor node of id
-Node* Node::findPredecessor(uint8_t id) {
-    Node* n = this;
-    while (!inRange(id, n->id_, n->fingerTable_.getNodePtr(1)->getId())) {
-        n = n->closestPrecedingFinger(id);
-        
-        // Prevent infinite loop if the network is not properly formed
-        if (n == this) {
-            break;
-        }
-    }
-    return n;
-}
-
-// Find the successor node of id
-Node* Node::findSuccessor(uint8_t id) {
-    // If this is the only node in the network, it's responsible for all keys
-    if (fingerTable_.getNodePtr(1) == this) {
-        return this;
-    }
-    
-    // If id is in range (n, successor], then successor is responsible for id
-    if (inRange(id, id_, fingerTable_.getNodePtr(1)->getId())) {
-        return fingerTable_.getNodePtr(1);
-    }
-    
-    // Otherwise find the predecessor and return its successor
-    Node* predecessor = findPredecessor(id);
-    return predecessor->fingerTable_.getNodePtr(1);
-}
-
-// Notify method - called by a node thinking it might be our predecessor
-void Node::notify(Node* n) {
-    // If predecessor is null or n is in (predecessor, this)
-    if (predecessor_ == nullptr || inRange(n->getId(), predecessor_->getId(), id_)) {
-        predecessor_ = n;
-    }
-}
-
-// Stabilize the ring by verifying immediate successor and notifying it
-void Node::stabilize() {
-    Node* successor = fingerTable_.getNodePtr(1);
-    Node* x = successor->getPredecessor();
-    
-    if (x != nullptr && inRange(x->getId(), id_, successor->getId())) {
-        fingerTable_.set(1, x);
-        successor = x;
-    }
-    
-    successor->notify(this);
-}
-
-// Fix finger table entries
-void Node::fixFingers() {
-    next_finger_ = next_finger_ + 1;
-    if (next_finger_ > BITLENGTH) {
-        next_finger_ = 1;
-    }
-    
-    uint8_t start = (id_ + (1 << (next_finger_ - 1))) % (1 << BITLENGTH);
-    Node* nextSuccessor = findSuccessor(start);
-    
-    // Only update if different to avoid unnecessary network traffic
-    if (fingerTable_.getNodePtr(next_finger_) != nextSuccessor) {
-        fingerTable_.set(next_finger_, nextSuccessor);
-    }
-}
-
-// Check if this node is responsible for a key based on Chord's rules
-bool Node::isResponsibleForKey(uint8_t key) const {
-    // If we're the only node in the network
-    if (predecessor_ == this) {
-        return true;
-    }
-    
-    // Normal case: key is in (predecessor, this]
-    return inRange(key, predecessor_->getId(), id_);
-}
-
-// Transfer a key to another node
-void Node::transferKey(uint8_t key, Node* toNode) {
-    if (localKeys_.find(key) != localKeys_.end()) {
-        // Transfer the key and value
-        uint8_t value = localKeys_[key];
-        toNode->localKeys_[key] = value;
-        
-        // Log the transfer
-        std::cout << "Migrate key " << static_cast<int>(key)
-                  << " from node " << static_cast<int>(id_)
-                  << " to node " << static_cast<int>(toNode->getId()) << std::endl;
-        
-        // Remove from this node
-        localKeys_.erase(key);
-    }
-}
-
-// Implementation of the join function
-void Node::join(Node* node) {
-    if (node == nullptr) {
-        // This is the first node in the network
-        for (int i = 1; i <= BITLENGTH; i++) {
-            fingerTable_.set(i, this);
-        }
-        predecessor_ = this;
-        std::cout << "Node " << static_cast<int>(id_) << " is the first node to join the Chord network." << std::endl;
-    } else {
-        // Initialize finger table
-        fingerTable_.set(1, node->findSuccessor(id_));
-        
-        std::cout << "Node " << static_cast<int>(id_) << " joined with successor " 
-                  << static_cast<int>(fingerTable_.getNodePtr(1)->getId()) << std::endl;
-        
-        // Initialize finger table entries
-        for (int i = 1; i < BITLENGTH; i++) {
-            uint8_t start = (id_ + (1 << i)) % (1 << BITLENGTH);
-            
-            // Check if finger i+1 is in the same interval as finger i
-            if (inRange(start, id_, fingerTable_.getNodePtr(i)->getId())) {
-                fingerTable_.set(i + 1, fingerTable_.getNodePtr(i));
-            } else {
-                fingerTable_.set(i + 1, node->findSuccessor(start));
-            }
-        }
-        
-        // Update predecessor of successor
-        predecessor_ = fingerTable_.getNodePtr(1)->getPredecessor();
-        fingerTable_.getNodePtr(1)->setPredecessor(this);
-        
-        // Update other nodes' finger tables
-        updateOthers();
-        
-        // Move keys from successor
-        moveKeys(fingerTable_.getNodePtr(1));
-        
-        // Check all nodes for keys that belong to this node
-        checkAllNodesForKeys();
-        
-        // Print the finger table
-        fingerTable_.prettyPrint();
-    }
-}
-
-// Leave the Chord network
-void Node::leave() {
-    std::cout << "Node " << static_cast<int>(id_) << " is leaving the network." << std::endl;
-    
-    if (predecessor_ == this && fingerTable_.getNodePtr(1) == this) {
-        // This is the only node in the network
-        std::cout << "Node " << static_cast<int>(id_) << " was the only node in the network." << std::endl;
-        return;
-    }
-    
-    // Move keys to successor
-    Node* successor = fingerTable_.getNodePtr(1);
-    
-    for (const auto& pair : localKeys_) {
-        successor->localKeys_[pair.first] = pair.second;
-        std::cout << "Migrate key " << static_cast<int>(pair.first)
-                  << " from node " << static_cast<int>(id_)
-                  << " to node " << static_cast<int>(successor->getId()) << std::endl;
-    }
-    
-    // Clear local keys
-    localKeys_.clear();
-    
-    // Update predecessor of successor
-    successor->setPredecessor(predecessor_);
-    
-    // Update finger tables of other nodes
-    for (int i = 1; i <= BITLENGTH; i++) {
-        uint8_t p_id = (id_ - (1 << (i - 1)) + (1 << BITLENGTH)) % (1 << BITLENGTH);
-        Node* p = findPredecessor(p_id);
-        
-        if (p != this && p->fingerTable_.getNodePtr(i) == this) {
-            p->fingerTable_.set(i, successor);
-        }
-    }
-    
-    // Notify predecessor about the change
-    if (predecessor_ != this) {
-        predecessor_->fingerTable_.set(1, successor);
-        predecessor_->fixFingers();
-    }
-    
-    std::cout << "Node " << static_cast<int>(id_) << " has left the network." << std::endl;
-    
-    // Print updated finger tables of affected nodes
-    if (predecessor_ != this) {
-        std::cout << "Updated finger table of predecessor:" << std::endl;
-        // Display correct predecessor
-        std::cout << "Node id:" << static_cast<int>(predecessor_->getId()) 
-                  << " Predecessor: " << static_cast<int>(predecessor_->getPredecessor()->getId()) << std::endl;
-        predecessor_->fingerTable_.prettyPrint();
-    }
-    
-    std::cout << "Updated finger table of successor:" << std::endl;
-    // Display correct predecessor
-    std::cout << "Node id:" << static_cast<int>(successor->getId()) 
-              << " Predecessor: " << static_cast<int>(successor->getPredecessor()->getId()) << std::endl;
-    successor->fingerTable_.prettyPrint();
-}
-
-// Check all nodes in the network for keys that should belong to this node
-void Node::checkAllNodesForKeys() {
-    if (predecessor_ == nullptr) return;
-    
-    // Start from our successor and go around the ring
-    Node* current = fingerTable_.getNodePtr(1);
-    std::set<Node*> visited;
-    visited.insert(this); // Don't check ourselves
-    
-    while (current != this && visited.find(current) == visited.end()) {
-        visited.insert(current);
-        
-        // Check if any keys in this node should belong to us
-        std::vector<uint8_t> keysToMove;
-        
-        for (const auto& pair : current->localKeys_) {
-            uint8_t key = pair.first;
-            if (isResponsibleForKey(key)) {
-                keysToMove.push_back(key);
-            }
-        }
-        
-        // Move the identified keys
-        for (uint8_t key : keysToMove) {
-            current->transferKey(key, this);
-        }
-        
-        // Move to the next node
-        current = current->fingerTable_.getNodePtr(1);
-    }
-}
-
-// Update all nodes that should have this node in their finger tables
-void Node::updateOthers() {
-    for (int i = 1; i <= BITLENGTH; i++) {
-        // Find the last node p whose i-th finger might be this node
-        uint8_t p_id = (id_ - (1 << (i - 1)) + (1 << BITLENGTH)) % (1 << BITLENGTH);
-        Node* p = findPredecessor(p_id);
-        
-        // Skip if p is this node
-        if (p != this) {
-            // Update p's finger table with this node
-            p->updateFingerTable(this, i);
-        }
-    }
-}
-
-// Update finger table with s at position i
-void Node::updateFingerTable(Node* s, int i) {
-    // Check if s should be the i-th finger
-    if (fingerTable_.getNodePtr(i) == nullptr || 
-        inRange(s->getId(), id_, fingerTable_.getNodePtr(i)->getId())) {
-        
-        fingerTable_.set(i, s);
-        
-        // Propagate to predecessor if needed
-        if (predecessor_ != nullptr && predecessor_ != this && predecessor_ != s) {
-            predecessor_->updateFingerTable(s, i);
-        }
-    }
-}
-
-// Move keys from successor to this node
-void Node::moveKeys(Node* successor) {
-    // Find keys that should be moved to this node
-    std::vector<uint8_t> keysToMove;
-    
-    for (const auto& pair : successor->localKeys_) {
-        uint8_t key = pair.first;
-        // Check if this node is responsible for the key
-        if (isResponsibleForKey(key)) {
-            keysToMove.push_back(key);
-        }
-    }
-    
-    // Move the keys
-    for (uint8_t key : keysToMove) {
-        successor->transferKey(key, this);
-    }
-}
-
-// Find the value associated with key (API compatible version)
-uint8_t Node::find(uint8_t key) {
-    std::cout << "Look-up result of key " << static_cast<int>(key) 
-              << " from node " << static_cast<int>(id_) << " with path [";
-    
-    // Local search first
-    if (localKeys_.find(key) != localKeys_.end()) {
-        std::cout << static_cast<int>(id_) << "] value is ";
-        uint8_t value = localKeys_[key];
-        if (value == NONE_VALUE) {
-            std::cout << "None" << std::endl;
-            return NONE_VALUE;
-        } else {
-            std::cout << static_cast<int>(value) << std::endl;
-            return value;
-        }
-    }
-    
-    // Forward search through the Chord ring
-    std::vector<uint8_t> path;
-    path.push_back(id_);
-    
-    Node* current = this;
-    Node* responsibleNode = nullptr;
-    
-    while (true) {
-        Node* next = current->closestPrecedingFinger(key);
-        
-        // If we can't make progress, find the successor
-        if (next == current) {
-            responsibleNode = current->fingerTable_.getNodePtr(1);
-            path.push_back(responsibleNode->getId());
-            break;
-        }
-        
-        // If we've found the predecessor, get its successor
-        if (inRange(key, next->getId(), next->fingerTable_.getNodePtr(1)->getId())) {
-            responsibleNode = next->fingerTable_.getNodePtr(1);
-            path.push_back(next->getId());
-            path.push_back(responsibleNode->getId());
-            break;
-        }
-        
-        // Continue with the next node
-        current = next;
-        path.push_back(current->getId());
-        
-        // Check for loop
-        if (path.size() > (1 << BITLENGTH)) {
-            std::cout << "Loop detected in lookup!" << std::endl;
-            break;
-        }
-    }
-    
-    // Print the path
-    for (size_t i = 0; i < path.size(); i++) {
-        std::cout << static_cast<int>(path[i]);
-        if (i < path.size() - 1) {
-            std::cout << ",";
-        }
-    }
-    
-    std::cout << "] value is ";
-    
-    // Check if the responsible node has the key
-    if (responsibleNode && responsibleNode->localKeys_.find(key) != responsibleNode->localKeys_.end()) {
-        uint8_t value = responsibleNode->localKeys_[key];
-        if (value == NONE_VALUE) {
-            std::cout << "None" << std::endl;
-            return NONE_VALUE;
-        } else {
-            std::cout << static_cast<int>(value) << std::endl;
-            return value;
-        }
-    } else {
-        std::cout << "None" << std::endl;
-        return NONE_VALUE;
-    }
-}
-
-// Insert a key-value pair (API compatible version)
-void Node::insert(uint8_t key, uint8_t value) {
-    // Find the node responsible for the key
-    Node* responsibleNode = findSuccessor(key);
-    
-    // Insert the key-value pair
-    responsibleNode->localKeys_[key] = value;
-    
-    std::cout << "Key " << static_cast<int>(key) << " with value ";
-    if (value == NONE_VALUE) {
-        std::cout << "None";
-    } else {
-        std::cout << static_cast<int>(value);
-    }
-    std::cout << " inserted at node " 
-              << static_cast<int>(responsibleNode->getId()) << std::endl;
-}
-
-// Overloaded insert method that uses None as the value
-void Node::insert(uint8_t key) {
-    // Call the main insert method with NONE_VALUE
-    insert(key, NONE_VALUE);
-}
-
-// Remove a key
-void Node::remove(uint8_t key) {
-    // Find the node responsible for the key
-    Node* responsibleNode = findSuccessor(key);
-    
-    // Remove the key if it exists
-    if (responsibleNode->localKeys_.find(key) != responsibleNode->localKeys_.end()) {
-        responsibleNode->localKeys_.erase(key);
-        std::cout << "Key " << static_cast<int>(key) << " removed from node " 
-                  << static_cast<int>(responsibleNode->getId()) << std::endl;
-    } else {
-        std::cout << "Key " << static_cast<int>(key) << " not found" << std::endl;
-    }
-}
-
-// Helper function to compute variance of key distribution
-double Node::computeVariance(const std::vector<int>& keyDistribution) {
-    double mean = std::accumulate(keyDistribution.begin(), keyDistribution.end(), 0.0) / keyDistribution.size();
-    double variance = 0.0;
-    
-    for (int count : keyDistribution) {
-        variance += std::pow(count - mean, 2);
-    }
-    
-    return variance / keyDistribution.size();
-}
-
-// Space Shuffle Optimization
-void Node::spaceShuffleOptimization() {
-    std::cout << "Performing Space Shuffle optimization for node " << static_cast<int>(id_) << std::endl;
-    
-    // 1. Gather information about key distribution
-    std::vector<Node*> allNodes;
-    std::map<Node*, int> keyDistribution;
-    
-    // Collect all nodes in the network
-    Node* current = this;
-    do {
-        allNodes.push_back(current);
-        current = current->fingerTable_.getNodePtr(1); // Move to successor
-    } while (current != this);
-    
-    // Count keys per node
-    for (Node* node : allNodes) {
-        keyDistribution[node] = node->localKeys_.size();
-    }
-    
-    // 2. Compute variance before optimization
-    std::vector<int> keyCountsBeforeOpt;
-    for (const auto& pair : keyDistribution) {
-        keyCountsBeforeOpt.push_back(pair.second);
-    }
-    
-    double varianceBefore = computeVariance(keyCountsBeforeOpt);
-    std::cout << "Variance before optimization: " << varianceBefore << std::endl;
-    
-    // 3. Identify heavily loaded and lightly loaded nodes
-    double mean = std::accumulate(keyCountsBeforeOpt.begin(), keyCountsBeforeOpt.end(), 0.0) / keyCountsBeforeOpt.size();
-    
-    std::vector<Node*> heavyNodes;
-    std::vector<Node*> lightNodes;
-    
-    for (const auto& pair : keyDistribution) {
-        if (pair.second > 1.2 * mean) {
-            heavyNodes.push_back(pair.first);
-        } else if (pair.second < 0.8 * mean) {
-            lightNodes.push_back(pair.first);
-        }
-    }
-    
-    // 4. Perform space shuffle
-    if (!heavyNodes.empty() && !lightNodes.empty()) {
-        std::random_device rd;
-        std::mt19937 g(rd());
-        
-        // Shuffle lists for randomness
-        std::shuffle(heavyNodes.begin(), heavyNodes.end(), g);
-        std::shuffle(lightNodes.begin(), lightNodes.end(), g);
-        
-        std::cout << "Starting Space Shuffle transfers:" << std::endl;
-        
-        // Transfer keys from heavy to light nodes
-        for (size_t i = 0; i < std::min(heavyNodes.size(), lightNodes.size()); i++) {
-            Node* heavyNode = heavyNodes[i];
-            Node* lightNode = lightNodes[i];
-            
-            int keysToTransfer = static_cast<int>((keyDistribution[heavyNode] - keyDistribution[lightNode]) / 2);
-            
-            if (keysToTransfer > 0) {
-                int transferred = 0;
-                
-                for (auto it = heavyNode->localKeys_.begin(); it != heavyNode->localKeys_.end() && transferred < keysToTransfer;) {
-                    // Transfer key
-                    lightNode->localKeys_[it->first] = it->second;
-                    
-                    std::cout << "Space Shuffle: Migrated key " << static_cast<int>(it->first) << " with value ";
-                    if (it->second == NONE_VALUE) {
-                        std::cout << "None";
-                    } else {
-                        std::cout << static_cast<int>(it->second);
-                    }
-                    std::cout << " from node " << static_cast<int>(heavyNode->getId())
-                              << " to node " << static_cast<int>(lightNode->getId()) << std::endl;
-                    
-                    // Erase from heavy node
-                    auto toErase = it;
-                    ++it;
-                    heavyNode->localKeys_.erase(toErase);
-                    
-                    transferred++;
-                }
-                
-                // Update key distribution
-                keyDistribution[heavyNode] -= transferred;
-                keyDistribution[lightNode] += transferred;
-            }
-        }
-    }
-    
-    // 5. Compute variance after optimization
-    std::vector<int> keyCountsAfterOpt;
-    for (const auto& pair : keyDistribution) {
-        keyCountsAfterOpt.push_back(pair.second);
-    }
-    
-    double varianceAfter = computeVariance(keyCountsAfterOpt);
-    std::cout << "Variance after optimization: " << varianceAfter << std::endl;
-    
-    double improvementPercent = ((varianceBefore - varianceAfter) / varianceBefore) * 100.0;
-    std::cout << "Improvement: " << improvementPercent << "%" << std::endl;
-}
-
-void Node::printPredecessorChain() {
-    std::cout << "Predecessor chain starting from Node " << static_cast<int>(id_) << ": ";
-    Node* current = this;
-    for (int i = 0; i < 10; i++) { // Limit to 10 hops to avoid infinite loops
-        std::cout << static_cast<int>(current->getId()) << " <- ";
-        current = current->getPredecessor();
-        if (current == this || current == nullptr) break;
-    }
-    std::cout << "..." << std::endl;
+#include "node.h"
+#include "parallel.h"
+#include <iostream>
+#include <cstring>
+#include <cmath>
+#include <random>
+#include <algorithm>
+#include <numeric>
+#include <chrono>
+#include <thread>
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#include <immintrin.h>
+#define CHORD_FINGER_SIMD 1
+#else
+#define CHORD_FINGER_SIMD 0
+#endif
+
+TraceSink* Node::traceSink_ = nullptr;
+std::atomic<uint64_t> Node::ringEpoch_(1);
+thread_local uint64_t Node::messages_ = 0;
+size_t Node::replicationFactor_ = 1;
+KeyHashFunction Node::keyHash_ = KeyHashFunction::Sha1;
+RoutingMode Node::routingMode_ = RoutingMode::Iterative;
+WriteAck Node::writeAck_ = WriteAck::All;
+
+// Constructor
+Node::Node(NodeId id, std::unique_ptr<KeyStore> store)
+    : id_(id), 
+      poolRef_(NodePool::claim(this)),
+      alive_(true),
+      predecessor_(nullptr), 
+      next_finger_(1),
+      fingerTable_(id), 
+      localKeys_(store ? std::move(store) : std::unique_ptr<KeyStore>(new SortedVectorStore())),
+      replication_(nullptr) {
+}
+
+Node::~Node() {
+    delete replication_.load(std::memory_order_acquire);
+}
+
+void* Node::operator new(size_t) {
+    void* slot = NodePool::allocate();
+    if (slot == nullptr) {
+        throw std::bad_alloc();
+    }
+    return slot;
+}
+
+void Node::operator delete(void* slot) {
+    NodePool::release(slot);
+}
+
+// Print the finger table in a nice format
+void FingerTable::prettyPrint(std::ostream& out) {
+    out << "----------Node id:" << ChordRing::toString(nodeId_) << "----------" << std::endl;
+    out << "Successor: " << ChordRing::toString(getNodePtr(1)->getId()) << std::endl;
+    
+    out << "FingerTables:" << std::endl;
+    for (size_t i = 1; i <= BITLENGTH; i++) {
+        NodeId start = ChordRing::fingerStart(nodeId_, i);
+        NodeId end = ChordRing::add(nodeId_, ChordRing::pow2(i));
+        out << "| k = " << i << " [" << ChordRing::toString(start) << " , " 
+                  << ChordRing::toString(end) << ") \tsucc. = " 
+                  << ChordRing::toString(getNodePtr(i)->getId()) << " |" << std::endl;
+    }
+    out << "-----------------------------" << std::endl;
+}
+
+enum class FingerKernel { Scalar, Sse2, Avx2 };
+
+static FingerKernel detectFingerKernel() {
+#if CHORD_FINGER_SIMD
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) {
+        return FingerKernel::Avx2;
+    }
+    return FingerKernel::Sse2;  // Part of x86-64
+#else
+    return FingerKernel::Scalar;
+#endif
+}
+
+static const FingerKernel kFingerKernel = detectFingerKernel();
+static std::atomic<bool> vectorSearch(true);
+
+static FingerKernel fingerKernel() {
+    return vectorSearch.load(std::memory_order_relaxed) ? kFingerKernel : FingerKernel::Scalar;
+}
+
+const char* FingerTable::searchKernel() {
+    switch (fingerKernel()) {
+    case FingerKernel::Avx2:
+        return "avx2";
+    case FingerKernel::Sse2:
+        return "sse2";
+    default:
+        return "scalar";
+    }
+}
+
+void FingerTable::setVectorSearch(bool enabled) {
+    vectorSearch.store(enabled, std::memory_order_relaxed);
+}
+
+// Search kernels over the groups of a finger table, from the farthest group
+// down, stopping at the first group that holds a live candidate.
+struct FingerSearch {
+    /**
+     * Fingers of a group whose hints are <= the key's, from the highest lane
+     * down, until one is in range and alive. Testing each lane with its own
+     * branch, rather than finding the highest bit, lets the CPU predict the
+     * lane and start loading the finger before the hints arrive.
+     * @param hits: lanes whose hint is <= the key's.
+     * @param ties: lanes whose hint equals the key's, whose full id decides.
+     */
+    static Node* firstLive(const FingerTable& table, const FingerTable::Group& group, const NodeId& limit,
+                           unsigned hits, unsigned ties) {
+        for (size_t lane = FingerTable::kGroupSize; lane-- > 0;) {
+            if (hits & (1u << lane)) {
+                Node* finger = group.nodes[lane].load(std::memory_order_acquire);
+                if (finger == nullptr || !finger->isAlive()) {
+                    continue;
+                }
+                if (!ChordRing::kHigh32Exact && (ties & (1u << lane)) && !(table.offsetOf(finger) <= limit)) {
+                    continue;
+                }
+                return finger;
+            }
+        }
+        return nullptr;
+    }
+
+    // Hint of one lane; the vector kernels gather a group's hints into
+    // registers this way instead of loading the atomics as one vector
+    static int32_t hint(const FingerTable::Group& group, size_t lane) {
+        return static_cast<int32_t>(group.hints[lane].load(std::memory_order_relaxed));
+    }
+
+    static Node* scalar(const FingerTable& table, const NodeId& limit) {
+        uint32_t bound = ChordRing::high32(limit);
+        for (size_t g = FingerTable::kGroups; g-- > 0;) {
+            const FingerTable::Group& group = table.groups_[g];
+            unsigned hits = 0, ties = 0;
+            for (size_t lane = 0; lane < FingerTable::kGroupSize; lane++) {
+                uint32_t hint = group.hints[lane].load(std::memory_order_relaxed);
+                hits |= static_cast<unsigned>(hint <= bound) << lane;
+                ties |= static_cast<unsigned>(hint == bound) << lane;
+            }
+            Node* finger = firstLive(table, group, limit, hits, ties);
+            if (finger != nullptr) {
+                return finger;
+            }
+        }
+        return nullptr;
+    }
+
+#if CHORD_FINGER_SIMD
+    // Unsigned compares are signed compares after flipping the top bit
+    __attribute__((target("avx2")))
+    static Node* avx2(const FingerTable& table, const NodeId& limit) {
+        const __m256i bias = _mm256_set1_epi32(INT32_MIN);
+        const __m256i key = _mm256_set1_epi32(static_cast<int32_t>(ChordRing::high32(limit)));
+        const __m256i bound = _mm256_xor_si256(key, bias);
+        for (size_t g = FingerTable::kGroups; g-- > 0;) {
+            const FingerTable::Group& group = table.groups_[g];
+            __m256i hints = _mm256_setr_epi32(hint(group, 0), hint(group, 1), hint(group, 2), hint(group, 3),
+                                              hint(group, 4), hint(group, 5), hint(group, 6), hint(group, 7));
+            __m256i above = _mm256_cmpgt_epi32(_mm256_xor_si256(hints, bias), bound);
+            unsigned hits = ~static_cast<unsigned>(_mm256_movemask_ps(_mm256_castsi256_ps(above))) & 0xFF;
+            if (hits == 0) {
+                continue;
+            }
+            unsigned ties = static_cast<unsigned>(_mm256_movemask_ps(_mm256_castsi256_ps(_mm256_cmpeq_epi32(hints, key))));
+            Node* finger = firstLive(table, group, limit, hits, ties);
+            if (finger != nullptr) {
+                return finger;
+            }
+        }
+        return nullptr;
+    }
+
+    static Node* sse2(const FingerTable& table, const NodeId& limit) {
+        const __m128i bias = _mm_set1_epi32(INT32_MIN);
+        const __m128i key = _mm_set1_epi32(static_cast<int32_t>(ChordRing::high32(limit)));
+        const __m128i bound = _mm_xor_si128(key, bias);
+        for (size_t g = FingerTable::kGroups; g-- > 0;) {
+            const FingerTable::Group& group = table.groups_[g];
+            __m128i low = _mm_setr_epi32(hint(group, 0), hint(group, 1), hint(group, 2), hint(group, 3));
+            __m128i high = _mm_setr_epi32(hint(group, 4), hint(group, 5), hint(group, 6), hint(group, 7));
+            unsigned above =
+                static_cast<unsigned>(_mm_movemask_ps(_mm_castsi128_ps(_mm_cmpgt_epi32(_mm_xor_si128(low, bias), bound)))) |
+                static_cast<unsigned>(_mm_movemask_ps(_mm_castsi128_ps(_mm_cmpgt_epi32(_mm_xor_si128(high, bias), bound)))) << 4;
+            unsigned hits = ~above & 0xFF;
+            if (hits == 0) {
+                continue;
+            }
+            unsigned ties = static_cast<unsigned>(_mm_movemask_ps(_mm_castsi128_ps(_mm_cmpeq_epi32(low, key)))) |
+                            static_cast<unsigned>(_mm_movemask_ps(_mm_castsi128_ps(_mm_cmpeq_epi32(high, key)))) << 4;
+            Node* finger = firstLive(table, group, limit, hits, ties);
+            if (finger != nullptr) {
+                return finger;
+            }
+        }
+        return nullptr;
+    }
+#endif
+};
+
+Node* FingerTable::closestPreceding(NodeId key) const {
+    // Fingers at this node and empty entries share the offset kNoOffset; a
+    // key equal to nodeId would reach it, so the limit stops one short
+    NodeId limit = ChordRing::sub(ChordRing::sub(key, nodeId_), NodeId(1));
+    if (limit == kNoOffset) {
+        limit = ChordRing::sub(kNoOffset, NodeId(1));
+    }
+    switch (fingerKernel()) {
+#if CHORD_FINGER_SIMD
+    case FingerKernel::Avx2:
+        return FingerSearch::avx2(*this, limit);
+    case FingerKernel::Sse2:
+        return FingerSearch::sse2(*this, limit);
+#endif
+    default:
+        return FingerSearch::scalar(*this, limit);
+    }
+}
+
+// Find the closest preceding finger node for id. The scan runs as an
+// optimistic seqlock read and repeats if a writer changed the table meanwhile.
+// Failed fingers are skipped; if none is usable the successor list is tried.
+Node* Node::closestPrecedingFinger(NodeId id) {
+    while (true) {
+        uint32_t seq = fingerTable_.readBegin();
+        Node* closest = fingerTable_.closestPreceding(id);
+        if (!fingerTable_.readRetry(seq)) {
+            if (closest != nullptr) {
+                return closest;
+            }
+            for (size_t i = successors_.size(); i-- > 0;) {
+                Node* entry = successors_.get(i);
+                if (entry != this && inRange(entry->getId(), id_, id) && entry->isAlive()) {
+                    return entry;
+                }
+            }
+            return this;
+        }
+    }
+}
+
+// First live node after this one: the successor finger, or the next live
+// entry of the successor list when it has failed
+Node* Node::successor() const {
+    Node* first = fingerTable_.getNodePtr(1);
+    if (first == nullptr || first->isAlive()) {
+        return first;
+    }
+    for (size_t i = 0; i < successors_.size(); i++) {
+        Node* entry = successors_.get(i);
+        if (entry != nullptr && entry->isAlive()) {
+            return entry;
+        }
+    }
+    return first;
+}
+
+// Find the predecessor node of id
+Node* Node::findPredecessor(NodeId id) {
+    Route route = this->route(id, false, nullptr);
+    countMessage(Counter::FindSuccessorMessages, routeMessages(route.asked));
+    return route.predecessor;
+}
+
+// Find the successor node of id
+Node* Node::findSuccessor(NodeId id) {
+    Node* successor = this->successor();
+    
+    // If this is the only node in the network, it's responsible for all keys;
+    // a node is always responsible for its own id
+    if (successor == this || id == id_) {
+        return this;
+    }
+    
+    // If id is in range (n, successor], then successor is responsible for id
+    if (inRange(id, id_, successor->getId())) {
+        return successor;
+    }
+    
+    // Otherwise route to the predecessor, which names its successor
+    Route route = this->route(id, false, nullptr);
+    countMessage(Counter::FindSuccessorMessages, routeMessages(route.asked));
+    return route.owner != nullptr ? route.owner : route.predecessor->successor();
+}
+
+// Walk from this node towards the owner of key, the routing shared by
+// lookups, findSuccessor and findPredecessor. The walk is the same in every
+// RoutingMode; callers price it with routeMessages.
+Node::Route Node::route(NodeId key, bool viaReplicas, SmallVector<NodeId, 8>* path) {
+    Route route;
+    route.predecessor = this;
+
+    // A node owns its own id; no finger precedes it, so routing would
+    // circle the ring
+    if (key == id_) {
+        Node* predecessor = getPredecessor();
+        bool known = predecessor != nullptr && predecessor != this && predecessor->isAlive();
+        route.owner = this;
+        route.predecessor = known ? predecessor : this;
+        route.rangeStart = known ? predecessor->getId() : ChordRing::sub(key, NodeId(1));
+        return route;
+    }
+
+    // A key up to our own successor needs no finger
+    Node* first = successor();
+    if (first != this && inRange(key, id_, first->getId())) {
+        route.owner = first;
+        route.rangeStart = id_;
+        route.hops = 1;
+        if (path) {
+            path->push_back(first->getId());
+        }
+        return route;
+    }
+    
+    Node* current = this;
+    bool landedOnKey = false;
+    while (true) {
+        Node* next = current->closestPrecedingFinger(key);
+        
+        // With replication, a successor list that reaches the key names the
+        // owner and its replicas directly, skipping the hop to the owner's
+        // predecessor. The list can only reach the key when the closest
+        // preceding finger is on it.
+        if (viaReplicas && (next == current || current->successors_.holds(next))) {
+            route.replica = current->nearestReplica(key, this, &route.owner, &route.rangeStart);
+            if (route.replica != nullptr) {
+                route.predecessor = current;
+                route.hops += 1;
+                if (path) {
+                    path->push_back(route.replica->getId());
+                }
+                return route;
+            }
+        }
+        
+        // If we can't make progress, our successor is responsible
+        if (next == current) {
+            route.predecessor = current;
+            route.owner = current->successor();
+            route.rangeStart = current->getId();
+            route.hops += 1;
+            if (path) {
+                path->push_back(route.owner->getId());
+            }
+            return route;
+        }
+        
+        // Stale fingers can send the walk back to where it started, before
+        // the ring is formed
+        if (next == this) {
+            route.predecessor = this;
+            route.looped = true;
+            return route;
+        }
+        
+        // If next is the predecessor, its successor is responsible
+        route.asked += 1;
+        Node* nextSuccessor = next->successor();
+        if (inRange(key, next->getId(), nextSuccessor->getId())) {
+            route.predecessor = next;
+            route.owner = nextSuccessor;
+            route.rangeStart = next->getId();
+            route.hops += 2;
+            if (path) {
+                path->push_back(next->getId());
+                path->push_back(nextSuccessor->getId());
+            }
+            return route;
+        }
+        
+        // Continue with the next node
+        current = next;
+        route.predecessor = current;
+        route.hops += 1;
+        if (path) {
+            path->push_back(current->getId());
+        }
+        
+        // Fingers are matched on (n, key], so a key equal to a node id can
+        // carry the route to that node before its predecessor. The node owns
+        // the key; its live predecessor is the key's predecessor. Otherwise
+        // the walk goes on, and landing on the node a second time means the
+        // route would circle forever.
+        if (current->getId() == key) {
+            Node* predecessor = current->getPredecessor();
+            if (landedOnKey || (predecessor != nullptr && predecessor->isAlive())) {
+                route.owner = current;
+                route.rangeStart = landedOnKey ? ChordRing::sub(key, NodeId(1)) : predecessor->getId();
+                if (!landedOnKey) {
+                    route.predecessor = predecessor;
+                }
+                return route;
+            }
+            landedOnKey = true;
+        }
+        
+        // Check for loop
+        if (route.hops >= ChordRing::kMaxHops) {
+            route.looped = true;
+            return route;
+        }
+    }
+}
+
+// Notify method - called by a node thinking it might be our predecessor
+void Node::notify(Node* n) {
+    // If predecessor is null, failed, or n is in (predecessor, this); retry
+    // if a concurrent notify replaced the predecessor first
+    Node* current = predecessor_.load(std::memory_order_acquire);
+    while (current == nullptr || !current->isAlive() || inRange(n->getId(), current->getId(), id_)) {
+        if (predecessor_.compare_exchange_weak(current, n, std::memory_order_acq_rel)) {
+            if (current != n) {
+                advanceRingEpoch();
+            }
+            break;
+        }
+    }
+}
+
+// Stabilize the ring by verifying immediate successor and notifying it
+void Node::stabilize() {
+    CHORD_METRIC_SAMPLED_TIMER(timer, Histogram::StabilizeNanos);
+    Node* successor = this->successor();
+    if (!successor->isAlive()) {
+        return;  // Every known successor failed; nothing to talk to
+    }
+    if (successor != fingerTable_.getNodePtr(1)) {
+        // The successor failed: promote the next live entry of the list
+        fingerTable_.set(1, successor);
+        advanceRingEpoch();
+    }
+    
+    Node* x = successor->getPredecessor();
+    countMessage(Counter::NotifyMessages);
+    
+    if (x != nullptr && x->isAlive() && inRange(x->getId(), id_, successor->getId())) {
+        fingerTable_.set(1, x);
+        if (x != successor) {
+            advanceRingEpoch();
+        }
+        successor = x;
+    }
+    
+    // The notify reply carries the successor's list
+    successor->notify(this);
+    countMessage(Counter::NotifyMessages);
+    refreshSuccessorList(successor);
+    
+    repairReplicas();
+}
+
+// Our successor followed by its list, minus failed nodes, cut off at r
+// entries or where the ring wraps back to us
+void Node::refreshSuccessorList(Node* successor) {
+    Node* entries[SuccessorList::kCapacity];
+    successors_.assign(entries, successorListVia(successor, entries));
+}
+
+// The list refreshSuccessorList would install, written to entries; returns its length
+size_t Node::successorListVia(Node* successor, Node** entries) const {
+    size_t length = successors_.length();
+    size_t count = 0;
+    entries[count++] = successor;
+    
+    const SuccessorList& next = successor->successors_;
+    size_t available = next.size();
+    for (size_t i = 0; successor != this && count < length && i < available; i++) {
+        Node* entry = next.get(i);
+        if (entry == this) {
+            break;
+        }
+        if (entry->isAlive()) {
+            entries[count++] = entry;
+        }
+    }
+    return count;
+}
+
+// Simulate a crash
+void Node::fail() {
+    alive_.store(false, std::memory_order_release);
+    advanceRingEpoch();
+}
+
+// Fix finger table entries
+void Node::fixFingers() {
+    CHORD_METRIC_SAMPLED_TIMER(timer, Histogram::FixFingersNanos);
+    next_finger_ = next_finger_ + 1;
+    if (next_finger_ > BITLENGTH) {
+        next_finger_ = 1;
+    }
+    
+    NodeId start = ChordRing::fingerStart(id_, next_finger_);
+    Node* nextSuccessor = findSuccessor(start);
+    
+    // Only update if different to avoid unnecessary network traffic
+    CHORD_METRIC_ADD(Counter::FingersChecked, 1);
+    if (fingerTable_.getNodePtr(next_finger_) != nextSuccessor) {
+        fingerTable_.set(next_finger_, nextSuccessor);
+        CHORD_METRIC_ADD(Counter::FingersStale, 1);
+    }
+}
+
+// Parallel maintenance: every round reads the tables as the previous round
+// left them and buffers its updates, so no node sees a half-finished round
+StabilizeResult Node::stabilizeRing(const std::vector<Node*>& nodes, size_t threads, size_t maxRounds) {
+    typedef std::chrono::steady_clock Clock;
+    StabilizeResult result;
+    if (nodes.empty()) {
+        return result;
+    }
+    if (threads == 0) {
+        threads = std::max(1u, std::thread::hardware_concurrency());
+    }
+    size_t n = nodes.size();
+    
+    // Sorted by id, so a notify finds its target's slot by binary search
+    std::vector<Node*> sorted(nodes);
+    parallelSort(sorted, threads, [](Node* a, Node* b) { return a->id_ < b->id_; });
+    std::vector<NodeId> ids(n);
+    for (size_t i = 0; i < n; i++) {
+        ids[i] = sorted[i]->id_;
+    }
+    
+    // A node's new tables, kept only when they differ from the current ones
+    struct Update {
+        Node* node;
+        bool fingersChanged;
+        bool listChanged;
+        size_t count;
+        Node* fingers[BITLENGTH + 1];
+        Node* list[SuccessorList::kCapacity];
+    };
+    size_t chunks = std::max<size_t>(1, std::min(threads, n));
+    size_t chunk = (n + chunks - 1) / chunks;
+    std::vector<std::vector<Update> > updates(chunks);
+    // Closest node that notified each node this round, as its slot + 1; 0 if none
+    std::unique_ptr<std::atomic<uint32_t>[]> notified(new std::atomic<uint32_t>[n]);
+    std::atomic<uint64_t> sent(0);
+    
+    while (result.roundSeconds.size() < maxRounds) {
+        auto start = Clock::now();
+        for (size_t i = 0; i < n; i++) {
+            notified[i].store(0, std::memory_order_relaxed);
+        }
+        
+        // Compute: read only, every write goes to this chunk's buffer or to notified
+        parallelFor(n, threads, [&](size_t begin, size_t end) {
+            uint64_t before = messages_;
+            std::vector<Update>& buffer = updates[begin / chunk];
+            buffer.clear();
+            Update update;
+            for (size_t i = begin; i < end; i++) {
+                Node* node = sorted[i];
+                if (!node->isAlive()) {
+                    continue;
+                }
+                Node* successor = node->successor();
+                if (!successor->isAlive()) {
+                    continue;  // Every known successor failed; nothing to talk to
+                }
+                Node* x = successor->getPredecessor();
+                if (x != nullptr && x->isAlive() && inRange(x->id_, node->id_, successor->id_)) {
+                    successor = x;
+                }
+                countMessage(Counter::NotifyMessages, 2);
+                
+                size_t target = std::lower_bound(ids.begin(), ids.end(), successor->id_) - ids.begin();
+                uint32_t closest = notified[target].load(std::memory_order_relaxed);
+                while (closest == 0 || inRange(node->id_, ids[closest - 1], successor->id_)) {
+                    if (notified[target].compare_exchange_weak(closest, static_cast<uint32_t>(i + 1),
+                                                               std::memory_order_relaxed)) {
+                        break;
+                    }
+                }
+                
+                update.node = node;
+                update.count = node->successorListVia(successor, update.list);
+                const SuccessorList& current = node->successors_;
+                update.listChanged = update.count != current.size();
+                for (size_t s = 0; !update.listChanged && s < update.count; s++) {
+                    update.listChanged = update.list[s] != current.get(s);
+                }
+                
+                // A finger whose start falls before the previous finger reuses it
+                update.fingers[1] = successor;
+                update.fingersChanged = successor != node->fingerTable_.getNodePtr(1);
+                for (int k = 2; k <= BITLENGTH; k++) {
+                    NodeId fingerStart = ChordRing::fingerStart(node->id_, k);
+                    Node* previous = update.fingers[k - 1];
+                    update.fingers[k] = previous == node || inRange(fingerStart, node->id_, previous->id_)
+                                            ? previous
+                                            : node->findSuccessor(fingerStart);
+                    update.fingersChanged |= update.fingers[k] != node->fingerTable_.getNodePtr(k);
+                }
+                CHORD_METRIC_ADD(Counter::FingersChecked, BITLENGTH);
+                if (update.fingersChanged || update.listChanged) {
+                    buffer.push_back(update);
+                }
+            }
+            sent.fetch_add(messages_ - before, std::memory_order_relaxed);
+            messages_ = before;
+        });
+        
+        // Commit: each chunk writes its own nodes and the notifies aimed at them
+        std::atomic<uint64_t> changes(0);
+        std::atomic<bool> successorsChanged(false);
+        parallelFor(n, threads, [&](size_t begin, size_t end) {
+            uint64_t changed = 0;
+            bool successorChanged = false;
+            for (const Update& update : updates[begin / chunk]) {
+                Node* node = update.node;
+                if (update.fingersChanged) {
+                    successorChanged |= update.fingers[1] != node->fingerTable_.getNodePtr(1);
+                    node->fingerTable_.assign(update.fingers);
+                    CHORD_METRIC_ADD(Counter::FingersStale, 1);
+                    changed++;
+                }
+                if (update.listChanged) {
+                    node->successors_.assign(update.list, update.count);
+                    changed++;
+                }
+            }
+            for (size_t i = begin; i < end; i++) {
+                uint32_t closest = notified[i].load(std::memory_order_relaxed);
+                if (closest != 0) {
+                    Node* before = sorted[i]->getPredecessor();
+                    sorted[i]->notify(sorted[closest - 1]);
+                    changed += sorted[i]->getPredecessor() != before;
+                }
+            }
+            changes.fetch_add(changed, std::memory_order_relaxed);
+            if (successorChanged) {
+                successorsChanged.store(true, std::memory_order_relaxed);
+            }
+        });
+        if (successorsChanged.load()) {
+            advanceRingEpoch();
+        }
+        if (replicationFactor_ > 1) {
+            parallelFor(n, threads, [&](size_t begin, size_t end) {
+                for (size_t i = begin; i < end; i++) {
+                    if (sorted[i]->isAlive()) {
+                        sorted[i]->repairReplicas();
+                    }
+                }
+            });
+        }
+        result.roundSeconds.push_back(std::chrono::duration<double>(Clock::now() - start).count());
+        
+        if (changes.load() == 0) {
+            result.converged = true;
+            break;
+        }
+        result.rounds++;
+        result.changes += changes.load();
+    }
+    messages_ += sent.load();
+    return result;
+}
+
+// Implementation of the join function
+void Node::join(Node* node) {
+    CHORD_METRIC_TIMER(timer, Histogram::JoinNanos);
+    alive_.store(true, std::memory_order_release);
+    
+    if (node == nullptr) {
+        // This is the first node in the network
+        for (int i = 1; i <= BITLENGTH; i++) {
+            fingerTable_.set(i, this);
+        }
+        refreshSuccessorList(this);
+        predecessor_ = this;
+        advanceRingEpoch();
+        if (traceSink_) {
+            traceSink_->onJoin(*this, nullptr);
+        }
+    } else {
+        // Initialize finger table
+        countMessage(Counter::FindSuccessorMessages);
+        fingerTable_.set(1, node->findSuccessor(id_));
+        refreshSuccessorList(fingerTable_.getNodePtr(1));
+        
+        if (traceSink_) {
+            traceSink_->onJoin(*this, node);
+        }
+        
+        // Initialize finger table entries
+        for (int i = 1; i < BITLENGTH; i++) {
+            NodeId start = ChordRing::fingerStart(id_, i + 1);
+            
+            // Check if finger i+1 is in the same interval as finger i
+            if (inRange(start, id_, fingerTable_.getNodePtr(i)->getId())) {
+                fingerTable_.set(i + 1, fingerTable_.getNodePtr(i));
+            } else {
+                countMessage(Counter::FindSuccessorMessages);
+                fingerTable_.set(i + 1, node->findSuccessor(start));
+            }
+        }
+        
+        // Copy (predecessor, this] from the successor, which keeps serving
+        // the range until every finger that should point here does
+        Node* successor = fingerTable_.getNodePtr(1);
+        Node* predecessor = successor->getPredecessor();
+        countMessage(Counter::NotifyMessages);
+        predecessor_ = predecessor;
+        if (predecessor != nullptr) {
+            // A node restarted on a persistent store keeps what it had in
+            // its new range; the successor's newer copies overwrite it
+            if (!localKeys_->empty()) {
+                localKeys_->eraseRange(id_, predecessor->getId());
+            }
+            pullRange(successor, predecessor->getId(), id_);
+        }
+        
+        successor->setPredecessor(this);
+        countMessage(Counter::NotifyMessages);
+        
+        // Update other nodes' finger tables
+        updateOthers();
+        
+        // Routes now end here; the successor drops its copy of the range
+        if (predecessor != nullptr) {
+            successor->localKeys_->eraseRange(predecessor->getId(), id_);
+            countMessage(Counter::TransferMessages);
+        }
+        advanceRingEpoch();
+        
+        if (traceSink_) {
+            traceSink_->onJoinComplete(*this);
+        }
+    }
+}
+
+// Bulk bootstrap: sort once, then wire and fill every node independently
+void Node::buildRing(std::vector<Node*>& nodes, const std::vector<std::pair<NodeId, std::string> >& entries,
+                     size_t threads) {
+    if (nodes.empty()) {
+        return;
+    }
+    if (threads == 0) {
+        threads = std::max(1u, std::thread::hardware_concurrency());
+    }
+    size_t n = nodes.size();
+    parallelSort(nodes, threads, [](Node* a, Node* b) { return a->id_ < b->id_; });
+    
+    // Keys sorted by ring id; the input position breaks ties so the last
+    // write of a repeated key lands last
+    typedef std::pair<NodeId, uint32_t> SortedKey;
+    std::vector<SortedKey> keys(entries.size());
+    parallelFor(entries.size(), threads, [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; i++) {
+            keys[i] = SortedKey(entries[i].first, static_cast<uint32_t>(i));
+        }
+    });
+    parallelSort(keys, threads, std::less<SortedKey>());
+    
+    // Ids copied out so the searches stay in contiguous memory
+    std::vector<NodeId> ids(n);
+    parallelFor(n, threads, [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; i++) {
+            ids[i] = nodes[i]->id_;
+        }
+    });
+    
+    // First node at or after id
+    auto ownerIndex = [&](NodeId id) {
+        size_t index = std::lower_bound(ids.begin(), ids.end(), id) - ids.begin();
+        return index == n ? 0 : index;
+    };
+    // First key past each node id; node i owns keys [ends[i - 1], ends[i])
+    // and node 0 also owns the run past the last node
+    auto keyEnd = [&](size_t i) {
+        return static_cast<size_t>(std::upper_bound(keys.begin(), keys.end(), ids[i],
+                                                    [](NodeId id, const SortedKey& k) { return id < k.first; }) -
+                                   keys.begin());
+    };
+    auto store = [&](Node* node, size_t begin, size_t end) {
+        for (size_t k = begin; k < end; k++) {
+            node->localKeys_->put(keys[k].first, ByteView(entries[keys[k].second].second));
+        }
+    };
+    
+    parallelFor(n, threads, [&](size_t begin, size_t end) {
+        Node* fingers[BITLENGTH + 1];
+        Node* list[SuccessorList::kCapacity];
+        for (size_t i = begin; i < end; i++) {
+            Node* node = nodes[i];
+            node->alive_.store(true, std::memory_order_release);
+            node->predecessor_.store(nodes[(i + n - 1) % n], std::memory_order_release);
+            
+            // A finger whose start falls before the previous finger reuses it
+            size_t finger = (i + 1) % n;
+            fingers[1] = nodes[finger];
+            for (int k = 2; k <= BITLENGTH; k++) {
+                NodeId start = ChordRing::fingerStart(ids[i], k);
+                if (finger != i && !inRange(start, ids[i], ids[finger])) {
+                    finger = ownerIndex(start);
+                }
+                fingers[k] = nodes[finger];
+            }
+            node->fingerTable_.assign(fingers);
+            
+            size_t count = n == 1 ? 1 : std::min(node->successors_.length(), n - 1);
+            for (size_t s = 0; s < count; s++) {
+                list[s] = nodes[(i + 1 + s) % n];
+            }
+            node->successors_.assign(list, count);
+            
+            size_t keyBegin = i == 0 ? 0 : keyEnd(i - 1);
+            store(node, keyBegin, keyEnd(i));
+            if (i == 0) {
+                store(node, keyEnd(n - 1), keys.size());
+            }
+        }
+    });
+    advanceRingEpoch();
+}
+
+// Leave the Chord network
+void Node::leave() {
+    CHORD_METRIC_TIMER(timer, Histogram::LeaveNanos);
+    if (traceSink_) {
+        traceSink_->onLeave(*this);
+    }
+    
+    if (predecessor_ == this && fingerTable_.getNodePtr(1) == this) {
+        // This is the only node in the network
+        if (traceSink_) {
+            traceSink_->onLeaveComplete(*this, nullptr, nullptr);
+        }
+        return;
+    }
+    
+    // Stream every key to the successor, in ring order after our
+    // predecessor; we keep serving them until the handoff
+    Node* successor = fingerTable_.getNodePtr(1);
+    Node* predecessor = getPredecessor();
+    NodeId after = predecessor != nullptr ? predecessor->getId() : id_;
+    successor->pullRange(this, after, after);
+    
+    // Handoff: the successor takes over our range and we drop our copy
+    successor->setPredecessor(predecessor);
+    countMessage(Counter::NotifyMessages);
+    localKeys_->clear();
+    
+    // Update finger tables of other nodes
+    for (int i = 1; i <= BITLENGTH; i++) {
+        NodeId p_id = ChordRing::sub(id_, ChordRing::pow2(i - 1));
+        Node* p = findPredecessor(p_id);
+        
+        if (p != this && p->fingerTable_.getNodePtr(i) == this) {
+            p->fingerTable_.set(i, successor);
+            countMessage(Counter::UpdateFingerMessages);
+        }
+    }
+    
+    // Notify predecessor about the change; there is none to notify before
+    // the first stabilize or after it failed
+    if (predecessor != nullptr && predecessor != this) {
+        predecessor->fingerTable_.set(1, successor);
+        predecessor->fixFingers();
+        countMessage(Counter::UpdateFingerMessages);
+    }
+    
+    // Entries for us left in other nodes' successor lists are now skipped
+    alive_.store(false, std::memory_order_release);
+    advanceRingEpoch();
+    
+    if (traceSink_) {
+        traceSink_->onLeaveComplete(*this, predecessor != this ? predecessor : nullptr, successor);
+    }
+}
+
+// Update all nodes that should have this node in their finger tables
+void Node::updateOthers() {
+    for (int i = 1; i <= BITLENGTH; i++) {
+        // Find the last node p whose i-th finger might be this node
+        NodeId p_id = ChordRing::sub(id_, ChordRing::pow2(i - 1));
+        Node* p = findPredecessor(p_id);
+        
+        // Skip if p is this node
+        if (p != this) {
+            // Update p's finger table with this node
+            countMessage(Counter::UpdateFingerMessages);
+            p->updateFingerTable(this, i);
+        }
+    }
+}
+
+// Update finger table with s at position i, then walk back along the
+// predecessors while s should be their i-th finger too. Crashes can leave
+// the predecessor pointers in a cycle that never reaches s, so the walk is
+// bounded like routing.
+void Node::updateFingerTable(Node* s, int i) {
+    Node* n = this;
+    for (size_t hops = 0; hops < ChordRing::kMaxHops; hops++) {
+        // Check if s should be the i-th finger
+        Node* finger = n->fingerTable_.getNodePtr(i);
+        if (finger != nullptr && !inRange(s->getId(), n->id_, finger->getId())) {
+            return;
+        }
+        n->fingerTable_.set(i, s);
+        
+        // Propagate to predecessor if needed
+        Node* predecessor = n->getPredecessor();
+        if (predecessor == nullptr || predecessor == n || predecessor == s || !predecessor->isAlive()) {
+            return;
+        }
+        countMessage(Counter::UpdateFingerMessages);
+        n = predecessor;
+    }
+}
+
+// Copy the entries in (start, end] from another node, one bounded batch per
+// message. A batch is staged and applied here before the next one is
+// requested, so at most one batch is in flight and a slow receiver throttles
+// the sender. The source is left untouched; the caller drops its copy once
+// the range has been handed over.
+size_t Node::pullRange(Node* from, NodeId start, NodeId end) {
+    size_t copied = 0;
+    SortedVectorStore batch;
+    RangeChunk chunk;
+    do {
+        chunk = from->localKeys_->copyRange(start, end, batch, kMigrationBatchEntries, kMigrationBatchBytes);
+        countMessage(Counter::TransferMessages);
+        for (const KeyValue& kv : batch) {
+            localKeys_->put(kv);
+            CHORD_METRIC_ADD(Counter::BytesMigrated, kv.key.size + kv.second.size);
+            if (traceSink_) {
+                traceSink_->onMigrate(kv.first, *from, *this);
+            }
+        }
+        copied += chunk.entries;
+        CHORD_METRIC_ADD(Counter::KeysMigrated, chunk.entries);
+        batch.clear();
+        start = chunk.last;
+    } while (!chunk.done);
+    return copied;
+}
+
+void Node::setReplication(size_t factor, WriteAck ack) {
+    replicationFactor_ = std::max<size_t>(1, std::min(factor, SuccessorList::kCapacity + 1));
+    writeAck_ = ack;
+}
+
+// Whether (innerStart, innerEnd] lies within (start, end]; start == end is
+// the whole ring
+static bool rangeCovers(NodeId start, NodeId end, NodeId innerStart, NodeId innerEnd) {
+    if (start == end) {
+        return true;
+    }
+    if (innerStart == innerEnd) {
+        return false;
+    }
+    NodeId from = ChordRing::sub(innerStart, start);
+    NodeId to = ChordRing::sub(innerEnd, start);
+    return from < to && to <= ChordRing::sub(end, start);
+}
+
+// Replication state, created on first use
+Node::ReplicaState& Node::replication() {
+    ReplicaState* state = replication_.load(std::memory_order_acquire);
+    if (state != nullptr) {
+        return *state;
+    }
+    ReplicaState* created = new ReplicaState();
+    if (replication_.compare_exchange_strong(state, created, std::memory_order_acq_rel)) {
+        return *created;
+    }
+    delete created;  // Another thread won; state holds its block
+    return *state;
+}
+
+// Caller holds state.lock
+Node::Replica* Node::findReplica(ReplicaState& state, const Node* owner) {
+    for (Replica& replica : state.replicas) {
+        if (replica.owner == owner) {
+            return &replica;
+        }
+    }
+    return nullptr;
+}
+
+// Value of key in one of the copies held for predecessors
+bool Node::getCopy(NodeId key, ByteView* value, Node** owner) const {
+    ReplicaState* state = replication_.load(std::memory_order_acquire);
+    if (state == nullptr) {
+        return false;
+    }
+    std::lock_guard<std::mutex> guard(state->lock);
+    for (const Replica& replica : state->replicas) {
+        if (inRange(key, replica.start, replica.owner->getId()) && replica.keys->get(key, value)) {
+            *owner = replica.owner;
+            return true;
+        }
+    }
+    return false;
+}
+
+// Stored key and value of key, from the primary store or a replica
+bool Node::findEntry(NodeId key, KeyValue* entry) const {
+    if (localKeys_->lookup(key, entry)) {
+        return true;
+    }
+    ReplicaState* state = replication_.load(std::memory_order_acquire);
+    if (state == nullptr) {
+        return false;
+    }
+    std::lock_guard<std::mutex> guard(state->lock);
+    for (const Replica& replica : state->replicas) {
+        if (inRange(key, replica.start, replica.owner->getId()) && replica.keys->lookup(key, entry)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// Copy of key's value from the primary store or a replica
+bool Node::readCopy(NodeId key, std::string* value) const {
+    if (localKeys_->read(key, value)) {
+        return true;
+    }
+    ReplicaState* state = replication_.load(std::memory_order_acquire);
+    if (state == nullptr) {
+        return false;
+    }
+    std::lock_guard<std::mutex> guard(state->lock);
+    for (const Replica& replica : state->replicas) {
+        if (inRange(key, replica.start, replica.owner->getId()) && replica.keys->read(key, value)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// Reference to key's value from the primary store or a replica
+bool Node::readShared(NodeId key, ValueRef* value) const {
+    if (localKeys_->share(key, value)) {
+        return true;
+    }
+    ReplicaState* state = replication_.load(std::memory_order_acquire);
+    if (state == nullptr) {
+        return false;
+    }
+    std::lock_guard<std::mutex> guard(state->lock);
+    for (const Replica& replica : state->replicas) {
+        if (inRange(key, replica.start, replica.owner->getId()) && replica.keys->share(key, value)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// One batch of owner's range; reset starts a full copy of (start, owner]
+void Node::storeReplica(Node* owner, NodeId start, const KeyStore& entries, bool reset) {
+    ReplicaState& state = replication();
+    std::lock_guard<std::mutex> guard(state.lock);
+    Replica* replica = findReplica(state, owner);
+    if (replica == nullptr) {
+        state.replicas.push_back(Replica{owner, start, std::unique_ptr<KeyStore>(new SortedVectorStore())});
+        replica = &state.replicas.back();
+    }
+    if (reset) {
+        replica->keys->clear();
+        replica->start = start;
+    }
+    for (const KeyValue& kv : entries) {
+        replica->keys->put(kv);
+    }
+}
+
+// Apply one write to the copy of owner's range; a null value removes key
+void Node::updateReplica(Node* owner, NodeId start, NodeId key, const ValueRef* value) {
+    ReplicaState& state = replication();
+    std::lock_guard<std::mutex> guard(state.lock);
+    Replica* replica = findReplica(state, owner);
+    if (replica == nullptr) {
+        state.replicas.push_back(Replica{owner, start, std::unique_ptr<KeyStore>(new SortedVectorStore())});
+        replica = &state.replicas.back();
+    }
+    if (value != nullptr) {
+        replica->keys->putShared(key, ByteView(), value->get());
+    } else {
+        replica->keys->erase(key);
+    }
+}
+
+void Node::dropReplica(const Node* owner) {
+    ReplicaState* state = replication_.load(std::memory_order_acquire);
+    if (state == nullptr) {
+        return;
+    }
+    std::lock_guard<std::mutex> guard(state->lock);
+    for (size_t i = 0; i < state->replicas.size(); i++) {
+        if (state->replicas[i].owner == owner) {
+            state->replicas.erase(state->replicas.begin() + i);
+            return;
+        }
+    }
+}
+
+// Called on the owner after a write: copy the key's current value (or its
+// removal) to as many successors as the write acknowledgement requires now;
+// the other replicas get it at the next repair
+void Node::replicateWrite(NodeId key) {
+    size_t copies = replicationFactor_ - 1;
+    size_t now = writeAck_ == WriteAck::All ? copies : writeAck_ == WriteAck::Quorum ? replicationFactor_ / 2 : 0;
+    ValueRef value;
+    bool present = localKeys_->share(key, &value);
+    Node* predecessor = getPredecessor();
+    NodeId start = predecessor != nullptr ? predecessor->getId() : id_;
+    
+    size_t written = 0;
+    for (size_t i = 0; i < successors_.size() && written < now; i++) {
+        Node* target = successors_.get(i);
+        if (target == this || !target->isAlive()) {
+            continue;
+        }
+        target->updateReplica(this, start, key, present ? &value : nullptr);
+        countMessage(Counter::ReplicateMessages);
+        written++;
+    }
+    if (written < copies) {
+        ReplicaState& state = replication();
+        std::lock_guard<std::mutex> guard(state.lock);
+        state.pending.push_back(key);
+    }
+}
+
+// Run from stabilize. Takes over the copies of crashed owners whose range
+// now ends here, then brings the next R - 1 live successors up to date:
+// a successor that is new to the set, or every successor after our range
+// changed, gets the whole range in migration-sized batches; the others
+// only get the keys written since the last repair. Successors that dropped
+// out of the set discard their copy.
+void Node::repairReplicas() {
+    if (replicationFactor_ <= 1) {
+        return;
+    }
+    Node* predecessor = getPredecessor();
+    if (predecessor == nullptr || !predecessor->isAlive()) {
+        return;  // Our range is unknown until a live predecessor notifies us
+    }
+    NodeId start = predecessor == this ? id_ : predecessor->getId();
+    ReplicaState& state = replication();
+    
+    {
+        std::lock_guard<std::mutex> guard(state.lock);
+        for (size_t i = 0; i < state.replicas.size();) {
+            Replica& replica = state.replicas[i];
+            NodeId end = replica.owner->getId();
+            if (replica.owner->isAlive()) {
+                i++;
+                continue;
+            }
+            bool ours = rangeCovers(start, id_, replica.start, end);
+            if (ours) {
+                for (const KeyValue& kv : *replica.keys) {
+                    if (!localKeys_->contains(kv.first)) {
+                        localKeys_->put(kv);
+                    }
+                }
+            }
+            // Keep a copy the range's new owner has not replicated again yet
+            bool covered = ours;
+            for (const Replica& other : state.replicas) {
+                if (other.owner->isAlive() && rangeCovers(other.start, other.owner->getId(), replica.start, end)) {
+                    covered = true;
+                }
+            }
+            if (covered) {
+                state.replicas.erase(state.replicas.begin() + i);
+            } else {
+                i++;
+            }
+        }
+    }
+    
+    std::vector<Node*> targets;
+    for (size_t i = 0; i < successors_.size() && targets.size() < replicationFactor_ - 1; i++) {
+        Node* target = successors_.get(i);
+        if (target != this && target->isAlive()) {
+            targets.push_back(target);
+        }
+    }
+    std::vector<NodeId> pending;
+    {
+        std::lock_guard<std::mutex> guard(state.lock);
+        pending.swap(state.pending);
+    }
+    
+    bool rangeChanged = start != state.start;
+    SortedVectorStore batch;
+    for (Node* target : targets) {
+        bool known = std::find(state.targets.begin(), state.targets.end(), target) != state.targets.end();
+        if (!known || rangeChanged) {
+            NodeId from = start;
+            bool reset = true;
+            RangeChunk chunk;
+            do {
+                chunk = localKeys_->copyRange(from, id_, batch, kMigrationBatchEntries, kMigrationBatchBytes);
+                target->storeReplica(this, start, batch, reset);
+                countMessage(Counter::ReplicateMessages);
+                batch.clear();
+                reset = false;
+                from = chunk.last;
+            } while (!chunk.done);
+            continue;
+        }
+        ValueRef value;
+        for (size_t i = 0; i < pending.size(); i++) {
+            bool present = localKeys_->share(pending[i], &value);
+            target->updateReplica(this, start, pending[i], present ? &value : nullptr);
+            if (i % kMigrationBatchEntries == 0) {
+                countMessage(Counter::ReplicateMessages);
+            }
+        }
+    }
+    
+    for (Node* old : state.targets) {
+        if (old->isAlive() && std::find(targets.begin(), targets.end(), old) == targets.end()) {
+            old->dropReplica(this);
+            countMessage(Counter::ReplicateMessages);
+        }
+    }
+    state.targets.swap(targets);
+    state.start = start;
+}
+
+// When key falls within the span of this node's successor list, its owner
+// and the replicas after it are all known here and one hop away. Reads of
+// one key from different origins pick different live copies, spreading a
+// hot key over its R nodes. Returns nullptr when the list does not reach key.
+Node* Node::nearestReplica(NodeId key, const Node* origin, Node** owner, NodeId* rangeStart) const {
+    size_t count = successors_.size();
+    NodeId previous = id_;
+    for (size_t i = 0; i < count; i++) {
+        Node* entry = successors_.get(i);
+        if (entry == this) {
+            break;
+        }
+        if (inRange(key, previous, entry->getId())) {
+            Node* live[SuccessorList::kCapacity];
+            size_t copies = 0;
+            for (size_t j = i; j < count && j < i + replicationFactor_; j++) {
+                Node* candidate = successors_.get(j);
+                if (candidate != this && candidate->isAlive()) {
+                    live[copies++] = candidate;
+                }
+            }
+            if (copies == 0) {
+                return nullptr;
+            }
+            *owner = live[0];
+            *rangeStart = previous;
+            return live[ChordRing::low64(origin->id_) % copies];
+        }
+        previous = entry->getId();
+    }
+    return nullptr;
+}
+
+// Route to the node responsible for key without printing anything
+LookupResult Node::lookup(NodeId key, bool recordPath) {
+    CHORD_METRIC_SAMPLED_TIMER(timer, Histogram::LookupNanos);
+    LookupResult result;
+    
+    // Local search first, including the copies held for predecessors
+    Node* owner = this;
+    if (localKeys_->get(key, &result.value) ||
+        (replicationFactor_ > 1 && getCopy(key, &result.value, &owner))) {
+        result.found = true;
+        result.node = owner->isAlive() ? owner : this;
+        result.servedBy = this;
+        if (recordPath) {
+            result.path.push_back(id_);
+        }
+        CHORD_METRIC_RECORD(Histogram::LookupHops, 0);
+        return result;
+    }
+    
+    // Forward search through the Chord ring
+    if (recordPath) {
+        result.path.push_back(id_);
+    }
+    
+    // A range learned in the current epoch names the owner directly
+    uint64_t epoch = 0;
+    if (locationCache_) {
+        epoch = getRingEpoch();
+        Node* owner = locationCache_->find(key, epoch);
+        if (owner != nullptr) {
+            result.cached = true;
+            result.node = owner;
+            result.servedBy = owner;
+            result.hops = 1;
+            result.messages = routeMessages(1);
+            result.roundTrips = routeRoundTrips(1);
+            if (recordPath) {
+                result.path.push_back(owner->getId());
+            }
+            result.found = owner->localKeys_->get(key, &result.value);
+            CHORD_METRIC_RECORD(Histogram::LookupHops, 1);
+            return result;
+        }
+    }
+    
+    Route route = this->route(key, replicationFactor_ > 1, recordPath ? &result.path : nullptr);
+    result.hops = route.hops;
+    result.looped = route.looped;
+    Node* responsibleNode = route.looped ? nullptr : route.owner;
+    Node* replica = route.replica;
+    NodeId rangeStart = route.rangeStart;
+    
+    // Every successor of the last hop failed: the key is unreachable
+    if (responsibleNode && !responsibleNode->isAlive()) {
+        responsibleNode = nullptr;
+    }
+    
+    result.node = responsibleNode;
+    if (responsibleNode) {
+        result.servedBy = responsibleNode;
+        if (replica != nullptr && replica != responsibleNode) {
+            // A replica that has not received the range yet sends the read
+            // on to the owner
+            Node* ignored;
+            if (replica->getCopy(key, &result.value, &ignored)) {
+                result.servedBy = replica;
+                result.found = true;
+            } else {
+                result.hops += 1;
+            }
+        }
+        if (result.servedBy == responsibleNode) {
+            result.found = responsibleNode->localKeys_->get(key, &result.value);
+        }
+        if (locationCache_ && responsibleNode != this) {
+            locationCache_->insert(rangeStart, responsibleNode->getId(), responsibleNode, result.hops, epoch);
+        }
+    }
+    result.messages = routeMessages(result.hops);
+    result.roundTrips = routeRoundTrips(result.hops);
+    CHORD_METRIC_RECORD(Histogram::LookupHops, result.hops);
+    return result;
+}
+
+// One hop of a lookup: the owner if this node can name it, else the next node
+Node* Node::routeStep(NodeId key, bool* owner) {
+    Node* successor = this->successor();
+    *owner = true;
+    if (key == id_) {
+        return this;
+    }
+    if (successor == this || inRange(key, id_, successor->getId())) {
+        return successor;
+    }
+    Node* next = closestPrecedingFinger(key);
+    if (next == this) {
+        return successor;
+    }
+    *owner = false;
+    return next;
+}
+
+// Lookup that copies the value while holding the owner's store lock
+LookupResult Node::lookup(NodeId key, std::string* value) {
+    LookupResult result = lookup(key, false);
+    if (result.servedBy) {
+        result.found = result.servedBy->readCopy(key, value);
+        result.value = result.found ? ByteView(*value) : ByteView();
+    }
+    return result;
+}
+
+// Lookup that takes a reference to the value while holding the owner's store lock
+LookupResult Node::lookup(NodeId key, ValueRef* value) {
+    LookupResult result = lookup(key, false);
+    if (result.servedBy) {
+        result.found = result.servedBy->readShared(key, value);
+        result.value = result.found ? value->view() : ByteView();
+    }
+    return result;
+}
+
+// Find the value associated with key (API compatible version)
+uint8_t Node::find(NodeId key) {
+    LookupResult result = lookup(key, traceSink_ != nullptr);
+    if (traceSink_) {
+        traceSink_->onLookup(*this, key, result);
+    }
+    return result.found ? result.value.asByte() : NONE_VALUE;
+}
+
+// Insert a key-value pair (API compatible version)
+void Node::insert(NodeId key, uint8_t value) {
+    // Store the byte as a one-byte value
+    insert(key, std::string(1, static_cast<char>(value)));
+}
+
+// Insert a key with a variable-length value
+void Node::insert(NodeId key, const std::string& value) {
+    CHORD_METRIC_SAMPLED_TIMER(timer, Histogram::InsertNanos);
+    // Find the node responsible for the key
+    Node* responsibleNode = findSuccessor(key);
+    
+    // Insert the key-value pair
+    responsibleNode->applyInsert(key, ByteView(value));
+    countMessage(Counter::StoreMessages, responsibleNode != this ? 1 : 0);
+    
+    if (traceSink_) {
+        traceSink_->onInsert(*this, key, ByteView(value), *responsibleNode);
+    }
+}
+
+// Overloaded insert method that uses None as the value
+void Node::insert(NodeId key) {
+    // Call the main insert method with NONE_VALUE
+    insert(key, NONE_VALUE);
+}
+
+// Remove a key
+void Node::remove(NodeId key) {
+    CHORD_METRIC_SAMPLED_TIMER(timer, Histogram::RemoveNanos);
+    // Find the node responsible for the key
+    Node* responsibleNode = findSuccessor(key);
+    
+    // Remove the key if it exists
+    bool found = responsibleNode->applyRemove(key);
+    countMessage(Counter::StoreMessages, responsibleNode != this ? 1 : 0);
+    if (traceSink_) {
+        traceSink_->onRemove(*this, key, *responsibleNode, found);
+    }
+}
+
+// Store a write that reached the key's owner
+void Node::applyInsert(NodeId key, ByteView value, ByteView keyBytes) {
+    localKeys_->put(key, keyBytes, value);
+    if (replicationFactor_ > 1) {
+        replicateWrite(key);
+    }
+}
+
+bool Node::applyRemove(NodeId key) {
+    bool found = localKeys_->erase(key);
+    if (replicationFactor_ > 1) {
+        replicateWrite(key);
+    }
+    return found;
+}
+
+// Route a batch of keys to their responsible nodes. At every node the keys
+// are sorted by clockwise distance; since the finger chosen by
+// closestPrecedingFinger only moves outward as the distance grows, each
+// finger owns a contiguous run of keys that is forwarded as one sub-batch.
+void Node::routeBatch(std::vector<BatchKey>& keys, BatchResult& result) {
+    struct Hop {
+        Node* node;
+        size_t begin;
+        size_t end;
+        uint32_t hops;
+    };
+    
+    auto resolve = [&](size_t begin, size_t end, Node* owner, uint32_t hops) {
+        for (size_t k = begin; k < end; k++) {
+            LookupResult& r = result.results[keys[k].index];
+            r.node = owner;
+            r.hops = hops;
+        }
+    };
+    
+    std::vector<Hop> pending;
+    pending.push_back(Hop{this, 0, keys.size(), 0});
+    
+    // Fingers of the current node ordered by distance, each paired with the
+    // highest finger index at or below that distance. For a key at distance
+    // d, the last finger with distance <= d gives the index the top-down scan
+    // in closestPrecedingFinger would return. Fingers at distance zero point
+    // back at this node and never qualify, as in closestPrecedingFinger.
+    std::vector<std::pair<NodeId, int> > fingers;
+    fingers.reserve(BITLENGTH);
+    
+    while (!pending.empty()) {
+        Hop hop = pending.back();
+        pending.pop_back();
+        Node* current = hop.node;
+        
+        if (hop.hops >= ChordRing::kMaxHops) {
+            for (size_t k = hop.begin; k < hop.end; k++) {
+                result.results[keys[k].index].looped = true;
+            }
+            resolve(hop.begin, hop.end, nullptr, hop.hops);
+            continue;
+        }
+        
+        for (size_t k = hop.begin; k < hop.end; k++) {
+            keys[k].distance = ChordRing::distance(current->id_, keys[k].key);
+        }
+        std::sort(keys.begin() + hop.begin, keys.begin() + hop.end,
+                  [](const BatchKey& a, const BatchKey& b) { return a.distance < b.distance; });
+        
+        // Keys equal to the current id sort first and follow the rules of
+        // route: the origin owns its own id, and a node reached for its id
+        // owns it when its predecessor is live. Otherwise the key goes on,
+        // and landing here for the second time means it is circling.
+        size_t k = hop.begin;
+        size_t zeroEnd = k;
+        while (zeroEnd < hop.end && keys[zeroEnd].distance == NodeId(0)) {
+            zeroEnd++;
+        }
+        Node* predecessor = current->getPredecessor();
+        if (hop.hops == 0 || (predecessor != nullptr && predecessor->isAlive())) {
+            resolve(k, zeroEnd, current, hop.hops);
+            k = zeroEnd;
+        } else {
+            auto split = std::partition(keys.begin() + k, keys.begin() + zeroEnd,
+                                        [](const BatchKey& bk) { return bk.landed; });
+            size_t landedEnd = split - keys.begin();
+            resolve(k, landedEnd, current, hop.hops);
+            for (size_t z = landedEnd; z < zeroEnd; z++) {
+                keys[z].landed = true;
+            }
+            k = landedEnd;
+        }
+        
+        // At the origin, keys up to the successor need no finger
+        Node* successor = current->successor();
+        if (hop.hops == 0 && successor != current) {
+            NodeId reach = ChordRing::distance(current->id_, successor->id_);
+            size_t nearEnd = k;
+            while (nearEnd < hop.end && keys[nearEnd].distance <= reach) {
+                nearEnd++;
+            }
+            if (nearEnd > k) {
+                result.messages++;
+                resolve(k, nearEnd, successor->isAlive() ? successor : nullptr, 1);
+                k = nearEnd;
+            }
+        }
+        
+        fingers.clear();
+        for (int i = 1; i <= BITLENGTH; i++) {
+            Node* finger = current->fingerTable_.getNodePtr(i);
+            NodeId d = ChordRing::distance(current->id_, finger->id_);
+            if (d != NodeId(0) && finger->isAlive()) {
+                fingers.push_back(std::make_pair(d, i));
+            }
+        }
+        std::sort(fingers.begin(), fingers.end());
+        for (size_t f = 1; f < fingers.size(); f++) {
+            fingers[f].second = std::max(fingers[f].second, fingers[f - 1].second);
+        }
+        
+        size_t f = 0;
+        while (k < hop.end) {
+            // Collect the run of keys whose closest preceding finger is the same
+            int best = 0;
+            size_t groupEnd = k;
+            while (groupEnd < hop.end) {
+                int candidate;
+                if (keys[groupEnd].distance == NodeId(0)) {
+                    // A key equal to the current id makes every other finger qualify
+                    candidate = fingers.empty() ? 0 : fingers.back().second;
+                } else {
+                    while (f < fingers.size() && fingers[f].first <= keys[groupEnd].distance) {
+                        f++;
+                    }
+                    candidate = f > 0 ? fingers[f - 1].second : 0;
+                }
+                if (groupEnd > k && candidate != best) {
+                    break;
+                }
+                best = candidate;
+                groupEnd++;
+            }
+            Node* next = best > 0 ? current->fingerTable_.getNodePtr(best) : current;
+            
+            result.messages++;
+            if (next == current) {
+                // No finger precedes these keys: the successor owns them
+                Node* owner = current->successor();
+                resolve(k, groupEnd, owner->isAlive() ? owner : nullptr, hop.hops + 1);
+            } else {
+                // Keys in (next, successor(next)] resolve there, the rest move on
+                Node* nextSuccessor = next->successor();
+                auto split = std::partition(keys.begin() + k, keys.begin() + groupEnd,
+                                            [&](const BatchKey& bk) { return inRange(bk.key, next->id_, nextSuccessor->id_); });
+                size_t resolvedEnd = split - keys.begin();
+                if (resolvedEnd > k) {
+                    result.messages++;
+                    resolve(k, resolvedEnd, nextSuccessor->isAlive() ? nextSuccessor : nullptr, hop.hops + 2);
+                }
+                if (resolvedEnd < groupEnd) {
+                    pending.push_back(Hop{next, resolvedEnd, groupEnd, hop.hops + 1});
+                }
+            }
+            k = groupEnd;
+        }
+    }
+}
+
+// Look up many keys at once
+BatchResult Node::findBatch(const std::vector<NodeId>& keys) {
+    auto startTime = std::chrono::steady_clock::now();
+    BatchResult result;
+    result.results.resize(keys.size());
+    
+    // Keys stored here resolve without leaving the node, as in lookup()
+    std::vector<BatchKey> remote;
+    remote.reserve(keys.size());
+    for (size_t i = 0; i < keys.size(); i++) {
+        LookupResult& r = result.results[i];
+        if (localKeys_->get(keys[i], &r.value)) {
+            r.found = true;
+            r.node = this;
+            r.servedBy = this;
+        } else {
+            remote.push_back(BatchKey{keys[i], NodeId(0), static_cast<uint32_t>(i), false});
+        }
+    }
+    
+    routeBatch(remote, result);
+    
+    for (const BatchKey& bk : remote) {
+        LookupResult& r = result.results[bk.index];
+        if (r.node) {
+            r.servedBy = r.node;
+            r.found = r.node->localKeys_->get(bk.key, &r.value);
+        }
+    }
+    
+    result.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - startTime).count();
+    if (traceSink_) {
+        traceSink_->onBatch(*this, "find", result);
+    }
+    return result;
+}
+
+// Insert many key-value pairs at once
+BatchResult Node::insertBatch(const std::vector<std::pair<NodeId, std::string> >& entries) {
+    auto startTime = std::chrono::steady_clock::now();
+    BatchResult result;
+    result.results.resize(entries.size());
+    
+    std::vector<BatchKey> keys;
+    keys.reserve(entries.size());
+    for (size_t i = 0; i < entries.size(); i++) {
+        keys.push_back(BatchKey{entries[i].first, NodeId(0), static_cast<uint32_t>(i), false});
+    }
+    
+    routeBatch(keys, result);
+    
+    // Keys leave routing grouped by owner and sorted, so stores mostly append.
+    // Each run for a remote owner is one store message and its reply
+    uint64_t storeMessages = 0;
+    Node* previous = nullptr;
+    for (const BatchKey& bk : keys) {
+        LookupResult& r = result.results[bk.index];
+        if (r.node) {
+            r.node->applyInsert(bk.key, ByteView(entries[bk.index].second));
+            r.found = true;
+            storeMessages += r.node != this && r.node != previous ? 2 : 0;
+        }
+        previous = r.node;
+    }
+    countMessage(Counter::StoreMessages, storeMessages);
+    
+    result.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - startTime).count();
+    if (traceSink_) {
+        traceSink_->onBatch(*this, "insert", result);
+    }
+    return result;
+}
+
+// Remove many keys at once; found reports whether each key existed
+BatchResult Node::removeBatch(const std::vector<NodeId>& keys) {
+    auto startTime = std::chrono::steady_clock::now();
+    BatchResult result;
+    result.results.resize(keys.size());
+    
+    std::vector<BatchKey> routed;
+    routed.reserve(keys.size());
+    for (size_t i = 0; i < keys.size(); i++) {
+        routed.push_back(BatchKey{keys[i], NodeId(0), static_cast<uint32_t>(i), false});
+    }
+    
+    routeBatch(routed, result);
+    
+    // As in insertBatch, one store message and its reply per remote owner run
+    uint64_t storeMessages = 0;
+    Node* previous = nullptr;
+    for (const BatchKey& bk : routed) {
+        LookupResult& r = result.results[bk.index];
+        if (r.node) {
+            r.found = r.node->applyRemove(bk.key);
+            storeMessages += r.node != this && r.node != previous ? 2 : 0;
+        }
+        previous = r.node;
+    }
+    countMessage(Counter::StoreMessages, storeMessages);
+    
+    result.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - startTime).count();
+    if (traceSink_) {
+        traceSink_->onBatch(*this, "remove", result);
+    }
+    return result;
+}
+
+// Whether the entry stored at a key's ring id was stored under that key
+static bool sameKey(const KeyValue& entry, ByteView key) {
+    return entry.key.size == key.size && (key.size == 0 || std::memcmp(entry.key.data, key.data, key.size) == 0);
+}
+
+// Insert a byte-string key at its hashed ring id
+void Node::insertKey(ByteView key, ByteView value) {
+    CHORD_METRIC_SAMPLED_TIMER(timer, Histogram::InsertNanos);
+    NodeId id = keyId(key);
+    Node* responsibleNode = findSuccessor(id);
+    responsibleNode->applyInsert(id, value, key);
+    countMessage(Counter::StoreMessages, responsibleNode != this ? 1 : 0);
+    if (traceSink_) {
+        traceSink_->onInsert(*this, id, value, *responsibleNode);
+    }
+}
+
+// Look up a byte-string key; another key at the same id counts as missing
+LookupResult Node::findKey(ByteView key) {
+    NodeId id = keyId(key);
+    LookupResult result = lookup(id);
+    KeyValue entry;
+    if (result.found && !(result.servedBy->findEntry(id, &entry) && sameKey(entry, key))) {
+        result.found = false;
+        result.value = ByteView();
+    }
+    return result;
+}
+
+// Remove a byte-string key, unless another key has taken its id since
+bool Node::removeKey(ByteView key) {
+    CHORD_METRIC_SAMPLED_TIMER(timer, Histogram::RemoveNanos);
+    NodeId id = keyId(key);
+    Node* responsibleNode = findSuccessor(id);
+    countMessage(Counter::StoreMessages, responsibleNode != this ? 1 : 0);
+    KeyValue entry;
+    bool found = responsibleNode->localKeys_->lookup(id, &entry) && sameKey(entry, key) &&
+                 responsibleNode->applyRemove(id);
+    if (traceSink_) {
+        traceSink_->onRemove(*this, id, *responsibleNode, found);
+    }
+    return found;
+}
+
+// Hash every key in one batch, then store them like insertBatch
+BatchResult Node::insertKeys(const std::vector<std::pair<std::string, std::string> >& entries) {
+    auto startTime = std::chrono::steady_clock::now();
+    BatchResult result;
+    result.results.resize(entries.size());
+    
+    std::vector<ByteView> keyBytes;
+    keyBytes.reserve(entries.size());
+    for (const auto& entry : entries) {
+        keyBytes.push_back(ByteView(entry.first));
+    }
+    std::vector<NodeId> ids(entries.size());
+    KeyHash::toIds(keyBytes.data(), keyBytes.size(), ids.data(), keyHash_);
+    
+    std::vector<BatchKey> keys;
+    keys.reserve(entries.size());
+    for (size_t i = 0; i < entries.size(); i++) {
+        keys.push_back(BatchKey{ids[i], NodeId(0), static_cast<uint32_t>(i), false});
+    }
+    
+    routeBatch(keys, result);
+    
+    for (const BatchKey& bk : keys) {
+        LookupResult& r = result.results[bk.index];
+        if (r.node) {
+            r.node->applyInsert(bk.key, ByteView(entries[bk.index].second), keyBytes[bk.index]);
+            r.found = true;
+        }
+    }
+    
+    result.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - startTime).count();
+    if (traceSink_) {
+        traceSink_->onBatch(*this, "insert", result);
+    }
+    return result;
+}
+
+// Hash every key in one batch, then look them up like findBatch
+BatchResult Node::findKeys(const std::vector<std::string>& keys) {
+    auto startTime = std::chrono::steady_clock::now();
+    std::vector<ByteView> keyBytes(keys.begin(), keys.end());
+    std::vector<NodeId> ids(keys.size());
+    KeyHash::toIds(keyBytes.data(), keyBytes.size(), ids.data(), keyHash_);
+    
+    BatchResult result = findBatch(ids);
+    KeyValue entry;
+    for (size_t i = 0; i < keys.size(); i++) {
+        LookupResult& r = result.results[i];
+        if (r.found && !(r.servedBy->findEntry(ids[i], &entry) && sameKey(entry, keyBytes[i]))) {
+            r.found = false;
+            r.value = ByteView();
+        }
+    }
+    result.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - startTime).count();
+    return result;
+}
+
+// Helper function to compute variance of key distribution
+double Node::computeVariance(const std::vector<int>& keyDistribution) {
+    double mean = std::accumulate(keyDistribution.begin(), keyDistribution.end(), 0.0) / keyDistribution.size();
+    double variance = 0.0;
+    
+    for (int count : keyDistribution) {
+        variance += std::pow(count - mean, 2);
+    }
+    
+    return variance / keyDistribution.size();
+}
+
+// Space Shuffle Optimization
+void Node::spaceShuffleOptimization() {
+    // 1. Gather information about key distribution
+    std::vector<Node*> allNodes;
+    std::map<Node*, int> keyDistribution;
+    
+    // Collect all nodes in the network
+    Node* current = this;
+    do {
+        allNodes.push_back(current);
+        current = current->fingerTable_.getNodePtr(1); // Move to successor
+    } while (current != this);
+    
+    // Count keys per node
+    for (Node* node : allNodes) {
+        keyDistribution[node] = node->localKeys_->size();
+    }
+    
+    // 2. Compute variance before optimization
+    std::vector<int> keyCountsBeforeOpt;
+    for (const auto& pair : keyDistribution) {
+        keyCountsBeforeOpt.push_back(pair.second);
+    }
+    
+    double varianceBefore = computeVariance(keyCountsBeforeOpt);
+    if (traceSink_) {
+        traceSink_->onShuffle(*this, varianceBefore);
+    }
+    
+    // 3. Identify heavily loaded and lightly loaded nodes
+    double mean = std::accumulate(keyCountsBeforeOpt.begin(), keyCountsBeforeOpt.end(), 0.0) / keyCountsBeforeOpt.size();
+    
+    std::vector<Node*> heavyNodes;
+    std::vector<Node*> lightNodes;
+    
+    for (const auto& pair : keyDistribution) {
+        if (pair.second > 1.2 * mean) {
+            heavyNodes.push_back(pair.first);
+        } else if (pair.second < 0.8 * mean) {
+            lightNodes.push_back(pair.first);
+        }
+    }
+    
+    // 4. Perform space shuffle
+    if (!heavyNodes.empty() && !lightNodes.empty()) {
+        std::random_device rd;
+        std::mt19937 g(rd());
+        
+        // Shuffle lists for randomness
+        std::shuffle(heavyNodes.begin(), heavyNodes.end(), g);
+        std::shuffle(lightNodes.begin(), lightNodes.end(), g);
+        
+        // Transfer keys from heavy to light nodes
+        for (size_t i = 0; i < std::min(heavyNodes.size(), lightNodes.size()); i++) {
+            Node* heavyNode = heavyNodes[i];
+            Node* lightNode = lightNodes[i];
+            
+            int keysToTransfer = static_cast<int>((keyDistribution[heavyNode] - keyDistribution[lightNode]) / 2);
+            
+            if (keysToTransfer > 0) {
+                int transferred = 0;
+                
+                while (!heavyNode->localKeys_->empty() && transferred < keysToTransfer) {
+                    // Transfer the lowest key
+                    KeyValue entry = heavyNode->localKeys_->entryAt(0);
+                    lightNode->localKeys_->put(entry);
+                    
+                    if (traceSink_) {
+                        traceSink_->onShuffleMigrate(entry.first, entry.second, *heavyNode, *lightNode);
+                    }
+                    
+                    // Erase from heavy node
+                    heavyNode->localKeys_->erase(entry.first);
+                    
+                    transferred++;
+                }
+                
+                // Update key distribution
+                keyDistribution[heavyNode] -= transferred;
+                keyDistribution[lightNode] += transferred;
+            }
+        }
+    }
+    
+    // 5. Compute variance after optimization
+    std::vector<int> keyCountsAfterOpt;
+    for (const auto& pair : keyDistribution) {
+        keyCountsAfterOpt.push_back(pair.second);
+    }
+    
+    double varianceAfter = computeVariance(keyCountsAfterOpt);
+    if (traceSink_) {
+        traceSink_->onShuffleComplete(*this, varianceBefore, varianceAfter);
+    }
+}
+
+// Move the keys into a lock-striped store
+void Node::enableConcurrency(size_t stripes) {
+    std::unique_ptr<KeyStore> striped(new StripedStore(stripes));
+    NodeId self = id_;
+    localKeys_->extractRange(self, self, *striped);
+    localKeys_ = std::move(striped);
+}
+
+// Attach a location cache, replacing any previous one
+void Node::enableLocationCache(size_t capacity) {
+    locationCache_.reset(capacity > 0 ? new LocationCache(capacity) : nullptr);
+}
+
+LocationCache::Stats Node::getLocationCacheStats() const {
+    return locationCache_ ? locationCache_->stats() : LocationCache::Stats();
+}
+
+void Node::printPredecessorChain() {
+    std::cout << "Predecessor chain starting from Node " << ChordRing::toString(id_) << ": ";
+    Node* current = this;
+    for (int i = 0; i < 10; i++) { // Limit to 10 hops to avoid infinite loops
+        std::cout << ChordRing::toString(current->getId()) << " <- ";
+        current = current->getPredecessor();
+        if (current == this || current == nullptr) break;
+    }
+    std::cout << "..." << std::endl;
 }
\ No newline at end of file
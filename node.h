@@ -1,115 +1,684 @@
-#ifndef NODE_H
-#define NODE_H
-
-#include <stdint.h>
-#include <map>
-#include <set>
-#include <vector>
-#include <iostream>
-
-#define BITLENGTH 8
-#define NONE_VALUE 0  // Use 0 as sentinel value for "None"
-
-// Forward declaration
-class Node;
-
-// The FingerTable class with compatibility functions for both interfaces
-class FingerTable {
-public:
-    /**
-     * @param nodeId: the id of node hosting the finger table.
-     */
-    FingerTable(uint8_t nodeId): nodeId_(nodeId) {
-        fingerTable_.resize(BITLENGTH + 1);
-    }
-    
-    void set(size_t index, Node* successor) {
-        fingerTable_[index] = successor;
-    }
-    
-    
-    uint8_t get(size_t index);
-    
-    // Internal method for implementation that returns Node pointer
-    Node* getNodePtr(size_t index) {
-        return fingerTable_[index];
-    }
-    
-    void prettyPrint();
-    
-private:
-    uint8_t nodeId_;
-    std::vector<Node*> fingerTable_;
-};
-
-class Node {
-public:
-    Node(uint8_t id);
-
-    void join(Node* node);
-    uint8_t find(uint8_t key);
-    void insert(uint8_t key);
-    void remove(uint8_t key);
-    
-    // Additional methods needed for implementation
-    void insert(uint8_t key, uint8_t value);  // Overloaded version
-    void leave();  // Optional method
-    void stabilize();
-    void fixFingers();
-    void spaceShuffleOptimization();
-    
-    // Getters and setters needed for implementation
-    uint8_t getId() const {
-        return static_cast<uint8_t>(id_);
-    }
-    
-    Node* getPredecessor() const {
-        return predecessor_;
-    }
-    
-    void setPredecessor(Node* pred) {
-        predecessor_ = pred;
-    }
-    
-    FingerTable& getFingerTable() {
-        return fingerTable_;
-    }
-    
-    const std::map<uint8_t, uint8_t>& getLocalKeys() const {
-        return localKeys_;
-    }
-    
-    // Debug helper
-    void printPredecessorChain();
-    
-private:
-    uint64_t id_;                     
-    FingerTable fingerTable_;
-    std::map<uint8_t, uint8_t> localKeys_;  
-    
-    // Additional members for implementation
-    Node* predecessor_;
-    int next_finger_;
-    
-    // Helper methods
-    Node* findSuccessor(uint8_t id);
-    Node* findPredecessor(uint8_t id);
-    Node* closestPrecedingFinger(uint8_t id);
-    bool inRange(uint8_t id, uint8_t start, uint8_t end) const;
-    void updateOthers();
-    void updateFingerTable(Node* s, int i);
-    void moveKeys(Node* successor);
-    void notify(Node* n);
-    bool isResponsibleForKey(uint8_t key) const;
-    void transferKey(uint8_t key, Node* toNode);
-    void checkAllNodesForKeys();
-    double computeVariance(const std::vector<int>& keyDistribution);
-};
-
-
-inline uint8_t FingerTable::get(size_t index) {
-    if (fingerTable_[index] == nullptr) return 0;
-    return fingerTable_[index]->getId();
-}
-
+#ifndef NODE_H
+#define NODE_H
+
+#include <stdint.h>
+#include <map>
+#include <set>
+#include <vector>
+#include <iostream>
+#include <memory>
+#include <array>
+#include <algorithm>
+#include <atomic>
+#include <mutex>
+#include "ring.h"
+#include "key_hash.h"
+#include "key_store.h"
+#include "location_cache.h"
+#include "metrics.h"
+#include "node_pool.h"
+#include "small_vector.h"
+#include "trace.h"
+
+#define NONE_VALUE 0  // Use 0 as sentinel value for "None"
+
+// Forward declaration
+class Node;
+
+// The FingerTable class with compatibility functions for both interfaces.
+// Entries are atomics guarded by a sequence counter (seqlock): writers take
+// the table by moving the counter from even to odd and back, readers never
+// block and retry only if a write overlapped their read.
+class FingerTable {
+    friend struct FingerSearch;
+    
+public:
+    /**
+     * @param nodeId: the id of node hosting the finger table.
+     */
+    FingerTable(NodeId nodeId): nodeId_(nodeId), seq_(0) {
+        for (Group& group : groups_) {
+            for (size_t lane = 0; lane < kGroupSize; lane++) {
+                group.hints[lane].store(ChordRing::high32(kNoOffset), std::memory_order_relaxed);
+            }
+        }
+    }
+    
+    void set(size_t index, Node* successor);
+    
+    // Replace entries 1..BITLENGTH from entries[1..BITLENGTH] as one write
+    void assign(Node* const* entries);
+    
+    NodeId get(size_t index);
+    
+    // Internal method for implementation that returns Node pointer
+    Node* getNodePtr(size_t index) const {
+        return entry(index).load(std::memory_order_acquire);
+    }
+    
+    // Consistent copy of entries 1..BITLENGTH into out[1..BITLENGTH]
+    void snapshot(Node** out) const {
+        while (true) {
+            uint32_t before = seq_.load(std::memory_order_acquire);
+            if (before & 1) {
+                continue;  // Writer in progress
+            }
+            for (size_t i = 1; i <= BITLENGTH; i++) {
+                out[i] = entry(i).load(std::memory_order_relaxed);
+            }
+            std::atomic_thread_fence(std::memory_order_acquire);
+            if (seq_.load(std::memory_order_relaxed) == before) {
+                return;
+            }
+        }
+    }
+    
+    // Sequence counter for optimistic readers; odd while a write is in progress
+    uint32_t readBegin() const {
+        uint32_t seq;
+        while ((seq = seq_.load(std::memory_order_acquire)) & 1) {
+        }
+        return seq;
+    }
+    
+    bool readRetry(uint32_t seq) const {
+        std::atomic_thread_fence(std::memory_order_acquire);
+        return seq_.load(std::memory_order_relaxed) != seq;
+    }
+    
+    /**
+     * Farthest live finger in (nodeId, key] other than this node itself,
+     * or nullptr if there is none.
+     * Compares the cached offsets, a group of fingers per instruction where
+     * the CPU allows, and loads only the candidate nodes. Call between
+     * readBegin and readRetry.
+     * @param key: the id being routed to.
+     */
+    Node* closestPreceding(NodeId key) const;
+    
+    // Instruction set closestPreceding runs on: "avx2", "sse2" or "scalar"
+    static const char* searchKernel();
+    
+    // Turn the vector kernels off or back on, to compare them with the scalar scan
+    static void setVectorSearch(bool enabled);
+    
+    void prettyPrint(std::ostream& out = std::cout);
+    
+private:
+    // Offset of an empty entry and of a finger at this node; closestPreceding
+    // never searches that far
+    static constexpr NodeId kNoOffset = ChordRing::sub(NodeId(0), NodeId(1));
+    
+    // Entries 1..BITLENGTH in groups of eight, entry 1 at position 0;
+    // positions past BITLENGTH stay empty. A group is one cache line: the
+    // NodePool references of its fingers and the top 32 bits of each
+    // finger's offset (id - nodeId - 1) mod 2^m. "Finger in (nodeId, key]"
+    // is offset <= key - nodeId - 1, so the search compares a group's hints
+    // in one go without loading the finger nodes, and checks the full id of
+    // a candidate only when its hint equals the key's (never on rings of at
+    // most 32 bits, where the hint is the whole offset). Hints are written
+    // with the references inside the seqlock; both are relaxed atomics, so
+    // a read that overlaps a write is torn, not a data race, and is retried.
+    static constexpr size_t kGroupSize = 8;
+    static constexpr size_t kGroups = (BITLENGTH + kGroupSize - 1) / kGroupSize;
+    
+    struct alignas(64) Group {
+        std::atomic<uint32_t> hints[kGroupSize];
+        AtomicNodeRef nodes[kGroupSize];
+    };
+    
+    NodeId offsetOf(const Node* node) const;
+    
+    AtomicNodeRef& entry(size_t index) {
+        return groups_[(index - 1) / kGroupSize].nodes[(index - 1) % kGroupSize];
+    }
+    
+    const AtomicNodeRef& entry(size_t index) const {
+        return groups_[(index - 1) / kGroupSize].nodes[(index - 1) % kGroupSize];
+    }
+    
+    std::atomic<uint32_t>& hint(size_t index) {
+        return groups_[(index - 1) / kGroupSize].hints[(index - 1) % kGroupSize];
+    }
+    
+    uint32_t beginWrite() {
+        uint32_t seq = seq_.load(std::memory_order_relaxed);
+        while ((seq & 1) || !seq_.compare_exchange_weak(seq, seq + 1, std::memory_order_relaxed)) {
+            seq = seq_.load(std::memory_order_relaxed);
+        }
+        std::atomic_thread_fence(std::memory_order_release);
+        return seq;
+    }
+    
+    void endWrite(uint32_t seq) {
+        seq_.store(seq + 2, std::memory_order_release);
+    }
+    
+    Group groups_[kGroups];
+    NodeId nodeId_;
+    std::atomic<uint32_t> seq_;
+};
+
+// The r nodes following a node on the ring, refreshed by stabilize from the
+// successor's own list. When the immediate successor fails, routing moves on
+// to the next live entry instead of waiting for the ring to be repaired.
+// Only the owning node writes; entries are atomics so lookups on other
+// threads can read the list while stabilize replaces it.
+class SuccessorList {
+public:
+    static constexpr size_t kCapacity = 32;
+    static constexpr size_t kDefaultLength = 8;
+
+    SuccessorList() : length_(kDefaultLength), size_(0) {
+    }
+
+    // Number of entries stabilize keeps, between 1 and kCapacity
+    size_t length() const {
+        return length_.load(std::memory_order_relaxed);
+    }
+
+    void setLength(size_t r) {
+        length_.store(static_cast<uint32_t>(std::max<size_t>(1, std::min(r, kCapacity))), std::memory_order_relaxed);
+    }
+
+    // Entries currently filled in, at most length()
+    size_t size() const {
+        return size_.load(std::memory_order_acquire);
+    }
+
+    Node* get(size_t index) const {
+        return entries_[index].load(std::memory_order_acquire);
+    }
+
+    bool holds(const Node* node) const {
+        for (size_t i = 0, n = size(); i < n; i++) {
+            if (get(i) == node) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    void assign(Node* const* entries, size_t count) {
+        for (size_t i = 0; i < count; i++) {
+            entries_[i].store(entries[i], std::memory_order_relaxed);
+        }
+        size_.store(static_cast<uint32_t>(count), std::memory_order_release);
+    }
+
+private:
+    std::atomic<uint32_t> length_;
+    std::atomic<uint32_t> size_;
+    AtomicNodeRef entries_[kCapacity];
+};
+
+// How many copies of a write are in place when insert or remove returns
+// (see Node::setReplication)
+enum class WriteAck {
+    One,     // The owner's; replicas catch up at the owner's next stabilize
+    Quorum,  // A majority of the R copies, the owner's included
+    All      // The owner's and all R - 1 replicas
+};
+
+// Outcome of a non-printing lookup
+struct LookupResult {
+    bool found = false;             // Whether the node that answered stores the key
+    ByteView value;                 // Value view, valid until the answering store changes
+    Node* node = nullptr;           // Node responsible for the key; null if no live route was found
+    Node* servedBy = nullptr;       // Node that answered: node itself, or a replica of its range
+    uint32_t hops = 0;              // Nodes contacted after the origin
+    uint32_t messages = 0;          // Messages the lookup sent, replies included (see Node::routeMessages)
+    uint32_t roundTrips = 0;        // Requests the origin sent and waited for in turn
+    bool looped = false;            // Routing gave up after ChordRing::kMaxHops
+    bool cached = false;            // Owner came from the origin's location cache
+    bool coalesced = false;         // Completed by a concurrent lookup's route (AsyncExecutor::enableCoalescing)
+    SmallVector<NodeId, 8> path;    // Visited node ids, only filled when requested
+};
+
+// Outcome of a batched operation
+struct BatchResult {
+    std::vector<LookupResult> results;  // One per input key, in input order; paths are not recorded
+    size_t messages = 0;                // Sub-batches forwarded between nodes
+    double seconds = 0.0;               // Wall time of the whole batch
+
+    double keysPerSecond() const {
+        return seconds > 0.0 ? results.size() / seconds : 0.0;
+    }
+};
+
+// Outcome of Node::stabilizeRing
+struct StabilizeResult {
+    size_t rounds = 0;                 // Rounds that changed some successor, predecessor or finger
+    bool converged = false;            // A round changed nothing before the round limit
+    uint64_t changes = 0;              // Successor lists, predecessors and finger tables rewritten
+    std::vector<double> roundSeconds;  // Wall time of every round run, the final unchanged one included
+
+    double seconds() const {
+        double total = 0.0;
+        for (double s : roundSeconds) {
+            total += s;
+        }
+        return total;
+    }
+};
+
+class Node {
+public:
+    /**
+     * @param id: position of the node on the ring.
+     * @param store: storage engine for the node's keys; a SortedVectorStore
+     *               is used when none is given.
+     */
+    Node(NodeId id, std::unique_ptr<KeyStore> store = nullptr);
+
+    ~Node();
+
+    // Nodes are allocated in the NodePool (see node_pool.h)
+    static void* operator new(size_t size);
+    static void operator delete(void* slot);
+
+    void join(Node* node);
+
+    /**
+     * Bootstrap a whole ring at once instead of joining nodes one by one.
+     * Nodes are sorted by id, every predecessor, finger and successor list is
+     * computed directly by binary search over the sorted ids, and entries are
+     * handed to their owners in one pass: O(N log N + K log K) in total.
+     * Nodes must have distinct ids and not be part of a ring yet.
+     * @param nodes: the ring's nodes; sorted by id on return.
+     * @param entries: key-value pairs to store; a repeated key keeps its last value.
+     * @param threads: worker threads for sorting and wiring; 0 uses every core.
+     */
+    static void buildRing(std::vector<Node*>& nodes,
+                          const std::vector<std::pair<NodeId, std::string> >& entries =
+                              std::vector<std::pair<NodeId, std::string> >(),
+                          size_t threads = 1);
+
+    /**
+     * Maintenance for a whole ring in synchronous rounds instead of calling
+     * stabilize and fixFingers node by node. Each round first computes, on
+     * worker threads, every live node's new successor, successor list and
+     * fingers and the predecessor its successor would adopt on notify, all
+     * from the tables as they were when the round started; nothing is
+     * written until every node is done. Then the changed tables are
+     * committed, again in parallel. Rounds repeat until one changes nothing.
+     * Lookups from other threads may run alongside; joins, leaves and other
+     * stabilize calls must not.
+     * @param nodes: every node of the ring, in any order; crashed nodes are skipped.
+     * @param threads: worker threads; 0 uses every core.
+     * @param maxRounds: give up unconverged after this many rounds.
+     */
+    static StabilizeResult stabilizeRing(const std::vector<Node*>& nodes, size_t threads = 0,
+                                         size_t maxRounds = 1000);
+
+    uint8_t find(NodeId key);
+
+    /**
+     * Route to the node responsible for key without any output.
+     * @param key: ring position to resolve.
+     * @param recordPath: also collect the ids of the visited nodes.
+     */
+    LookupResult lookup(NodeId key, bool recordPath = false);
+
+    // Lookup that copies the value into *value under the owner's store lock;
+    // use it instead of the ByteView form when other threads may write
+    LookupResult lookup(NodeId key, std::string* value);
+
+    // Lookup that takes a reference to the value under the owner's store
+    // lock instead of copying it; *value stays readable whatever is written
+    // afterwards. Values under ValueBuffer::kSharedBytes are still copied.
+    LookupResult lookup(NodeId key, ValueRef* value);
+
+    /**
+     * One step of a lookup at this node, for callers that carry the request
+     * between nodes themselves (async.h).
+     * @param owner: set when the returned node is responsible for key: this
+     *               node for its own id, or its successor when key lies
+     *               between them or no finger precedes key.
+     * @return the owner, or else the closest preceding live finger to forward to.
+     */
+    Node* routeStep(NodeId key, bool* owner);
+
+    // The write of insert and remove once it has reached key's responsible
+    // node: store or erase here and update the replicas. keyBytes is the
+    // original key of a hashed insert, stored next to the value.
+    void applyInsert(NodeId key, ByteView value, ByteView keyBytes = ByteView());
+    bool applyRemove(NodeId key);
+
+    // Batched operations. Keys are sorted on the ring and split by finger
+    // interval at every hop, so keys sharing a next hop travel together as
+    // one sub-batch instead of each walking the fingers on its own.
+    BatchResult findBatch(const std::vector<NodeId>& keys);
+    BatchResult insertBatch(const std::vector<std::pair<NodeId, std::string> >& entries);
+    BatchResult removeBatch(const std::vector<NodeId>& keys);
+    void insert(NodeId key);
+    void remove(NodeId key);
+    
+    // Additional methods needed for implementation
+    void insert(NodeId key, uint8_t value);  // Overloaded version
+    void insert(NodeId key, const std::string& value);  // Variable-length value
+    void leave();  // Optional method
+
+    // Byte-string keys. Each key is hashed to its ring id with the function
+    // set by setKeyHash and stored at that id together with its bytes. A ring
+    // id holds one key: on narrow rings two keys can hash to the same id, and
+    // the later insert replaces the earlier, which then reads as missing.
+    void insertKey(ByteView key, ByteView value);
+    // Like lookup(keyId(key)); found only when the stored key bytes match
+    LookupResult findKey(ByteView key);
+    // Returns whether the key was stored
+    bool removeKey(ByteView key);
+    // Batched forms: all keys are hashed in one KeyHash::toIds call, then
+    // routed like insertBatch and findBatch
+    BatchResult insertKeys(const std::vector<std::pair<std::string, std::string> >& entries);
+    BatchResult findKeys(const std::vector<std::string>& keys);
+
+    // Hash used by the byte-string key calls; SHA-1 by default. Set it before
+    // storing any keys, since keys stored under another hash are not found.
+    static void setKeyHash(KeyHashFunction function) {
+        keyHash_ = function;
+    }
+
+    static KeyHashFunction getKeyHash() {
+        return keyHash_;
+    }
+
+    // How lookups, findSuccessor and the async calls travel; iterative by
+    // default. Routes visit the same nodes in either mode, only the messages
+    // they are charged differ.
+    static void setRoutingMode(RoutingMode mode) {
+        routingMode_ = mode;
+    }
+
+    static RoutingMode getRoutingMode() {
+        return routingMode_;
+    }
+
+    // Messages of a route that contacts hops nodes after the origin:
+    // iteratively a request and a reply per hop, recursively one forward per
+    // hop and the reply to the origin
+    static uint32_t routeMessages(uint32_t hops) {
+        return routingMode_ == RoutingMode::Iterative ? 2 * hops : hops + (hops > 0 ? 1 : 0);
+    }
+
+    // Requests the origin of such a route waits for one after another
+    static uint32_t routeRoundTrips(uint32_t hops) {
+        return routingMode_ == RoutingMode::Iterative ? hops : (hops > 0 ? 1 : 0);
+    }
+
+    // Ring id of a byte-string key under the current hash
+    static NodeId keyId(ByteView key) {
+        return KeyHash::toId(key, keyHash_);
+    }
+
+    // Crash without handing off keys or telling anyone. Other nodes notice
+    // when they next route through this node and skip it.
+    void fail();
+
+    bool isAlive() const {
+        return alive_.load(std::memory_order_acquire);
+    }
+
+    // Length r of the successor list; set before join so it fills right away
+    void setSuccessorListLength(size_t r) {
+        successors_.setLength(r);
+    }
+
+    const SuccessorList& getSuccessorList() const {
+        return successors_;
+    }
+
+    void stabilize();
+    void fixFingers();
+    // Moves keys from heavy to light nodes that are not their successors, so
+    // later lookups miss them; Host::rebalance balances load without that
+    void spaceShuffleOptimization();
+
+    // Population variance of per-node (or per-host) key counts
+    static double computeVariance(const std::vector<int>& keyDistribution);
+    
+    // Getters and setters needed for implementation
+    NodeId getId() const {
+        return id_;
+    }
+    
+    Node* getPredecessor() const {
+        return predecessor_.load(std::memory_order_acquire);
+    }
+    
+    void setPredecessor(Node* pred) {
+        predecessor_.store(pred, std::memory_order_release);
+    }
+    
+    FingerTable& getFingerTable() {
+        return fingerTable_;
+    }
+    
+    // Ordered view of the keys stored at this node
+    const KeyStore& getLocalKeys() const {
+        return *localKeys_;
+    }
+    
+    // Debug helper
+    void printPredecessorChain();
+
+    /**
+     * Switch this node to a lock-striped store so lookups and inserts from
+     * many threads can run alongside stabilize/fixFingers. Finger tables and
+     * predecessors are always safe to read concurrently; only the store
+     * needs this. Call before other threads can reach the node, and keep
+     * nodes alive while any thread may still route through them.
+     * @param stripes: number of independently locked shards (power of two).
+     */
+    void enableConcurrency(size_t stripes = 16);
+
+    /**
+     * Remember the owner of every key range this node routes to, so repeated
+     * lookups go straight to the owner in one hop. Entries are dropped when
+     * ring membership changes (see getRingEpoch). Off by default.
+     * @param capacity: number of ranges kept; 0 turns the cache off.
+     */
+    void enableLocationCache(size_t capacity = 256);
+
+    // Hit rate and hop savings of this node's location cache
+    LocationCache::Stats getLocationCacheStats() const;
+
+    /**
+     * Keep every key on its owner and on the owner's next factor - 1
+     * successors. Replicas are filled and repaired by stabilize, lookups are
+     * answered by the first replica the route can reach, and a replica
+     * takes over its owner's range when the owner crashes. Applies to every
+     * node; set it before other threads use the ring. Factor 1 (the default)
+     * keeps a single copy and routes exactly as without replication.
+     * @param factor: copies per key, capped at SuccessorList::kCapacity + 1;
+     *                nodes only replicate onto as many successors as their
+     *                list holds.
+     * @param ack: copies written before insert and remove return.
+     */
+    static void setReplication(size_t factor, WriteAck ack = WriteAck::All);
+
+    static size_t getReplicationFactor() {
+        return replicationFactor_;
+    }
+
+    static WriteAck getWriteAck() {
+        return writeAck_;
+    }
+
+    // Keys handed over on join and leave travel in batches of at most this
+    // many entries or bytes, whichever limit is reached first
+    static const size_t kMigrationBatchEntries = 256;
+    static const size_t kMigrationBatchBytes = 64 * 1024;
+
+    // Requests this thread's nodes sent to other nodes during join, leave,
+    // stabilize, fixFingers, insert and remove, with the replies and
+    // forwards of their routing (see routeMessages). Lookups report their
+    // cost in LookupResult instead.
+    static uint64_t messageCount() {
+        return messages_;
+    }
+
+    static void resetMessageCount() {
+        messages_ = 0;
+    }
+
+    // Incremented whenever a join, leave, crash or stabilize changes who owns
+    // which keys; cached locations from older epochs are ignored
+    static uint64_t getRingEpoch() {
+        return ringEpoch_.load(std::memory_order_acquire);
+    }
+
+    // Install the sink that receives join/lookup/insert/migration events for
+    // every node; nullptr (the default) keeps all operations silent
+    static void setTraceSink(TraceSink* sink) {
+        traceSink_ = sink;
+    }
+
+    static TraceSink* getTraceSink() {
+        return traceSink_;
+    }
+    
+private:
+    // Restores fingers, successors and predecessors from a saved ring
+    friend class RingSnapshot;
+    friend class NodePool;
+
+    // Routing reads the id and liveness of every node it passes, so they
+    // share the first cache line
+    NodeId id_;
+    uint32_t poolRef_;  // This node's NodePool reference
+    std::atomic<bool> alive_;
+    AtomicNodeRef predecessor_;
+    int next_finger_;  // Only touched by the thread running this node's fixFingers
+    FingerTable fingerTable_;
+    std::unique_ptr<KeyStore> localKeys_;
+    SuccessorList successors_;
+
+    std::unique_ptr<LocationCache> locationCache_;
+
+    // Copy of a predecessor's range (start, owner] kept for that owner
+    struct Replica {
+        Node* owner;
+        NodeId start;
+        std::unique_ptr<KeyStore> keys;
+    };
+    // Replication bookkeeping, allocated by the first replica write or
+    // repair so that nodes of unreplicated rings do not carry it
+    struct ReplicaState {
+        std::mutex lock;
+        std::vector<Replica> replicas;   // Guarded by lock
+        std::vector<NodeId> pending;     // Keys written since the last repair that a replica lacks; guarded by lock
+        std::vector<Node*> targets;      // Successors that held our range after the last repair
+        NodeId start = NodeId(0);        // Our predecessor's id at that repair
+    };
+    std::atomic<ReplicaState*> replication_;
+
+    static TraceSink* traceSink_;
+    static size_t replicationFactor_;
+    static KeyHashFunction keyHash_;
+    static RoutingMode routingMode_;
+    static WriteAck writeAck_;
+    static std::atomic<uint64_t> ringEpoch_;
+    static thread_local uint64_t messages_;
+    
+    // Helper methods
+    static void countMessage(Counter type, uint64_t count = 1) {
+        messages_ += count;
+        CHORD_METRIC_ADD(type, count);
+    }
+    static void advanceRingEpoch() {
+        ringEpoch_.fetch_add(1, std::memory_order_acq_rel);
+    }
+    Node* successor() const;
+    void refreshSuccessorList(Node* successor);
+    size_t successorListVia(Node* successor, Node** entries) const;
+    Node* findSuccessor(NodeId id);
+    Node* findPredecessor(NodeId id);
+    Node* closestPrecedingFinger(NodeId id);
+
+    // Walk of a route from this node towards the owner of a key
+    struct Route {
+        Node* predecessor = nullptr;    // Last node asked for the next hop; its successor owns the key
+        Node* owner = nullptr;          // Node responsible for the key; null if the walk gave up
+        Node* replica = nullptr;        // Copy of the owner's range a successor list named instead
+        NodeId rangeStart = NodeId(0);  // owner is responsible for (rangeStart, owner]
+        uint32_t hops = 0;              // Nodes contacted after this one, owner or replica included
+        uint32_t asked = 0;             // ... of which asked for the next hop
+        bool looped = false;            // Gave up after ChordRing::kMaxHops or came back here
+    };
+    Route route(NodeId key, bool viaReplicas, SmallVector<NodeId, 8>* path);
+    static bool inRange(NodeId id, NodeId start, NodeId end) {
+        return ChordRing::inRange(id, start, end);
+    }
+    void updateOthers();
+    void updateFingerTable(Node* s, int i);
+    size_t pullRange(Node* from, NodeId start, NodeId end);
+    void notify(Node* n);
+
+    // Replication (see setReplication)
+    void replicateWrite(NodeId key);
+    void repairReplicas();
+    Node* nearestReplica(NodeId key, const Node* origin, Node** owner, NodeId* rangeStart) const;
+    bool getCopy(NodeId key, ByteView* value, Node** owner) const;
+    bool readCopy(NodeId key, std::string* value) const;
+    bool readShared(NodeId key, ValueRef* value) const;
+    bool findEntry(NodeId key, KeyValue* entry) const;
+    Replica* findReplica(ReplicaState& state, const Node* owner);
+    ReplicaState& replication();
+    void storeReplica(Node* owner, NodeId start, const KeyStore& entries, bool reset);
+    void updateReplica(Node* owner, NodeId start, NodeId key, const ValueRef* value);
+    void dropReplica(const Node* owner);
+
+    struct BatchKey {
+        NodeId key;
+        NodeId distance;  // Clockwise distance from the node currently routing it
+        uint32_t index;   // Position in the caller's batch
+        bool landed;      // Already routed through the node whose id equals key
+    };
+    void routeBatch(std::vector<BatchKey>& keys, BatchResult& result);
+};
+
+
+inline NodeId FingerTable::offsetOf(const Node* node) const {
+    return node == nullptr ? kNoOffset : ChordRing::sub(ChordRing::sub(node->getId(), nodeId_), NodeId(1));
+}
+
+inline void FingerTable::set(size_t index, Node* successor) {
+    uint32_t distance = ChordRing::high32(offsetOf(successor));
+    uint32_t seq = beginWrite();
+    entry(index).store(successor, std::memory_order_relaxed);
+    hint(index).store(distance, std::memory_order_relaxed);
+    endWrite(seq);
+}
+
+inline void FingerTable::assign(Node* const* entries) {
+    uint32_t hints[BITLENGTH + 1];
+    for (size_t i = 1; i <= BITLENGTH; i++) {
+        hints[i] = ChordRing::high32(offsetOf(entries[i]));
+    }
+    uint32_t seq = beginWrite();
+    for (size_t i = 1; i <= BITLENGTH; i++) {
+        entry(i).store(entries[i], std::memory_order_relaxed);
+        hint(i).store(hints[i], std::memory_order_relaxed);
+    }
+    endWrite(seq);
+}
+
+inline Node* NodePool::node(uint32_t ref) {
+    if (ref == 0) {
+        return nullptr;
+    }
+    return reinterpret_cast<Node*>(slabs_[ref >> kSlabBits]) + (ref & (kSlabNodes - 1));
+}
+
+inline uint32_t NodePool::refOf(const Node* node) {
+    return node == nullptr ? 0 : node->poolRef_;
+}
+
+inline NodeId FingerTable::get(size_t index) {
+    Node* node = getNodePtr(index);
+    if (node == nullptr) return NodeId(0);
+    return node->getId();
+}
+
 #endif
\ No newline at end of file
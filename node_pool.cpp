@@ -0,0 +1,119 @@
+#include "node_pool.h"
+#include "node.h"
+#include <cstdio>
+#include <cstdlib>
+#include <map>
+#include <mutex>
+#include <new>
+#include <vector>
+
+char* NodePool::slabs_[NodePool::kMaxSlabs];
+
+// Allocation state behind one lock; never destroyed, since nodes may still
+// be deleted during static destruction
+struct NodePoolState {
+    std::mutex lock;
+    uint32_t next = 1;                // Next slot never handed out; slot 0 stands for nullptr
+    bool exhausted = false;           // next has wrapped around
+    std::vector<uint32_t> free;       // Slots of deleted nodes
+    std::map<const char*, size_t> bases;  // Slab base address to slab number
+    size_t live = 0;
+};
+
+static NodePoolState& state() {
+    static NodePoolState* instance = new NodePoolState();
+    return *instance;
+}
+
+// The slot allocate last returned on this thread, for the constructor that
+// runs on it next
+static thread_local const void* claimedSlot = nullptr;
+static thread_local uint32_t claimedRef = 0;
+
+static const size_t kSlabBytes = NodePool::kSlabNodes * sizeof(Node);
+
+// Reference of the slot at address; 0 if no slab holds it. Caller holds the lock.
+static uint32_t refAt(NodePoolState& pool, const void* address) {
+    const char* at = static_cast<const char*>(address);
+    auto it = pool.bases.upper_bound(at);
+    if (it == pool.bases.begin()) {
+        return 0;
+    }
+    --it;
+    size_t offset = at - it->first;
+    if (offset >= kSlabBytes || offset % sizeof(Node) != 0) {
+        return 0;
+    }
+    return static_cast<uint32_t>((it->second << NodePool::kSlabBits) + offset / sizeof(Node));
+}
+
+void* NodePool::allocate() {
+    NodePoolState& pool = state();
+    uint32_t ref;
+    {
+        std::lock_guard<std::mutex> guard(pool.lock);
+        if (!pool.free.empty()) {
+            ref = pool.free.back();
+            pool.free.pop_back();
+        } else {
+            if (pool.exhausted) {
+                return nullptr;
+            }
+            ref = pool.next++;
+            pool.exhausted = pool.next == 0;
+            size_t slab = ref >> kSlabBits;
+            if (slabs_[slab] == nullptr) {
+                char* base = static_cast<char*>(::operator new(kSlabBytes, std::align_val_t(alignof(Node))));
+                slabs_[slab] = base;
+                pool.bases[base] = slab;
+            }
+        }
+        pool.live++;
+    }
+    void* slot = node(ref);
+    claimedSlot = slot;
+    claimedRef = ref;
+    return slot;
+}
+
+void NodePool::release(void* slot) {
+    if (slot == nullptr) {
+        return;
+    }
+    NodePoolState& pool = state();
+    std::lock_guard<std::mutex> guard(pool.lock);
+    uint32_t ref = refAt(pool, slot);
+    if (ref != 0) {
+        pool.free.push_back(ref);
+        pool.live--;
+    }
+}
+
+uint32_t NodePool::claim(const Node* node) {
+    if (claimedSlot == node) {
+        claimedSlot = nullptr;
+        return claimedRef;
+    }
+    NodePoolState& pool = state();
+    uint32_t ref;
+    {
+        std::lock_guard<std::mutex> guard(pool.lock);
+        ref = refAt(pool, node);
+    }
+    if (ref == 0) {
+        std::fprintf(stderr, "NodePool: Node constructed outside the pool; create nodes with new\n");
+        std::abort();
+    }
+    return ref;
+}
+
+NodePool::Stats NodePool::stats() {
+    NodePoolState& pool = state();
+    std::lock_guard<std::mutex> guard(pool.lock);
+    Stats stats;
+    stats.slabs = pool.bases.size();
+    stats.live = pool.live;
+    stats.nodeBytes = sizeof(Node);
+    stats.bytes = stats.slabs * kSlabBytes;
+    return stats;
+}
@@ -0,0 +1,98 @@
+#ifndef NODE_POOL_H
+#define NODE_POOL_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <atomic>
+
+class Node;
+
+// Arena that every Node of the process lives in. Node::operator new takes a
+// slot from a slab of kSlabNodes nodes, so nodes sit next to each other
+// instead of scattered over the heap with an allocator header each, and every
+// node gets a 32-bit reference: its slot number, with 0 meaning no node.
+// Fingers, successor lists and predecessors hold these references instead of
+// 64-bit pointers. A reference turns back into a pointer with one load from
+// the slab table, which stays in cache. Slots of deleted nodes are reused by
+// later ones, as the heap would reuse their memory.
+class NodePool {
+public:
+    static constexpr unsigned kSlabBits = 12;
+    static constexpr size_t kSlabNodes = size_t(1) << kSlabBits;
+    static constexpr size_t kMaxSlabs = (size_t(1) << 32) / kSlabNodes;
+
+    struct Stats {
+        size_t slabs = 0;      // Slabs allocated
+        size_t live = 0;       // Nodes currently allocated
+        size_t nodeBytes = 0;  // sizeof(Node)
+        size_t bytes = 0;      // Memory held by the slabs
+    };
+
+    /**
+     * Storage for one Node, for Node::operator new.
+     * @return null once all 2^32 - 1 references are in use.
+     */
+    static void* allocate();
+
+    // Return a slot taken by allocate
+    static void release(void* slot);
+
+    // Reference of the slot that allocate returned for node; called once by
+    // the Node constructor, which stores it
+    static uint32_t claim(const Node* node);
+
+    // Node behind a reference, nullptr for 0; defined in node.h
+    static Node* node(uint32_t ref);
+
+    // Reference of a node, 0 for nullptr; defined in node.h
+    static uint32_t refOf(const Node* node);
+
+    static Stats stats();
+
+private:
+    // Base of every slab allocated so far; entries are written once, before
+    // any reference into the slab is handed out
+    static char* slabs_[kMaxSlabs];
+};
+
+// A Node* kept as its 32-bit NodePool reference, with the interface of
+// std::atomic<Node*>
+class AtomicNodeRef {
+public:
+    AtomicNodeRef(Node* node = nullptr) : ref_(NodePool::refOf(node)) {
+    }
+
+    Node* load(std::memory_order order = std::memory_order_seq_cst) const {
+        return NodePool::node(ref_.load(order));
+    }
+
+    void store(Node* node, std::memory_order order = std::memory_order_seq_cst) {
+        ref_.store(NodePool::refOf(node), order);
+    }
+
+    bool compare_exchange_weak(Node*& expected, Node* desired, std::memory_order order = std::memory_order_seq_cst) {
+        uint32_t ref = NodePool::refOf(expected);
+        if (ref_.compare_exchange_weak(ref, NodePool::refOf(desired), order)) {
+            return true;
+        }
+        expected = NodePool::node(ref);
+        return false;
+    }
+
+    AtomicNodeRef& operator=(Node* node) {
+        store(node);
+        return *this;
+    }
+
+    operator Node*() const {
+        return load();
+    }
+
+    AtomicNodeRef(const AtomicNodeRef&) = delete;
+    AtomicNodeRef& operator=(const AtomicNodeRef&) = delete;
+
+private:
+    std::atomic<uint32_t> ref_;
+};
+
+#endif
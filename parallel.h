@@ -0,0 +1,54 @@
+#ifndef PARALLEL_H
+#define PARALLEL_H
+
+#include <stddef.h>
+#include <algorithm>
+#include <thread>
+#include <vector>
+
+// Fork-join helpers for bulk operations over whole rings (Node::buildRing,
+// Node::stabilizeRing, RingSnapshot::load)
+
+// Run body(begin, end) over [0, count) in one contiguous chunk per thread
+template <typename Body>
+inline void parallelFor(size_t count, size_t threads, Body body) {
+    threads = std::max<size_t>(1, std::min(threads, count));
+    if (threads == 1) {
+        body(size_t(0), count);
+        return;
+    }
+    std::vector<std::thread> workers;
+    size_t chunk = (count + threads - 1) / threads;
+    for (size_t begin = 0; begin < count; begin += chunk) {
+        workers.emplace_back(body, begin, std::min(count, begin + chunk));
+    }
+    for (std::thread& worker : workers) {
+        worker.join();
+    }
+}
+
+// Sort chunks on separate threads, then merge neighbouring runs pairwise
+template <typename T, typename Less>
+inline void parallelSort(std::vector<T>& items, size_t threads, Less less) {
+    size_t count = items.size();
+    threads = std::max<size_t>(1, std::min(threads, count / 4096));
+    size_t chunk = (count + threads - 1) / threads;
+    parallelFor(threads, threads, [&](size_t first, size_t last) {
+        for (size_t t = first; t < last; t++) {
+            std::sort(items.begin() + std::min(count, t * chunk), items.begin() + std::min(count, (t + 1) * chunk), less);
+        }
+    });
+    for (size_t width = chunk; width < count; width *= 2) {
+        size_t pairs = (count + 2 * width - 1) / (2 * width);
+        parallelFor(pairs, threads, [&](size_t first, size_t last) {
+            for (size_t p = first; p < last; p++) {
+                size_t begin = p * 2 * width;
+                size_t middle = std::min(count, begin + width);
+                size_t end = std::min(count, begin + 2 * width);
+                std::inplace_merge(items.begin() + begin, items.begin() + middle, items.begin() + end, less);
+            }
+        });
+    }
+}
+
+#endif
@@ -0,0 +1,295 @@
+#ifndef RING_H
+#define RING_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string>
+#include <type_traits>
+
+// Fixed-width unsigned integer made of 32-bit limbs, used for identifier
+// spaces that do not fit in a native register (128 and 160 bits).
+// Arithmetic wraps modulo 2^(32 * Words) like the native unsigned types.
+template <unsigned Words>
+struct WideId {
+    uint32_t w[Words];  // Little-endian: w[0] holds the least significant limb
+
+    constexpr WideId() : w{} {}
+
+    constexpr WideId(uint64_t v) : w{} {
+        w[0] = static_cast<uint32_t>(v);
+        if (Words > 1) {
+            w[1] = static_cast<uint32_t>(v >> 32);
+        }
+    }
+
+    constexpr uint64_t low64() const {
+        return Words > 1 ? (static_cast<uint64_t>(w[1]) << 32) | w[0] : w[0];
+    }
+
+    friend constexpr WideId operator+(const WideId& a, const WideId& b) {
+        WideId r;
+        uint64_t carry = 0;
+        for (unsigned i = 0; i < Words; i++) {
+            uint64_t s = static_cast<uint64_t>(a.w[i]) + b.w[i] + carry;
+            r.w[i] = static_cast<uint32_t>(s);
+            carry = s >> 32;
+        }
+        return r;
+    }
+
+    friend constexpr WideId operator-(const WideId& a, const WideId& b) {
+        WideId r;
+        uint64_t borrow = 0;
+        for (unsigned i = 0; i < Words; i++) {
+            uint64_t d = static_cast<uint64_t>(a.w[i]) - b.w[i] - borrow;
+            r.w[i] = static_cast<uint32_t>(d);
+            borrow = (d >> 32) & 1;
+        }
+        return r;
+    }
+
+    friend constexpr bool operator==(const WideId& a, const WideId& b) {
+        uint32_t diff = 0;
+        for (unsigned i = 0; i < Words; i++) {
+            diff |= a.w[i] ^ b.w[i];
+        }
+        return diff == 0;
+    }
+
+    friend constexpr bool operator!=(const WideId& a, const WideId& b) {
+        return !(a == b);
+    }
+
+    // Branch-free comparison: the borrow out of a - b is set iff a < b
+    friend constexpr bool operator<(const WideId& a, const WideId& b) {
+        uint64_t borrow = 0;
+        for (unsigned i = 0; i < Words; i++) {
+            uint64_t d = static_cast<uint64_t>(a.w[i]) - b.w[i] - borrow;
+            borrow = (d >> 32) & 1;
+        }
+        return borrow != 0;
+    }
+
+    friend constexpr bool operator>(const WideId& a, const WideId& b) { return b < a; }
+    friend constexpr bool operator<=(const WideId& a, const WideId& b) { return !(b < a); }
+    friend constexpr bool operator>=(const WideId& a, const WideId& b) { return !(a < b); }
+};
+
+// Selects the identifier type for a ring of the given bit width: the
+// smallest native unsigned type up to 64 bits, a multiword integer above.
+template <unsigned Bits, bool Native = (Bits <= 64)>
+struct RingIdType {
+    typedef WideId<(Bits + 31) / 32> type;
+};
+
+template <unsigned Bits>
+struct RingIdType<Bits, true> {
+    typedef typename std::conditional<Bits <= 8, uint8_t,
+            typename std::conditional<Bits <= 16, uint16_t,
+            typename std::conditional<Bits <= 32, uint32_t, uint64_t>::type>::type>::type type;
+};
+
+// Width-specific helpers that Ring<Bits> dispatches to
+template <unsigned Bits, bool Native = (Bits <= 64)>
+struct RingOps;
+
+template <unsigned Bits>
+struct RingOps<Bits, true> {
+    typedef typename RingIdType<Bits>::type Id;
+
+    static constexpr uint64_t kMask = Bits == 64 ? ~0ULL : (1ULL << Bits) - 1;
+
+    static constexpr Id wrap(uint64_t v) {
+        return static_cast<Id>(v & kMask);
+    }
+
+    static constexpr Id pow2(unsigned k) {
+        return k >= Bits ? Id(0) : wrap(1ULL << k);
+    }
+
+    static constexpr uint64_t low64(Id id) {
+        return id;
+    }
+
+    static constexpr uint32_t high32(Id id) {
+        return static_cast<uint32_t>(static_cast<uint64_t>(id) >> (Bits > 32 ? Bits - 32 : 0));
+    }
+
+    static void toBytes(Id id, uint8_t* out) {
+        for (unsigned i = 0; i < (Bits + 7) / 8; i++) {
+            out[i] = static_cast<uint8_t>(static_cast<uint64_t>(id) >> (8 * i));
+        }
+    }
+
+    static Id fromBytes(const uint8_t* in) {
+        uint64_t v = 0;
+        for (unsigned i = 0; i < (Bits + 7) / 8; i++) {
+            v |= static_cast<uint64_t>(in[i]) << (8 * i);
+        }
+        return wrap(v);
+    }
+
+    static std::string toString(Id id) {
+        return std::to_string(static_cast<unsigned long long>(id));
+    }
+};
+
+template <unsigned Bits>
+struct RingOps<Bits, false> {
+    typedef typename RingIdType<Bits>::type Id;
+    static constexpr unsigned kWords = (Bits + 31) / 32;
+    static constexpr unsigned kTopBits = Bits - 32 * (kWords - 1);
+
+    static constexpr Id wrap(Id v) {
+        if (kTopBits < 32) {
+            v.w[kWords - 1] &= (1U << (kTopBits % 32)) - 1;
+        }
+        return v;
+    }
+
+    static constexpr Id pow2(unsigned k) {
+        Id r;
+        if (k < Bits) {
+            r.w[k / 32] = 1U << (k % 32);
+        }
+        return r;
+    }
+
+    static constexpr uint64_t low64(const Id& id) {
+        return id.low64();
+    }
+
+    static constexpr uint32_t high32(const Id& id) {
+        return kTopBits == 32 ? id.w[kWords - 1]
+                              : (id.w[kWords - 1] << ((32 - kTopBits) % 32)) | (id.w[kWords - 2] >> (kTopBits % 32));
+    }
+
+    static void toBytes(const Id& id, uint8_t* out) {
+        for (unsigned i = 0; i < (Bits + 7) / 8; i++) {
+            out[i] = static_cast<uint8_t>(id.w[i / 4] >> (8 * (i % 4)));
+        }
+    }
+
+    static Id fromBytes(const uint8_t* in) {
+        Id id;
+        for (unsigned i = 0; i < (Bits + 7) / 8; i++) {
+            id.w[i / 4] |= static_cast<uint32_t>(in[i]) << (8 * (i % 4));
+        }
+        return wrap(id);
+    }
+
+    // Wide identifiers print as fixed-width hexadecimal
+    static std::string toString(const Id& id) {
+        static const char digits[] = "0123456789abcdef";
+        std::string s = "0x";
+        for (unsigned i = kWords; i-- > 0;) {
+            unsigned nibbles = (i == kWords - 1) ? (kTopBits + 3) / 4 : 8;
+            for (unsigned j = nibbles; j-- > 0;) {
+                s += digits[(id.w[i] >> (4 * j)) & 0xF];
+            }
+        }
+        return s;
+    }
+};
+
+// Identifier space of 2^Bits positions. All modular arithmetic the Chord
+// protocol needs lives here so the routing code stays width-agnostic.
+template <unsigned Bits>
+struct Ring {
+    static_assert(Bits >= 1, "ring needs at least one bit");
+
+    typedef RingOps<Bits> Ops;
+    typedef typename Ops::Id Id;
+
+    static constexpr unsigned kBits = Bits;
+
+    // Bytes needed to serialize an identifier
+    static constexpr size_t kBytes = (Bits + 7) / 8;
+
+    // Upper bound on lookup hops before a route is considered looping
+    static constexpr size_t kMaxHops = Bits < 16 ? (size_t(1) << Bits) : size_t(1) << 16;
+
+    static constexpr Id add(const Id& a, const Id& b) {
+        return Ops::wrap(a + b);
+    }
+
+    static constexpr Id sub(const Id& a, const Id& b) {
+        return Ops::wrap(a - b);
+    }
+
+    // Clockwise distance from 'from' to 'to'
+    static constexpr Id distance(const Id& from, const Id& to) {
+        return sub(to, from);
+    }
+
+    // 2^k mod 2^Bits
+    static constexpr Id pow2(unsigned k) {
+        return Ops::pow2(k);
+    }
+
+    /**
+     * @param n: id of the node owning the finger table.
+     * @param i: 1-based finger index.
+     * @return start of the i-th finger interval, (n + 2^(i-1)) mod 2^Bits.
+     */
+    static constexpr Id fingerStart(const Id& n, unsigned i) {
+        return add(n, pow2(i - 1));
+    }
+
+    // id is in (start, end] on the ring; start == end covers the whole ring.
+    // Rotating by start turns the interval test into one unsigned compare:
+    // (id - start - 1) <= (end - start - 1), where end == start wraps to max.
+    static constexpr bool inRange(const Id& id, const Id& start, const Id& end) {
+        return sub(sub(id, start), Id(1)) <= sub(sub(end, start), Id(1));
+    }
+
+    // id is in the open interval (start, end); start == end excludes only start
+    static constexpr bool inOpenRange(const Id& id, const Id& start, const Id& end) {
+        return sub(sub(id, start), Id(1)) < sub(sub(end, start), Id(1));
+    }
+
+    // Least significant 64 bits, for hashing and sharding
+    static constexpr uint64_t low64(const Id& id) {
+        return Ops::low64(id);
+    }
+
+    // Most significant 32 bits; the whole id on rings of at most 32 bits.
+    // Orders ids like the ids themselves, except that ids sharing their top
+    // 32 bits compare equal.
+    static constexpr uint32_t high32(const Id& id) {
+        return Ops::high32(id);
+    }
+
+    static constexpr bool kHigh32Exact = Bits <= 32;
+
+    // Little-endian serialization using exactly kBytes bytes
+    static void toBytes(const Id& id, uint8_t* out) {
+        Ops::toBytes(id, out);
+    }
+
+    static Id fromBytes(const uint8_t* in) {
+        return Ops::fromBytes(in);
+    }
+
+    static std::string toString(const Id& id) {
+        return Ops::toString(id);
+    }
+};
+
+// Width of the identifier space used by the Chord implementation. Override
+// at compile time (-DBITLENGTH=64, 128 or 160) for rings larger than the
+// 256-position demo.
+#ifndef BITLENGTH
+#define BITLENGTH 8
+#endif
+
+typedef Ring<BITLENGTH> ChordRing;
+typedef ChordRing::Id NodeId;
+
+// How a lookup travels between nodes. Both modes visit the same nodes.
+enum class RoutingMode : uint8_t {
+    Iterative,  // The origin asks every hop for the next one: a request and a reply per hop
+    Recursive   // Every hop forwards the request and the owner replies to the origin directly
+};
+
+#endif
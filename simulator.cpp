@@ -0,0 +1,346 @@
+#include "simulator.h"
+#include "parallel.h"
+#include <cmath>
+
+static uint64_t splitmix64(uint64_t x) {
+    x += 0x9e3779b97f4a7c15ULL;
+    x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    x = (x ^ (x >> 27)) * 0x94d049bb133111ebULL;
+    return x ^ (x >> 31);
+}
+
+Simulator::Simulator(const SimulatorOptions& options)
+    : options_(options), now_(0.0), sequence_(0), rng_(options.seed) {
+    if (options_.joinRate > 0) {
+        schedule(exponential(options_.joinRate), EventType::Join);
+    }
+    if (options_.leaveRate > 0) {
+        schedule(exponential(options_.leaveRate), EventType::Leave);
+    }
+    if (options_.failRate > 0) {
+        schedule(exponential(options_.failRate), EventType::Fail);
+    }
+    if (options_.lookupRate > 0) {
+        schedule(exponential(options_.lookupRate), EventType::Lookup);
+    }
+    if (options_.sampleInterval > 0) {
+        schedule(options_.sampleInterval, EventType::Sample);
+    }
+}
+
+Simulator::~Simulator() {
+    for (auto& entry : nodes_) {
+        delete entry.second;
+    }
+}
+
+void Simulator::bootstrap(size_t count) {
+    std::vector<Node*> ring;
+    while (ring.size() < count) {
+        NodeId id = randomId();
+        if (nodes_.count(id) == 0) {
+            Node* node = new Node(id);
+            nodes_[id] = node;
+            ring.push_back(node);
+        }
+    }
+    Node::buildRing(ring, std::vector<std::pair<NodeId, std::string> >(), options_.threads);
+    std::uniform_real_distribution<double> phase(0.0, 1.0);
+    for (Node* node : ring) {
+        addLive(node);
+        schedule(now_ + phase(rng_) * options_.stabilizeInterval, EventType::Stabilize, node);
+        schedule(now_ + phase(rng_) * options_.fixFingersInterval, EventType::FixFingers, node);
+    }
+}
+
+double Simulator::latency(NodeId a, NodeId b) const {
+    // Machine coordinates are a hash of the id, so no per-node table is kept
+    uint64_t ha = splitmix64(ChordRing::low64(a));
+    uint64_t hb = splitmix64(ChordRing::low64(b));
+    double dx = (double(uint32_t(ha)) - double(uint32_t(hb))) / 4294967296.0;
+    double dy = (double(ha >> 32) - double(hb >> 32)) / 4294967296.0;
+    double distance = std::sqrt((dx * dx + dy * dy) / 2.0);
+    return options_.minLatency + (options_.maxLatency - options_.minLatency) * distance;
+}
+
+void Simulator::schedule(double time, EventType type, Node* node) {
+    Event event;
+    event.time = time;
+    event.sequence = sequence_++;
+    event.type = type;
+    event.node = node;
+    queue_.push(event);
+}
+
+// Queue the next event of the stream or timer event belongs to; false if
+// event itself should be dropped because its node is gone
+bool Simulator::reschedule(const Event& event) {
+    switch (event.type) {
+    case EventType::Stabilize:
+    case EventType::FixFingers:
+        if (!event.node->isAlive()) {
+            return false;
+        }
+        schedule(event.time + (event.type == EventType::Stabilize ? options_.stabilizeInterval
+                                                                 : options_.fixFingersInterval),
+                 event.type, event.node);
+        return true;
+    case EventType::Join:
+        schedule(event.time + exponential(options_.joinRate), event.type);
+        return true;
+    case EventType::Leave:
+        schedule(event.time + exponential(options_.leaveRate), event.type);
+        return true;
+    case EventType::Fail:
+        schedule(event.time + exponential(options_.failRate), event.type);
+        return true;
+    case EventType::Lookup:
+        schedule(event.time + exponential(options_.lookupRate), event.type);
+        return true;
+    case EventType::Sample:
+        schedule(event.time + options_.sampleInterval, event.type);
+        return true;
+    }
+    return true;
+}
+
+void Simulator::dispatch(const Event& event) {
+    now_ = event.time;
+    stats_.events++;
+    uint64_t before = Node::messageCount();
+    switch (event.type) {
+    case EventType::Stabilize:
+    case EventType::FixFingers:
+        if (event.node->isAlive()) {
+            if (event.type == EventType::Stabilize) {
+                event.node->stabilize();
+            } else {
+                event.node->fixFingers();
+            }
+        }
+        stats_.maintenanceMessages += Node::messageCount() - before;
+        break;
+    case EventType::Join:
+        join();
+        stats_.churnMessages += Node::messageCount() - before;
+        break;
+    case EventType::Leave:
+    case EventType::Fail:
+        depart(event.type == EventType::Leave);
+        stats_.churnMessages += Node::messageCount() - before;
+        break;
+    case EventType::Lookup:
+        if (!live_.empty()) {
+            Node* origin = randomLive();
+            record(route(origin, randomId()));
+        }
+        break;
+    case EventType::Sample:
+        sample();
+        break;
+    }
+}
+
+void Simulator::run(double duration) {
+    Node::setRoutingMode(options_.routing);
+    double end = now_ + duration;
+    while (!queue_.empty() && queue_.top().time <= end) {
+        if (options_.threads > 1) {
+            double limit = queue_.top().time + options_.minLatency;
+            runWindow(std::min(limit, end), limit >= end);
+            continue;
+        }
+        Event event = queue_.top();
+        queue_.pop();
+        if (reschedule(event)) {
+            dispatch(event);
+        }
+    }
+    now_ = end;
+}
+
+// Take the events before limit, and those at limit when it ends the run;
+// the first event is always taken. Origins and keys are drawn in event
+// order, so a window gives the same lookups whatever the thread count.
+void Simulator::runWindow(double limit, bool inclusive) {
+    std::vector<std::pair<Node*, NodeId> > lookups;
+    std::vector<Event> others;
+    do {
+        Event event = queue_.top();
+        queue_.pop();
+        if (!reschedule(event)) {
+            continue;
+        }
+        if (event.type == EventType::Lookup) {
+            stats_.events++;
+            if (!live_.empty()) {
+                Node* origin = randomLive();
+                lookups.emplace_back(origin, randomId());
+            }
+        } else {
+            others.push_back(event);
+        }
+    } while (!queue_.empty() && (queue_.top().time < limit || (inclusive && queue_.top().time <= limit)));
+
+    std::vector<LookupOutcome> outcomes(lookups.size());
+    parallelFor(lookups.size(), options_.threads, [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; i++) {
+            outcomes[i] = route(lookups[i].first, lookups[i].second);
+        }
+    });
+    for (const LookupOutcome& outcome : outcomes) {
+        record(outcome);
+    }
+    for (const Event& event : others) {
+        dispatch(event);
+    }
+}
+
+double Simulator::exponential(double rate) {
+    return std::exponential_distribution<double>(rate)(rng_);
+}
+
+NodeId Simulator::randomId() {
+    // Fill every byte so wide rings are covered evenly
+    uint8_t bytes[ChordRing::kBytes];
+    uint64_t word = 0;
+    for (size_t i = 0; i < ChordRing::kBytes; i++) {
+        if (i % 8 == 0) {
+            word = rng_();
+        }
+        bytes[i] = static_cast<uint8_t>(word >> (8 * (i % 8)));
+    }
+    return ChordRing::fromBytes(bytes);
+}
+
+Node* Simulator::randomLive() {
+    return liveList_[std::uniform_int_distribution<size_t>(0, liveList_.size() - 1)(rng_)];
+}
+
+void Simulator::addLive(Node* node) {
+    live_[node->getId()] = node;
+    livePosition_[node] = liveList_.size();
+    liveList_.push_back(node);
+}
+
+void Simulator::removeLive(Node* node) {
+    live_.erase(node->getId());
+    auto it = livePosition_.find(node);
+    size_t position = it->second;
+    livePosition_.erase(it);
+    if (position + 1 != liveList_.size()) {
+        liveList_[position] = liveList_.back();
+        livePosition_[liveList_[position]] = position;
+    }
+    liveList_.pop_back();
+}
+
+// First live node at or after key
+Node* Simulator::liveSuccessor(NodeId key) const {
+    auto it = live_.lower_bound(key);
+    return it != live_.end() ? it->second : live_.begin()->second;
+}
+
+// Run the lookup on the ring and price its route. At every hop from a to b
+// the nodes a would have tried first are the dead ones it knows between b
+// and the key, or between a and b when b is the owner; each costs a timeout.
+Simulator::LookupOutcome Simulator::route(Node* origin, NodeId key) const {
+    LookupOutcome outcome;
+    LookupResult result = origin->lookup(key, true);
+    outcome.hops = result.hops;
+    outcome.messages = result.messages;
+    outcome.roundTrips = result.roundTrips;
+    bool iterative = options_.routing == RoutingMode::Iterative;
+    outcome.ok = result.node != nullptr && !result.looped && result.node == liveSuccessor(key);
+    for (size_t i = 0; i + 1 < result.path.size(); i++) {
+        Node* from = nodes_.at(result.path[i]);
+        NodeId to = result.path[i + 1];
+        bool last = ChordRing::inRange(key, from->getId(), to);
+        NodeId start = last ? from->getId() : to;
+        NodeId end = last ? to : key;
+        Node* previous = nullptr;
+        const FingerTable& fingers = from->getFingerTable();
+        for (size_t k = BITLENGTH; k >= 1; k--) {
+            Node* finger = fingers.getNodePtr(k);
+            if (finger != nullptr && finger != previous && !finger->isAlive() && ChordRing::inOpenRange(finger->getId(), start, end)) {
+                outcome.timeouts++;
+            }
+            previous = finger;
+        }
+        const SuccessorList& successors = from->getSuccessorList();
+        for (size_t s = 0; s < successors.size(); s++) {
+            Node* entry = successors.get(s);
+            if (!entry->isAlive() && ChordRing::inOpenRange(entry->getId(), start, end) &&
+                entry != fingers.getNodePtr(1)) {
+                outcome.timeouts++;
+            }
+        }
+        outcome.latency += iterative ? 2 * latency(origin->getId(), to) : latency(result.path[i], to);
+    }
+    if (!iterative && result.path.size() > 1) {
+        outcome.latency += latency(result.path.back(), origin->getId());
+    }
+    outcome.latency += outcome.timeouts * options_.timeout;
+    return outcome;
+}
+
+void Simulator::record(const LookupOutcome& outcome) {
+    stats_.lookups++;
+    stats_.hops += outcome.hops;
+    stats_.timeouts += outcome.timeouts;
+    stats_.lookupMessages += outcome.messages + outcome.timeouts;
+    stats_.roundTrips += outcome.roundTrips;
+    if (outcome.ok) {
+        stats_.latencies.push_back(outcome.latency);
+    } else {
+        stats_.failedLookups++;
+    }
+}
+
+void Simulator::join() {
+    NodeId id = randomId();
+    // Small rings run out of ids; a departed node's id is never reused
+    if (nodes_.count(id) != 0) {
+        return;
+    }
+    Node* node = new Node(id);
+    nodes_[id] = node;
+    node->join(live_.empty() ? nullptr : randomLive());
+    addLive(node);
+    stats_.joins++;
+    std::uniform_real_distribution<double> phase(0.0, 1.0);
+    schedule(now_ + phase(rng_) * options_.stabilizeInterval, EventType::Stabilize, node);
+    schedule(now_ + phase(rng_) * options_.fixFingersInterval, EventType::FixFingers, node);
+}
+
+void Simulator::depart(bool graceful) {
+    if (live_.size() <= 1) {
+        return;
+    }
+    Node* node = randomLive();
+    removeLive(node);
+    if (graceful) {
+        node->leave();
+        stats_.leaves++;
+    } else {
+        node->fail();
+        stats_.failures++;
+    }
+}
+
+void Simulator::sample() {
+    if (live_.empty()) {
+        return;
+    }
+    size_t count = std::min(options_.sampleNodes, live_.size());
+    for (size_t i = 0; i < count; i++) {
+        Node* node = randomLive();
+        const FingerTable& fingers = node->getFingerTable();
+        for (size_t k = 1; k <= BITLENGTH; k++) {
+            stats_.fingersSampled++;
+            if (fingers.getNodePtr(k) != liveSuccessor(ChordRing::fingerStart(node->getId(), k))) {
+                stats_.staleFingers++;
+            }
+        }
+    }
+}
@@ -0,0 +1,156 @@
+#ifndef SIMULATOR_H
+#define SIMULATOR_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <functional>
+#include <map>
+#include <queue>
+#include <random>
+#include <unordered_map>
+#include <vector>
+#include "node.h"
+
+// Settings for Simulator; all times are virtual seconds
+struct SimulatorOptions {
+    double stabilizeInterval = 30.0;   // Period of stabilize at every node
+    double fixFingersInterval = 10.0;  // Period of fixFingers, which refreshes one finger per call
+    double minLatency = 0.005;         // One-way latency between the closest machines...
+    double maxLatency = 0.150;         // ... and between the farthest ones
+    double timeout = 0.5;              // Charged for every dead node a lookup sends to
+    double joinRate = 0.0;             // Churn: Poisson arrivals per second over the whole ring
+    double leaveRate = 0.0;            // Graceful departures per second
+    double failRate = 0.0;             // Crashes per second
+    double lookupRate = 0.0;           // Lookups per second, each from a random live node for a random key
+    double sampleInterval = 0.0;       // Period of finger staleness samples; 0 takes none
+    size_t sampleNodes = 100;          // Live nodes whose fingers each sample checks
+    size_t threads = 1;                // More than one runs the lookups of each lookahead window in parallel
+    RoutingMode routing = RoutingMode::Recursive;  // Set on Node by run; prices lookups and maintenance
+    uint64_t seed = 1;
+};
+
+// Counters collected by Simulator since construction or resetStats
+struct SimulatorStats {
+    uint64_t events = 0;
+    uint64_t lookups = 0;
+    uint64_t failedLookups = 0;        // Looped, reached no live node, or reached one that is not the key's live successor
+    uint64_t hops = 0;                 // Over all lookups
+    uint64_t timeouts = 0;             // Dead fingers and successors lookups tried before a live one
+    uint64_t lookupMessages = 0;       // Sent by lookups, replies and timed out requests included
+    uint64_t roundTrips = 0;           // Requests lookup origins waited for in turn
+    uint64_t maintenanceMessages = 0;  // Sent by stabilize and fixFingers
+    uint64_t churnMessages = 0;        // Sent by joins and graceful leaves
+    uint64_t joins = 0;
+    uint64_t leaves = 0;
+    uint64_t failures = 0;
+    uint64_t fingersSampled = 0;
+    uint64_t staleFingers = 0;         // Sampled fingers that do not name the live successor of their start
+    std::vector<double> latencies;     // End-to-end time of every successful lookup
+};
+
+// Discrete-event simulation of an in-process ring over virtual time. A
+// binary-heap event queue drives periodic stabilize and fixFingers at every
+// node (at random phases), Poisson streams of joins, graceful leaves, crashes
+// and lookups, and periodic samples of how stale finger tables are.
+//
+// Every machine sits at a point of the unit square derived from its id, and
+// a message between two machines takes minLatency plus their distance scaled
+// to maxLatency. Each event runs atomically on the current ring at its
+// virtual time; a lookup is then charged the latency of its route and one
+// timeout for each dead node it would have tried first. A recursive route
+// costs every hop and the owner's reply to the origin; an iterative one a
+// round trip from the origin to every hop.
+//
+// With threads > 1 the run is conservative-parallel: events are taken in
+// windows of minLatency, no message can arrive within the window it was sent
+// in, so the window's lookups all see the ring as it was at the start of the
+// window and run in parallel, and the other events then run in time order.
+// Results depend on the windowing, not on the thread count.
+class Simulator {
+public:
+    explicit Simulator(const SimulatorOptions& options = SimulatorOptions());
+    ~Simulator();
+
+    Simulator(const Simulator&) = delete;
+    Simulator& operator=(const Simulator&) = delete;
+
+    /**
+     * Add count nodes at random ids as one ring built with Node::buildRing
+     * and start their maintenance timers. Only valid before the first join.
+     */
+    void bootstrap(size_t count);
+
+    // Process every event up to virtual time now() + duration
+    void run(double duration);
+
+    double now() const {
+        return now_;
+    }
+
+    size_t liveCount() const {
+        return live_.size();
+    }
+
+    const SimulatorStats& getStats() const {
+        return stats_;
+    }
+
+    void resetStats() {
+        stats_ = SimulatorStats();
+    }
+
+    // One-way message latency between the machines of two nodes
+    double latency(NodeId a, NodeId b) const;
+
+private:
+    enum class EventType : uint8_t { Stabilize, FixFingers, Join, Leave, Fail, Lookup, Sample };
+
+    struct Event {
+        double time;
+        uint64_t sequence;  // Events at the same time run in scheduling order
+        EventType type;
+        Node* node;         // Target of Stabilize and FixFingers
+
+        bool operator>(const Event& other) const {
+            return time != other.time ? time > other.time : sequence > other.sequence;
+        }
+    };
+
+    struct LookupOutcome {
+        bool ok = false;
+        uint32_t hops = 0;
+        uint32_t messages = 0;
+        uint32_t roundTrips = 0;
+        uint32_t timeouts = 0;
+        double latency = 0.0;
+    };
+
+    void schedule(double time, EventType type, Node* node = nullptr);
+    bool reschedule(const Event& event);
+    void dispatch(const Event& event);
+    void runWindow(double limit, bool inclusive);
+    double exponential(double rate);
+    NodeId randomId();
+    Node* randomLive();
+    void addLive(Node* node);
+    void removeLive(Node* node);
+    Node* liveSuccessor(NodeId key) const;
+    LookupOutcome route(Node* origin, NodeId key) const;
+    void record(const LookupOutcome& outcome);
+    void join();
+    void depart(bool graceful);
+    void sample();
+
+    SimulatorOptions options_;
+    std::priority_queue<Event, std::vector<Event>, std::greater<Event> > queue_;
+    double now_;
+    uint64_t sequence_;
+    std::mt19937_64 rng_;
+    std::map<NodeId, Node*> nodes_;  // Every node ever created, owned; departed ones stay for stale pointers
+    std::map<NodeId, Node*> live_;   // Ground truth for key ownership
+    std::vector<Node*> liveList_;    // live_ again, for uniform picks
+    std::unordered_map<Node*, size_t> livePosition_;
+    SimulatorStats stats_;
+};
+
+#endif
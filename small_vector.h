@@ -0,0 +1,116 @@
+#ifndef SMALL_VECTOR_H
+#define SMALL_VECTOR_H
+
+#include <stddef.h>
+#include <algorithm>
+#include <initializer_list>
+#include <vector>
+
+// Vector that keeps its first N elements inline and only touches the heap
+// when it grows past them. Used for lookup paths, which are O(log N) long.
+// T must be default-constructible and copyable.
+template <typename T, size_t N>
+class SmallVector {
+public:
+    typedef T value_type;
+    typedef T* iterator;
+    typedef const T* const_iterator;
+
+    SmallVector() : size_(0) {}
+
+    SmallVector(std::initializer_list<T> init) : size_(0) {
+        for (const T& v : init) {
+            push_back(v);
+        }
+    }
+
+    SmallVector(const SmallVector& other) : size_(0) {
+        *this = other;
+    }
+
+    SmallVector& operator=(const SmallVector& other) {
+        if (this != &other) {
+            clear();
+            for (const T& v : other) {
+                push_back(v);
+            }
+        }
+        return *this;
+    }
+
+    void push_back(const T& v) {
+        if (size_ < N) {
+            inline_[size_] = v;
+        } else {
+            if (size_ == N) {
+                overflow_.assign(inline_, inline_ + N);
+            }
+            overflow_.push_back(v);
+        }
+        ++size_;
+    }
+
+    void pop_back() {
+        --size_;
+        if (size_ >= N) {
+            overflow_.pop_back();
+            if (size_ == N) {
+                std::copy(overflow_.begin(), overflow_.end(), inline_);
+                overflow_.clear();
+            }
+        }
+    }
+
+    void clear() {
+        size_ = 0;
+        overflow_.clear();
+    }
+
+    size_t size() const {
+        return size_;
+    }
+
+    bool empty() const {
+        return size_ == 0;
+    }
+
+    bool isInline() const {
+        return size_ <= N;
+    }
+
+    T* data() {
+        return size_ <= N ? inline_ : overflow_.data();
+    }
+
+    const T* data() const {
+        return size_ <= N ? inline_ : overflow_.data();
+    }
+
+    T& operator[](size_t i) {
+        return data()[i];
+    }
+
+    const T& operator[](size_t i) const {
+        return data()[i];
+    }
+
+    T& back() {
+        return data()[size_ - 1];
+    }
+
+    const T& back() const {
+        return data()[size_ - 1];
+    }
+
+    iterator begin() { return data(); }
+    iterator end() { return data() + size_; }
+    const_iterator begin() const { return data(); }
+    const_iterator end() const { return data() + size_; }
+
+private:
+    T inline_[N];
+    std::vector<T> overflow_;  // Holds all elements once size_ exceeds N
+    size_t size_;
+};
+
+#endif
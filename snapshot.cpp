@@ -0,0 +1,415 @@
+#include "snapshot.h"
+#include "parallel.h"
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <unordered_map>
+
+static const char kSnapshotMagic[8] = {'C', 'H', 'O', 'R', 'D', 'S', 'N', 'P'};
+static const uint32_t kSnapshotVersion = 1;
+static const uint32_t kByteOrderMark = 0x01020304;
+static const uint32_t kNoNode = 0xFFFFFFFF;
+
+// File header; every section starts on an 8-byte boundary
+struct SnapshotHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t bits;            // BITLENGTH of the writer
+    uint32_t byteOrder;       // kByteOrderMark as the writer stored it
+    uint32_t nodeBytes;       // sizeof(SnapshotNode) and sizeof(SnapshotSlot) of the writer
+    uint32_t slotBytes;
+    uint32_t reserved;
+    uint64_t nodeCount;
+    uint64_t keyCount;
+    uint64_t successorCount;  // Entries over all successor lists
+    uint64_t dataBytes;
+    uint64_t nodesOffset;     // SnapshotNode[nodeCount]
+    uint64_t fingersOffset;   // uint32_t[nodeCount][BITLENGTH], finger k of node i at [i][k - 1]
+    uint64_t successorsOffset;  // uint32_t[successorCount]
+    uint64_t slotsOffset;     // SnapshotSlot[keyCount]
+    uint64_t dataOffset;      // char[dataBytes]
+};
+
+struct SnapshotNode {
+    NodeId id;
+    uint32_t predecessor;     // Node index, or kNoNode
+    uint32_t alive;
+    uint64_t firstSuccessor;  // Run of the successors section
+    uint64_t successorCount;
+    uint64_t firstSlot;       // Run of the slots section
+    uint64_t slotCount;
+};
+
+static uint64_t align8(uint64_t offset) {
+    return (offset + 7) & ~uint64_t(7);
+}
+
+bool SnapshotStore::lookup(NodeId id, KeyValue* entry) const {
+    if (owned_) {
+        return owned_->lookup(id, entry);
+    }
+    const SnapshotSlot* end = slots_ + count_;
+    const SnapshotSlot* it = std::lower_bound(slots_, end, id,
+                                              [](const SnapshotSlot& slot, const NodeId& key) { return slot.id < key; });
+    if (it == end || it->id != id) {
+        return false;
+    }
+    *entry = entryAt(it - slots_);
+    return true;
+}
+
+KeyValue SnapshotStore::entryAt(size_t index) const {
+    if (owned_) {
+        return owned_->entryAt(index);
+    }
+    const SnapshotSlot& slot = slots_[index];
+    KeyValue kv;
+    kv.first = slot.id;
+    kv.key = ByteView(data_ + slot.offset, slot.keyLength);
+    kv.second = ByteView(data_ + slot.offset + slot.keyLength, slot.valueLength);
+    return kv;
+}
+
+// Copy the mapped entries into an owned store before the first write
+void SnapshotStore::materialize() {
+    if (owned_) {
+        return;
+    }
+    std::unique_ptr<SortedVectorStore> owned(new SortedVectorStore());
+    size_t bytes = 0;
+    for (size_t i = 0; i < count_; i++) {
+        bytes += slots_[i].keyLength + slots_[i].valueLength;
+    }
+    owned->reserve(count_, bytes);
+    for (size_t i = 0; i < count_; i++) {
+        KeyValue kv = entryAt(i);
+        owned->put(kv.first, kv.key, kv.second);
+    }
+    owned_ = std::move(owned);
+}
+
+void SnapshotStore::put(NodeId id, ByteView key, ByteView value) {
+    materialize();
+    owned_->put(id, key, value);
+}
+
+void SnapshotStore::putShared(NodeId id, ByteView key, const ValueBuffer* value) {
+    materialize();
+    owned_->putShared(id, key, value);
+}
+
+bool SnapshotStore::erase(NodeId id) {
+    if (!owned_ && !contains(id)) {
+        return false;
+    }
+    materialize();
+    return owned_->erase(id);
+}
+
+size_t SnapshotStore::extractRange(NodeId start, NodeId end, KeyStore& dest) {
+    materialize();
+    return owned_->extractRange(start, end, dest);
+}
+
+size_t SnapshotStore::eraseRange(NodeId start, NodeId end) {
+    materialize();
+    return owned_->eraseRange(start, end);
+}
+
+void SnapshotStore::clear() {
+    owned_.reset(new SortedVectorStore());
+}
+
+RingSnapshot::RingSnapshot() : base_(nullptr), size_(0) {
+}
+
+RingSnapshot::~RingSnapshot() {
+    unload();
+}
+
+void RingSnapshot::unload() {
+    for (Node* node : nodes_) {
+        delete node;
+    }
+    nodes_.clear();
+    if (base_ != nullptr) {
+        munmap(const_cast<char*>(base_), size_);
+        base_ = nullptr;
+        size_ = 0;
+    }
+}
+
+size_t RingSnapshot::keyCount() const {
+    return base_ != nullptr ? reinterpret_cast<const SnapshotHeader*>(base_)->keyCount : 0;
+}
+
+// Buffered writer that remembers the first error
+class SnapshotWriter {
+public:
+    explicit SnapshotWriter(const std::string& path) : file_(std::fopen(path.c_str(), "wb")), offset_(0) {
+        if (file_ != nullptr) {
+            std::setvbuf(file_, nullptr, _IOFBF, 1 << 20);
+        }
+    }
+
+    ~SnapshotWriter() {
+        if (file_ != nullptr) {
+            std::fclose(file_);
+        }
+    }
+
+    void write(const void* data, size_t len) {
+        if (file_ != nullptr && len > 0 && std::fwrite(data, 1, len, file_) != len) {
+            failed_ = true;
+        }
+        offset_ += len;
+    }
+
+    // Zero-pad to the next 8-byte boundary and return the offset there
+    uint64_t align() {
+        static const char zeros[8] = {};
+        write(zeros, align8(offset_) - offset_);
+        return offset_;
+    }
+
+    bool rewind() {
+        return file_ != nullptr && std::fseek(file_, 0, SEEK_SET) == 0;
+    }
+
+    bool finish() {
+        bool ok = file_ != nullptr && !failed_ && std::fflush(file_) == 0;
+        if (file_ != nullptr && std::fclose(file_) != 0) {
+            ok = false;
+        }
+        file_ = nullptr;
+        return ok;
+    }
+
+private:
+    FILE* file_;
+    uint64_t offset_;
+    bool failed_ = false;
+};
+
+bool RingSnapshot::save(const std::vector<Node*>& nodes, const std::string& path) {
+    std::vector<Node*> sorted(nodes);
+    std::sort(sorted.begin(), sorted.end(), [](Node* a, Node* b) { return a->getId() < b->getId(); });
+    size_t n = sorted.size();
+    std::unordered_map<const Node*, uint32_t> index;
+    index.reserve(n);
+    for (size_t i = 0; i < n; i++) {
+        index[sorted[i]] = static_cast<uint32_t>(i);
+    }
+    auto indexOf = [&](const Node* node) -> uint32_t {
+        if (node == nullptr || n == 0) {
+            return kNoNode;
+        }
+        auto it = index.find(node);
+        if (it != index.end()) {
+            return it->second;
+        }
+        // Not part of the saved ring: stand in the first node after it
+        size_t i = std::lower_bound(sorted.begin(), sorted.end(), node->getId(),
+                                    [](Node* a, const NodeId& id) { return a->getId() < id; }) - sorted.begin();
+        return static_cast<uint32_t>(i == n ? 0 : i);
+    };
+
+    SnapshotHeader header = {};
+    std::memcpy(header.magic, kSnapshotMagic, sizeof(kSnapshotMagic));
+    header.version = kSnapshotVersion;
+    header.bits = BITLENGTH;
+    header.byteOrder = kByteOrderMark;
+    header.nodeBytes = sizeof(SnapshotNode);
+    header.slotBytes = sizeof(SnapshotSlot);
+    header.nodeCount = n;
+
+    std::vector<SnapshotNode> records(n);  // Value-initialized, so unset fields write as zero
+    for (size_t i = 0; i < n; i++) {
+        Node* node = sorted[i];
+        SnapshotNode& record = records[i];
+        record.id = node->getId();
+        record.predecessor = indexOf(node->getPredecessor());
+        record.alive = node->isAlive() ? 1 : 0;
+        record.firstSuccessor = header.successorCount;
+        record.successorCount = node->getSuccessorList().size();
+        record.firstSlot = header.keyCount;
+        record.slotCount = node->getLocalKeys().size();
+        header.successorCount += record.successorCount;
+        header.keyCount += record.slotCount;
+    }
+
+    SnapshotWriter out(path);
+    out.write(&header, sizeof(header));
+    header.nodesOffset = out.align();
+    out.write(records.data(), n * sizeof(SnapshotNode));
+
+    header.fingersOffset = out.align();
+    std::vector<uint32_t> fingers(BITLENGTH);
+    for (Node* node : sorted) {
+        for (size_t k = 1; k <= BITLENGTH; k++) {
+            fingers[k - 1] = indexOf(node->getFingerTable().getNodePtr(k));
+        }
+        out.write(fingers.data(), BITLENGTH * sizeof(uint32_t));
+    }
+
+    header.successorsOffset = out.align();
+    for (size_t i = 0; i < n; i++) {
+        const SuccessorList& list = sorted[i]->getSuccessorList();
+        for (size_t s = 0; s < records[i].successorCount; s++) {
+            uint32_t entry = indexOf(list.get(s));
+            out.write(&entry, sizeof(entry));
+        }
+    }
+
+    header.slotsOffset = out.align();
+    for (size_t i = 0; i < n; i++) {
+        const KeyStore& keys = sorted[i]->getLocalKeys();
+        for (size_t k = 0; k < records[i].slotCount; k++) {
+            KeyValue kv = keys.entryAt(k);
+            SnapshotSlot slot{};
+            slot.id = kv.first;
+            slot.keyLength = static_cast<uint32_t>(kv.key.size);
+            slot.valueLength = static_cast<uint32_t>(kv.second.size);
+            slot.offset = header.dataBytes;
+            header.dataBytes += kv.key.size + kv.second.size;
+            out.write(&slot, sizeof(slot));
+        }
+    }
+
+    header.dataOffset = out.align();
+    for (size_t i = 0; i < n; i++) {
+        const KeyStore& keys = sorted[i]->getLocalKeys();
+        for (size_t k = 0; k < records[i].slotCount; k++) {
+            KeyValue kv = keys.entryAt(k);
+            out.write(kv.key.data, kv.key.size);
+            out.write(kv.second.data, kv.second.size);
+        }
+    }
+    out.align();
+
+    if (!out.rewind()) {
+        return false;
+    }
+    out.write(&header, sizeof(header));
+    return out.finish();
+}
+
+bool RingSnapshot::load(const std::string& path, size_t threads) {
+    unload();
+    if (threads == 0) {
+        threads = std::max(1u, std::thread::hardware_concurrency());
+    }
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        return false;
+    }
+    struct stat info;
+    if (fstat(fd, &info) != 0 || static_cast<size_t>(info.st_size) < sizeof(SnapshotHeader)) {
+        close(fd);
+        return false;
+    }
+    size_t size = static_cast<size_t>(info.st_size);
+    void* mapping = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (mapping == MAP_FAILED) {
+        return false;
+    }
+    base_ = static_cast<const char*>(mapping);
+    size_ = size;
+
+    const SnapshotHeader& header = *reinterpret_cast<const SnapshotHeader*>(base_);
+    auto fits = [size](uint64_t offset, uint64_t count, uint64_t bytes) {
+        return offset <= size && (bytes == 0 || count <= (size - offset) / bytes);
+    };
+    uint64_t n = header.nodeCount;
+    if (std::memcmp(header.magic, kSnapshotMagic, sizeof(kSnapshotMagic)) != 0 ||
+        header.version != kSnapshotVersion || header.bits != BITLENGTH || header.byteOrder != kByteOrderMark ||
+        header.nodeBytes != sizeof(SnapshotNode) || header.slotBytes != sizeof(SnapshotSlot) || n >= kNoNode ||
+        !fits(header.nodesOffset, n, sizeof(SnapshotNode)) ||
+        !fits(header.fingersOffset, n, BITLENGTH * sizeof(uint32_t)) ||
+        !fits(header.successorsOffset, header.successorCount, sizeof(uint32_t)) ||
+        !fits(header.slotsOffset, header.keyCount, sizeof(SnapshotSlot)) || !fits(header.dataOffset, header.dataBytes, 1)) {
+        unload();
+        return false;
+    }
+    const SnapshotNode* records = reinterpret_cast<const SnapshotNode*>(base_ + header.nodesOffset);
+    const uint32_t* fingers = reinterpret_cast<const uint32_t*>(base_ + header.fingersOffset);
+    const uint32_t* successors = reinterpret_cast<const uint32_t*>(base_ + header.successorsOffset);
+    const SnapshotSlot* slots = reinterpret_cast<const SnapshotSlot*>(base_ + header.slotsOffset);
+    const char* data = base_ + header.dataOffset;
+
+    // Node records index into the other sections and slots into the data
+    // section; check them all, and that every node's slots are in id order
+    // for SnapshotStore's binary search, before any pointer is followed
+    std::atomic<bool> valid(true);
+    parallelFor(n, threads, [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; i++) {
+            const SnapshotNode& record = records[i];
+            bool ok = (record.predecessor < n || record.predecessor == kNoNode) &&
+                      record.successorCount <= SuccessorList::kCapacity &&
+                      record.firstSuccessor <= header.successorCount &&
+                      record.successorCount <= header.successorCount - record.firstSuccessor &&
+                      record.firstSlot <= header.keyCount && record.slotCount <= header.keyCount - record.firstSlot;
+            for (size_t k = 0; ok && k < BITLENGTH; k++) {
+                ok = fingers[i * BITLENGTH + k] < n;
+            }
+            for (size_t s = 0; ok && s < record.successorCount; s++) {
+                ok = successors[record.firstSuccessor + s] < n;
+            }
+            const SnapshotSlot* run = slots + record.firstSlot;
+            for (size_t k = 0; ok && k < record.slotCount; k++) {
+                ok = run[k].offset <= header.dataBytes &&
+                     static_cast<uint64_t>(run[k].keyLength) + run[k].valueLength <= header.dataBytes - run[k].offset &&
+                     (k == 0 || run[k - 1].id < run[k].id);
+            }
+            if (!ok) {
+                valid.store(false, std::memory_order_relaxed);
+                return;
+            }
+        }
+    });
+    if (!valid.load()) {
+        unload();
+        return false;
+    }
+
+    nodes_.assign(n, nullptr);
+    parallelFor(n, threads, [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; i++) {
+            const SnapshotNode& record = records[i];
+            nodes_[i] = new Node(record.id, std::unique_ptr<KeyStore>(
+                                                new SnapshotStore(slots + record.firstSlot, record.slotCount, data)));
+        }
+    });
+
+    parallelFor(n, threads, [&](size_t begin, size_t end) {
+        Node* table[BITLENGTH + 1];
+        Node* list[SuccessorList::kCapacity];
+        for (size_t i = begin; i < end; i++) {
+            const SnapshotNode& record = records[i];
+            Node* node = nodes_[i];
+            table[0] = nullptr;
+            for (size_t k = 1; k <= BITLENGTH; k++) {
+                table[k] = nodes_[fingers[i * BITLENGTH + k - 1]];
+            }
+            node->fingerTable_.assign(table);
+            for (size_t s = 0; s < record.successorCount; s++) {
+                list[s] = nodes_[successors[record.firstSuccessor + s]];
+            }
+            if (record.successorCount > node->successors_.length()) {
+                node->successors_.setLength(record.successorCount);
+            }
+            node->successors_.assign(list, record.successorCount);
+            node->predecessor_.store(record.predecessor == kNoNode ? nullptr : nodes_[record.predecessor],
+                                     std::memory_order_release);
+            node->alive_.store(record.alive != 0, std::memory_order_release);
+        }
+    });
+    Node::advanceRingEpoch();
+    return true;
+}
@@ -0,0 +1,102 @@
+#ifndef SNAPSHOT_H
+#define SNAPSHOT_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <memory>
+#include <string>
+#include <vector>
+#include "node.h"
+
+// One key in a snapshot file; key and value bytes live in the data section
+struct SnapshotSlot {
+    NodeId id;
+    uint32_t keyLength;
+    uint32_t valueLength;
+    uint64_t offset;  // Key bytes, followed by the value bytes, from the start of the data section
+};
+
+// A node's keys read in place from a mapped snapshot. Lookups binary-search
+// the node's run of slots and return views into the mapping, so loading a
+// ring copies no keys. The first write copies the entries into an owned
+// SortedVectorStore, which serves everything from then on.
+class SnapshotStore : public KeyStore {
+public:
+    SnapshotStore(const SnapshotSlot* slots, size_t count, const char* data)
+        : slots_(slots), count_(count), data_(data) {}
+
+    bool lookup(NodeId id, KeyValue* entry) const override;
+    void put(NodeId id, ByteView key, ByteView value) override;
+    void putShared(NodeId id, ByteView key, const ValueBuffer* value) override;
+    bool erase(NodeId id) override;
+    size_t extractRange(NodeId start, NodeId end, KeyStore& dest) override;
+    size_t eraseRange(NodeId start, NodeId end) override;
+    KeyValue entryAt(size_t index) const override;
+    void clear() override;
+
+    size_t size() const override {
+        return owned_ ? owned_->size() : count_;
+    }
+
+    using KeyStore::put;
+    using KeyStore::get;
+
+private:
+    void materialize();
+
+    const SnapshotSlot* slots_;
+    size_t count_;
+    const char* data_;
+    std::unique_ptr<SortedVectorStore> owned_;  // Set once the store has been written to
+};
+
+// Whole-ring snapshots for starting large simulations without replaying
+// joins and inserts. The file is versioned and laid out to be mapped as is:
+// a header, one record per node (id, predecessor and successor list as node
+// indices, and its run of key slots), every finger table as node indices,
+// the key slots of all nodes sorted by node and id, and the key and value
+// bytes. Ids are stored in the in-memory NodeId layout, so a snapshot loads
+// only on a build with the same BITLENGTH and byte order.
+class RingSnapshot {
+public:
+    RingSnapshot();
+    ~RingSnapshot();
+
+    RingSnapshot(const RingSnapshot&) = delete;
+    RingSnapshot& operator=(const RingSnapshot&) = delete;
+
+    /**
+     * Write the ring formed by nodes to path. Location caches and replica
+     * copies are not saved; stabilize rebuilds the replicas after loading.
+     * Fingers or list entries naming a node outside nodes are saved as the
+     * first node in nodes at or after that node's id.
+     * @return false if the file could not be written.
+     */
+    static bool save(const std::vector<Node*>& nodes, const std::string& path);
+
+    /**
+     * Map the snapshot at path and rebuild its nodes, wired exactly as they
+     * were saved. Keys stay in the mapping (see SnapshotStore), so the
+     * snapshot must outlive its nodes: they are deleted with it.
+     * @param threads: worker threads for creating and wiring nodes; 0 uses every core.
+     * @return false if the file is missing, truncated, or from another
+     *         format version or ring width.
+     */
+    bool load(const std::string& path, size_t threads = 1);
+
+    // Loaded nodes, sorted by id
+    std::vector<Node*>& getNodes() {
+        return nodes_;
+    }
+
+    size_t keyCount() const;
+
+private:
+    void unload();
+
+    std::vector<Node*> nodes_;
+    const char* base_;  // Mapping of the whole file
+    size_t size_;
+};
+
+#endif
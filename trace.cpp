@@ -0,0 +1,108 @@
+#include "trace.h"
+#include "node.h"
+
+void StreamTraceSink::onJoin(Node& node, const Node* bootstrap) {
+    if (bootstrap == nullptr) {
+        out_ << "Node " << ChordRing::toString(node.getId()) << " is the first node to join the Chord network." << std::endl;
+    } else {
+        out_ << "Node " << ChordRing::toString(node.getId()) << " joined with successor "
+             << ChordRing::toString(node.getFingerTable().getNodePtr(1)->getId()) << std::endl;
+    }
+}
+
+void StreamTraceSink::onJoinComplete(Node& node) {
+    // Print the finger table
+    node.getFingerTable().prettyPrint(out_);
+}
+
+void StreamTraceSink::onLeave(Node& node) {
+    out_ << "Node " << ChordRing::toString(node.getId()) << " is leaving the network." << std::endl;
+}
+
+void StreamTraceSink::onLeaveComplete(Node& node, Node* predecessor, Node* successor) {
+    if (successor == nullptr) {
+        out_ << "Node " << ChordRing::toString(node.getId()) << " was the only node in the network." << std::endl;
+        return;
+    }
+
+    out_ << "Node " << ChordRing::toString(node.getId()) << " has left the network." << std::endl;
+
+    // Print updated finger tables of affected nodes
+    if (predecessor != nullptr) {
+        out_ << "Updated finger table of predecessor:" << std::endl;
+        out_ << "Node id:" << ChordRing::toString(predecessor->getId())
+             << " Predecessor: " << ChordRing::toString(predecessor->getPredecessor()->getId()) << std::endl;
+        predecessor->getFingerTable().prettyPrint(out_);
+    }
+
+    out_ << "Updated finger table of successor:" << std::endl;
+    out_ << "Node id:" << ChordRing::toString(successor->getId())
+         << " Predecessor: " << ChordRing::toString(successor->getPredecessor()->getId()) << std::endl;
+    successor->getFingerTable().prettyPrint(out_);
+}
+
+void StreamTraceSink::onLookup(const Node& origin, NodeId key, const LookupResult& result) {
+    out_ << "Look-up result of key " << ChordRing::toString(key)
+         << " from node " << ChordRing::toString(origin.getId()) << " with path [";
+
+    if (result.looped) {
+        out_ << "Loop detected in lookup!" << std::endl;
+    }
+
+    // Print the path
+    for (size_t i = 0; i < result.path.size(); i++) {
+        out_ << ChordRing::toString(result.path[i]);
+        if (i < result.path.size() - 1) {
+            out_ << ",";
+        }
+    }
+
+    out_ << "] value is " << (result.found ? result.value.toDisplayString() : "None") << std::endl;
+}
+
+void StreamTraceSink::onInsert(const Node& /* origin */, NodeId key, ByteView value, const Node& owner) {
+    out_ << "Key " << ChordRing::toString(key) << " with value " << value.toDisplayString()
+         << " inserted at node " << ChordRing::toString(owner.getId()) << std::endl;
+}
+
+void StreamTraceSink::onRemove(const Node& /* origin */, NodeId key, const Node& owner, bool found) {
+    if (found) {
+        out_ << "Key " << ChordRing::toString(key) << " removed from node "
+             << ChordRing::toString(owner.getId()) << std::endl;
+    } else {
+        out_ << "Key " << ChordRing::toString(key) << " not found" << std::endl;
+    }
+}
+
+void StreamTraceSink::onMigrate(NodeId key, const Node& from, const Node& to) {
+    out_ << "Migrate key " << ChordRing::toString(key)
+         << " from node " << ChordRing::toString(from.getId())
+         << " to node " << ChordRing::toString(to.getId()) << std::endl;
+}
+
+void StreamTraceSink::onBatch(const Node& origin, const char* op, const BatchResult& result) {
+    uint64_t totalHops = 0;
+    for (const LookupResult& r : result.results) {
+        totalHops += r.hops;
+    }
+    out_ << "Batch " << op << " of " << result.results.size() << " keys from node "
+         << ChordRing::toString(origin.getId()) << ": " << result.messages << " messages, "
+         << (result.results.empty() ? 0.0 : static_cast<double>(totalHops) / result.results.size())
+         << " avg hops, " << result.keysPerSecond() << " keys/s" << std::endl;
+}
+
+void StreamTraceSink::onShuffle(const Node& origin, double variance) {
+    out_ << "Performing Space Shuffle optimization for node " << ChordRing::toString(origin.getId()) << std::endl;
+    out_ << "Variance before optimization: " << variance << std::endl;
+}
+
+void StreamTraceSink::onShuffleMigrate(NodeId key, ByteView value, const Node& from, const Node& to) {
+    out_ << "Space Shuffle: Migrated key " << ChordRing::toString(key) << " with value " << value.toDisplayString()
+         << " from node " << ChordRing::toString(from.getId())
+         << " to node " << ChordRing::toString(to.getId()) << std::endl;
+}
+
+void StreamTraceSink::onShuffleComplete(const Node& /* origin */, double varianceBefore, double varianceAfter) {
+    out_ << "Variance after optimization: " << varianceAfter << std::endl;
+    out_ << "Improvement: " << (varianceBefore - varianceAfter) / varianceBefore * 100.0 << "%" << std::endl;
+}
@@ -0,0 +1,72 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <iostream>
+#include "key_store.h"
+
+class Node;
+struct LookupResult;
+struct BatchResult;
+
+// Receives protocol events from every Node. Nodes are silent unless a sink
+// is installed with Node::setTraceSink, so lookups and inserts run without
+// any formatting or terminal I/O on the hot path.
+class TraceSink {
+public:
+    virtual ~TraceSink() {}
+
+    // A node created the ring (bootstrap == nullptr) or found its successor
+    virtual void onJoin(Node& /* node */, const Node* /* bootstrap */) {}
+
+    // A joining node finished building its finger table and pulling keys
+    virtual void onJoinComplete(Node& /* node */) {}
+
+    virtual void onLeave(Node& /* node */) {}
+
+    // The leaving node handed its range to successor. successor is null when
+    // the node was alone; predecessor is null when no other node links to it
+    virtual void onLeaveComplete(Node& /* node */, Node* /* predecessor */, Node* /* successor */) {}
+
+    virtual void onLookup(const Node& /* origin */, NodeId /* key */, const LookupResult& /* result */) {}
+
+    virtual void onInsert(const Node& /* origin */, NodeId /* key */, ByteView /* value */, const Node& /* owner */) {}
+
+    virtual void onRemove(const Node& /* origin */, NodeId /* key */, const Node& /* owner */, bool /* found */) {}
+
+    virtual void onMigrate(NodeId /* key */, const Node& /* from */, const Node& /* to */) {}
+
+    // A findBatch/insertBatch/removeBatch call finished; op names the call
+    virtual void onBatch(const Node& /* origin */, const char* /* op */, const BatchResult& /* result */) {}
+
+    // spaceShuffleOptimization started from origin; variance is of keys per node
+    virtual void onShuffle(const Node& /* origin */, double /* variance */) {}
+
+    // The shuffle moved key from a heavy node to a light one
+    virtual void onShuffleMigrate(NodeId /* key */, ByteView /* value */, const Node& /* from */, const Node& /* to */) {}
+
+    virtual void onShuffleComplete(const Node& /* origin */, double /* varianceBefore */, double /* varianceAfter */) {}
+};
+
+// Writes the human-readable log the demo in main.cpp prints
+class StreamTraceSink : public TraceSink {
+public:
+    explicit StreamTraceSink(std::ostream& out = std::cout) : out_(out) {}
+
+    void onJoin(Node& node, const Node* bootstrap) override;
+    void onJoinComplete(Node& node) override;
+    void onLeave(Node& node) override;
+    void onLeaveComplete(Node& node, Node* predecessor, Node* successor) override;
+    void onLookup(const Node& origin, NodeId key, const LookupResult& result) override;
+    void onInsert(const Node& origin, NodeId key, ByteView value, const Node& owner) override;
+    void onRemove(const Node& origin, NodeId key, const Node& owner, bool found) override;
+    void onMigrate(NodeId key, const Node& from, const Node& to) override;
+    void onBatch(const Node& origin, const char* op, const BatchResult& result) override;
+    void onShuffle(const Node& origin, double variance) override;
+    void onShuffleMigrate(NodeId key, ByteView value, const Node& from, const Node& to) override;
+    void onShuffleComplete(const Node& origin, double varianceBefore, double varianceAfter) override;
+
+private:
+    std::ostream& out_;
+};
+
+#endif
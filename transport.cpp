@@ -0,0 +1,370 @@
+#include "transport.h"
+#include <arpa/inet.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <unistd.h>
+#include <algorithm>
+
+const char* messageTypeName(uint8_t type) {
+    static const char* const names[MSG_TYPE_COUNT] = {
+        "unknown", "ping", "find_successor", "get_successor", "get_predecessor", "notify",
+        "transfer_keys", "store_keys", "get", "put", "remove", "leave", "stats", "release_keys", "route",
+        "route_reply"
+    };
+    type &= static_cast<uint8_t>(~kResponseBit);
+    return type < MSG_TYPE_COUNT ? names[type] : "unknown";
+}
+
+std::string NodeHandle::toString() const {
+    if (!valid()) {
+        return "none";
+    }
+    return std::to_string((ip >> 24) & 0xFF) + "." + std::to_string((ip >> 16) & 0xFF) + "." +
+           std::to_string((ip >> 8) & 0xFF) + "." + std::to_string(ip & 0xFF) + ":" +
+           std::to_string(port) + "/" + ChordRing::toString(id);
+}
+
+static void setNonBlocking(int fd) {
+    fcntl(fd, F_SETFL, fcntl(fd, F_GETFL, 0) | O_NONBLOCK);
+}
+
+static void setNoDelay(int fd) {
+    int one = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+}
+
+EventLoop::EventLoop() : epoll_(-1), listen_(-1), wake_(-1), port_(0), running_(false) {
+    epoll_ = epoll_create1(0);
+    wake_ = eventfd(0, EFD_NONBLOCK);
+    epoll_event ev = {};
+    ev.events = EPOLLIN;
+    ev.data.fd = wake_;
+    epoll_ctl(epoll_, EPOLL_CTL_ADD, wake_, &ev);
+}
+
+EventLoop::~EventLoop() {
+    for (auto& entry : connections_) {
+        close(entry.first);
+    }
+    if (listen_ >= 0) close(listen_);
+    if (wake_ >= 0) close(wake_);
+    if (epoll_ >= 0) close(epoll_);
+}
+
+bool EventLoop::listen(uint32_t ip, uint16_t port) {
+    listen_ = socket(AF_INET, SOCK_STREAM, 0);
+    if (listen_ < 0) {
+        return false;
+    }
+    int one = 1;
+    setsockopt(listen_, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+
+    sockaddr_in addr = {};
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(ip);
+    addr.sin_port = htons(port);
+    if (bind(listen_, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) < 0 || ::listen(listen_, 128) < 0) {
+        close(listen_);
+        listen_ = -1;
+        return false;
+    }
+
+    socklen_t len = sizeof(addr);
+    getsockname(listen_, reinterpret_cast<sockaddr*>(&addr), &len);
+    port_ = ntohs(addr.sin_port);
+
+    setNonBlocking(listen_);
+    epoll_event ev = {};
+    ev.events = EPOLLIN;
+    ev.data.fd = listen_;
+    epoll_ctl(epoll_, EPOLL_CTL_ADD, listen_, &ev);
+    return true;
+}
+
+void EventLoop::run() {
+    running_.store(true);
+    epoll_event events[64];
+    while (running_.load()) {
+        int n = epoll_wait(epoll_, events, 64, -1);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            break;
+        }
+        for (int i = 0; i < n; i++) {
+            int fd = events[i].data.fd;
+            if (fd == wake_) {
+                uint64_t drained;
+                ssize_t ignored = read(wake_, &drained, sizeof(drained));
+                (void)ignored;
+                continue;
+            }
+            if (fd == listen_) {
+                acceptAll();
+                continue;
+            }
+            auto it = connections_.find(fd);
+            if (it == connections_.end()) {
+                continue;
+            }
+            if (events[i].events & (EPOLLHUP | EPOLLERR)) {
+                closeConnection(fd);
+                continue;
+            }
+            if (events[i].events & EPOLLIN) {
+                readable(it->second);
+            }
+            it = connections_.find(fd);
+            if (it != connections_.end() && (events[i].events & EPOLLOUT)) {
+                flush(it->second);
+            }
+        }
+    }
+}
+
+void EventLoop::stop() {
+    running_.store(false);
+    uint64_t one = 1;
+    ssize_t ignored = write(wake_, &one, sizeof(one));
+    (void)ignored;
+}
+
+void EventLoop::acceptAll() {
+    while (true) {
+        int fd = accept(listen_, nullptr, nullptr);
+        if (fd < 0) {
+            return;
+        }
+        setNonBlocking(fd);
+        setNoDelay(fd);
+        epoll_event ev = {};
+        ev.events = EPOLLIN;
+        ev.data.fd = fd;
+        epoll_ctl(epoll_, EPOLL_CTL_ADD, fd, &ev);
+        Connection& conn = connections_[fd];
+        conn.fd = fd;
+    }
+}
+
+void EventLoop::readable(Connection& conn) {
+    uint8_t chunk[16384];
+    while (true) {
+        ssize_t n = read(conn.fd, chunk, sizeof(chunk));
+        if (n > 0) {
+            conn.in.insert(conn.in.end(), chunk, chunk + n);
+            continue;
+        }
+        if (n == 0 || (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)) {
+            closeConnection(conn.fd);
+            return;
+        }
+        if (errno == EINTR) continue;
+        break;
+    }
+
+    // Dispatch every complete frame in the buffer
+    size_t pos = 0;
+    while (true) {
+        uint32_t length;
+        uint8_t type;
+        uint32_t requestId;
+        if (!decodeHeader(conn.in.data() + pos, conn.in.size() - pos, &length, &type, &requestId)) {
+            break;
+        }
+        if (length > kMaxWirePayload) {
+            closeConnection(conn.fd);
+            return;
+        }
+        if (conn.in.size() - pos < kWireHeaderSize + length) {
+            break;
+        }
+        WireReader request(conn.in.data() + pos + kWireHeaderSize, length);
+        WireWriter reply;
+        if (handler_ && handler_(type, request, reply)) {
+            encodeFrame(static_cast<uint8_t>(type | kResponseBit), requestId, reply.data(), conn.out);
+        }
+        pos += kWireHeaderSize + length;
+    }
+    conn.in.erase(conn.in.begin(), conn.in.begin() + pos);
+    flush(conn);
+}
+
+void EventLoop::flush(Connection& conn) {
+    while (conn.outPos < conn.out.size()) {
+        ssize_t n = write(conn.fd, conn.out.data() + conn.outPos, conn.out.size() - conn.outPos);
+        if (n > 0) {
+            conn.outPos += n;
+            continue;
+        }
+        if (n < 0 && errno == EINTR) continue;
+        if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            break;
+        }
+        closeConnection(conn.fd);
+        return;
+    }
+
+    bool pending = conn.outPos < conn.out.size();
+    if (!pending) {
+        conn.out.clear();
+        conn.outPos = 0;
+    }
+    // Only ask for EPOLLOUT while a reply is stuck in the buffer
+    if (pending != conn.wantWrite) {
+        conn.wantWrite = pending;
+        epoll_event ev = {};
+        ev.events = pending ? EPOLLIN | EPOLLOUT : EPOLLIN;
+        ev.data.fd = conn.fd;
+        epoll_ctl(epoll_, EPOLL_CTL_MOD, conn.fd, &ev);
+    }
+}
+
+void EventLoop::closeConnection(int fd) {
+    epoll_ctl(epoll_, EPOLL_CTL_DEL, fd, nullptr);
+    close(fd);
+    connections_.erase(fd);
+}
+
+RpcClient::RpcClient(int timeoutMs)
+    : timeoutMs_(timeoutMs), nextRequestId_(1), bytesSent_(0), bytesReceived_(0) {
+    std::fill(sent_, sent_ + MSG_TYPE_COUNT, 0);
+}
+
+RpcClient::~RpcClient() {
+    for (auto& entry : connections_) {
+        close(entry.second);
+    }
+}
+
+uint64_t RpcClient::totalSent() const {
+    uint64_t total = 0;
+    for (uint64_t count : sent_) {
+        total += count;
+    }
+    return total;
+}
+
+int RpcClient::connectTo(const NodeHandle& to) {
+    uint64_t key = (static_cast<uint64_t>(to.ip) << 16) | to.port;
+    auto it = connections_.find(key);
+    if (it != connections_.end()) {
+        return it->second;
+    }
+
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (fd < 0) {
+        return -1;
+    }
+    timeval tv;
+    tv.tv_sec = timeoutMs_ / 1000;
+    tv.tv_usec = (timeoutMs_ % 1000) * 1000;
+    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+    setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &tv, sizeof(tv));
+    setNoDelay(fd);
+
+    sockaddr_in addr = {};
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(to.ip);
+    addr.sin_port = htons(to.port);
+    if (connect(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) < 0) {
+        close(fd);
+        return -1;
+    }
+    connections_[key] = fd;
+    return fd;
+}
+
+void RpcClient::disconnect(const NodeHandle& to) {
+    uint64_t key = (static_cast<uint64_t>(to.ip) << 16) | to.port;
+    auto it = connections_.find(key);
+    if (it != connections_.end()) {
+        close(it->second);
+        connections_.erase(it);
+    }
+}
+
+static bool readFully(int fd, uint8_t* data, size_t size) {
+    size_t done = 0;
+    while (done < size) {
+        ssize_t n = read(fd, data + done, size - done);
+        if (n > 0) {
+            done += n;
+        } else if (n < 0 && errno == EINTR) {
+            continue;
+        } else {
+            return false;
+        }
+    }
+    return true;
+}
+
+static bool writeFully(int fd, const uint8_t* data, size_t size) {
+    size_t done = 0;
+    while (done < size) {
+        ssize_t n = send(fd, data + done, size - done, MSG_NOSIGNAL);
+        if (n > 0) {
+            done += n;
+        } else if (n < 0 && errno == EINTR) {
+            continue;
+        } else {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool RpcClient::send(const NodeHandle& to, uint8_t type, const WireWriter& request) {
+    int fd = connectTo(to);
+    if (fd < 0) {
+        return false;
+    }
+    std::vector<uint8_t> frame;
+    encodeFrame(type, nextRequestId_++, request.data(), frame);
+    if (!writeFully(fd, frame.data(), frame.size())) {
+        disconnect(to);
+        return false;
+    }
+    sent_[type < MSG_TYPE_COUNT ? type : 0]++;
+    bytesSent_ += frame.size();
+    return true;
+}
+
+bool RpcClient::call(const NodeHandle& to, uint8_t type, const WireWriter& request, std::vector<uint8_t>* response) {
+    int fd = connectTo(to);
+    if (fd < 0) {
+        return false;
+    }
+
+    uint32_t requestId = nextRequestId_++;
+    std::vector<uint8_t> frame;
+    encodeFrame(type, requestId, request.data(), frame);
+    if (!writeFully(fd, frame.data(), frame.size())) {
+        disconnect(to);
+        return false;
+    }
+    sent_[type < MSG_TYPE_COUNT ? type : 0]++;
+    bytesSent_ += frame.size();
+
+    uint8_t header[kWireHeaderSize];
+    uint32_t length;
+    uint8_t replyType;
+    uint32_t replyId;
+    if (!readFully(fd, header, sizeof(header)) ||
+        !decodeHeader(header, sizeof(header), &length, &replyType, &replyId) ||
+        replyId != requestId || replyType != (type | kResponseBit) || length > kMaxWirePayload) {
+        disconnect(to);
+        return false;
+    }
+    response->resize(length);
+    if (!readFully(fd, response->data(), length)) {
+        disconnect(to);
+        return false;
+    }
+    bytesReceived_ += kWireHeaderSize + length;
+    return true;
+}
@@ -0,0 +1,122 @@
+#ifndef TRANSPORT_H
+#define TRANSPORT_H
+
+#include <stdint.h>
+#include <atomic>
+#include <functional>
+#include <unordered_map>
+#include <vector>
+#include "wire.h"
+
+// Single-threaded, non-blocking TCP server built on epoll. Requests are
+// decoded from per-connection buffers and handed to the handler, whose reply
+// is queued and flushed as the socket becomes writable. Handlers must only
+// touch local state: they run on the loop thread and never make RPCs.
+class EventLoop {
+public:
+    /**
+     * @param type: request message type.
+     * @param request: decoder over the request payload.
+     * @param reply: encoder for the response payload.
+     * @return whether to send a response.
+     */
+    typedef std::function<bool(uint8_t type, WireReader& request, WireWriter& reply)> Handler;
+
+    EventLoop();
+    ~EventLoop();
+
+    // Bind and listen on ip:port (host byte order); port 0 picks a free port
+    bool listen(uint32_t ip, uint16_t port);
+
+    uint16_t port() const {
+        return port_;
+    }
+
+    void setHandler(Handler handler) {
+        handler_ = handler;
+    }
+
+    // Serve until stop() is called
+    void run();
+
+    // Safe to call from any thread
+    void stop();
+
+private:
+    struct Connection {
+        int fd;
+        std::vector<uint8_t> in;
+        std::vector<uint8_t> out;
+        size_t outPos = 0;
+        bool wantWrite = false;
+    };
+
+    void acceptAll();
+    void readable(Connection& conn);
+    void flush(Connection& conn);
+    void closeConnection(int fd);
+
+    int epoll_;
+    int listen_;
+    int wake_;
+    uint16_t port_;
+    std::atomic<bool> running_;
+    Handler handler_;
+    std::unordered_map<int, Connection> connections_;
+};
+
+// Blocking request/response client with one cached connection per peer.
+// Calls time out instead of hanging on dead peers. Not thread-safe; give
+// each thread that issues RPCs its own client.
+class RpcClient {
+public:
+    explicit RpcClient(int timeoutMs = 1000);
+    ~RpcClient();
+
+    /**
+     * @param to: peer to call.
+     * @param type: request message type.
+     * @param request: request payload.
+     * @param response: receives the response payload.
+     * @return false if the peer could not be reached or timed out.
+     */
+    bool call(const NodeHandle& to, uint8_t type, const WireWriter& request, std::vector<uint8_t>* response);
+
+    // One-way message: returns once the request is written, and the peer
+    // sends no response. Succeeds for a peer that died since the connection
+    // was cached; the message is then lost.
+    bool send(const NodeHandle& to, uint8_t type, const WireWriter& request);
+
+    // Drop the cached connection to a peer
+    void disconnect(const NodeHandle& to);
+
+    // Requests sent, by message type
+    uint64_t sent(uint8_t type) const {
+        return sent_[type];
+    }
+
+    uint64_t totalSent() const;
+
+    uint64_t bytesSent() const {
+        return bytesSent_;
+    }
+
+    uint64_t bytesReceived() const {
+        return bytesReceived_;
+    }
+
+private:
+    int connectTo(const NodeHandle& to);
+
+    int timeoutMs_;
+    uint32_t nextRequestId_;
+    std::unordered_map<uint64_t, int> connections_;  // (ip << 16 | port) -> socket
+    uint64_t sent_[MSG_TYPE_COUNT];
+    uint64_t bytesSent_;
+    uint64_t bytesReceived_;
+};
+
+// 127.0.0.1 in host byte order
+const uint32_t kLoopback = 0x7F000001;
+
+#endif
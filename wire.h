@@ -0,0 +1,267 @@
+#ifndef WIRE_H
+#define WIRE_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include <string>
+#include <vector>
+#include "ring.h"
+#include "key_store.h"
+
+// Binary wire protocol shared by chord_net processes. Every message is a
+// fixed 9-byte header followed by the payload:
+//
+//   u32 payload length | u8 message type | u32 request id
+//
+// Integers are little-endian, ring ids use ChordRing::kBytes bytes and
+// byte strings are a u32 length followed by the bytes. A response carries
+// the request's id and type with kResponseBit set.
+
+enum MessageType : uint8_t {
+    MSG_PING = 1,
+    MSG_FIND_SUCCESSOR = 2,     // id -> u8 done, handle (owner if done, else next hop)
+    MSG_GET_SUCCESSOR = 3,      // -> handle
+    MSG_GET_PREDECESSOR = 4,    // -> handle (invalid if unknown)
+    MSG_NOTIFY = 5,             // handle -> nothing
+    MSG_TRANSFER_KEYS = 6,      // start, end, u32 max entries -> u8 done, next entries copied from (start, end]
+    MSG_STORE_KEYS = 7,         // entries -> nothing
+    MSG_GET = 8,                // id -> u8 found, value
+    MSG_PUT = 9,                // id, key, value -> nothing
+    MSG_REMOVE = 10,            // id -> u8 found
+    MSG_LEAVE = 11,             // leaving handle, its predecessor, its successor
+    MSG_STATS = 12,             // -> per-type message counters
+    MSG_RELEASE_KEYS = 13,      // start, end -> u32 entries dropped from (start, end]
+    MSG_ROUTE = 14,             // id, u32 tag, origin handle, u32 hops; one-way, forwarded towards the owner
+    MSG_ROUTE_REPLY = 15,       // u32 tag, owner handle, u32 hops; one-way, from the owner's predecessor to the origin
+    MSG_TYPE_COUNT = 16
+};
+
+const uint8_t kResponseBit = 0x80;
+const size_t kWireHeaderSize = 9;
+const uint32_t kMaxWirePayload = 64 * 1024 * 1024;
+
+// Key migration streams at most this many entries or bytes per message
+const uint32_t kMigrationBatchEntries = 256;
+const uint32_t kMigrationBatchBytes = 64 * 1024;
+
+const char* messageTypeName(uint8_t type);
+
+// Address plus ring id: how networked nodes refer to each other
+struct NodeHandle {
+    uint32_t ip = 0;      // IPv4 address in host byte order; 0 marks an invalid handle
+    uint16_t port = 0;
+    NodeId id = NodeId(0);
+
+    bool valid() const {
+        return port != 0;
+    }
+
+    bool operator==(const NodeHandle& other) const {
+        return ip == other.ip && port == other.port && id == other.id;
+    }
+
+    bool operator!=(const NodeHandle& other) const {
+        return !(*this == other);
+    }
+
+    std::string toString() const;
+};
+
+// Appends encoded values to a byte buffer
+class WireWriter {
+public:
+    void u8(uint8_t v) {
+        buf_.push_back(v);
+    }
+
+    void u16(uint16_t v) {
+        for (int i = 0; i < 2; i++) {
+            buf_.push_back(static_cast<uint8_t>(v >> (8 * i)));
+        }
+    }
+
+    void u32(uint32_t v) {
+        for (int i = 0; i < 4; i++) {
+            buf_.push_back(static_cast<uint8_t>(v >> (8 * i)));
+        }
+    }
+
+    void u64(uint64_t v) {
+        for (int i = 0; i < 8; i++) {
+            buf_.push_back(static_cast<uint8_t>(v >> (8 * i)));
+        }
+    }
+
+    void id(const NodeId& v) {
+        size_t at = buf_.size();
+        buf_.resize(at + ChordRing::kBytes);
+        ChordRing::toBytes(v, buf_.data() + at);
+    }
+
+    void bytes(ByteView v) {
+        u32(static_cast<uint32_t>(v.size));
+        buf_.insert(buf_.end(), v.data, v.data + v.size);
+    }
+
+    void handle(const NodeHandle& h) {
+        u32(h.ip);
+        u16(h.port);
+        id(h.id);
+    }
+
+    const std::vector<uint8_t>& data() const {
+        return buf_;
+    }
+
+    size_t size() const {
+        return buf_.size();
+    }
+
+private:
+    std::vector<uint8_t> buf_;
+};
+
+// Decodes values from a received payload. Reads past the end set a sticky
+// error flag and return zeros, so handlers check ok() once at the end.
+class WireReader {
+public:
+    WireReader(const uint8_t* data, size_t size) : data_(data), size_(size), pos_(0), ok_(true) {}
+
+    uint8_t u8() {
+        return need(1) ? data_[pos_++] : 0;
+    }
+
+    uint16_t u16() {
+        if (!need(2)) return 0;
+        uint16_t v = static_cast<uint16_t>(data_[pos_] | (data_[pos_ + 1] << 8));
+        pos_ += 2;
+        return v;
+    }
+
+    uint32_t u32() {
+        if (!need(4)) return 0;
+        uint32_t v = 0;
+        for (int i = 0; i < 4; i++) {
+            v |= static_cast<uint32_t>(data_[pos_ + i]) << (8 * i);
+        }
+        pos_ += 4;
+        return v;
+    }
+
+    uint64_t u64() {
+        if (!need(8)) return 0;
+        uint64_t v = 0;
+        for (int i = 0; i < 8; i++) {
+            v |= static_cast<uint64_t>(data_[pos_ + i]) << (8 * i);
+        }
+        pos_ += 8;
+        return v;
+    }
+
+    NodeId id() {
+        if (!need(ChordRing::kBytes)) return NodeId(0);
+        NodeId v = ChordRing::fromBytes(data_ + pos_);
+        pos_ += ChordRing::kBytes;
+        return v;
+    }
+
+    // View into the payload; valid as long as the payload buffer is
+    ByteView bytes() {
+        uint32_t len = u32();
+        if (!need(len)) return ByteView();
+        ByteView v(reinterpret_cast<const char*>(data_ + pos_), len);
+        pos_ += len;
+        return v;
+    }
+
+    NodeHandle handle() {
+        NodeHandle h;
+        h.ip = u32();
+        h.port = u16();
+        h.id = id();
+        return h;
+    }
+
+    bool ok() const {
+        return ok_;
+    }
+
+    bool atEnd() const {
+        return pos_ == size_;
+    }
+
+private:
+    bool need(size_t n) {
+        if (!ok_ || size_ - pos_ < n) {
+            ok_ = false;
+            return false;
+        }
+        return true;
+    }
+
+    const uint8_t* data_;
+    size_t size_;
+    size_t pos_;
+    bool ok_;
+};
+
+// Build a framed message from a payload
+inline void encodeFrame(uint8_t type, uint32_t requestId, const std::vector<uint8_t>& payload,
+                        std::vector<uint8_t>& out) {
+    size_t at = out.size();
+    out.resize(at + kWireHeaderSize);
+    uint32_t len = static_cast<uint32_t>(payload.size());
+    for (int i = 0; i < 4; i++) {
+        out[at + i] = static_cast<uint8_t>(len >> (8 * i));
+        out[at + 5 + i] = static_cast<uint8_t>(requestId >> (8 * i));
+    }
+    out[at + 4] = type;
+    out.insert(out.end(), payload.begin(), payload.end());
+}
+
+// Parse a frame header; returns false if fewer than kWireHeaderSize bytes
+inline bool decodeHeader(const uint8_t* data, size_t size, uint32_t* length, uint8_t* type, uint32_t* requestId) {
+    if (size < kWireHeaderSize) {
+        return false;
+    }
+    *length = 0;
+    *requestId = 0;
+    for (int i = 0; i < 4; i++) {
+        *length |= static_cast<uint32_t>(data[i]) << (8 * i);
+        *requestId |= static_cast<uint32_t>(data[5 + i]) << (8 * i);
+    }
+    *type = data[4];
+    return true;
+}
+
+// Key lists: u32 count, then id, key bytes and value bytes per entry
+inline void writeEntries(WireWriter& out, const KeyStore& entries) {
+    out.u32(static_cast<uint32_t>(entries.size()));
+    for (const KeyValue& kv : entries) {
+        out.id(kv.first);
+        out.bytes(kv.key);
+        out.bytes(kv.second);
+    }
+}
+
+// Store a key list into dest; *last, if given, receives the final entry's id
+inline uint32_t readEntries(WireReader& in, KeyStore& dest, NodeId* last) {
+    uint32_t count = in.u32();
+    uint32_t stored = 0;
+    for (uint32_t i = 0; i < count && in.ok(); i++) {
+        NodeId id = in.id();
+        ByteView key = in.bytes();
+        ByteView value = in.bytes();
+        if (in.ok()) {
+            dest.put(id, key, value);
+            stored++;
+            if (last) {
+                *last = id;
+            }
+        }
+    }
+    return stored;
+}
+
+#endif